@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	glm::quat ToQuat(const glm::vec4& value)
+	{
+		return glm::quat(value.w, value.x, value.y, value.z);
+	}
+}
+
+glm::mat4 Resource::JointPose::ToMatrix() const
+{
+	// T * R * S like glTF nodes
+	glm::mat4 matrix = glm::mat4_cast(rotation);
+	matrix[0] *= scale.x;
+	matrix[1] *= scale.y;
+	matrix[2] *= scale.z;
+	matrix[3] = glm::vec4(translation, 1.0f);
+	return matrix;
+}
+
+Resource::AnimationSampler::AnimationSampler()
+{
+}
+
+Resource::AnimationSampler::AnimationSampler(const Skeleton* skeleton, const AnimationClip* clip)
+	: _skeleton(skeleton), _clip(clip)
+{
+	if (_clip != nullptr)
+		_cursors.assign(_clip->channels.size(), 0);
+
+	uint32_t jointCount = _skeleton->GetJointCount();
+	_globalTransforms.resize(jointCount);
+	_skinningMatrices.assign(jointCount, glm::mat4(1.0f));
+	Sample(0.0f, false);
+}
+
+void Resource::AnimationSampler::Sample(float time, bool bLoop)
+{
+	if (_skeleton == nullptr)
+		return;
+
+	// assignment keeps the capacity, sampling does not allocate after the first frame
+	_pose = _skeleton->restPose;
+
+	if (_clip != nullptr && _clip->duration > 0.0f)
+	{
+		if (bLoop)
+		{
+			time = std::fmod(time, _clip->duration);
+			if (time < 0.0f)
+				time += _clip->duration;
+		}
+		else
+			time = std::clamp(time, 0.0f, _clip->duration);
+
+		for (size_t channel = 0; channel < _clip->channels.size(); channel++)
+		{
+			const AnimationChannel& source = _clip->channels[channel];
+			if (source.times.empty())
+				continue;
+
+			uint32_t key = FindKey(channel, time);
+			glm::vec4 value = source.values[key];
+			bool bBetweenKeys = key + 1 < source.times.size() && time > source.times[key];
+			if (bBetweenKeys && source.interpolation == AnimationInterpolation::Linear)
+			{
+				float span = source.times[key + 1] - source.times[key];
+				float t = span > 0.0f ? (time - source.times[key]) / span : 0.0f;
+				if (source.path == AnimationPath::Rotation)
+				{
+					glm::quat rotation = glm::slerp(ToQuat(source.values[key]), ToQuat(source.values[key + 1]), t);
+					value = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+				}
+				else
+					value = glm::mix(source.values[key], source.values[key + 1], t);
+			}
+
+			JointPose& pose = _pose[source.joint];
+			switch (source.path)
+			{
+			case AnimationPath::Translation:
+				pose.translation = glm::vec3(value);
+				break;
+			case AnimationPath::Rotation:
+				pose.rotation = glm::normalize(ToQuat(value));
+				break;
+			case AnimationPath::Scale:
+				pose.scale = glm::vec3(value);
+				break;
+			}
+		}
+	}
+
+	// parents come first, so every parent transform is final when its children read it
+	for (uint32_t joint = 0; joint < _skeleton->GetJointCount(); joint++)
+	{
+		int32_t parent = _skeleton->parents[joint];
+		glm::mat4 parentTransform = parent < 0 ? _skeleton->parentOffsets[joint] : _globalTransforms[parent] * _skeleton->parentOffsets[joint];
+		_globalTransforms[joint] = parentTransform * _pose[joint].ToMatrix();
+		_skinningMatrices[joint] = _globalTransforms[joint] * _skeleton->inverseBindMatrices[joint];
+	}
+}
+
+uint32_t Resource::AnimationSampler::FindKey(size_t channel, float time)
+{
+	const std::vector<float>& times = _clip->channels[channel].times;
+	uint32_t key = _cursors[channel];
+
+	// playback jumped back or wrapped around, search the whole channel once
+	if (key >= times.size() || times[key] > time)
+	{
+		auto next = std::upper_bound(times.begin(), times.end(), time);
+		key = next == times.begin() ? 0 : static_cast<uint32_t>(next - times.begin() - 1);
+	}
+
+	// moving forward usually passes one key at most
+	while (key + 1 < times.size() && times[key + 1] <= time)
+		key++;
+
+	_cursors[channel] = key;
+	return key;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <string>
+
+#include <glm/gtc/quaternion.hpp>
+
+namespace Resource
+{
+	// Joint indices are stored in 8 bits per influence
+	const uint32_t MAX_SKIN_JOINTS = 256;
+
+	// Local transform of a joint relative to its parent
+	struct JointPose
+	{
+		glm::vec3 translation = glm::vec3(0.0f);
+		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 scale = glm::vec3(1.0f);
+
+		glm::mat4 ToMatrix() const;
+	};
+
+	// Joint hierarchy of a skin, parents always come before their children so poses resolve in one pass
+	struct Skeleton
+	{
+		// -1 for roots
+		std::vector<int32_t> parents;
+		// model space to joint space in the bind pose
+		std::vector<glm::mat4> inverseBindMatrices;
+		// pose of the joints no animation channel touches
+		std::vector<JointPose> restPose;
+		// static transform of the nodes between a joint and its parent joint, or above a root, that are no joints themselves.
+		// Identity for most joints.
+		std::vector<glm::mat4> parentOffsets;
+
+		uint32_t GetJointCount() const { return static_cast<uint32_t>(parents.size()); }
+	};
+
+	enum class AnimationPath : uint8_t
+	{
+		Translation,
+		Rotation,
+		Scale,
+	};
+
+	enum class AnimationInterpolation : uint8_t
+	{
+		Step,
+		// rotations are interpolated with slerp
+		Linear,
+	};
+
+	// Keyframes of one property of one joint
+	struct AnimationChannel
+	{
+		uint32_t joint = 0;
+		AnimationPath path = AnimationPath::Translation;
+		AnimationInterpolation interpolation = AnimationInterpolation::Linear;
+		// seconds, ascending
+		std::vector<float> times;
+		// xyz for translation and scale, quaternion xyzw for rotation
+		std::vector<glm::vec4> values;
+	};
+
+	struct AnimationClip
+	{
+		std::string name;
+		// time of the last key of any channel
+		float duration = 0.0f;
+		std::vector<AnimationChannel> channels;
+	};
+
+	// Plays one clip on a skeleton and produces the joint matrices skinning reads.
+	// Every channel remembers the key it sampled last, so playback moving forward finds its keys without searching.
+	class AnimationSampler
+	{
+	public:
+		AnimationSampler();
+		AnimationSampler(const Skeleton* skeleton, const AnimationClip* clip);
+
+		// Poses the skeleton at the time, wrapped into the clip when bLoop is set and clamped otherwise.
+		// Without a clip the skeleton keeps its rest pose.
+		void Sample(float time, bool bLoop = true);
+
+	private:
+		uint32_t FindKey(size_t channel, float time);
+
+	public:
+#pragma region Getters
+
+		// model space, inverse bind matrices included, one per joint
+		const std::vector<glm::mat4>& GetSkinningMatrices() const { return _skinningMatrices; }
+
+#pragma endregion
+
+	private:
+		const Skeleton* _skeleton = nullptr;
+		const AnimationClip* _clip = nullptr;
+		// key before the last sampled time, per channel
+		std::vector<uint32_t> _cursors;
+		std::vector<JointPose> _pose;
+		// model space joint transforms, reused between samples
+		std::vector<glm::mat4> _globalTransforms;
+		std::vector<glm::mat4> _skinningMatrices;
+	};
+}
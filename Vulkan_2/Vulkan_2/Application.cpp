@@ -16,6 +16,19 @@
 #include "RenderPass.h"
 #include "Material.h"
 #include "Object.h"
+#include "ShaderPermutation.h"
+#include "PipelineCache.h"
+#include "BindlessTextureTable.h"
+#include "Descriptors.h"
+#include "ThreadPool.h"
+#include "AssetManager.h"
+#include "StagingRing.h"
+#include "MipGenerator.h"
+#include "Texture.h"
+#include "TextureStreamer.h"
+#include "MeshStreamer.h"
+#include "TextureArrayPool.h"
+#include "SkinningPass.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -25,12 +38,24 @@
 VkDevice Application::s_logicalDevice = VK_NULL_HANDLE;
 VkPhysicalDevice Application::s_physicalDevice = VK_NULL_HANDLE;
 VkPhysicalDeviceProperties Application::s_physicalDeviceProperties{};
+OptionalDeviceFeatures Application::s_optionalFeatures{};
 uint32_t* Application::TransferOperationQueueIndices = nullptr;
 VkCommandPool Application::_graphicsCommandPool = VK_NULL_HANDLE;
 VkCommandPool Application::_transferCommandPool = VK_NULL_HANDLE;
 Engine::Queue* Application::s_graphicsQueue = nullptr;
 Engine::Queue* Application::s_presentQueue = nullptr;
 Engine::Queue* Application::s_transferQueue = nullptr;
+Engine::BindlessTextureTable* Application::s_bindlessTextures = nullptr;
+Engine::ThreadPool* Application::s_threadPool = nullptr;
+Engine::AssetManager* Application::s_assetManager = nullptr;
+Engine::StagingRing* Application::s_stagingRing = nullptr;
+Engine::MipGenerator* Application::s_mipGenerator = nullptr;
+Resource::Texture* Application::s_placeholderTexture = nullptr;
+Engine::TextureStreamer* Application::s_textureStreamer = nullptr;
+Engine::MeshStreamer* Application::s_meshStreamer = nullptr;
+Engine::TextureArrayPool* Application::s_textureArrays = nullptr;
+Engine::SkinningPass* Application::s_skinningPass = nullptr;
+Engine::DescriptorSetCache* Application::s_descriptorSetCache = nullptr;
 
 Application::Application()
 {
@@ -70,6 +95,7 @@ Application::Application()
 	s_transferQueue = new Engine::Queue();
 	_graphicsPipeline = new Engine::GraphicsPipeline();
 	_renderPass = new Engine::RenderPass();
+	_pipelineCache = new Engine::PipelineCache();
 	_object1 = new Object();
 }
 
@@ -81,6 +107,18 @@ void Application::Run()
 	Cleanup();
 }
 
+void Application::Initialize()
+{
+	InitWindow();
+	InitVulkan();
+}
+
+void Application::Shutdown()
+{
+	vkDeviceWaitIdle(s_logicalDevice);
+	Cleanup();
+}
+
 void Application::InitWindow()
 {
 	// init GLFW lib
@@ -98,6 +136,9 @@ void Application::InitWindow()
 
 void Application::InitVulkan()
 {
+	s_threadPool = new Engine::ThreadPool();
+	s_assetManager = new Engine::AssetManager();
+
 	CreateInstance();
 	SetupDebugMessenger();
 	CreateSurface();
@@ -107,16 +148,24 @@ void Application::InitVulkan()
 	CreateImageViews();
 	CreateRenderPass();
 	CreateDescriptorSetLayout();
+	CreatePipelineCache();
 	CreateGraphicsPipeline();
 	CreateCommandPools();
+	CreateStagingRing();
+	CreateMipGenerator();
+	CreateTextureStreamer();
+	CreateMeshStreamer();
+	CreateTextureArrayPool();
+	CreateSkinningPass();
 	CreateDepthResources();
 	CreateFrameBuffers();
 	CreateTextureImage();
 	CreateTextureImageView();
 	CreateTextureSampler();
+	CreatePlaceholderTexture();
 	CreateDataBuffer();
 	CreateUniformBuffers();
-	CreateDescriptorPool();
+	CreateDescriptorAllocators();
 	CreateDescriptorSets();
 	CreateCommandBuffer();
 	CreateSyncObjects();
@@ -152,15 +201,48 @@ void Application::Cleanup()
 	delete _material;
 
 	delete _object1;
+	// after every object released its handles, before the bindless table the materials unregister from
+	delete s_assetManager;
+	delete s_placeholderTexture;
+	// after every streamed texture unregistered
+	delete s_textureStreamer;
+	// after every mesh left its queue
+	delete s_meshStreamer;
+	// after every packed texture freed its layer
+	delete s_textureArrays;
+	// runs the texture decodes still queued, they query the physical device
+	delete s_threadPool;
 
 	delete _textureSampler;
 
 	delete _depthImage;
 
-	vkDestroyDescriptorPool(s_logicalDevice, _descriptorPool, nullptr);
+	// waits for its last copies, before the transfer pool its command buffers come from
+	delete s_stagingRing;
+	delete s_mipGenerator;
+	// after every object destroyed its skin instance
+	delete s_skinningPass;
+
+	delete s_descriptorSetCache;
+	s_descriptorSetCache = nullptr;
+	delete _descriptorAllocator;
+	for (Engine::DescriptorAllocator* allocator : _frameDescriptorAllocators)
+	{
+		delete allocator;
+	}
 	vkDestroyDescriptorSetLayout(s_logicalDevice, _descriptorSetLayout, nullptr);
+	// the bindless table owns the material layout in bindless mode
+	if (s_bindlessTextures != nullptr)
+		delete s_bindlessTextures;
+	else
+		vkDestroyDescriptorSetLayout(s_logicalDevice, _materialSetLayout, nullptr);
 
 	delete _graphicsPipeline;
+	delete _shaderProgram;
+
+	// persist every variant compiled this run
+	_pipelineCache->SavePipelineCache();
+	delete _pipelineCache;
 
 	delete _renderPass;
 
@@ -181,6 +263,7 @@ void Application::Cleanup()
 		DestroyDebugUtilsMessengerEXT(_instance, _debugMessenger, nullptr);
 
 	vkDestroyInstance(_instance, nullptr);
+
 	glfwDestroyWindow(_window);
 
 	glfwTerminate();
@@ -201,7 +284,8 @@ void Application::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_API_VERSION(1, 0, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_API_VERSION(1, 0, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// 1.2 for vkGetPhysicalDeviceFeatures2 and the optional feature structs
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -261,14 +345,45 @@ void Application::CreateLogicalDevice()
 	// To get features from physical device
 	//vkGetPhysicalDeviceFeatures(s_physicalDevice, &physicalDeviceFeatures);
 	physicalDeviceFeatures.samplerAnisotropy = VK_TRUE;
+	physicalDeviceFeatures.textureCompressionBC = s_optionalFeatures.textureCompressionBC ? VK_TRUE : VK_FALSE;
 
 	VkDeviceCreateInfo deviceCreateInfo{};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.pQueueCreateInfos = logicalDeviceQueueCreateInfos.data();
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(logicalDeviceQueueCreateInfos.size());
 	deviceCreateInfo.pEnabledFeatures = &physicalDeviceFeatures;
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+	std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	void* featuresChain = nullptr;
+
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+	graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	if (s_optionalFeatures.graphicsPipelineLibrary)
+	{
+		enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+		graphicsPipelineLibraryFeatures.pNext = featuresChain;
+		featuresChain = &graphicsPipelineLibraryFeatures;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+	descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	if (s_optionalFeatures.descriptorIndexing)
+	{
+		descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		descriptorIndexingFeatures.pNext = featuresChain;
+		featuresChain = &descriptorIndexingFeatures;
+	}
+
+	deviceCreateInfo.pNext = featuresChain;
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 #pragma region DEPRICATED AND IGNORED
 	// DEPRICATED AND IGNORED BY NEW VULKAN VERSIONS
@@ -453,6 +568,8 @@ void Application::PickPhysicalDevice()
 	TransferOperationQueueIndices = transferOpsQueueFamilyIndices;
 
 	vkGetPhysicalDeviceProperties(s_physicalDevice, &s_physicalDeviceProperties);
+
+	QueryOptionalDeviceFeatures(s_physicalDevice);
 }
 
 void Application::CreateSwapChain()
@@ -546,58 +663,82 @@ void Application::CreateDescriptorSetLayout()
 
 #pragma endregion
 
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = 1;
+	layoutCreateInfo.pBindings = &uboLayoutBinding;
+	
+	if(vkCreateDescriptorSetLayout(s_logicalDevice, &layoutCreateInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create descriptor set layout!!!");
+	}
+
+	if (s_optionalFeatures.descriptorIndexing)
+	{
+		// Every texture lives in one array, selected per draw by its slot index
+		s_bindlessTextures = new Engine::BindlessTextureTable();
+		s_bindlessTextures->CreateDescriptorSetLayout(s_optionalFeatures.maxBindlessTextures);
+		_materialSetLayout = s_bindlessTextures->GetDescriptorSetLayout();
+		_globalShaderFeatures |= Engine::SHADER_FEATURE_BINDLESS;
+		return;
+	}
+
 #pragma region Sampler
 
 	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
 	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	// Sampler is bound to 1
-	samplerLayoutBinding.binding = 1;
+	// Sampler is bound to 0 of the material set
+	samplerLayoutBinding.binding = 0;
 	samplerLayoutBinding.descriptorCount = 1;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 
 #pragma endregion
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+	VkDescriptorSetLayoutCreateInfo materialLayoutCreateInfo{};
+	materialLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	materialLayoutCreateInfo.bindingCount = 1;
+	materialLayoutCreateInfo.pBindings = &samplerLayoutBinding;
 
-	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
-	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutCreateInfo.pBindings = bindings.data();
-	
-	if(vkCreateDescriptorSetLayout(s_logicalDevice, &layoutCreateInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS)
+	if(vkCreateDescriptorSetLayout(s_logicalDevice, &materialLayoutCreateInfo, nullptr, &_materialSetLayout) != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create descriptor set layout!!!");
+		throw std::runtime_error("Failed to create material descriptor set layout!!!");
 	}
 }
 
-void Application::CreateGraphicsPipeline()
+void Application::CreatePipelineCache()
 {
-	std::vector<char> vertShaderCode = ReadFile("shaders/vert.spv");
-	std::vector<char> fragShaderCode = ReadFile("shaders/frag.spv");
-
-	VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
-
-	VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
-	vertShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageCreateInfo.module = vertShaderModule;
-	vertShaderStageCreateInfo.pName = "main";
-	vertShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-
-	VkPipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
-	fragShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageCreateInfo.module = fragShaderModule;
-	fragShaderStageCreateInfo.pName = "main";
-	fragShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCreateInfo, fragShaderStageCreateInfo };
-
-	_graphicsPipeline->CreateGraphicsPipeline(shaderStages, _descriptorSetLayout, _renderPass->GetRenderPass());
+	_pipelineCache->CreatePipelineCache("pipeline_cache.bin");
+}
 
-	// Destroy shader module as its no longer required after creating graphics pipeline
-	vkDestroyShaderModule(s_logicalDevice, vertShaderModule, nullptr);
-	vkDestroyShaderModule(s_logicalDevice, fragShaderModule, nullptr);
+void Application::CreateGraphicsPipeline()
+{
+	// Features every shader can be permuted on. Specialization constants share one SPIR-V module,
+	// defines need a precompiled module per combination (see shaders/compile.bat)
+	Engine::Shader* vertexShader = new Engine::Shader("vert", VK_SHADER_STAGE_VERTEX_BIT, {
+		{ Engine::SHADER_FEATURE_VERTEX_COLOR, Engine::ShaderFeatureKind::SpecializationConstant, "USE_VERTEX_COLOR", 1 },
+		{ Engine::SHADER_FEATURE_DEPTH_ONLY, Engine::ShaderFeatureKind::Define, "DEPTH_ONLY" },
+	});
+	Engine::Shader* fragmentShader = new Engine::Shader("frag", VK_SHADER_STAGE_FRAGMENT_BIT, {
+		{ Engine::SHADER_FEATURE_TEXTURE, Engine::ShaderFeatureKind::SpecializationConstant, "USE_TEXTURE", 0 },
+		{ Engine::SHADER_FEATURE_ALPHA_TEST, Engine::ShaderFeatureKind::Define, "ALPHA_TEST" },
+		{ Engine::SHADER_FEATURE_BINDLESS, Engine::ShaderFeatureKind::Define, "BINDLESS" },
+	});
+	_shaderProgram = new Engine::ShaderProgram(vertexShader, fragmentShader);
+
+	std::vector<VkDescriptorSetLayout> setLayouts = { _descriptorSetLayout, _materialSetLayout };
+
+	// Per draw data skips descriptors entirely
+	VkPushConstantRange drawPushConstantRange{};
+	drawPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	drawPushConstantRange.offset = 0;
+	drawPushConstantRange.size = sizeof(DrawPushConstants);
+	std::vector<VkPushConstantRange> pushConstantRanges = { drawPushConstantRange };
+
+	// Shader modules are kept alive by the program since variants are created on demand.
+	// The default variant uses the layout meshes are imported with by default
+	_graphicsPipeline->CreateGraphicsPipeline(_shaderProgram, setLayouts, pushConstantRanges, _renderPass->GetRenderPass(), _pipelineCache->Get(),
+		Engine::SHADER_FEATURE_TEXTURE | _globalShaderFeatures, Resource::MeshImportSettings().vertexFormat);
 }
 
 void Application::CreateRenderPass()
@@ -657,6 +798,37 @@ void Application::CreateCommandPools()
 	}
 }
 
+void Application::CreateStagingRing()
+{
+	s_stagingRing = new Engine::StagingRing();
+	s_stagingRing->CreateStagingRing(STAGING_RING_SIZE);
+}
+
+void Application::CreateMipGenerator()
+{
+	s_mipGenerator = new Engine::MipGenerator();
+}
+
+void Application::CreateTextureStreamer()
+{
+	s_textureStreamer = new Engine::TextureStreamer();
+}
+
+void Application::CreateMeshStreamer()
+{
+	s_meshStreamer = new Engine::MeshStreamer();
+}
+
+void Application::CreateTextureArrayPool()
+{
+	s_textureArrays = new Engine::TextureArrayPool();
+}
+
+void Application::CreateSkinningPass()
+{
+	s_skinningPass = new Engine::SkinningPass();
+}
+
 void Application::CreateDepthResources()
 {
 	VkFormat depthFormat = FindSupportedDepthFormat();
@@ -739,6 +911,20 @@ void Application::CreateTextureSampler()
 {
 	_textureSampler = new Engine::Sampler();
 	_textureSampler->CreateSampler();
+
+	// The table has to exist before any material registers its texture
+	if (s_bindlessTextures != nullptr)
+	{
+		s_bindlessTextures->CreateDescriptorSet();
+		s_bindlessTextures->SetSampler(_textureSampler->Get());
+	}
+}
+
+void Application::CreatePlaceholderTexture()
+{
+	// after the bindless table, every texture still loading hands out its slot
+	const uint8_t white[4] = { 255, 255, 255, 255 };
+	s_placeholderTexture = new Resource::Texture(white);
 }
 
 void Application::CreateVertexBuffer()
@@ -803,46 +989,32 @@ void Application::CreateUniformBuffers()
 	}
 }
 
-void Application::CreateDescriptorPool()
+void Application::CreateDescriptorAllocators()
 {
-	std::array<VkDescriptorPoolSize, 2>  poolSize{};
-	poolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	poolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	// TODO: Remove this arbitrary value: 2 (number of materials)
-	poolSize[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 1;
+	// Descriptors per set for every type the set layouts use, the pools grow as more sets are needed
+	std::vector<Engine::DescriptorPoolSizeRatio> poolRatios = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
+	};
 
-	VkDescriptorPoolCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	createInfo.poolSizeCount = static_cast<uint32_t>(poolSize.size());
-	createInfo.pPoolSizes = poolSize.data();
-	createInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	// Material sets, written once and reused through the cache until a texture drops its image view
+	_descriptorAllocator = new Engine::DescriptorAllocator();
+	_descriptorAllocator->CreateDescriptorAllocator(16, poolRatios, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+	s_descriptorSetCache = new Engine::DescriptorSetCache(_descriptorAllocator);
 
-	if(vkCreateDescriptorPool(s_logicalDevice, &createInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+	// Sets only valid for a single frame, reset wholesale once the frame's fence has signaled.
+	// They never go through the cache, so nothing holds on to them past the reset.
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		throw std::runtime_error("Failed to create descriptor pool!!!");
+		_frameDescriptorAllocators[i] = new Engine::DescriptorAllocator();
+		_frameDescriptorAllocators[i]->CreateDescriptorAllocator(16, poolRatios);
 	}
 }
 
 void Application::CreateDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, _descriptorSetLayout);
-	int numberOfDescriptorSets = 1 + (1); // 1 UBO descriptor + num of materials(1)
-	VkDescriptorSetAllocateInfo allocateInfo{};
-	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocateInfo.descriptorPool = _descriptorPool;
-	// TODO: Remove this arbitrary value: 2 (1 UBO descriptor + num of materials(2) )
-	allocateInfo.descriptorSetCount = static_cast<uint32_t>(numberOfDescriptorSets);
-	allocateInfo.pSetLayouts = layouts.data();
-
-	_descriptorSets.resize(numberOfDescriptorSets);
-	if(vkAllocateDescriptorSets(s_logicalDevice, &allocateInfo, _descriptorSets.data()) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate descriptor sets!!!");
-	}
-
-	// Update descriptor sets
-	UpdateDescriptorSets();
+	// Warm the cache so the first frames do not pay for descriptor writes
+	GetMaterialDescriptorSet(_object1->GetMaterial());
 }
 
 void Application::CreateDataBuffer()
@@ -966,6 +1138,87 @@ bool Application::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 	return requiredExtensions.empty();
 }
 
+bool Application::CheckDeviceExtensionSupport(VkPhysicalDevice device, const char* extension)
+{
+	uint32_t extensionsCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionsCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionsCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionsCount, availableExtensions.data());
+
+	for (const VkExtensionProperties& availableExtension : availableExtensions)
+	{
+		if (strcmp(availableExtension.extensionName, extension) == 0)
+			return true;
+	}
+	return false;
+}
+
+void Application::QueryOptionalDeviceFeatures(VkPhysicalDevice device)
+{
+	s_optionalFeatures = {};
+
+	if (CheckDeviceExtensionSupport(device, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+		CheckDeviceExtensionSupport(device, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+		graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &graphicsPipelineLibraryFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT graphicsPipelineLibraryProperties{};
+		graphicsPipelineLibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &graphicsPipelineLibraryProperties;
+		vkGetPhysicalDeviceProperties2(device, &properties);
+
+		s_optionalFeatures.graphicsPipelineLibrary = graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+		s_optionalFeatures.graphicsPipelineLibraryFastLinking = graphicsPipelineLibraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+	}
+
+	VkPhysicalDeviceFeatures deviceFeatures;
+	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+	s_optionalFeatures.textureCompressionBC = deviceFeatures.textureCompressionBC == VK_TRUE;
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+	// descriptor indexing is core in 1.2
+	if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+		descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &descriptorIndexingFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{};
+		descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &descriptorIndexingProperties;
+		vkGetPhysicalDeviceProperties2(device, &properties);
+
+		s_optionalFeatures.descriptorIndexing =
+			descriptorIndexingFeatures.runtimeDescriptorArray &&
+			descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+			descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+			descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+			descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+			descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount;
+
+		s_optionalFeatures.maxBindlessTextures = std::min({ MAX_BINDLESS_TEXTURES,
+			descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+			descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+	}
+}
+
 QueueFamilyIndices Application::FindQueueFamily(VkPhysicalDevice device, bool bExclusivelyCheckForTransfer)
 {
 	QueueFamilyIndices indices;
@@ -1222,47 +1475,22 @@ void Application::CopyBufferToImage(Engine::Buffer* buffer, Engine::Image* image
 	EndSingleTimeCommands(commandBuffer);
 }
 
-void Application::UpdateDescriptorSets()
+VkDescriptorSet Application::AllocateFrameDescriptorSet(uint32_t frame)
 {
-	int numOfMaterals = 1;
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-	{
-		for (size_t j = 0; j < numOfMaterals; j++)
-		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = _uniformBuffers[i]->GetBuffer();
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
-
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = /*_textureImage->GetImageView()*/ _object1->GetMaterial()->GetTextureImage()->GetImageView();
-			imageInfo.sampler = _textureSampler->Get();
-
-			std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = _descriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].pBufferInfo = &bufferInfo;
-			descriptorWrites[0].pImageInfo = nullptr;
-			descriptorWrites[0].pTexelBufferView = nullptr;
-
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = _descriptorSets[i];
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[1].pBufferInfo = nullptr;
-			descriptorWrites[1].pImageInfo = &imageInfo;
-			descriptorWrites[1].pTexelBufferView = nullptr;
-
-			vkUpdateDescriptorSets(s_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-		}
-	}
+	Engine::DescriptorSetBuilder builder(_descriptorSetLayout);
+	builder.BindBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _uniformBuffers[frame]->GetBuffer(), 0, sizeof(UniformBufferObject));
+	return builder.Build(_frameDescriptorAllocators[frame]);
+}
+
+VkDescriptorSet Application::GetMaterialDescriptorSet(Resource::Material* material)
+{
+	// Bindless mode has no per material sets, the texture slot was registered when the material loaded
+	if (s_bindlessTextures != nullptr)
+		return s_bindlessTextures->GetDescriptorSet();
+
+	Engine::DescriptorSetBuilder builder(_materialSetLayout);
+	builder.BindImage(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, material->GetTextureImageView(), _textureSampler->Get(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	return s_descriptorSetCache->GetDescriptorSet(builder);
 }
 
 VkCommandBuffer Application::BeginSingleTimeCommands()
@@ -1379,10 +1607,18 @@ void Application::RecordCommandBuffer(VkCommandBuffer commmandBuffer, uint32_t s
 	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassBeginInfo.pClearValues = clearValues.data();
 
+	// Swap streamed textures to the levels last frame's draws asked for. The copies run ahead of this frame's draws,
+	// the old images and the cached material sets pointing at them are kept until no frame in flight can use them.
+	if (s_textureStreamer->Update(commmandBuffer))
+		s_assetManager->RefreshMemoryUsage();
+
+	// Skinned positions for every pass of the frame, dispatches cannot be recorded inside the render pass
+	s_skinningPass->Record(commmandBuffer, _currentFrame);
+
 	// Begin recording commands
 	vkCmdBeginRenderPass(commmandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	vkCmdBindPipeline(commmandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline->GetGraphicsPipeline());
+	Resource::Mesh* mesh = _object1->GetMesh();
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
@@ -1399,19 +1635,9 @@ void Application::RecordCommandBuffer(VkCommandBuffer commmandBuffer, uint32_t s
 	scissor.offset = { 0, 0 };
 	vkCmdSetScissor(commmandBuffer, 0, 1, &scissor);
 
-	// Bind vertex buffer to the command buffer
-	VkDeviceSize offsets[] = { _object1->GetMesh()->GetDataBuffer()->GetVertexOffset() };
-	vkCmdBindVertexBuffers(commmandBuffer, 0, 1, &_object1->GetMesh()->GetDataBuffer()->GetBuffer(), offsets);
-	// Bind index buffer to the command buffer
-	vkCmdBindIndexBuffer(commmandBuffer, _object1->GetMesh()->GetDataBuffer()->GetBuffer(), _object1->GetMesh()->GetDataBuffer()->GetIndexOffset(), VK_INDEX_TYPE_UINT32);
-
-	// Bind UBOs and Textures
-	int numOfMaterials = 1;
-	int materialIndex = 0;
-	vkCmdBindDescriptorSets(commmandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline->GetPipelineLayout(), 0, 1, &_descriptorSets[_currentFrame * numOfMaterials + materialIndex], 0, nullptr);
-
-	// Draw :)
-	vkCmdDrawIndexed(commmandBuffer, static_cast<uint32_t>(_object1->GetMesh()->GetIndices().size()), 1, 0, 0, 0);
+	// A mesh still streaming in is skipped, the pass only clears
+	if (mesh->IsResident())
+		RecordObjectDraw(commmandBuffer, mesh);
 
 	vkCmdEndRenderPass(commmandBuffer);
 
@@ -1419,20 +1645,114 @@ void Application::RecordCommandBuffer(VkCommandBuffer commmandBuffer, uint32_t s
 		throw std::runtime_error("Failed to end recording Command Buffer!!!");
 }
 
+void Application::RecordObjectDraw(VkCommandBuffer commmandBuffer, Resource::Mesh* mesh)
+{
+	// Index ranges to draw, shared by the depth prepass and the shading pass
+	const Resource::MeshLod& lod = mesh->GetLod(_object1->GetLod());
+	_drawRanges.clear();
+	if (lod.meshletCount == 0)
+	{
+		_drawRanges.push_back({ lod.firstIndex, lod.indexCount });
+	}
+	else
+	{
+		// Only the meshlets in view and facing the camera, the bounds are in object space so the culling uses the unquantized model matrix
+		Engine::CullView cullView = Engine::CullView::Create(_object1->GetTransform()->GetModelMatrix(), GetProjectionMatrix() * GetViewMatrix(), _cameraPosition);
+		Engine::MeshletCuller::Cull(mesh->GetMeshlets(), mesh->GetMeshletBounds(), lod.firstMeshlet, lod.meshletCount, cullView, _drawRanges);
+	}
+
+	// Bind index buffer to the command buffer
+	vkCmdBindIndexBuffer(commmandBuffer, mesh->GetDataBuffer()->GetBuffer(), mesh->GetDataBuffer()->GetIndexOffset(), mesh->GetIndexType());
+
+	// Bind UBOs
+	VkDescriptorSet frameSet = AllocateFrameDescriptorSet(_currentFrame);
+	vkCmdBindDescriptorSets(commmandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline->GetPipelineLayout(), 0, 1, &frameSet, 0, nullptr);
+
+	// Per draw data
+	DrawPushConstants pushConstants{};
+	// quantized positions are mapped back to object space before the object transform
+	pushConstants.model = _object1->GetTransform()->GetModelMatrix() * mesh->GetDequantizationMatrix();
+	pushConstants.textureIndex = _object1->GetMaterial()->GetTextureIndex();
+	pushConstants.textureLayer = _object1->GetMaterial()->GetTextureLayer();
+	vkCmdPushConstants(commmandBuffer, _graphicsPipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawPushConstants), &pushConstants);
+
+	uint32_t streamCount = mesh->GetVertexFormat().GetStreamCount();
+	std::array<VkBuffer, MAX_VERTEX_STREAMS> vertexBuffers;
+	std::array<VkDeviceSize, MAX_VERTEX_STREAMS> offsets;
+	for (uint32_t stream = 0; stream < streamCount; stream++)
+	{
+		vertexBuffers[stream] = mesh->GetDataBuffer()->GetBuffer();
+		offsets[stream] = mesh->GetStreamOffset(stream);
+	}
+
+	// A skinned mesh draws the positions posed for this frame instead of its bind pose
+	if (Engine::SkinInstance* skin = _object1->GetSkin())
+	{
+		vertexBuffers[0] = skin->outputs[_currentFrame]->GetBuffer();
+		offsets[0] = 0;
+	}
+
+	// Depth prepass: only the position stream is bound and only the vertex shader runs. Alpha tested materials are left out,
+	// without a fragment stage the texels the shading pass discards would still write depth, they lay down their own there.
+	Engine::ShaderFeatureFlags materialFeatures = _object1->GetMaterial()->GetShaderFeatures() | _globalShaderFeatures;
+	if (DEPTH_PREPASS && (materialFeatures & Engine::SHADER_FEATURE_ALPHA_TEST) == 0)
+	{
+		vkCmdBindPipeline(commmandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline->GetGraphicsPipeline(Engine::SHADER_FEATURE_DEPTH_ONLY, mesh->GetVertexFormat()));
+		vkCmdBindVertexBuffers(commmandBuffer, 0, 1, vertexBuffers.data(), offsets.data());
+		for (const Engine::DrawRange& range : _drawRanges)
+			vkCmdDrawIndexed(commmandBuffer, range.indexCount, 1, range.firstIndex, 0, 0);
+	}
+
+	// Pick the permutation the material asks for, with the vertex layout of the mesh
+	vkCmdBindPipeline(commmandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline->GetGraphicsPipeline(materialFeatures, mesh->GetVertexFormat()));
+
+	// Bind vertex buffer to the command buffer, one binding per stream of the vertex format
+	vkCmdBindVertexBuffers(commmandBuffer, 0, streamCount, vertexBuffers.data(), offsets.data());
+
+	// Bind Textures: the bindless table once per frame, otherwise the set of the material
+	VkDescriptorSet materialSet = GetMaterialDescriptorSet(_object1->GetMaterial());
+	vkCmdBindDescriptorSets(commmandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline->GetPipelineLayout(), 1, 1, &materialSet, 0, nullptr);
+
+	// Draw :)
+	for (const Engine::DrawRange& range : _drawRanges)
+		vkCmdDrawIndexed(commmandBuffer, range.indexCount, 1, range.firstIndex, 0, 0);
+}
+
 void Application::UpdateUniformBuffer(uint32_t currentImage)
+{
+	UniformBufferObject ubo{};
+	ubo.view = GetViewMatrix();
+	ubo.proj = GetProjectionMatrix();
+	memcpy(_uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+}
+
+glm::mat4 Application::GetViewMatrix() const
+{
+	return glm::lookAt(_cameraPosition, glm::vec3(0, 0, 0), glm::vec3(0, 1.0f, 0.0f));
+}
+
+glm::mat4 Application::GetProjectionMatrix() const
+{
+	glm::mat4 proj = glm::perspective(glm::radians(_cameraFieldOfView), _swapChainExtent.width / (float)_swapChainExtent.height, 0.1f, 20.0f);
+	// flip the scaling factor
+	proj[1][1] *= -1;
+	return proj;
+}
+
+void Application::UpdateObjects()
 {
 	static auto startTime = std::chrono::high_resolution_clock::now();
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	// time in seconds since rendering has started with floating point 
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f),  time * glm::radians(90.0f), glm::vec3(0, 1.0f, 0.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 0.0f, 15.0f), glm::vec3(0, 0, 0), glm::vec3(0, 1.0f, 0.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), _swapChainExtent.width / (float)_swapChainExtent.height, 0.1f, 20.0f);
-	// flip the scaling factor
-	ubo.proj[1][1] *= -1;
-	memcpy(_uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	// rotation is in degrees
+	_object1->GetTransform()->SetRotation(glm::vec3(0.0f, time * 90.0f, 0.0f));
+	_object1->UpdateAnimation(time);
+
+	// pixels covered by one world unit at distance 1
+	float projectionScale = _swapChainExtent.height / (2.0f * std::tan(glm::radians(_cameraFieldOfView) * 0.5f));
+	_object1->UpdateLod(_cameraPosition, projectionScale);
 }
 
 void Application::DrawFrame()
@@ -1440,6 +1760,23 @@ void Application::DrawFrame()
 	// Wait for the previous frame to finish rendering
 	vkWaitForFences(s_logicalDevice, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
 
+	// Pick up optimized pipeline links that finished in the background
+	_graphicsPipeline->Update();
+
+	// Free the material sets dropped MAX_FRAMES_IN_FLIGHT frames ago
+	s_descriptorSetCache->Update();
+
+	// The GPU is done with this frame's transient descriptor sets
+	_frameDescriptorAllocators[_currentFrame]->ResetPools();
+
+	// Unload meshes and materials no object has used for MAX_FRAMES_IN_FLIGHT frames, and the device data of
+	// resources nobody drew recently while over the budget. The other frame in flight keeps its material sets,
+	// an unloaded texture only drops the cached sets of its own view and they are freed once no frame can bind them.
+	s_assetManager->Update();
+
+	// Start importing the queued meshes nearest to last frame's objects
+	s_meshStreamer->Update();
+
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(s_logicalDevice, _swapChain, UINT64_MAX, _imageReadySemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
 	if(result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -1458,6 +1795,8 @@ void Application::DrawFrame()
 	// Use 0 as flag to make the command buffer hold onto the memory to be reused in the next recording
 	vkResetCommandBuffer(_commandBuffers[_currentFrame], 0);
 
+	// The model matrices are pushed while recording
+	UpdateObjects();
 	RecordCommandBuffer(_commandBuffers[_currentFrame], imageIndex);
 
 	UpdateUniformBuffer(_currentFrame);
@@ -1,5 +1,6 @@
 #pragma once
 #include "Constants.h"
+#include "MeshletCuller.h"
 
 
 namespace Engine
@@ -10,12 +11,26 @@ namespace Engine
 	class Sampler;
 	class GraphicsPipeline;
 	class RenderPass;
+	class PipelineCache;
+	class ShaderProgram;
+	class BindlessTextureTable;
+	class ThreadPool;
+	class DescriptorAllocator;
+	class DescriptorSetCache;
+	class AssetManager;
+	class StagingRing;
+	class MipGenerator;
+	class TextureStreamer;
+	class MeshStreamer;
+	class TextureArrayPool;
+	class SkinningPass;
 }
 
 namespace Resource
 {
 	class Mesh;
 	class Material;
+	class Texture;
 }
 
 namespace Component
@@ -25,13 +40,24 @@ namespace Component
 
 class Object;
 
+// Per view data, bound once per frame through set 0
 struct UniformBufferObject
 {
-	alignas(16) glm::mat4 model;
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 proj;
 };
 
+// Per draw data, pushed right before each draw call.
+// Must stay within the guaranteed 128 bytes of push constant space.
+struct DrawPushConstants
+{
+	alignas(16) glm::mat4 model;
+	// slot in the bindless texture table, unused without bindless textures
+	uint32_t textureIndex;
+	// layer of the array view the texture is sampled from, packed textures share one view per array
+	uint32_t textureLayer;
+};
+
 static std::vector<char> ReadFile(const std::string& fileName)
 {
 	std::ifstream file(fileName, std::ios::ate | std::ios::binary);
@@ -76,6 +102,20 @@ struct QueueFamilyIndices
 	}
 };
 
+// Features the engine uses when the device exposes them, but does not require
+struct OptionalDeviceFeatures
+{
+	// VK_EXT_graphics_pipeline_library (+ VK_KHR_pipeline_library)
+	bool graphicsPipelineLibrary = false;
+	// linking libraries without link time optimization is guaranteed to be cheap
+	bool graphicsPipelineLibraryFastLinking = false;
+	// Vulkan 1.2 descriptor indexing with update after bind for sampled images
+	bool descriptorIndexing = false;
+	uint32_t maxBindlessTextures = 0;
+	// BC1-7 sampled images, cooked textures are decoded on the CPU without it
+	bool textureCompressionBC = false;
+};
+
 struct SwapChainSupportDetails
 {
 	VkSurfaceCapabilitiesKHR surfaceCapabilities;
@@ -88,6 +128,10 @@ class Application
 public:
 	Application();
 	void Run();
+	// Brings the window and the device up without entering the main loop, for the benchmarks that check GPU results.
+	// Shutdown waits for the device and tears everything down again.
+	void Initialize();
+	void Shutdown();
 
 private: // Run functions
 	void InitWindow();
@@ -104,18 +148,26 @@ private:
 	void CreateSwapChain();
 	void CreateImageViews();
 	void CreateDescriptorSetLayout();
+	void CreatePipelineCache();
 	void CreateGraphicsPipeline();
 	void CreateRenderPass();
 	void CreateFrameBuffers();
 	void CreateCommandPools();
+	void CreateStagingRing();
+	void CreateMipGenerator();
+	void CreateTextureStreamer();
+	void CreateMeshStreamer();
+	void CreateTextureArrayPool();
+	void CreateSkinningPass();
 	void CreateDepthResources();
 	void CreateTextureImage();
 	void CreateTextureImageView();
 	void CreateTextureSampler();
+	void CreatePlaceholderTexture();
 	void CreateVertexBuffer();
 	void CreateIndexBuffer();
 	void CreateUniformBuffers();
-	void CreateDescriptorPool();
+	void CreateDescriptorAllocators();
 	void CreateDescriptorSets();
 	void CreateDataBuffer();
 	void CreateCommandBuffer();
@@ -136,13 +188,22 @@ private: // helper functions
 	VkShaderModule CreateShaderModule(const std::vector<char>& shaderCode);
 	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkSharingMode sharingMode, uint32_t queueFamilyIndexCount = 0);
-	void UpdateDescriptorSets();
+	// Sets are looked up by their contents, stable content is only written the first time
+	VkDescriptorSet GetMaterialDescriptorSet(Resource::Material* material);
+	// Writes the uniform buffer set of the frame into its transient pools, valid until they are reset the next time the frame comes around
+	VkDescriptorSet AllocateFrameDescriptorSet(uint32_t frame);
 	void TransitionImageLayout(Engine::Image* image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 	VkFormat FindSupportedDepthFormat();
 
 private:
 	void RecordCommandBuffer(VkCommandBuffer commmandBuffer, uint32_t swapChainImageIndex);
+	// Depth prepass and shading draws of _object1, inside the render pass
+	void RecordObjectDraw(VkCommandBuffer commmandBuffer, Resource::Mesh* mesh);
 	void UpdateUniformBuffer(uint32_t currentImage);
+	void UpdateObjects();
+	// Camera matrices, shared by the uniform buffer and the meshlet culling
+	glm::mat4 GetViewMatrix() const;
+	glm::mat4 GetProjectionMatrix() const;
 	void DrawFrame();
 	void CleanupSwapChain();
 	void RecreateSwapChain();
@@ -156,10 +217,13 @@ public:
 	static void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
 	static VkCommandBuffer BeginSingleTimeTransferCommands();
 	static void EndSingleTimeTransferCommands(VkCommandBuffer commandBuffer);
+	static VkCommandPool GetTransferCommandPool() { return _transferCommandPool; }
 
 private: // util functions
 	bool IsDeviceSuitable(VkPhysicalDevice device);
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+	bool CheckDeviceExtensionSupport(VkPhysicalDevice device, const char* extension);
+	void QueryOptionalDeviceFeatures(VkPhysicalDevice device);
 	bool CheckRequiredSupportedExtensionsPresent(const char** extensions, uint32_t extensionCount);
 	bool CheckValidationLayerSupport();
 	std::vector<const char*> GetRequiredExtensions(uint32_t& extensionsCount);
@@ -177,24 +241,57 @@ public:
 	static VkDevice s_logicalDevice;
 	static VkPhysicalDevice s_physicalDevice;
 	static VkPhysicalDeviceProperties s_physicalDeviceProperties;
+	static OptionalDeviceFeatures s_optionalFeatures;
 	static uint32_t* TransferOperationQueueIndices;
 
 	static Engine::Queue* s_graphicsQueue;
 	static Engine::Queue* s_presentQueue;
 	static Engine::Queue* s_transferQueue;
+
+	// nullptr when descriptor indexing is not supported
+	static Engine::BindlessTextureTable* s_bindlessTextures;
+	// workers for CPU heavy asset processing
+	static Engine::ThreadPool* s_threadPool;
+	// shared meshes and materials, one copy per file and import settings
+	static Engine::AssetManager* s_assetManager;
+	// upload path of every mesh, buffer data goes through it to the device local buffers
+	static Engine::StagingRing* s_stagingRing;
+	// fills the mip chains of textures loaded without precomputed mips
+	static Engine::MipGenerator* s_mipGenerator;
+	// white texel every texture shows until its decode has been uploaded
+	static Resource::Texture* s_placeholderTexture;
+	// moves the finer mip levels of cooked textures in and out of device memory
+	static Engine::TextureStreamer* s_textureStreamer;
+	// orders the background imports of meshes by camera distance
+	static Engine::MeshStreamer* s_meshStreamer;
+	// shared array images holding the small textures as layers
+	static Engine::TextureArrayPool* s_textureArrays;
+	// poses the skinned meshes once per frame for every pass
+	static Engine::SkinningPass* s_skinningPass;
+	// material sets by content, textures drop the sets of their image views before destroying them
+	static Engine::DescriptorSetCache* s_descriptorSetCache;
 private:
 	GLFWwindow* _window;
 	VkInstance _instance;
 	VkSurfaceKHR _surface;
 	VkSwapchainKHR _swapChain;
 
+	// set 0: per frame data
 	VkDescriptorSetLayout _descriptorSetLayout;
-	VkDescriptorPool _descriptorPool;
-	std::vector<VkDescriptorSet> _descriptorSets;
+	// set 1: per material texture, replaced by the bindless table layout in bindless mode
+	VkDescriptorSetLayout _materialSetLayout;
+	// material sets, owned by the cache and freed one by one when their image view goes away
+	Engine::DescriptorAllocator* _descriptorAllocator;
+	// transient per frame and per draw sets, reset wholesale once the frame's fence has signaled
+	std::array<Engine::DescriptorAllocator*, MAX_FRAMES_IN_FLIGHT> _frameDescriptorAllocators;
 
 	Engine::RenderPass* _renderPass;
 
 	Engine::GraphicsPipeline* _graphicsPipeline;
+	Engine::ShaderProgram* _shaderProgram;
+	Engine::PipelineCache* _pipelineCache;
+	// features applied to every draw on top of the material features
+	uint32_t _globalShaderFeatures = 0;
 
 	VkDebugUtilsMessengerEXT _debugMessenger;
 
@@ -232,6 +329,12 @@ private:
 
 	bool _bFrameBufferResized = false;
 
+	// Fixed camera, shared by the view matrix and the LOD selection. The field of view is in degrees
+	glm::vec3 _cameraPosition = glm::vec3(2.0f, 0.0f, 15.0f);
+	float _cameraFieldOfView = 45.0f;
+
+	// Index ranges left after meshlet culling, reused every frame
+	std::vector<Engine::DrawRange> _drawRanges;
 
 #pragma region Move this to Component System
 	// TODO: Move this to the component system
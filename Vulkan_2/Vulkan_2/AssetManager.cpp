@@ -0,0 +1,291 @@
+#include "pch.h"
+#include "AssetManager.h"
+#include "Material.h"
+#include "Model.h"
+#include "SkinnedMesh.h"
+#include "Texture.h"
+#include "Constants.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+Engine::AssetManager::AssetManager()
+{
+}
+
+uint64_t Engine::GetAssetMemorySize(Resource::Texture* texture)
+{
+	return texture->GetMemorySize();
+}
+
+bool Engine::FinishAssetLoading(Resource::Texture* texture, bool bWait)
+{
+	return texture->FinishLoading(bWait);
+}
+
+bool Engine::FinishAssetLoading(Resource::Mesh* mesh, bool bWait)
+{
+	return mesh->FinishLoading(bWait);
+}
+
+uint64_t Engine::GetAssetMemorySize(Resource::Mesh* mesh)
+{
+	return mesh->GetMemorySize();
+}
+
+uint64_t Engine::GetAssetCpuMemorySize(Resource::Mesh* mesh)
+{
+	return mesh->GetCpuMemorySize();
+}
+
+bool Engine::UnloadAsset(Resource::Texture* texture)
+{
+	return texture->Unload();
+}
+
+bool Engine::UnloadAsset(Resource::Mesh* mesh)
+{
+	return mesh->Unload();
+}
+
+void Engine::ReloadAsset(Resource::Texture* texture)
+{
+	texture->Reload();
+}
+
+void Engine::ReloadAsset(Resource::Mesh* mesh)
+{
+	mesh->Reload();
+}
+
+void Engine::PinAsset(Resource::Mesh* mesh, bool bPinned)
+{
+	mesh->SetCpuCopyPinned(bPinned);
+}
+
+void Engine::DropAssetCpuCopy(Resource::Mesh* mesh)
+{
+	mesh->DropCpuCopy();
+}
+
+Engine::AssetManager::~AssetManager()
+{
+	// Called after the device went idle, nothing is in flight anymore.
+	// Resources hold handles to other resources (materials to their textures), so unreferenced entries go first,
+	// destroying them releases the next ones. Entries still referenced from outside go last.
+	while (!_entries.empty())
+	{
+		auto it = std::find_if(_entries.begin(), _entries.end(), [](const auto& entry) { return entry.second->refCount == 0; });
+		if (it == _entries.end())
+			it = _entries.begin();
+		Destroy(it->second);
+	}
+}
+
+Engine::AssetHandle<Resource::Mesh> Engine::AssetManager::LoadMesh(const char* file, const Resource::MeshImportSettings& settings)
+{
+	std::ostringstream key;
+	key << "mesh|" << GetCanonicalPath(file) << "|" << std::hex << settings.GetKey();
+	return Load<Resource::Mesh>(key.str(), [file, &settings]() { return new Resource::Mesh(file, settings); });
+}
+
+Engine::AssetHandle<Resource::Material> Engine::AssetManager::LoadMaterial(const char* file)
+{
+	std::string key = "material|" + GetCanonicalPath(file);
+	return Load<Resource::Material>(key, [file]() { return new Resource::Material(file); });
+}
+
+Engine::AssetHandle<Resource::Texture> Engine::AssetManager::LoadTexture(const char* file, Resource::TextureColorSpace colorSpace)
+{
+	std::string key = "texture|" + GetCanonicalPath(file) + (colorSpace == Resource::TextureColorSpace::Srgb ? "|srgb" : "|linear");
+	return Load<Resource::Texture>(key, [file, colorSpace]() { return new Resource::Texture(file, colorSpace); });
+}
+
+Engine::AssetHandle<Resource::Model> Engine::AssetManager::LoadModel(const char* file)
+{
+	std::string key = "model|" + GetCanonicalPath(file);
+	return Load<Resource::Model>(key, [file]() { return new Resource::Model(file); });
+}
+
+Engine::AssetHandle<Resource::SkinnedMesh> Engine::AssetManager::LoadSkinnedMesh(const char* file)
+{
+	std::string key = "skinned|" + GetCanonicalPath(file);
+	return Load<Resource::SkinnedMesh>(key, [file]() { return new Resource::SkinnedMesh(file); });
+}
+
+void Engine::AssetManager::Update()
+{
+	_frame++;
+
+	// uploads whatever finished decoding since the last frame, unloading entries are not worth the upload
+	for (auto it = _loading.begin(); it != _loading.end();)
+	{
+		AssetEntry* entry = *it;
+		if (entry->state != AssetState::Unloading && entry->FinishLoading(false))
+		{
+			it = _loading.erase(it);
+			OnLoaded(entry);
+		}
+		else
+			++it;
+	}
+
+	for (auto it = _unloading.begin(); it != _unloading.end();)
+	{
+		AssetEntry* entry = *it;
+		if (entry->framesLeft-- == 0)
+		{
+			// erased first, destroying a material appends its texture to the list
+			it = _unloading.erase(it);
+			Destroy(entry);
+		}
+		else
+			++it;
+	}
+
+	EnforceBudgets();
+}
+
+void Engine::AssetManager::FinishLoading()
+{
+	while (!_loading.empty())
+	{
+		AssetEntry* entry = _loading.front();
+		entry->FinishLoading(true);
+		_loading.pop_front();
+		OnLoaded(entry);
+	}
+}
+
+void Engine::AssetManager::RefreshMemoryUsage()
+{
+	for (const auto& it : _entries)
+	{
+		AssetEntry* entry = it.second;
+		if (std::find(_loading.begin(), _loading.end(), entry) == _loading.end())
+			UpdateMemorySize(entry);
+	}
+}
+
+void Engine::AssetManager::Release(AssetEntry* entry)
+{
+	// command buffers still in flight may reference the buffers and images of the resource
+	entry->state = AssetState::Unloading;
+	entry->framesLeft = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	_unloading.push_back(entry);
+}
+
+void Engine::AssetManager::MarkUsed(AssetEntry* entry)
+{
+	entry->lastUsedFrame = _frame;
+	if (!entry->bEvicted)
+		return;
+
+	entry->bEvicted = false;
+	entry->state = AssetState::Loading;
+	entry->ReloadResource();
+	_loading.push_back(entry);
+}
+
+void Engine::AssetManager::SetPinned(AssetEntry* entry, bool bPinned)
+{
+	entry->bPinned = bPinned;
+	entry->PinResource(bPinned);
+	// pinning a loaded resource may have read its CPU copies back
+	if (std::find(_loading.begin(), _loading.end(), entry) == _loading.end())
+		UpdateMemorySize(entry);
+}
+
+std::vector<Engine::AssetResidencyInfo> Engine::AssetManager::GetResidencyReport() const
+{
+	std::vector<AssetResidencyInfo> report;
+	report.reserve(_entries.size());
+	for (const auto& it : _entries)
+	{
+		const AssetEntry* entry = it.second;
+		report.push_back({ entry->key, entry->state, entry->bEvicted, entry->bPinned, entry->refCount,
+			entry->memorySize, entry->cpuMemorySize, _frame - entry->lastUsedFrame });
+	}
+
+	std::sort(report.begin(), report.end(), [](const AssetResidencyInfo& a, const AssetResidencyInfo& b) { return a.key < b.key; });
+	return report;
+}
+
+void Engine::AssetManager::OnLoaded(AssetEntry* entry)
+{
+	// an entry released while loading stays unloading
+	if (entry->state == AssetState::Loading)
+		entry->state = AssetState::Loaded;
+	UpdateMemorySize(entry);
+}
+
+void Engine::AssetManager::UpdateMemorySize(AssetEntry* entry)
+{
+	_memoryUsage -= entry->memorySize;
+	_cpuMemoryUsage -= entry->cpuMemorySize;
+	entry->memorySize = entry->GetResourceMemorySize();
+	entry->cpuMemorySize = entry->GetResourceCpuMemorySize();
+	_memoryUsage += entry->memorySize;
+	_cpuMemoryUsage += entry->cpuMemorySize;
+}
+
+void Engine::AssetManager::EnforceBudgets()
+{
+	if (_cpuMemoryUsage <= ASSET_CPU_MEMORY_BUDGET && _memoryUsage <= ASSET_GPU_MEMORY_BUDGET)
+		return;
+
+	// Least recently used first. Unloading entries go on their own, loading ones have nothing to give up yet.
+	std::vector<AssetEntry*> entries;
+	for (const auto& it : _entries)
+	{
+		if (it.second->state == AssetState::Loaded)
+			entries.push_back(it.second);
+	}
+	std::sort(entries.begin(), entries.end(), [](const AssetEntry* a, const AssetEntry* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+
+	// nothing draws from the CPU copies, they are dropped regardless of when the resource was used
+	for (AssetEntry* entry : entries)
+	{
+		if (_cpuMemoryUsage <= ASSET_CPU_MEMORY_BUDGET)
+			break;
+		if (entry->bPinned || entry->cpuMemorySize == 0)
+			continue;
+
+		entry->DropResourceCpuCopy();
+		UpdateMemorySize(entry);
+	}
+
+	for (AssetEntry* entry : entries)
+	{
+		// command buffers still in flight may reference the device data of everything used since
+		if (_memoryUsage <= ASSET_GPU_MEMORY_BUDGET || _frame - entry->lastUsedFrame <= static_cast<uint64_t>(MAX_FRAMES_IN_FLIGHT))
+			break;
+		if (entry->bEvicted || entry->memorySize == 0 || !entry->UnloadResource())
+			continue;
+
+		entry->bEvicted = true;
+		UpdateMemorySize(entry);
+	}
+}
+
+void Engine::AssetManager::Destroy(AssetEntry* entry)
+{
+	_loading.remove(entry);
+	_entries.erase(entry->key);
+	_memoryUsage -= entry->memorySize;
+	_cpuMemoryUsage -= entry->cpuMemorySize;
+	delete entry;
+}
+
+std::string Engine::AssetManager::GetCanonicalPath(const char* file)
+{
+	// weakly_canonical also works for files that do not exist (yet), the loader reports those
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::absolute(file, error);
+	if (!error)
+		path = std::filesystem::weakly_canonical(path, error);
+	if (error)
+		return std::filesystem::path(file).lexically_normal().generic_string();
+	return path.generic_string();
+}
\ No newline at end of file
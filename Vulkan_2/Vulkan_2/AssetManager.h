@@ -0,0 +1,358 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <algorithm>
+
+#include "Mesh.h"
+
+namespace Resource
+{
+	class Material;
+	class Model;
+	class SkinnedMesh;
+	class Texture;
+	enum class TextureColorSpace;
+}
+
+namespace Engine
+{
+	class AssetManager;
+
+	enum class AssetState
+	{
+		Loading,
+		Loaded,
+		// no handle is left, the resource is destroyed once no frame in flight can use it anymore
+		Unloading,
+	};
+
+	// Bookkeeping of one loaded resource, shared by every handle to it
+	struct AssetEntry
+	{
+		virtual ~AssetEntry() {}
+
+		// Main thread, completes a resource that loads over several frames, bWait blocks until it can.
+		// Returns true once the resource is loaded.
+		virtual bool FinishLoading(bool bWait) = 0;
+		virtual uint64_t GetResourceMemorySize() = 0;
+		virtual uint64_t GetResourceCpuMemorySize() = 0;
+		// Frees the device data, returns false when the resource cannot load it again
+		virtual bool UnloadResource() = 0;
+		// Loads the device data of an unloaded resource again, FinishLoading completes it
+		virtual void ReloadResource() = 0;
+		virtual void PinResource(bool bPinned) = 0;
+		virtual void DropResourceCpuCopy() = 0;
+
+		AssetManager* manager = nullptr;
+		// canonical path plus import settings
+		std::string key;
+		AssetState state = AssetState::Loading;
+		uint32_t refCount = 0;
+		// frames until an unloading entry is destroyed
+		uint32_t framesLeft = 0;
+		// device memory owned by the resource itself, not by the resources it references
+		uint64_t memorySize = 0;
+		// system memory of the CPU copies the resource keeps after its upload
+		uint64_t cpuMemorySize = 0;
+		// manager frame of the last request or use
+		uint64_t lastUsedFrame = 0;
+		// the device data was unloaded over ASSET_GPU_MEMORY_BUDGET, the next use loads it again.
+		// Kept apart from the state since an unloaded resource can still be released and requested again.
+		bool bEvicted = false;
+		// the CPU copies are kept regardless of ASSET_CPU_MEMORY_BUDGET
+		bool bPinned = false;
+	};
+
+	// Residency of one resource, see AssetManager::GetResidencyReport
+	struct AssetResidencyInfo
+	{
+		std::string key;
+		AssetState state;
+		bool bEvicted;
+		bool bPinned;
+		uint32_t refCount;
+		uint64_t memorySize;
+		uint64_t cpuMemorySize;
+		// frames since the last request or use
+		uint64_t unusedFrames;
+	};
+
+	template<typename T>
+	struct TypedAssetEntry : AssetEntry
+	{
+		~TypedAssetEntry() override { delete resource; }
+
+		bool FinishLoading(bool bWait) override;
+		uint64_t GetResourceMemorySize() override;
+		uint64_t GetResourceCpuMemorySize() override;
+		bool UnloadResource() override;
+		void ReloadResource() override;
+		void PinResource(bool bPinned) override;
+		void DropResourceCpuCopy() override;
+
+		T* resource = nullptr;
+	};
+
+	// Counted reference to a resource owned by the AssetManager. Copies share the resource,
+	// the last handle to go away hands it back to the manager for unloading.
+	// Handles are only created, copied and destroyed on the main thread.
+	template<typename T>
+	class AssetHandle
+	{
+	public:
+		AssetHandle() {}
+		explicit AssetHandle(TypedAssetEntry<T>* entry) : _entry(entry) { AddRef(); }
+		AssetHandle(const AssetHandle& other) : _entry(other._entry) { AddRef(); }
+		AssetHandle(AssetHandle&& other) noexcept : _entry(other._entry) { other._entry = nullptr; }
+		~AssetHandle() { Reset(); }
+
+		AssetHandle& operator=(const AssetHandle& other)
+		{
+			if (_entry != other._entry)
+			{
+				Reset();
+				_entry = other._entry;
+				AddRef();
+			}
+			return *this;
+		}
+
+		AssetHandle& operator=(AssetHandle&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Reset();
+				_entry = other._entry;
+				other._entry = nullptr;
+			}
+			return *this;
+		}
+
+		void Reset();
+
+		// Keeps the resource from being unloaded over the budgets and brings an unloaded one back.
+		// Call every frame for the resources a draw uses.
+		void MarkUsed() const;
+		// Pinned resources keep their CPU copies, for physics or picking. Shared by every handle to the resource.
+		void SetPinned(bool bPinned) const;
+
+#pragma region Getters
+
+		T* Get() const { return _entry != nullptr ? _entry->resource : nullptr; }
+		T* operator->() const { return Get(); }
+		bool IsValid() const { return _entry != nullptr; }
+		// valid handles only
+		AssetState GetState() const { return _entry->state; }
+		bool IsLoaded() const { return _entry != nullptr && _entry->state == AssetState::Loaded; }
+		uint32_t GetRefCount() const { return _entry != nullptr ? _entry->refCount : 0; }
+
+#pragma endregion
+
+	private:
+		void AddRef()
+		{
+			if (_entry != nullptr)
+				_entry->refCount++;
+		}
+
+	private:
+		TypedAssetEntry<T>* _entry = nullptr;
+	};
+
+	// Device memory a resource reports to the manager, only textures and meshes track theirs so far
+	template<typename T>
+	uint64_t GetAssetMemorySize(T*) { return 0; }
+	uint64_t GetAssetMemorySize(Resource::Texture* texture);
+	uint64_t GetAssetMemorySize(Resource::Mesh* mesh);
+
+	// CPU copies a resource keeps after its upload, only meshes have any
+	template<typename T>
+	uint64_t GetAssetCpuMemorySize(T*) { return 0; }
+	uint64_t GetAssetCpuMemorySize(Resource::Mesh* mesh);
+
+	// Only textures and meshes loaded from a file can give up their device data and load it again
+	template<typename T>
+	bool UnloadAsset(T*) { return false; }
+	bool UnloadAsset(Resource::Texture* texture);
+	bool UnloadAsset(Resource::Mesh* mesh);
+	template<typename T>
+	void ReloadAsset(T*) {}
+	void ReloadAsset(Resource::Texture* texture);
+	void ReloadAsset(Resource::Mesh* mesh);
+
+	template<typename T>
+	void PinAsset(T*, bool) {}
+	void PinAsset(Resource::Mesh* mesh, bool bPinned);
+	template<typename T>
+	void DropAssetCpuCopy(T*) {}
+	void DropAssetCpuCopy(Resource::Mesh* mesh);
+
+	// Resources are loaded when their constructor returns, except textures which decode on the thread pool
+	// and meshes which import there (see MeshStreamer)
+	template<typename T>
+	bool FinishAssetLoading(T*, bool) { return true; }
+	bool FinishAssetLoading(Resource::Texture* texture, bool bWait);
+	bool FinishAssetLoading(Resource::Mesh* mesh, bool bWait);
+
+	template<typename T>
+	bool TypedAssetEntry<T>::FinishLoading(bool bWait) { return FinishAssetLoading(resource, bWait); }
+	template<typename T>
+	uint64_t TypedAssetEntry<T>::GetResourceMemorySize() { return GetAssetMemorySize(resource); }
+	template<typename T>
+	uint64_t TypedAssetEntry<T>::GetResourceCpuMemorySize() { return GetAssetCpuMemorySize(resource); }
+	template<typename T>
+	bool TypedAssetEntry<T>::UnloadResource() { return UnloadAsset(resource); }
+	template<typename T>
+	void TypedAssetEntry<T>::ReloadResource() { ReloadAsset(resource); }
+	template<typename T>
+	void TypedAssetEntry<T>::PinResource(bool bPinned) { PinAsset(resource, bPinned); }
+	template<typename T>
+	void TypedAssetEntry<T>::DropResourceCpuCopy() { DropAssetCpuCopy(resource); }
+
+	// Loads every mesh, material, texture and model once per canonical path and import settings and hands out counted handles to it.
+	// Resources nobody references anymore are destroyed MAX_FRAMES_IN_FLIGHT frames later,
+	// a request in between revives them without loading again.
+	// Handles of textures and meshes start out in the Loading state, Update uploads each one as soon as its decode finished.
+	// Residency: above ASSET_CPU_MEMORY_BUDGET the CPU copies of unpinned resources are dropped, above ASSET_GPU_MEMORY_BUDGET
+	// the device data of resources no draw used for more than MAX_FRAMES_IN_FLIGHT frames is unloaded, least recently used first.
+	// Unloaded resources load again from their caches on the next use (AssetHandle::MarkUsed).
+	class AssetManager
+	{
+	public:
+		AssetManager();
+		~AssetManager();
+
+		AssetHandle<Resource::Mesh> LoadMesh(const char* file, const Resource::MeshImportSettings& settings = Resource::MeshImportSettings());
+		AssetHandle<Resource::Material> LoadMaterial(const char* file);
+		// One decode and one upload per file and color space, every material using the file shares the image
+		AssetHandle<Resource::Texture> LoadTexture(const char* file, Resource::TextureColorSpace colorSpace);
+		// binary glTF scene, see GlbImporter
+		AssetHandle<Resource::Model> LoadModel(const char* file);
+		// first skinned mesh of a binary glTF file with its skeleton and animations, see GlbImporter::ImportSkin
+		AssetHandle<Resource::SkinnedMesh> LoadSkinnedMesh(const char* file);
+
+		// Call once per frame after the frame's fence has been waited on.
+		// Finishes the resources whose background loading is done, destroys unused resources that are out of flight
+		// and enforces the budgets. Unloaded textures drop the cached descriptor sets of their views themselves.
+		void Update();
+		// Blocks until every resource still loading is loaded, for callers that need the final data right away
+		void FinishLoading();
+		// Asks every loaded resource for its memory again, after streaming changed it
+		void RefreshMemoryUsage();
+
+		// Called by the last handle of an entry
+		void Release(AssetEntry* entry);
+		// Called by handles, see AssetHandle::MarkUsed and AssetHandle::SetPinned
+		void MarkUsed(AssetEntry* entry);
+		void SetPinned(AssetEntry* entry, bool bPinned);
+
+		// Every resource held in memory with its state, memory and the frames since its last use, sorted by key
+		std::vector<AssetResidencyInfo> GetResidencyReport() const;
+
+		// Path the asset keys are built from: absolute, normalized, generic separators
+		static std::string GetCanonicalPath(const char* file);
+
+#pragma region Getters
+
+		// resources currently held in memory, unloading ones included
+		size_t GetAssetCount() const { return _entries.size(); }
+		// resources still loading in the background
+		size_t GetLoadingCount() const { return _loading.size(); }
+		// device memory of the resources currently held, unloading ones included
+		uint64_t GetMemoryUsage() const { return _memoryUsage; }
+		// system memory of their CPU copies
+		uint64_t GetCpuMemoryUsage() const { return _cpuMemoryUsage; }
+
+#pragma endregion
+
+	private:
+		template<typename T, typename Loader>
+		AssetHandle<T> Load(const std::string& key, Loader load);
+		// Marks the entry loaded and adds its memory to the statistics
+		void OnLoaded(AssetEntry* entry);
+		// Asks the resource for its memory again and updates the statistics
+		void UpdateMemorySize(AssetEntry* entry);
+		// Drops CPU copies and unloads device data over the budgets, least recently used first
+		void EnforceBudgets();
+		// Removes the entry from the memory statistics and destroys it
+		void Destroy(AssetEntry* entry);
+
+	private:
+		std::unordered_map<std::string, AssetEntry*> _entries;
+		std::list<AssetEntry*> _unloading;
+		// entries whose resource is still loading in the background, unloading ones included
+		std::list<AssetEntry*> _loading;
+		// sum of the memorySize of every entry
+		uint64_t _memoryUsage = 0;
+		// sum of the cpuMemorySize of every entry
+		uint64_t _cpuMemoryUsage = 0;
+		// counts the Update calls
+		uint64_t _frame = 0;
+	};
+
+	template<typename T>
+	void AssetHandle<T>::Reset()
+	{
+		if (_entry != nullptr && --_entry->refCount == 0)
+			_entry->manager->Release(_entry);
+		_entry = nullptr;
+	}
+
+	template<typename T>
+	void AssetHandle<T>::MarkUsed() const
+	{
+		if (_entry != nullptr)
+			_entry->manager->MarkUsed(_entry);
+	}
+
+	template<typename T>
+	void AssetHandle<T>::SetPinned(bool bPinned) const
+	{
+		if (_entry != nullptr)
+			_entry->manager->SetPinned(_entry, bPinned);
+	}
+
+	template<typename T, typename Loader>
+	AssetHandle<T> AssetManager::Load(const std::string& key, Loader load)
+	{
+		auto it = _entries.find(key);
+		if (it != _entries.end())
+		{
+			TypedAssetEntry<T>* entry = static_cast<TypedAssetEntry<T>*>(it->second);
+			entry->lastUsedFrame = _frame;
+			if (entry->state == AssetState::Unloading)
+			{
+				_unloading.remove(entry);
+				bool bLoading = std::find(_loading.begin(), _loading.end(), entry) != _loading.end();
+				entry->state = bLoading ? AssetState::Loading : AssetState::Loaded;
+			}
+			return AssetHandle<T>(entry);
+		}
+
+		TypedAssetEntry<T>* entry = new TypedAssetEntry<T>();
+		entry->manager = this;
+		entry->key = key;
+		entry->lastUsedFrame = _frame;
+		_entries[key] = entry;
+
+		bool bLoaded;
+		try
+		{
+			entry->resource = load();
+			bLoaded = entry->FinishLoading(false);
+		}
+		catch (...)
+		{
+			_entries.erase(key);
+			delete entry;
+			throw;
+		}
+
+		if (bLoaded)
+			OnLoaded(entry);
+		else
+			_loading.push_back(entry);
+		return AssetHandle<T>(entry);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include "pch.h"
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "Vertex.h"
+#include "VertexWelder.h"
+#include "ObjImporter.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include "SkinnedMesh.h"
+#include "SkinningPass.h"
+#include "Application.h"
+
+#include <cmath>
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	double ElapsedMilliseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// tinyobjloader parse used by the importer before ObjImporter
+	bool LoadCorners(const char* objFile, std::vector<Vertex>& corners)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warning, error;
+
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, objFile))
+		{
+			std::cerr << "Failed to load obj: " << warning << error << std::endl;
+			return false;
+		}
+
+		for (const tinyobj::shape_t& shape : shapes)
+		{
+			for (const tinyobj::index_t& index : shape.mesh.indices)
+			{
+				Vertex vertex{};
+				vertex.pos = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2],
+				};
+				if (index.texcoord_index >= 0)
+				{
+					vertex.texCoord = {
+						attrib.texcoords[2 * index.texcoord_index + 0],
+						1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
+					};
+				}
+				vertex.color = { 1.0f, 1.0f, 1.0f };
+				corners.push_back(vertex);
+			}
+		}
+		return true;
+	}
+
+	// Distance in representable floats, 0 for identical values
+	uint32_t UlpDistance(float a, float b)
+	{
+		int32_t aBits, bBits;
+		memcpy(&aBits, &a, sizeof(float));
+		memcpy(&bBits, &b, sizeof(float));
+		// sign magnitude to a monotonic order
+		int64_t aOrdered = aBits < 0 ? static_cast<int64_t>(INT32_MIN) - aBits : aBits;
+		int64_t bOrdered = bBits < 0 ? static_cast<int64_t>(INT32_MIN) - bBits : bBits;
+		return static_cast<uint32_t>(std::min<int64_t>(std::abs(aOrdered - bOrdered), UINT32_MAX));
+	}
+
+	uint32_t UlpDistance(const Vertex& a, const Vertex& b)
+	{
+		uint32_t distance = 0;
+		for (int i = 0; i < 3; i++)
+			distance = std::max({ distance, UlpDistance(a.pos[i], b.pos[i]), UlpDistance(a.color[i], b.color[i]) });
+		for (int i = 0; i < 2; i++)
+			distance = std::max(distance, UlpDistance(a.texCoord[i], b.texCoord[i]));
+		return distance;
+	}
+
+	// Regular grid with shared vertices, 2 * width * height triangles
+	void GenerateGridCorners(uint32_t width, uint32_t height, std::vector<Vertex>& corners)
+	{
+		auto makeVertex = [width, height](uint32_t x, uint32_t y)
+		{
+			Vertex vertex{};
+			vertex.pos = { x * 0.01f, 0.0f, y * 0.01f };
+			vertex.color = { 1.0f, 1.0f, 1.0f };
+			vertex.texCoord = { x / static_cast<float>(width), y / static_cast<float>(height) };
+			return vertex;
+		};
+
+		corners.reserve(static_cast<size_t>(width) * height * 6);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				corners.push_back(makeVertex(x, y));
+				corners.push_back(makeVertex(x + 1, y));
+				corners.push_back(makeVertex(x, y + 1));
+				corners.push_back(makeVertex(x + 1, y));
+				corners.push_back(makeVertex(x + 1, y + 1));
+				corners.push_back(makeVertex(x, y + 1));
+			}
+		}
+	}
+
+	// Tube of vertices around a chain of joints along y, each vertex weighted between its two nearest joints and every
+	// fourth one spread over four. The clip bends every joint back and forth.
+	void GenerateSkin(uint32_t jointCount, uint32_t ringCount, uint32_t ringVertices, Resource::Skeleton& skeleton,
+		Resource::AnimationClip& clip, std::vector<Resource::SkinVertex>& vertices)
+	{
+		const float jointLength = 0.1f;
+		for (uint32_t joint = 0; joint < jointCount; joint++)
+		{
+			Resource::JointPose pose;
+			pose.translation = glm::vec3(0.0f, joint == 0 ? 0.0f : jointLength, 0.0f);
+			skeleton.parents.push_back(static_cast<int32_t>(joint) - 1);
+			skeleton.restPose.push_back(pose);
+			skeleton.parentOffsets.push_back(glm::mat4(1.0f));
+			skeleton.inverseBindMatrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -jointLength * joint, 0.0f)));
+
+			Resource::AnimationChannel channel;
+			channel.joint = joint;
+			channel.path = Resource::AnimationPath::Rotation;
+			for (uint32_t key = 0; key < 5; key++)
+			{
+				glm::quat rotation = glm::angleAxis(0.2f * std::sin(key * 1.57f + joint), glm::vec3(0.0f, 0.0f, 1.0f));
+				channel.times.push_back(key * 0.25f);
+				channel.values.push_back(glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w));
+			}
+			clip.channels.push_back(channel);
+		}
+		clip.duration = 1.0f;
+
+		float height = jointLength * (jointCount - 1);
+		for (uint32_t ring = 0; ring < ringCount; ring++)
+		{
+			float y = height * ring / (ringCount - 1);
+			uint32_t lower = std::min(static_cast<uint32_t>(y / jointLength), jointCount - 2);
+			float blend = std::clamp(y / jointLength - lower, 0.0f, 1.0f);
+			for (uint32_t i = 0; i < ringVertices; i++)
+			{
+				float angle = 6.2831853f * i / ringVertices;
+				Resource::SkinVertex vertex{};
+				vertex.position[0] = 0.05f * std::cos(angle);
+				vertex.position[1] = y;
+				vertex.position[2] = 0.05f * std::sin(angle);
+				vertex.joints = lower | ((lower + 1) << 8);
+				vertex.weights[0] = 1.0f - blend;
+				vertex.weights[1] = blend;
+				if (i % 4 == 0 && lower + 3 < jointCount)
+				{
+					vertex.joints |= ((lower + 2) << 16) | ((lower + 3) << 24);
+					vertex.weights[0] *= 0.5f;
+					vertex.weights[1] *= 0.5f;
+					vertex.weights[2] = 0.3f;
+					vertex.weights[3] = 0.2f;
+				}
+				vertices.push_back(vertex);
+			}
+		}
+	}
+
+	// The deduplication Mesh used before the welder, kept as the baseline
+	void WeldWithUnorderedMap(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		for (const Vertex& vertex : corners)
+		{
+			if (uniqueVertices.count(vertex) == 0)
+			{
+				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+			}
+			indices.push_back(uniqueVertices[vertex]);
+		}
+	}
+}
+
+int Benchmarks::RunWeldBenchmark(const char* objFile)
+{
+	std::vector<Vertex> corners;
+	if (objFile != nullptr)
+	{
+		if (!LoadCorners(objFile, corners))
+			return EXIT_FAILURE;
+	}
+	else
+	{
+		// 4M triangles
+		GenerateGridCorners(2048, 1024, corners);
+	}
+
+	std::cout << "Welding " << corners.size() / 3 << " triangles (" << corners.size() << " corners)" << std::endl;
+
+	std::vector<Vertex> baselineVertices;
+	std::vector<uint32_t> baselineIndices;
+	Clock::time_point start = Clock::now();
+	WeldWithUnorderedMap(corners, baselineVertices, baselineIndices);
+	double baselineTime = ElapsedMilliseconds(start);
+
+	std::vector<Vertex> weldedVertices;
+	std::vector<uint32_t> weldedIndices;
+	start = Clock::now();
+	Resource::VertexWelder::Weld(corners, weldedVertices, weldedIndices);
+	double weldTime = ElapsedMilliseconds(start);
+
+	Resource::WeldSettings epsilonSettings;
+	epsilonSettings.positionEpsilon = 1e-5f;
+	std::vector<Vertex> epsilonVertices;
+	std::vector<uint32_t> epsilonIndices;
+	start = Clock::now();
+	Resource::VertexWelder::Weld(corners, epsilonVertices, epsilonIndices, epsilonSettings);
+	double epsilonTime = ElapsedMilliseconds(start);
+
+	bool bIdentical = baselineVertices == weldedVertices && baselineIndices == weldedIndices;
+
+	std::cout << "unordered_map:      " << baselineTime << " ms, " << baselineVertices.size() << " vertices" << std::endl;
+	std::cout << "welder (exact):     " << weldTime << " ms, " << weldedVertices.size() << " vertices, "
+		<< baselineTime / weldTime << "x" << std::endl;
+	std::cout << "welder (eps 1e-5):  " << epsilonTime << " ms, " << epsilonVertices.size() << " vertices" << std::endl;
+	std::cout << "exact output " << (bIdentical ? "matches" : "DIFFERS FROM") << " the unordered_map output" << std::endl;
+
+	return bIdentical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int Benchmarks::RunImportBenchmark(const char* objFile)
+{
+	std::cout << "Importing " << objFile << std::endl;
+
+	// previous import path: tinyobjloader + unordered_map
+	Clock::time_point start = Clock::now();
+	std::vector<Vertex> corners;
+	if (!LoadCorners(objFile, corners))
+		return EXIT_FAILURE;
+	std::vector<Vertex> baselineVertices;
+	std::vector<uint32_t> baselineIndices;
+	WeldWithUnorderedMap(corners, baselineVertices, baselineIndices);
+	double baselineTime = ElapsedMilliseconds(start);
+
+	std::vector<Vertex> serialVertices;
+	std::vector<uint32_t> serialIndices;
+	start = Clock::now();
+	Resource::ObjImporter(nullptr).Import(objFile, Resource::WeldSettings(), serialVertices, serialIndices);
+	double serialTime = ElapsedMilliseconds(start);
+
+	std::cout << "tinyobj + unordered_map: " << baselineTime << " ms, " << baselineVertices.size() << " vertices" << std::endl;
+	std::cout << "importer (serial):       " << serialTime << " ms, " << serialVertices.size() << " vertices, "
+		<< baselineTime / serialTime << "x over tinyobj" << std::endl;
+
+	// Against the previous path: the same vertices in the same order. from_chars rounds correctly where the tinyobj
+	// parser may land a unit in the last place off, so a one ulp difference is the expected deviation, anything more is a bug.
+	bool bSameTopology = baselineVertices.size() == serialVertices.size() && baselineIndices == serialIndices;
+	uint32_t maxUlps = 0;
+	size_t differingVertices = 0;
+	if (bSameTopology)
+	{
+		for (size_t i = 0; i < serialVertices.size(); i++)
+		{
+			uint32_t ulps = UlpDistance(serialVertices[i], baselineVertices[i]);
+			maxUlps = std::max(maxUlps, ulps);
+			differingVertices += ulps > 0 ? 1 : 0;
+		}
+	}
+	bool bMatchesTinyObj = bSameTopology && maxUlps <= 1;
+	if (!bSameTopology)
+		std::cout << "serial output DIFFERS FROM tinyobj: vertex count or indices do not match" << std::endl;
+	else
+		std::cout << "serial output " << (bMatchesTinyObj ? "matches" : "DIFFERS FROM") << " tinyobj, " << differingVertices
+			<< " vertices off by up to " << maxUlps << " ulp" << std::endl;
+
+	// Scaling with the thread count, the calling thread counts as one. The work split does not depend on it,
+	// every run has to be byte identical to the serial one since the mesh cache depends on it.
+	bool bIdentical = true;
+	uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t threads = 2; ; threads = std::min(threads * 2, hardwareThreads))
+	{
+		Engine::ThreadPool threadPool(threads - 1);
+		std::vector<Vertex> parallelVertices;
+		std::vector<uint32_t> parallelIndices;
+		start = Clock::now();
+		Resource::ObjImporter(&threadPool).Import(objFile, Resource::WeldSettings(), parallelVertices, parallelIndices);
+		double parallelTime = ElapsedMilliseconds(start);
+
+		bool bRunIdentical = serialVertices.size() == parallelVertices.size() && serialIndices == parallelIndices &&
+			memcmp(serialVertices.data(), parallelVertices.data(), serialVertices.size() * sizeof(Vertex)) == 0;
+		bIdentical = bIdentical && bRunIdentical;
+
+		std::cout << "importer (" << threads << " threads): " << parallelTime << " ms, " << serialTime / parallelTime
+			<< "x over serial, " << (bRunIdentical ? "matches" : "DIFFERS FROM") << " the serial output" << std::endl;
+
+		if (threads >= hardwareThreads)
+			break;
+	}
+	std::cout << hardwareThreads << " hardware threads" << std::endl;
+
+	// What the full import with the default settings makes of the mesh, the same path the renderer loads it through
+	start = Clock::now();
+	Resource::DecodedMesh decoded = Resource::Mesh::Decode(objFile, Resource::MeshImportSettings(), nullptr, false);
+	double decodeTime = ElapsedMilliseconds(start);
+	Resource::MeshDataView data = decoded.GetDataView();
+	uint64_t vertexBytes = 0;
+	for (uint32_t stream = 0; stream < decoded.format.GetStreamCount(); stream++)
+		vertexBytes += data.GetStreamSize(stream);
+
+	std::cout << "mesh import " << (decoded.cache != nullptr ? "(from the mesh cache): " : "(written to the mesh cache): ") << decodeTime << " ms" << std::endl;
+	std::cout << "  ACMR " << decoded.cacheStatsBefore.acmr << " -> " << decoded.cacheStatsAfter.acmr
+		<< ", ATVR " << decoded.cacheStatsBefore.atvr << " -> " << decoded.cacheStatsAfter.atvr
+		<< ", geometry " << (sizeof(Vertex) * data.vertexCount + sizeof(uint32_t) * data.indexCount) / 1024
+		<< " KB -> " << (vertexBytes + data.GetIndexDataSize()) / 1024 << " KB" << std::endl;
+	for (size_t lod = 1; lod < decoded.lods.size(); lod++)
+		std::cout << "  LOD " << lod << ": " << decoded.lods[lod].indexCount / 3 << " triangles, error " << decoded.lods[lod].error << std::endl;
+	if (!decoded.meshlets.empty())
+		std::cout << "  " << decoded.lods[0].meshletCount << " meshlets, " << decoded.meshlets.size() << " with every LOD" << std::endl;
+
+	return bIdentical && bMatchesTinyObj ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int Benchmarks::RunSkinningBenchmark()
+{
+	// 1M vertices on 64 joints
+	Resource::Skeleton skeleton;
+	Resource::AnimationClip clip;
+	std::vector<Resource::SkinVertex> vertices;
+	GenerateSkin(64, 4096, 256, skeleton, clip, vertices);
+
+	Resource::AnimationSampler sampler(&skeleton, &clip);
+	sampler.Sample(0.37f);
+	const glm::mat4* joints = sampler.GetSkinningMatrices().data();
+
+	std::cout << "Skinning " << vertices.size() << " vertices with " << skeleton.GetJointCount() << " joints" << std::endl;
+
+	const uint32_t iterations = 10;
+	std::vector<float> referencePositions(vertices.size() * 3);
+	Clock::time_point start = Clock::now();
+	for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		Engine::SkinningPass::SkinPositionsReference(vertices.data(), vertices.size(), joints, referencePositions.data());
+	double referenceTime = ElapsedMilliseconds(start) / iterations;
+
+	std::vector<float> positions(vertices.size() * 3);
+	start = Clock::now();
+	for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		Engine::SkinningPass::SkinPositions(vertices.data(), vertices.size(), joints, positions.data());
+	double simdTime = ElapsedMilliseconds(start) / iterations;
+
+	// both sum the same products in the same order, only contractions into fused multiply adds may differ
+	float maxError = 0.0f;
+	for (size_t i = 0; i < positions.size(); i++)
+		maxError = std::max(maxError, std::abs(positions[i] - referencePositions[i]));
+	bool bMatches = maxError <= 1e-5f;
+
+	std::cout << "reference: " << referenceTime << " ms per pass" << std::endl;
+	std::cout << "SSE:       " << simdTime << " ms per pass, " << referenceTime / simdTime << "x" << std::endl;
+	std::cout << "SSE output " << (bMatches ? "matches" : "DIFFERS FROM") << " the reference, max error " << maxError << std::endl;
+
+	// skinning.comp on the device the renderer picks, read back and checked against the same reference
+	Application app;
+	try
+	{
+		app.Initialize();
+		if (Application::s_skinningPass->IsGpuSkinning())
+		{
+			std::vector<float> gpuPositions(vertices.size() * 3);
+			start = Clock::now();
+			Application::s_skinningPass->SkinPositionsGpu(vertices.data(), vertices.size(), joints, skeleton.GetJointCount(), gpuPositions.data());
+			double gpuTime = ElapsedMilliseconds(start);
+
+			// the device may contract into fused multiply adds and order the matrix products its own way
+			float gpuMaxError = 0.0f;
+			for (size_t i = 0; i < gpuPositions.size(); i++)
+				gpuMaxError = std::max(gpuMaxError, std::abs(gpuPositions[i] - referencePositions[i]));
+			bool bGpuMatches = gpuMaxError <= 1e-4f;
+			bMatches = bMatches && bGpuMatches;
+
+			std::cout << "GPU:       " << gpuTime << " ms with upload and readback" << std::endl;
+			std::cout << "GPU output " << (bGpuMatches ? "matches" : "DIFFERS FROM") << " the reference, max error " << gpuMaxError << std::endl;
+		}
+		else
+		{
+			std::cout << "GPU:       skipped, the graphics queue has no compute support or GPU_SKINNING is off" << std::endl;
+		}
+		app.Shutdown();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "GPU check failed: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return bMatches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
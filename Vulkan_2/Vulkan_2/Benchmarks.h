@@ -0,0 +1,19 @@
+#pragma once
+
+// Command line benchmarks, run instead of the renderer (see main.cpp)
+namespace Benchmarks
+{
+	// Compares the welder against the previous unordered_map deduplication.
+	// Uses the given OBJ, or a generated multi-million triangle grid when objFile is nullptr.
+	int RunWeldBenchmark(const char* objFile);
+
+	// Times the previous tinyobjloader import against ObjImporter on one thread and on 2, 4, ... up to every hardware thread.
+	// Checks that every parallel output is byte identical to the serial one, and that the serial output has the vertices
+	// and indices of the tinyobj path with floats at most one ulp apart (from_chars rounds correctly, tinyobj may not).
+	// Ends with the vertex cache, LOD and meshlet statistics of the full mesh import.
+	int RunImportBenchmark(const char* objFile);
+
+	// Times the SSE skinning against the glm reference on a generated skin and checks both produce the same positions,
+	// then brings up the device and checks the positions skinning.comp reads back against the same reference
+	int RunSkinningBenchmark();
+}
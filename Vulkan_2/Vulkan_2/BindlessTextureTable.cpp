@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "BindlessTextureTable.h"
+
+#include "Application.h"
+#include "Image.h"
+
+Engine::BindlessTextureTable::BindlessTextureTable()
+{
+}
+
+Engine::BindlessTextureTable::~BindlessTextureTable()
+{
+	vkDestroyDescriptorPool(Application::s_logicalDevice, _descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(Application::s_logicalDevice, _descriptorSetLayout, nullptr);
+}
+
+void Engine::BindlessTextureTable::CreateDescriptorSetLayout(uint32_t maxTextures)
+{
+	_maxTextures = maxTextures;
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[0].pImmutableSamplers = nullptr;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[1].descriptorCount = _maxTextures;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].pImmutableSamplers = nullptr;
+
+	// Slots can be written while the set is bound, and unused slots may hold garbage
+	std::array<VkDescriptorBindingFlags, 2> bindingFlags = {
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT,
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+	bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsCreateInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+	layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(Application::s_logicalDevice, &layoutCreateInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create bindless descriptor set layout!!!");
+	}
+}
+
+void Engine::BindlessTextureTable::CreateDescriptorSet()
+{
+	std::array<VkDescriptorPoolSize, 2> poolSize{};
+	poolSize[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	poolSize[0].descriptorCount = 1;
+	poolSize[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSize[1].descriptorCount = _maxTextures;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo{};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSize.size());
+	poolCreateInfo.pPoolSizes = poolSize.data();
+	poolCreateInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(Application::s_logicalDevice, &poolCreateInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create bindless descriptor pool!!!");
+	}
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	variableCountInfo.descriptorSetCount = 1;
+	variableCountInfo.pDescriptorCounts = &_maxTextures;
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = &variableCountInfo;
+	allocateInfo.descriptorPool = _descriptorPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &_descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(Application::s_logicalDevice, &allocateInfo, &_descriptorSet) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate bindless descriptor set!!!");
+	}
+}
+
+void Engine::BindlessTextureTable::SetSampler(VkSampler sampler)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = _descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(Application::s_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+uint32_t Engine::BindlessTextureTable::RegisterTexture(VkImageView imageView)
+{
+	uint32_t slot;
+	if (!_freeSlots.empty())
+	{
+		slot = _freeSlots.back();
+		_freeSlots.pop_back();
+	}
+	else
+	{
+		if (_nextSlot >= _maxTextures)
+			throw std::runtime_error("Bindless texture table is full!!!");
+		slot = _nextSlot++;
+	}
+
+	WriteTexture(slot, imageView);
+	_textureCount++;
+	return slot;
+}
+
+void Engine::BindlessTextureTable::UnregisterTexture(uint32_t slot)
+{
+	// The slot keeps its stale view, partially bound lets it stay unwritten until reused
+	_freeSlots.push_back(slot);
+	_textureCount--;
+}
+
+void Engine::BindlessTextureTable::WriteTexture(uint32_t slot, VkImageView imageView)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = imageView;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = _descriptorSet;
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = slot;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(Application::s_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
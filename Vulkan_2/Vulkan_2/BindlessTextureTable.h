@@ -0,0 +1,48 @@
+#pragma once
+
+namespace Engine
+{
+	// One global descriptor set holding every texture in a single UPDATE_AFTER_BIND array of sampled images.
+	// Textures are registered into slots at load time and the shader selects them by slot index,
+	// so draws never have to rebind a texture set.
+	//   binding 0: sampler shared by every texture
+	//   binding 1: texture2DArray textures[] (variable count, partially bound), packed textures share the slot of their array
+	class BindlessTextureTable
+	{
+	public:
+		BindlessTextureTable();
+		~BindlessTextureTable();
+
+		void CreateDescriptorSetLayout(uint32_t maxTextures);
+		void CreateDescriptorSet();
+		void SetSampler(VkSampler sampler);
+
+		// Writes the image view into a free slot and returns the slot index
+		uint32_t RegisterTexture(VkImageView imageView);
+		void UnregisterTexture(uint32_t slot);
+
+	private:
+		void WriteTexture(uint32_t slot, VkImageView imageView);
+
+	public:
+#pragma region Getters
+
+		VkDescriptorSetLayout& GetDescriptorSetLayout() { return _descriptorSetLayout; }
+		VkDescriptorSet& GetDescriptorSet() { return _descriptorSet; }
+		uint32_t GetMaxTextures() const { return _maxTextures; }
+		uint32_t GetTextureCount() const { return _textureCount; }
+
+#pragma endregion
+
+	private:
+		VkDescriptorSetLayout _descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+
+		uint32_t _maxTextures = 0;
+		uint32_t _textureCount = 0;
+		// slots handed out so far, released slots are reused first
+		uint32_t _nextSlot = 0;
+		std::vector<uint32_t> _freeSlots;
+	};
+}
@@ -0,0 +1,579 @@
+#include "pch.h"
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+
+namespace
+{
+	// One 4x4 block, texels in row order
+	using BlockTexels = std::array<std::array<uint8_t, 4>, 16>;
+
+	const uint32_t BC7_MODE6_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Little endian bit stream, BC7 blocks are laid out from the lowest bit up
+	class BitWriter
+	{
+	public:
+		BitWriter(uint8_t* data) : _data(data) { memset(_data, 0, 16); }
+
+		void Write(uint32_t value, uint32_t bitCount)
+		{
+			for (uint32_t i = 0; i < bitCount; i++, _position++)
+			{
+				if (value & (1u << i))
+					_data[_position >> 3] |= static_cast<uint8_t>(1u << (_position & 7));
+			}
+		}
+
+	private:
+		uint8_t* _data;
+		uint32_t _position = 0;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data) : _data(data) {}
+
+		uint32_t Read(uint32_t bitCount)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < bitCount; i++, _position++)
+				value |= ((_data[_position >> 3] >> (_position & 7)) & 1u) << i;
+			return value;
+		}
+
+	private:
+		const uint8_t* _data;
+		uint32_t _position = 0;
+	};
+
+	uint32_t GetBlockSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			return 8;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	// Endpoints of the segment through the block along the principal axis of its first channelCount channels
+	void FitEndpoints(const BlockTexels& texels, uint32_t channelCount, float low[4], float high[4])
+	{
+		float mean[4] = {};
+		for (const auto& texel : texels)
+		{
+			for (uint32_t c = 0; c < channelCount; c++)
+				mean[c] += texel[c] / 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (const auto& texel : texels)
+		{
+			for (uint32_t i = 0; i < channelCount; i++)
+			{
+				for (uint32_t j = 0; j < channelCount; j++)
+					covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+			}
+		}
+
+		// power iteration, started from the channel with the largest spread so it never starts orthogonal to the axis
+		uint32_t widest = 0;
+		for (uint32_t c = 1; c < channelCount; c++)
+		{
+			if (covariance[c][c] > covariance[widest][widest])
+				widest = c;
+		}
+		float axis[4] = {};
+		for (uint32_t c = 0; c < channelCount; c++)
+			axis[c] = covariance[widest][c];
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (uint32_t i = 0; i < channelCount; i++)
+			{
+				for (uint32_t j = 0; j < channelCount; j++)
+					next[i] += covariance[i][j] * axis[j];
+				length += next[i] * next[i];
+			}
+			// flat block, every texel is the mean
+			if (length < 1e-12f)
+				break;
+			length = std::sqrt(length);
+			for (uint32_t c = 0; c < channelCount; c++)
+				axis[c] = next[c] / length;
+		}
+
+		float minT = 0.0f, maxT = 0.0f;
+		for (const auto& texel : texels)
+		{
+			float t = 0.0f;
+			for (uint32_t c = 0; c < channelCount; c++)
+				t += (texel[c] - mean[c]) * axis[c];
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+
+		for (uint32_t c = 0; c < channelCount; c++)
+		{
+			low[c] = std::min(std::max(mean[c] + axis[c] * minT, 0.0f), 255.0f);
+			high[c] = std::min(std::max(mean[c] + axis[c] * maxT, 0.0f), 255.0f);
+		}
+	}
+
+	uint16_t PackRgb565(const float color[3])
+	{
+		uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+		uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+		uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRgb565(uint16_t packed, int color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// bFourColors is false only for BC1 blocks with color0 <= color1, whose last entry is transparent black
+	void BuildColorPalette(uint16_t color0, uint16_t color1, bool bFourColors, int palette[4][4])
+	{
+		UnpackRgb565(color0, palette[0]);
+		UnpackRgb565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			if (bFourColors)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		palette[3][3] = bFourColors ? 255 : 0;
+	}
+
+	void BuildChannelPalette(uint8_t value0, uint8_t value1, int palette[8])
+	{
+		palette[0] = value0;
+		palette[1] = value1;
+		if (value0 > value1)
+		{
+			for (int i = 1; i < 7; i++)
+				palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++)
+				palette[i + 1] = ((5 - i) * value0 + i * value1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// BC1 color block, always in four color mode so it also serves as the color half of BC3
+	void EncodeColorBlock(const BlockTexels& texels, uint8_t* out)
+	{
+		float low[4], high[4];
+		FitEndpoints(texels, 3, low, high);
+
+		uint16_t color0 = PackRgb565(high);
+		uint16_t color1 = PackRgb565(low);
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t indices = 0;
+		// equal endpoints would switch the block to three color mode, index 0 alone already is exact
+		if (color0 != color1)
+		{
+			int palette[4][4];
+			BuildColorPalette(color0, color1, true, palette);
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				int bestError = INT32_MAX;
+				for (uint32_t entry = 0; entry < 4; entry++)
+				{
+					int error = 0;
+					for (int c = 0; c < 3; c++)
+						error += (texels[i][c] - palette[entry][c]) * (texels[i][c] - palette[entry][c]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = entry;
+					}
+				}
+				indices |= best << (i * 2);
+			}
+		}
+
+		memcpy(out, &color0, sizeof(color0));
+		memcpy(out + 2, &color1, sizeof(color1));
+		memcpy(out + 4, &indices, sizeof(indices));
+	}
+
+	void DecodeColorBlock(const uint8_t* block, bool bAllowThreeColors, BlockTexels& texels)
+	{
+		uint16_t color0, color1;
+		uint32_t indices;
+		memcpy(&color0, block, sizeof(color0));
+		memcpy(&color1, block + 2, sizeof(color1));
+		memcpy(&indices, block + 4, sizeof(indices));
+
+		int palette[4][4];
+		BuildColorPalette(color0, color1, !bAllowThreeColors || color0 > color1, palette);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const int* entry = palette[(indices >> (i * 2)) & 3];
+			for (int c = 0; c < 4; c++)
+				texels[i][c] = static_cast<uint8_t>(entry[c]);
+		}
+	}
+
+	// BC4 block of one channel, the alpha half of BC3 and either half of BC5
+	void EncodeChannelBlock(const BlockTexels& texels, uint32_t channel, uint8_t* out)
+	{
+		uint8_t minValue = 255, maxValue = 0;
+		for (const auto& texel : texels)
+		{
+			minValue = std::min(minValue, texel[channel]);
+			maxValue = std::max(maxValue, texel[channel]);
+		}
+
+		uint64_t indices = 0;
+		if (maxValue != minValue)
+		{
+			int palette[8];
+			BuildChannelPalette(maxValue, minValue, palette);
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint64_t best = 0;
+				int bestError = INT32_MAX;
+				for (uint32_t entry = 0; entry < 8; entry++)
+				{
+					int error = std::abs(texels[i][channel] - palette[entry]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = entry;
+					}
+				}
+				indices |= best << (i * 3);
+			}
+		}
+
+		out[0] = maxValue;
+		out[1] = minValue;
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+
+	void DecodeChannelBlock(const uint8_t* block, uint32_t channel, BlockTexels& texels)
+	{
+		int palette[8];
+		BuildChannelPalette(block[0], block[1], palette);
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+			indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+		for (uint32_t i = 0; i < 16; i++)
+			texels[i][channel] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+	}
+
+	uint8_t InterpolateBc7(uint32_t value0, uint32_t value1, uint32_t weight)
+	{
+		return static_cast<uint8_t>(((64 - weight) * value0 + weight * value1 + 32) >> 6);
+	}
+
+	// BC7 mode 6: 7 bit RGBA endpoints with one p-bit each, 4 bit indices
+	void EncodeBc7Block(const BlockTexels& texels, uint8_t* out)
+	{
+		float low[4], high[4];
+		FitEndpoints(texels, 4, low, high);
+
+		uint32_t bestEndpoints[2][4] = {};
+		uint32_t bestPBits[2] = {};
+		uint32_t bestIndices[16] = {};
+		uint64_t bestError = UINT64_MAX;
+
+		// every p-bit combination quantizes the endpoints differently, keep the one with the lowest error
+		for (uint32_t pBits = 0; pBits < 4; pBits++)
+		{
+			uint32_t pBit[2] = { pBits & 1, pBits >> 1 };
+			uint32_t endpoints[2][4];
+			uint32_t values[2][4];
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				const float source[2] = { low[c], high[c] };
+				for (uint32_t e = 0; e < 2; e++)
+				{
+					int quantized = static_cast<int>(std::floor((source[e] - pBit[e]) / 2.0f + 0.5f));
+					endpoints[e][c] = static_cast<uint32_t>(std::min(std::max(quantized, 0), 127));
+					values[e][c] = (endpoints[e][c] << 1) | pBit[e];
+				}
+			}
+
+			uint8_t palette[16][4];
+			for (uint32_t entry = 0; entry < 16; entry++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+					palette[entry][c] = InterpolateBc7(values[0][c], values[1][c], BC7_MODE6_WEIGHTS[entry]);
+			}
+
+			uint32_t indices[16];
+			uint64_t totalError = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				int bestTexelError = INT32_MAX;
+				for (uint32_t entry = 0; entry < 16; entry++)
+				{
+					int error = 0;
+					for (uint32_t c = 0; c < 4; c++)
+						error += (texels[i][c] - palette[entry][c]) * (texels[i][c] - palette[entry][c]);
+					if (error < bestTexelError)
+					{
+						bestTexelError = error;
+						indices[i] = entry;
+					}
+				}
+				totalError += bestTexelError;
+			}
+
+			if (totalError < bestError)
+			{
+				bestError = totalError;
+				memcpy(bestEndpoints, endpoints, sizeof(endpoints));
+				memcpy(bestPBits, pBit, sizeof(pBit));
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+		}
+
+		// the anchor index is stored without its top bit, swapping the endpoints clears it
+		if (bestIndices[0] & 8)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+				std::swap(bestEndpoints[0][c], bestEndpoints[1][c]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (uint32_t i = 0; i < 16; i++)
+				bestIndices[i] = 15 - bestIndices[i];
+		}
+
+		BitWriter writer(out);
+		writer.Write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writer.Write(bestEndpoints[0][c], 7);
+			writer.Write(bestEndpoints[1][c], 7);
+		}
+		writer.Write(bestPBits[0], 1);
+		writer.Write(bestPBits[1], 1);
+		writer.Write(bestIndices[0], 3);
+		for (uint32_t i = 1; i < 16; i++)
+			writer.Write(bestIndices[i], 4);
+	}
+
+	bool DecodeBc7Block(const uint8_t* block, BlockTexels& texels)
+	{
+		BitReader reader(block);
+		if (reader.Read(7) != (1 << 6))
+			return false;
+
+		uint32_t values[2][4];
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			values[0][c] = reader.Read(7) << 1;
+			values[1][c] = reader.Read(7) << 1;
+		}
+		uint32_t pBit0 = reader.Read(1);
+		uint32_t pBit1 = reader.Read(1);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			values[0][c] |= pBit0;
+			values[1][c] |= pBit1;
+		}
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t index = reader.Read(i == 0 ? 3 : 4);
+			for (uint32_t c = 0; c < 4; c++)
+				texels[i][c] = InterpolateBc7(values[0][c], values[1][c], BC7_MODE6_WEIGHTS[index]);
+		}
+		return true;
+	}
+
+	void EncodeBlock(VkFormat format, const BlockTexels& texels, uint8_t* out)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			EncodeColorBlock(texels, out);
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			EncodeChannelBlock(texels, 3, out);
+			EncodeColorBlock(texels, out + 8);
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			EncodeChannelBlock(texels, 0, out);
+			EncodeChannelBlock(texels, 1, out + 8);
+			break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			EncodeBc7Block(texels, out);
+			break;
+		default:
+			throw std::invalid_argument("Unsupported block compressed format!!!");
+		}
+	}
+
+	bool DecodeBlock(VkFormat format, const uint8_t* block, BlockTexels& texels)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			DecodeColorBlock(block, true, texels);
+			// the RGB formats ignore the transparent entry of three color blocks
+			for (auto& texel : texels)
+				texel[3] = 255;
+			return true;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			DecodeColorBlock(block + 8, false, texels);
+			DecodeChannelBlock(block, 3, texels);
+			return true;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			for (auto& texel : texels)
+			{
+				texel[2] = 0;
+				texel[3] = 255;
+			}
+			DecodeChannelBlock(block, 0, texels);
+			DecodeChannelBlock(block + 8, 1, texels);
+			return true;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return DecodeBc7Block(block, texels);
+		default:
+			return false;
+		}
+	}
+}
+
+VkFormat Resource::BlockCompression::GetFormat(TextureEncoding encoding, bool bSrgb)
+{
+	switch (encoding)
+	{
+	case TextureEncoding::RGBA8:
+		return bSrgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	case TextureEncoding::BC1:
+		return bSrgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case TextureEncoding::BC3:
+		return bSrgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	case TextureEncoding::BC5:
+		return bSrgb ? VK_FORMAT_UNDEFINED : VK_FORMAT_BC5_UNORM_BLOCK;
+	case TextureEncoding::BC7:
+		return bSrgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	default:
+		return VK_FORMAT_UNDEFINED;
+	}
+}
+
+bool Resource::BlockCompression::IsBlockCompressed(VkFormat format)
+{
+	return GetBlockSize(format) != 0;
+}
+
+bool Resource::BlockCompression::IsSrgb(VkFormat format)
+{
+	return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+uint64_t Resource::BlockCompression::GetLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	if (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB)
+		return static_cast<uint64_t>(width) * height * 4;
+
+	uint64_t blocksX = (static_cast<uint64_t>(width) + 3) / 4;
+	uint64_t blocksY = (static_cast<uint64_t>(height) + 3) / 4;
+	return blocksX * blocksY * GetBlockSize(format);
+}
+
+void Resource::BlockCompression::CompressLevel(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* blocks, Engine::ThreadPool* threadPool)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	uint32_t blockSize = GetBlockSize(format);
+
+	auto compressRow = [&](size_t blockY)
+	{
+		BlockTexels texels;
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = std::min(blockX * 4 + (i & 3), width - 1);
+				uint32_t y = std::min(static_cast<uint32_t>(blockY) * 4 + (i >> 2), height - 1);
+				memcpy(texels[i].data(), pixels + (static_cast<size_t>(y) * width + x) * 4, 4);
+			}
+			EncodeBlock(format, texels, blocks + (blockY * blocksX + blockX) * blockSize);
+		}
+	};
+
+	if (threadPool != nullptr)
+	{
+		threadPool->ParallelFor(blocksY, compressRow);
+	}
+	else
+	{
+		for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+			compressRow(blockY);
+	}
+}
+
+bool Resource::BlockCompression::DecompressLevel(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* pixels)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	uint32_t blockSize = GetBlockSize(format);
+
+	BlockTexels texels;
+	for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+	{
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			if (!DecodeBlock(format, blocks + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize, texels))
+				return false;
+
+			// texels past the edge of the level only exist in the block
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = blockX * 4 + (i & 3);
+				uint32_t y = blockY * 4 + (i >> 2);
+				if (x < width && y < height)
+					memcpy(pixels + (static_cast<size_t>(y) * width + x) * 4, texels[i].data(), 4);
+			}
+		}
+	}
+	return true;
+}
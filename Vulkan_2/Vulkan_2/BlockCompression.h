@@ -0,0 +1,45 @@
+#pragma once
+
+namespace Engine
+{
+	class ThreadPool;
+}
+
+namespace Resource
+{
+	// How the cooker stores a texture
+	enum class TextureEncoding
+	{
+		// uncompressed, 4 bytes per texel
+		RGBA8,
+		// opaque color, 0.5 bytes per texel
+		BC1,
+		// color with smooth alpha, 1 byte per texel
+		BC3,
+		// two independent channels (normal maps), 1 byte per texel
+		BC5,
+		// high quality color and alpha, 1 byte per texel
+		BC7,
+	};
+
+	// BCn encoders and decoders working on 4x4 blocks of RGBA8 texels.
+	// The encoders fit the endpoints along the principal axis of the block colors and pick the nearest palette entry
+	// per texel. BC7 is always written in mode 6 (one subset, RGBA endpoints, 4 bit indices), the decoder only reads that mode.
+	namespace BlockCompression
+	{
+		// VK_FORMAT_UNDEFINED when the encoding has no sRGB variant (BC5)
+		VkFormat GetFormat(TextureEncoding encoding, bool bSrgb);
+		bool IsBlockCompressed(VkFormat format);
+		bool IsSrgb(VkFormat format);
+		// Bytes of one level, 0 for formats the texture pipeline does not handle
+		uint64_t GetLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+		// Encodes an RGBA8 level, blocks on the right and bottom edge repeat the last column and row.
+		// Rows of blocks are spread over the pool when one is given.
+		void CompressLevel(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* blocks, Engine::ThreadPool* threadPool = nullptr);
+
+		// Decodes a level back into RGBA8 for devices without BC support.
+		// BC5 fills blue with 0 and alpha with 255. Returns false for BC7 blocks in another mode than the encoder writes.
+		bool DecompressLevel(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* pixels);
+	}
+}
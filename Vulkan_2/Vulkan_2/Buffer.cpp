@@ -39,6 +39,7 @@ void Engine::Buffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usageFla
 	{
 		throw std::runtime_error("Failed to allocate vertex buffer memory!!!");
 	}
+	_memorySize = memoryRequirements.size;
 
 	// Bind buffer memory
 	vkBindBufferMemory(Application::s_logicalDevice, _buffer, _bufferMemory, 0);
@@ -73,6 +74,7 @@ void Engine::Buffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usageFla
 	{
 		throw std::runtime_error("Failed to allocate vertex buffer memory!!!");
 	}
+	_memorySize = memoryRequirements.size;
 
 	// Bind buffer memory
 	vkBindBufferMemory(Application::s_logicalDevice, _buffer, _bufferMemory, 0);
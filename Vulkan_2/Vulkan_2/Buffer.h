@@ -19,6 +19,8 @@ namespace Engine
 
 		VkBuffer& GetBuffer() { return _buffer; }
 		VkDeviceMemory& GetBufferMemory() { return _bufferMemory; }
+		// bytes of the allocation, at least the requested size
+		VkDeviceSize GetMemorySize() const { return _memorySize; }
 
 		VkDeviceSize& GetVertexOffset() { return _vertexOffset; }
 		VkDeviceSize& GetIndexOffset() { return _indexOffset; }
@@ -37,5 +39,6 @@ namespace Engine
 		VkDeviceMemory _bufferMemory;
 		VkDeviceSize _vertexOffset;
 		VkDeviceSize _indexOffset;
+		VkDeviceSize _memorySize = 0;
 	};
 }
@@ -6,6 +6,51 @@ const uint32_t WINDOW_HEIGHT = 1080;
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+// Upper bound for the bindless texture array, clamped to the device limits
+const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+
+// Largest simplification error a LOD level may show on screen, in pixels
+const float LOD_ERROR_THRESHOLD = 1.0f;
+// Share of the threshold a coarser level has to stay below before it is picked
+const float LOD_HYSTERESIS = 0.25f;
+
+// Lay down depth with the position stream alone before shading, so fragments hidden behind
+// nearer surfaces never run the full fragment shader. Alpha tested materials only write depth in the shading pass.
+const bool DEPTH_PREPASS = true;
+
+// Bytes of the persistently mapped upload ring, larger uploads stream through it in chunks
+const uint64_t STAGING_RING_SIZE = 64ull * 1024 * 1024;
+
+// Meshes import on the thread pool and are skipped by the renderer until they are resident
+const bool MESH_STREAMING = true;
+// Mesh imports running at once, the rest wait in a queue ordered by camera distance
+const uint32_t MESH_STREAMING_MAX_LOADS = 2;
+
+// System memory the CPU copies of loaded meshes may take, unpinned copies are dropped above it.
+// 0 drops every copy nobody pinned right after its upload.
+const uint64_t ASSET_CPU_MEMORY_BUDGET = 0;
+// Device memory of loaded meshes and textures. Above it the ones no draw used recently are unloaded and load again
+// from their caches once an object draws them.
+const uint64_t ASSET_GPU_MEMORY_BUDGET = 1024ull * 1024 * 1024;
+
+// Cooked textures load their mip tail only and stream finer levels in as draws need them
+const bool TEXTURE_STREAMING = true;
+// Largest edge of the levels every streamed texture keeps resident
+const uint32_t TEXTURE_STREAMING_TAIL_SIZE = 128;
+// Bytes of texture levels read and uploaded per frame, one level is always allowed so large levels cannot starve
+const uint64_t TEXTURE_STREAMING_FRAME_BUDGET = 16ull * 1024 * 1024;
+// Device memory the streamed textures may take, levels nobody asked for recently are evicted above it
+const uint64_t TEXTURE_STREAMING_MEMORY_BUDGET = 512ull * 1024 * 1024;
+
+// Textures up to this edge share array images with others of their format and size.
+// Not above the streaming tail, a streamed texture changes its image and cannot live in an array.
+const uint32_t TEXTURE_ARRAY_MAX_SIZE = TEXTURE_STREAMING_TAIL_SIZE;
+// Layers of one texture array image
+const uint32_t TEXTURE_ARRAY_LAYERS = 64;
+
+// Skin meshes in a compute shader, otherwise with SSE on the CPU. Devices without compute on the graphics queue always use the CPU.
+const bool GPU_SKINNING = true;
+
 const std::vector<const char*> validationLayers = 
 {
     "VK_LAYER_KHRONOS_validation"
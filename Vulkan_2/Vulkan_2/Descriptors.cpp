@@ -1,2 +1,316 @@
 #include "pch.h"
-#include "Descriptors.h"
\ No newline at end of file
+#include "Descriptors.h"
+
+#include "Application.h"
+
+// Upper bound for a single pool in the chain
+static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+static void HashCombine(size_t& seed, size_t value)
+{
+	seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+#pragma region DescriptorAllocator
+
+Engine::DescriptorAllocator::DescriptorAllocator()
+{
+}
+
+Engine::DescriptorAllocator::~DescriptorAllocator()
+{
+	for (VkDescriptorPool pool : _readyPools)
+		vkDestroyDescriptorPool(Application::s_logicalDevice, pool, nullptr);
+	for (VkDescriptorPool pool : _fullPools)
+		vkDestroyDescriptorPool(Application::s_logicalDevice, pool, nullptr);
+}
+
+void Engine::DescriptorAllocator::CreateDescriptorAllocator(uint32_t initialSetsPerPool, const std::vector<DescriptorPoolSizeRatio>& poolRatios, VkDescriptorPoolCreateFlags flags)
+{
+	_poolRatios = poolRatios;
+	_flags = flags;
+
+	_readyPools.push_back(CreatePool(initialSetsPerPool));
+	_setsPerPool = std::min(initialSetsPerPool * 2, MAX_SETS_PER_POOL);
+}
+
+VkDescriptorSet Engine::DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+	VkDescriptorPool pool = GetPool();
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = pool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(Application::s_logicalDevice, &allocateInfo, &descriptorSet);
+
+	// The pool is exhausted, park it and retry once from a fresh pool
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		_fullPools.push_back(pool);
+		_readyPools.pop_back();
+
+		allocateInfo.descriptorPool = GetPool();
+		result = vkAllocateDescriptorSets(Application::s_logicalDevice, &allocateInfo, &descriptorSet);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate descriptor set!!!");
+	}
+
+	if (_flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+		_setPools.emplace(descriptorSet, allocateInfo.descriptorPool);
+
+	return descriptorSet;
+}
+
+void Engine::DescriptorAllocator::Free(VkDescriptorSet descriptorSet)
+{
+	auto it = _setPools.find(descriptorSet);
+	if (it == _setPools.end())
+	{
+		throw std::runtime_error("Failed to free descriptor set, it was not allocated from a pool that can free sets!!!");
+	}
+
+	VkDescriptorPool pool = it->second;
+	_setPools.erase(it);
+	vkFreeDescriptorSets(Application::s_logicalDevice, pool, 1, &descriptorSet);
+
+	// A full pool has room again, it goes behind the current one so new sets keep filling the newest pool first
+	auto full = std::find(_fullPools.begin(), _fullPools.end(), pool);
+	if (full != _fullPools.end())
+	{
+		_fullPools.erase(full);
+		_readyPools.insert(_readyPools.begin(), pool);
+	}
+}
+
+void Engine::DescriptorAllocator::ResetPools()
+{
+	for (VkDescriptorPool pool : _readyPools)
+		vkResetDescriptorPool(Application::s_logicalDevice, pool, 0);
+
+	for (VkDescriptorPool pool : _fullPools)
+	{
+		vkResetDescriptorPool(Application::s_logicalDevice, pool, 0);
+		_readyPools.push_back(pool);
+	}
+	_fullPools.clear();
+	_setPools.clear();
+}
+
+VkDescriptorPool Engine::DescriptorAllocator::GetPool()
+{
+	if (!_readyPools.empty())
+		return _readyPools.back();
+
+	VkDescriptorPool pool = CreatePool(_setsPerPool);
+	_setsPerPool = std::min(_setsPerPool * 2, MAX_SETS_PER_POOL);
+	_readyPools.push_back(pool);
+	return pool;
+}
+
+VkDescriptorPool Engine::DescriptorAllocator::CreatePool(uint32_t setCount)
+{
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	poolSizes.reserve(_poolRatios.size());
+	for (const DescriptorPoolSizeRatio& ratio : _poolRatios)
+	{
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = ratio.type;
+		poolSize.descriptorCount = std::max(1u, static_cast<uint32_t>(ratio.ratio * setCount));
+		poolSizes.push_back(poolSize);
+	}
+
+	VkDescriptorPoolCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	createInfo.flags = _flags;
+	createInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	createInfo.pPoolSizes = poolSizes.data();
+	createInfo.maxSets = setCount;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(Application::s_logicalDevice, &createInfo, nullptr, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create descriptor pool!!!");
+	}
+
+	return pool;
+}
+
+#pragma endregion
+
+#pragma region DescriptorSetBuilder
+
+Engine::DescriptorSetBuilder::DescriptorSetBuilder(VkDescriptorSetLayout layout)
+	: _layout(layout)
+{
+}
+
+Engine::DescriptorSetBuilder& Engine::DescriptorSetBuilder::BindBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	DescriptorBinding descriptorBinding{};
+	descriptorBinding.binding = binding;
+	descriptorBinding.type = type;
+	descriptorBinding.buffer = buffer;
+	descriptorBinding.offset = offset;
+	descriptorBinding.range = range;
+	_bindings.push_back(descriptorBinding);
+	return *this;
+}
+
+Engine::DescriptorSetBuilder& Engine::DescriptorSetBuilder::BindImage(uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout)
+{
+	DescriptorBinding descriptorBinding{};
+	descriptorBinding.binding = binding;
+	descriptorBinding.type = type;
+	descriptorBinding.imageView = imageView;
+	descriptorBinding.sampler = sampler;
+	descriptorBinding.imageLayout = imageLayout;
+	_bindings.push_back(descriptorBinding);
+	return *this;
+}
+
+VkDescriptorSet Engine::DescriptorSetBuilder::Build(DescriptorAllocator* allocator) const
+{
+	VkDescriptorSet descriptorSet = allocator->Allocate(_layout);
+	Write(descriptorSet);
+	return descriptorSet;
+}
+
+void Engine::DescriptorSetBuilder::Write(VkDescriptorSet descriptorSet) const
+{
+	// reserved up front, the writes point into these
+	std::vector<VkDescriptorBufferInfo> bufferInfos;
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	bufferInfos.reserve(_bindings.size());
+	imageInfos.reserve(_bindings.size());
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+	descriptorWrites.reserve(_bindings.size());
+
+	for (const DescriptorBinding& binding : _bindings)
+	{
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet;
+		descriptorWrite.dstBinding = binding.binding;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.descriptorType = binding.type;
+
+		if (binding.buffer != VK_NULL_HANDLE)
+		{
+			VkDescriptorBufferInfo bufferInfo{};
+			bufferInfo.buffer = binding.buffer;
+			bufferInfo.offset = binding.offset;
+			bufferInfo.range = binding.range;
+			bufferInfos.push_back(bufferInfo);
+			descriptorWrite.pBufferInfo = &bufferInfos.back();
+		}
+		else
+		{
+			VkDescriptorImageInfo imageInfo{};
+			imageInfo.imageView = binding.imageView;
+			imageInfo.sampler = binding.sampler;
+			imageInfo.imageLayout = binding.imageLayout;
+			imageInfos.push_back(imageInfo);
+			descriptorWrite.pImageInfo = &imageInfos.back();
+		}
+
+		descriptorWrites.push_back(descriptorWrite);
+	}
+
+	vkUpdateDescriptorSets(Application::s_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+size_t Engine::DescriptorSetBuilder::Hash() const
+{
+	size_t seed = std::hash<VkDescriptorSetLayout>()(_layout);
+	for (const DescriptorBinding& binding : _bindings)
+	{
+		HashCombine(seed, std::hash<uint32_t>()(binding.binding));
+		HashCombine(seed, std::hash<uint32_t>()(static_cast<uint32_t>(binding.type)));
+		HashCombine(seed, std::hash<VkBuffer>()(binding.buffer));
+		HashCombine(seed, std::hash<VkDeviceSize>()(binding.offset));
+		HashCombine(seed, std::hash<VkDeviceSize>()(binding.range));
+		HashCombine(seed, std::hash<VkImageView>()(binding.imageView));
+		HashCombine(seed, std::hash<VkSampler>()(binding.sampler));
+		HashCombine(seed, std::hash<uint32_t>()(static_cast<uint32_t>(binding.imageLayout)));
+	}
+	return seed;
+}
+
+bool Engine::DescriptorSetBuilder::BindsImageView(VkImageView imageView) const
+{
+	for (const DescriptorBinding& binding : _bindings)
+	{
+		if (binding.imageView == imageView)
+			return true;
+	}
+	return false;
+}
+
+#pragma endregion
+
+#pragma region DescriptorSetCache
+
+Engine::DescriptorSetCache::DescriptorSetCache(DescriptorAllocator* allocator)
+	: _allocator(allocator)
+{
+}
+
+Engine::DescriptorSetCache::~DescriptorSetCache()
+{
+}
+
+VkDescriptorSet Engine::DescriptorSetCache::GetDescriptorSet(const DescriptorSetBuilder& builder)
+{
+	auto it = _sets.find(builder);
+	if (it != _sets.end())
+		return it->second;
+
+	VkDescriptorSet descriptorSet = builder.Build(_allocator);
+	_sets.emplace(builder, descriptorSet);
+	return descriptorSet;
+}
+
+void Engine::DescriptorSetCache::InvalidateImageView(VkImageView imageView)
+{
+	for (auto it = _sets.begin(); it != _sets.end();)
+	{
+		if (it->first.BindsImageView(imageView))
+		{
+			Retire(it->second);
+			it = _sets.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+void Engine::DescriptorSetCache::Update()
+{
+	for (auto it = _retiredSets.begin(); it != _retiredSets.end();)
+	{
+		if (it->framesLeft-- == 0)
+		{
+			_allocator->Free(it->descriptorSet);
+			it = _retiredSets.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+void Engine::DescriptorSetCache::Retire(VkDescriptorSet descriptorSet)
+{
+	// command buffers still in flight may bind the set
+	_retiredSets.push_back({ descriptorSet, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) });
+}
+
+#pragma endregion
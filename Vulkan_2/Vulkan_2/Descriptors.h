@@ -1,36 +1,142 @@
 #pragma once
+#include <list>
 #include <unordered_map>
 
 namespace Engine
 {
-    class LveDescriptorSetLayout {
-    public:
-        class Builder {
-        public:
-            Builder(){}
-
-            Builder& addBinding(
-                uint32_t binding,
-                VkDescriptorType descriptorType,
-                VkShaderStageFlags stageFlags,
-                uint32_t count = 1);
-            std::unique_ptr<LveDescriptorSetLayout> build() const;
-
-        private:
-            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
-        };
-
-        LveDescriptorSetLayout(std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
-        ~LveDescriptorSetLayout();
-        LveDescriptorSetLayout(const LveDescriptorSetLayout&) = delete;
-        LveDescriptorSetLayout& operator=(const LveDescriptorSetLayout&) = delete;
-
-        VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
-
-    private:
-        VkDescriptorSetLayout descriptorSetLayout;
-        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
-
-        friend class LveDescriptorWriter;
-    };
+	// Descriptor count per set for one descriptor type, a pool for N sets gets ratio * N descriptors of that type
+	struct DescriptorPoolSizeRatio
+	{
+		VkDescriptorType type;
+		float ratio;
+	};
+
+	// Hands out descriptor sets from a chain of pools.
+	// When the current pool runs out a new, larger one is created, so allocation never fails on pool size.
+	// Pools are reset as a whole, individual sets can only be freed when the pools are created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+	class DescriptorAllocator
+	{
+	public:
+		DescriptorAllocator();
+		~DescriptorAllocator();
+
+		void CreateDescriptorAllocator(uint32_t initialSetsPerPool, const std::vector<DescriptorPoolSizeRatio>& poolRatios, VkDescriptorPoolCreateFlags flags = 0);
+
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+		// Returns a single set to its pool, the caller makes sure no command buffer in flight still uses it
+		void Free(VkDescriptorSet descriptorSet);
+		// Returns every set to the pools in one call, all sets handed out so far become invalid
+		void ResetPools();
+
+	private:
+		VkDescriptorPool GetPool();
+		VkDescriptorPool CreatePool(uint32_t setCount);
+
+	public:
+#pragma region Getters
+
+		size_t GetPoolCount() const { return _readyPools.size() + _fullPools.size(); }
+
+#pragma endregion
+
+	private:
+		std::vector<DescriptorPoolSizeRatio> _poolRatios;
+		VkDescriptorPoolCreateFlags _flags = 0;
+		// size of the next pool, grows every time the chain is extended
+		uint32_t _setsPerPool = 0;
+
+		std::vector<VkDescriptorPool> _readyPools;
+		std::vector<VkDescriptorPool> _fullPools;
+		// pool of every live set, only tracked when sets can be freed
+		std::unordered_map<VkDescriptorSet, VkDescriptorPool> _setPools;
+	};
+
+	// Everything that is written into one binding of a set
+	struct DescriptorBinding
+	{
+		uint32_t binding = 0;
+		VkDescriptorType type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize range = 0;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkImageLayout imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		bool operator==(const DescriptorBinding& other) const
+		{
+			return binding == other.binding && type == other.type && buffer == other.buffer && offset == other.offset && range == other.range &&
+				imageView == other.imageView && sampler == other.sampler && imageLayout == other.imageLayout;
+		}
+	};
+
+	// Layout plus binding contents, identifies a descriptor set by what it holds
+	class DescriptorSetBuilder
+	{
+	public:
+		DescriptorSetBuilder(VkDescriptorSetLayout layout);
+
+		DescriptorSetBuilder& BindBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+		DescriptorSetBuilder& BindImage(uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+
+		// Allocates a new set and writes every binding into it
+		VkDescriptorSet Build(DescriptorAllocator* allocator) const;
+		void Write(VkDescriptorSet descriptorSet) const;
+
+		bool operator==(const DescriptorSetBuilder& other) const { return _layout == other._layout && _bindings == other._bindings; }
+		size_t Hash() const;
+		bool BindsImageView(VkImageView imageView) const;
+
+#pragma region Getters
+
+		VkDescriptorSetLayout GetLayout() const { return _layout; }
+
+#pragma endregion
+
+	private:
+		VkDescriptorSetLayout _layout;
+		std::vector<DescriptorBinding> _bindings;
+	};
+
+	struct DescriptorSetBuilderHash
+	{
+		size_t operator()(const DescriptorSetBuilder& builder) const { return builder.Hash(); }
+	};
+
+	// Maps identical layout + binding contents to the set that was already written for them,
+	// so stable content costs a hash lookup per draw instead of an allocation and descriptor writes.
+	// Sets that reference a destroyed image view are dropped with InvalidateImageView and freed
+	// MAX_FRAMES_IN_FLIGHT frames later, the allocator needs VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+	class DescriptorSetCache
+	{
+	public:
+		DescriptorSetCache(DescriptorAllocator* allocator);
+		~DescriptorSetCache();
+
+		VkDescriptorSet GetDescriptorSet(const DescriptorSetBuilder& builder);
+		// Drops every cached set that binds the view, command buffers in flight keep using them until they are freed
+		void InvalidateImageView(VkImageView imageView);
+		// Once per frame after the frame's fence, frees the sets dropped MAX_FRAMES_IN_FLIGHT frames ago
+		void Update();
+
+#pragma region Getters
+
+		size_t GetSetCount() const { return _sets.size(); }
+
+#pragma endregion
+
+	private:
+		void Retire(VkDescriptorSet descriptorSet);
+
+	private:
+		struct RetiredSet
+		{
+			VkDescriptorSet descriptorSet;
+			uint32_t framesLeft;
+		};
+
+		DescriptorAllocator* _allocator;
+		std::unordered_map<DescriptorSetBuilder, VkDescriptorSet, DescriptorSetBuilderHash> _sets;
+		std::list<RetiredSet> _retiredSets;
+	};
 }
@@ -0,0 +1,777 @@
+#include "pch.h"
+#include "GlbImporter.h"
+#include "Mesh.h"
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+	const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+	const uint32_t GLB_VERSION = 2;
+	const uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+	const uint32_t GLB_CHUNK_BIN = 0x004E4942; // "BIN\0"
+
+	const uint32_t COMPONENT_BYTE = 5120;
+	const uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+	const uint32_t COMPONENT_SHORT = 5122;
+	const uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+	const uint32_t COMPONENT_UNSIGNED_INT = 5125;
+	const uint32_t COMPONENT_FLOAT = 5126;
+
+	const uint64_t PRIMITIVE_MODE_TRIANGLES = 4;
+
+	// nodes deeper than this are treated as a broken hierarchy
+	const uint32_t MAX_NODE_DEPTH = 256;
+
+	uint32_t ReadUint32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t GetComponentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case COMPONENT_BYTE:
+		case COMPONENT_UNSIGNED_BYTE:
+			return 1;
+		case COMPONENT_SHORT:
+		case COMPONENT_UNSIGNED_SHORT:
+			return 2;
+		case COMPONENT_UNSIGNED_INT:
+		case COMPONENT_FLOAT:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	uint32_t GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT4") return 16;
+		return 0;
+	}
+}
+
+uint32_t Resource::GlbImporter::Accessor::GetElementSize() const
+{
+	return componentCount * GetComponentSize(componentType);
+}
+
+void Resource::GlbImporter::Accessor::ReadFloats(uint64_t element, float* values, uint32_t valueCount) const
+{
+	for (uint32_t component = 0; component < valueCount; component++)
+		values[component] = 0.0f;
+	if (data == nullptr)
+		return;
+
+	const uint8_t* source = data + element * stride;
+	uint32_t count = std::min(valueCount, componentCount);
+	for (uint32_t component = 0; component < count; component++)
+	{
+		switch (componentType)
+		{
+		case COMPONENT_FLOAT:
+			memcpy(&values[component], source + component * 4, 4);
+			break;
+		case COMPONENT_UNSIGNED_BYTE:
+			values[component] = source[component] / (bNormalized ? 255.0f : 1.0f);
+			break;
+		case COMPONENT_BYTE:
+		{
+			float value = static_cast<int8_t>(source[component]);
+			values[component] = bNormalized ? std::max(value / 127.0f, -1.0f) : value;
+			break;
+		}
+		case COMPONENT_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, source + component * 2, 2);
+			values[component] = value / (bNormalized ? 65535.0f : 1.0f);
+			break;
+		}
+		case COMPONENT_SHORT:
+		{
+			int16_t value;
+			memcpy(&value, source + component * 2, 2);
+			values[component] = bNormalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+			break;
+		}
+		case COMPONENT_UNSIGNED_INT:
+			values[component] = static_cast<float>(ReadUint32(source + component * 4));
+			break;
+		}
+	}
+}
+
+uint32_t Resource::GlbImporter::Accessor::ReadIndex(uint64_t element) const
+{
+	if (data == nullptr)
+		return 0;
+
+	const uint8_t* source = data + element * stride;
+	switch (componentType)
+	{
+	case COMPONENT_UNSIGNED_BYTE:
+		return source[0];
+	case COMPONENT_UNSIGNED_SHORT:
+	{
+		uint16_t value;
+		memcpy(&value, source, 2);
+		return value;
+	}
+	default:
+		return ReadUint32(source);
+	}
+}
+
+Resource::GlbImporter::GlbImporter()
+{
+}
+
+Resource::GlbImporter::~GlbImporter()
+{
+}
+
+void Resource::GlbImporter::Import(const char* file, std::vector<Mesh*>& meshes, std::vector<ModelInstance>& instances)
+{
+	ReadChunks(file);
+
+	// every primitive is uploaded once, nodes only reference them
+	const Engine::JsonValue& gltfMeshes = _document["meshes"];
+	size_t firstMesh = meshes.size();
+	_meshPrimitives.resize(gltfMeshes.GetSize());
+	for (size_t mesh = 0; mesh < gltfMeshes.GetSize(); mesh++)
+	{
+		const Engine::JsonValue& primitives = gltfMeshes[mesh]["primitives"];
+		for (size_t primitive = 0; primitive < primitives.GetSize(); primitive++)
+		{
+			Mesh* imported = ImportPrimitive(primitives[primitive]);
+			if (imported == nullptr)
+				continue;
+
+			_meshPrimitives[mesh].push_back(static_cast<uint32_t>(meshes.size()));
+			meshes.push_back(imported);
+		}
+	}
+
+	const Engine::JsonValue& nodes = _document["nodes"];
+	_visitedNodes.assign(nodes.GetSize(), false);
+
+	const Engine::JsonValue& scenes = _document["scenes"];
+	if (scenes.GetSize() > 0)
+	{
+		const Engine::JsonValue& roots = scenes[_document["scene"].GetUint(0)]["nodes"];
+		for (size_t root = 0; root < roots.GetSize(); root++)
+			ImportNode(roots[root].GetUint(UINT64_MAX), glm::mat4(1.0f), 0, instances);
+	}
+	else
+	{
+		// no scene: every node that is nobody's child is a root
+		std::vector<bool> bChild(nodes.GetSize(), false);
+		for (size_t node = 0; node < nodes.GetSize(); node++)
+		{
+			const Engine::JsonValue& children = nodes[node]["children"];
+			for (size_t child = 0; child < children.GetSize(); child++)
+			{
+				uint64_t index = children[child].GetUint(UINT64_MAX);
+				if (index < bChild.size())
+					bChild[index] = true;
+			}
+		}
+		for (size_t node = 0; node < nodes.GetSize(); node++)
+		{
+			if (!bChild[node])
+				ImportNode(node, glm::mat4(1.0f), 0, instances);
+		}
+	}
+
+	// a file with meshes but without any nodes still shows its meshes, untransformed
+	if (nodes.GetSize() == 0)
+	{
+		for (size_t mesh = firstMesh; mesh < meshes.size(); mesh++)
+			instances.push_back({ static_cast<uint32_t>(mesh), glm::mat4(1.0f) });
+	}
+}
+
+void Resource::GlbImporter::ImportSkin(const char* file, Mesh*& mesh, std::vector<SkinVertex>& skinVertices, Skeleton& skeleton, std::vector<AnimationClip>& clips)
+{
+	ReadChunks(file);
+
+	const Engine::JsonValue& nodes = _document["nodes"];
+	size_t skinnedNode = 0;
+	while (skinnedNode < nodes.GetSize() && !(nodes[skinnedNode].Has("mesh") && nodes[skinnedNode].Has("skin")))
+		skinnedNode++;
+	if (skinnedNode == nodes.GetSize())
+		throw std::runtime_error(std::string(file) + " has no skinned mesh!!!");
+
+	const Engine::JsonValue& skin = _document["skins"][nodes[skinnedNode]["skin"].GetUint(UINT64_MAX)];
+	if (!skin.IsObject())
+		throw std::runtime_error("GLB node refers to a missing skin!!!");
+
+	const Engine::JsonValue& primitives = _document["meshes"][nodes[skinnedNode]["mesh"].GetUint(UINT64_MAX)]["primitives"];
+	size_t primitive = 0;
+	while (primitive < primitives.GetSize() && primitives[primitive]["mode"].GetUint(PRIMITIVE_MODE_TRIANGLES) != PRIMITIVE_MODE_TRIANGLES)
+		primitive++;
+	if (primitive == primitives.GetSize())
+		throw std::runtime_error("GLB skinned mesh has no triangle primitive!!!");
+
+	std::vector<uint32_t> jointRemap;
+	std::vector<uint32_t> nodeJoints;
+	ImportSkeleton(skin, skeleton, jointRemap, nodeJoints);
+	ImportSkinVertices(primitives[primitive], jointRemap, skinVertices);
+	ImportAnimations(nodeJoints, clips);
+
+	// last, nothing has to be cleaned up when the skin data is rejected
+	mesh = ImportPrimitive(primitives[primitive], false);
+}
+
+void Resource::GlbImporter::ReadChunks(const char* file)
+{
+	if (!_file.Open(file))
+		throw std::runtime_error(std::string("Failed to open ") + file + "!!!");
+
+	const uint8_t* data = _file.GetData();
+	uint64_t size = _file.GetSize();
+
+	// header: magic, version, total length
+	if (size < 12 || ReadUint32(data) != GLB_MAGIC)
+		throw std::runtime_error(std::string(file) + " is not a binary glTF file!!!");
+	if (ReadUint32(data + 4) != GLB_VERSION)
+		throw std::runtime_error(std::string(file) + " is not glTF 2.0!!!");
+	uint64_t length = std::min<uint64_t>(ReadUint32(data + 8), size);
+
+	// chunks: length, type, data padded to 4 bytes. The first one is the JSON, the optional second one the binary buffer
+	const char* json = nullptr;
+	uint64_t jsonSize = 0;
+	uint64_t offset = 12;
+	while (offset + 8 <= length)
+	{
+		uint64_t chunkSize = ReadUint32(data + offset);
+		uint32_t chunkType = ReadUint32(data + offset + 4);
+		offset += 8;
+		if (chunkSize > length - offset)
+			throw std::runtime_error(std::string(file) + " has a truncated chunk!!!");
+
+		if (chunkType == GLB_CHUNK_JSON && json == nullptr)
+		{
+			json = reinterpret_cast<const char*>(data + offset);
+			jsonSize = chunkSize;
+		}
+		else if (chunkType == GLB_CHUNK_BIN && _binary == nullptr)
+		{
+			_binary = data + offset;
+			_binarySize = chunkSize;
+		}
+		// unknown chunks are skipped as the specification asks
+		offset += (chunkSize + 3) & ~uint64_t(3);
+	}
+
+	if (json == nullptr || !Engine::JsonValue::Parse(json, static_cast<size_t>(jsonSize), _document) || !_document.IsObject())
+		throw std::runtime_error(std::string(file) + " has no valid JSON chunk!!!");
+
+	const Engine::JsonValue& required = _document["extensionsRequired"];
+	if (required.GetSize() > 0)
+		throw std::runtime_error(std::string(file) + " requires the unsupported extension " + required[size_t(0)].GetString() + "!!!");
+}
+
+Resource::GlbImporter::Accessor Resource::GlbImporter::GetAccessor(const Engine::JsonValue& index, const char* name) const
+{
+	const Engine::JsonValue& json = _document["accessors"][index.GetUint(UINT64_MAX)];
+	if (!json.IsObject())
+		throw std::runtime_error(std::string("GLB ") + name + " refers to a missing accessor!!!");
+	if (json.Has("sparse"))
+		throw std::runtime_error(std::string("GLB ") + name + " uses an unsupported sparse accessor!!!");
+
+	Accessor accessor;
+	accessor.count = json["count"].GetUint(0);
+	accessor.componentType = static_cast<uint32_t>(json["componentType"].GetUint(0));
+	accessor.componentCount = GetComponentCount(json["type"].GetString());
+	accessor.bNormalized = json["normalized"].GetBool(false);
+	uint32_t elementSize = accessor.GetElementSize();
+	if (elementSize == 0)
+		throw std::runtime_error(std::string("GLB ") + name + " has an invalid accessor type!!!");
+	accessor.stride = elementSize;
+
+	if (!json.Has("bufferView") || accessor.count == 0)
+		return accessor;
+
+	const Engine::JsonValue& view = _document["bufferViews"][json["bufferView"].GetUint(UINT64_MAX)];
+	if (!view.IsObject())
+		throw std::runtime_error(std::string("GLB ") + name + " refers to a missing buffer view!!!");
+	// only the binary chunk of the file itself, buffer 0 without uri
+	if (view["buffer"].GetUint(UINT64_MAX) != 0 || _document["buffers"][size_t(0)].Has("uri") || _binary == nullptr)
+		throw std::runtime_error(std::string("GLB ") + name + " uses an external buffer!!!");
+
+	uint64_t viewOffset = view["byteOffset"].GetUint(0);
+	uint64_t viewLength = view["byteLength"].GetUint(UINT64_MAX);
+	if (viewOffset > _binarySize || viewLength > _binarySize - viewOffset)
+		throw std::runtime_error(std::string("GLB ") + name + " buffer view lies outside the binary chunk!!!");
+
+	accessor.stride = static_cast<uint32_t>(view["byteStride"].GetUint(elementSize));
+	if (accessor.stride < elementSize)
+		throw std::runtime_error(std::string("GLB ") + name + " has a byte stride below its element size!!!");
+
+	// last element must end inside the view, count is checked first so the product cannot overflow
+	uint64_t accessorOffset = json["byteOffset"].GetUint(0);
+	if (accessor.count > viewLength || accessorOffset > viewLength
+		|| (accessor.count - 1) * accessor.stride + elementSize > viewLength - accessorOffset)
+		throw std::runtime_error(std::string("GLB ") + name + " accessor lies outside its buffer view!!!");
+
+	accessor.data = _binary + viewOffset + accessorOffset;
+	return accessor;
+}
+
+Resource::Mesh* Resource::GlbImporter::ImportPrimitive(const Engine::JsonValue& primitive, bool bColors)
+{
+	if (primitive["mode"].GetUint(PRIMITIVE_MODE_TRIANGLES) != PRIMITIVE_MODE_TRIANGLES)
+	{
+		std::cerr << "GLB primitive skipped, only triangle lists are supported" << std::endl;
+		return nullptr;
+	}
+
+	const Engine::JsonValue& attributes = primitive["attributes"];
+	if (!attributes.Has("POSITION"))
+		throw std::runtime_error("GLB primitive without positions!!!");
+
+	Accessor position = GetAccessor(attributes["POSITION"], "POSITION");
+	if (position.componentType != COMPONENT_FLOAT || position.componentCount != 3)
+		throw std::runtime_error("GLB positions have to be float3!!!");
+	if (position.count >= UINT32_MAX)
+		throw std::runtime_error("GLB primitive has too many vertices!!!");
+
+	Accessor texCoord;
+	bool bTexCoord = attributes.Has("TEXCOORD_0");
+	if (bTexCoord)
+		texCoord = GetAccessor(attributes["TEXCOORD_0"], "TEXCOORD_0");
+
+	Accessor color;
+	bool bColor = bColors && attributes.Has("COLOR_0");
+	if (bColor)
+		color = GetAccessor(attributes["COLOR_0"], "COLOR_0");
+
+	if ((bTexCoord && (texCoord.count != position.count || texCoord.componentCount != 2))
+		|| (bColor && (color.count != position.count || color.componentCount < 3 || color.componentCount > 4)))
+		throw std::runtime_error("GLB primitive attributes do not match its positions!!!");
+
+	Accessor indices;
+	bool bIndexed = primitive.Has("indices");
+	if (bIndexed)
+	{
+		indices = GetAccessor(primitive["indices"], "indices");
+		if (indices.componentCount != 1 || (indices.componentType != COMPONENT_UNSIGNED_BYTE
+			&& indices.componentType != COMPONENT_UNSIGNED_SHORT && indices.componentType != COMPONENT_UNSIGNED_INT))
+			throw std::runtime_error("GLB indices have to be unsigned integers!!!");
+
+		// The arrays go to the GPU as they are, an index past the vertices would read outside the buffer
+		for (uint64_t index = 0; index < indices.count; index++)
+		{
+			if (indices.ReadIndex(index) >= position.count)
+				throw std::runtime_error("GLB index out of range!!!");
+		}
+	}
+
+	MeshStreamSource source;
+	source.vertexCount = position.count;
+	source.indexCount = bIndexed ? indices.count : position.count;
+	source.indexCount -= source.indexCount % 3;
+	// 8 bit indices are widened, the others are kept so they can be copied as they are
+	if (bIndexed)
+		source.indexSize = indices.componentType == COMPONENT_UNSIGNED_INT ? sizeof(uint32_t) : sizeof(uint16_t);
+	else
+		source.indexSize = position.count <= 0xFFFF ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	// positions stay float, uvs float, colors only when the file has them (then as the interleaved full format)
+	source.format = bColor ? VertexFormat::Full() : VertexFormat{ PositionFormat::Float32, TexCoordFormat::Float32, ColorFormat::None };
+
+	// min and max are required on positions, files that leave them out are scanned
+	const Engine::JsonValue& json = _document["accessors"][attributes["POSITION"].GetUint(UINT64_MAX)];
+	if (json["min"].GetSize() == 3 && json["max"].GetSize() == 3)
+	{
+		for (size_t axis = 0; axis < 3; axis++)
+		{
+			source.boundsMin[static_cast<int>(axis)] = json["min"][axis].GetFloat();
+			source.boundsMax[static_cast<int>(axis)] = json["max"][axis].GetFloat();
+		}
+	}
+	else if (position.count > 0)
+	{
+		float value[3];
+		position.ReadFloats(0, value, 3);
+		source.boundsMin = source.boundsMax = glm::vec3(value[0], value[1], value[2]);
+		for (uint64_t vertex = 1; vertex < position.count; vertex++)
+		{
+			position.ReadFloats(vertex, value, 3);
+			source.boundsMin = glm::min(source.boundsMin, glm::vec3(value[0], value[1], value[2]));
+			source.boundsMax = glm::max(source.boundsMax, glm::vec3(value[0], value[1], value[2]));
+		}
+	}
+
+	source.writeVertices = [&](uint32_t stream, uint8_t* dst, uint64_t first, uint64_t count)
+	{
+		if (bColor)
+		{
+			// full format, one interleaved Vertex per element
+			for (uint64_t i = 0; i < count; i++)
+			{
+				float pos[3], rgb[3], uv[2];
+				position.ReadFloats(first + i, pos, 3);
+				color.ReadFloats(first + i, rgb, 3);
+				texCoord.ReadFloats(first + i, uv, 2);
+
+				Vertex vertex;
+				vertex.pos = glm::vec3(pos[0], pos[1], pos[2]);
+				vertex.color = glm::vec3(rgb[0], rgb[1], rgb[2]);
+				vertex.texCoord = glm::vec2(uv[0], uv[1]);
+				memcpy(dst + i * sizeof(Vertex), &vertex, sizeof(Vertex));
+			}
+			return;
+		}
+
+		const Accessor& accessor = stream == 0 ? position : texCoord;
+		uint32_t valueCount = stream == 0 ? 3 : 2;
+		uint32_t size = valueCount * sizeof(float);
+		if (accessor.data != nullptr && accessor.componentType == COMPONENT_FLOAT && accessor.stride == size)
+		{
+			// already the GPU layout, straight from the mapping into the ring
+			memcpy(dst, accessor.data + first * size, static_cast<size_t>(count * size));
+			return;
+		}
+
+		for (uint64_t i = 0; i < count; i++)
+		{
+			float values[3];
+			accessor.ReadFloats(first + i, values, valueCount);
+			memcpy(dst + i * size, values, size);
+		}
+	};
+
+	source.writeIndices = [&](uint8_t* dst, uint64_t first, uint64_t count)
+	{
+		if (bIndexed && indices.GetElementSize() == source.indexSize && indices.stride == source.indexSize)
+		{
+			memcpy(dst, indices.data + first * source.indexSize, static_cast<size_t>(count * source.indexSize));
+			return;
+		}
+
+		for (uint64_t i = 0; i < count; i++)
+		{
+			uint32_t index = bIndexed ? indices.ReadIndex(first + i) : static_cast<uint32_t>(first + i);
+			if (source.indexSize == sizeof(uint16_t))
+			{
+				uint16_t shortIndex = static_cast<uint16_t>(index);
+				memcpy(dst + i * sizeof(uint16_t), &shortIndex, sizeof(uint16_t));
+			}
+			else
+				memcpy(dst + i * sizeof(uint32_t), &index, sizeof(uint32_t));
+		}
+	};
+
+	return new Mesh(source);
+}
+
+void Resource::GlbImporter::ImportNode(uint64_t node, const glm::mat4& parentTransform, uint32_t depth, std::vector<ModelInstance>& instances)
+{
+	// a node has at most one parent, reaching it twice means a cycle or a shared child
+	if (node >= _visitedNodes.size() || _visitedNodes[node] || depth > MAX_NODE_DEPTH)
+		throw std::runtime_error("GLB node hierarchy is not a tree!!!");
+	_visitedNodes[node] = true;
+
+	const Engine::JsonValue& json = _document["nodes"][node];
+	glm::mat4 transform = parentTransform * GetLocalTransform(json);
+
+	if (json.Has("mesh"))
+	{
+		uint64_t mesh = json["mesh"].GetUint(UINT64_MAX);
+		if (mesh >= _meshPrimitives.size())
+			throw std::runtime_error("GLB node refers to a missing mesh!!!");
+		for (uint32_t primitive : _meshPrimitives[mesh])
+			instances.push_back({ primitive, transform });
+	}
+
+	const Engine::JsonValue& children = json["children"];
+	for (size_t child = 0; child < children.GetSize(); child++)
+		ImportNode(children[child].GetUint(UINT64_MAX), transform, depth + 1, instances);
+}
+
+void Resource::GlbImporter::ImportSkeleton(const Engine::JsonValue& skin, Skeleton& skeleton, std::vector<uint32_t>& jointRemap, std::vector<uint32_t>& nodeJoints)
+{
+	const Engine::JsonValue& nodes = _document["nodes"];
+	const Engine::JsonValue& joints = skin["joints"];
+	uint32_t jointCount = static_cast<uint32_t>(joints.GetSize());
+	if (jointCount == 0 || jointCount > MAX_SKIN_JOINTS)
+		throw std::runtime_error("GLB skin has no joints or more than the engine supports!!!");
+
+	// a node has at most one parent
+	std::vector<uint64_t> parents(nodes.GetSize(), UINT64_MAX);
+	for (size_t node = 0; node < nodes.GetSize(); node++)
+	{
+		const Engine::JsonValue& children = nodes[node]["children"];
+		for (size_t child = 0; child < children.GetSize(); child++)
+		{
+			uint64_t index = children[child].GetUint(UINT64_MAX);
+			if (index >= parents.size() || index == node || parents[index] != UINT64_MAX)
+				throw std::runtime_error("GLB node hierarchy is not a tree!!!");
+			parents[index] = node;
+		}
+	}
+
+	nodeJoints.assign(nodes.GetSize(), UINT32_MAX);
+	std::vector<uint32_t> depths(jointCount, 0);
+	for (uint32_t joint = 0; joint < jointCount; joint++)
+	{
+		uint64_t node = joints[joint].GetUint(UINT64_MAX);
+		if (node >= nodes.GetSize() || nodeJoints[node] != UINT32_MAX)
+			throw std::runtime_error("GLB skin joint is not a valid node!!!");
+		nodeJoints[node] = joint;
+
+		for (uint64_t ancestor = parents[node]; ancestor != UINT64_MAX; ancestor = parents[ancestor])
+		{
+			if (++depths[joint] > MAX_NODE_DEPTH)
+				throw std::runtime_error("GLB node hierarchy is not a tree!!!");
+		}
+	}
+
+	// an ancestor is always less deep, so sorting by depth puts every parent before its children
+	std::vector<uint32_t> order(jointCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&depths](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+	jointRemap.resize(jointCount);
+	for (uint32_t joint = 0; joint < jointCount; joint++)
+		jointRemap[order[joint]] = joint;
+
+	Accessor inverseBindMatrices;
+	if (skin.Has("inverseBindMatrices"))
+	{
+		inverseBindMatrices = GetAccessor(skin["inverseBindMatrices"], "inverseBindMatrices");
+		if (inverseBindMatrices.componentType != COMPONENT_FLOAT || inverseBindMatrices.componentCount != 16 || inverseBindMatrices.count < jointCount)
+			throw std::runtime_error("GLB inverse bind matrices do not match the skin joints!!!");
+	}
+
+	skeleton.parents.resize(jointCount);
+	skeleton.inverseBindMatrices.resize(jointCount);
+	skeleton.restPose.resize(jointCount);
+	skeleton.parentOffsets.resize(jointCount);
+	for (uint32_t joint = 0; joint < jointCount; joint++)
+	{
+		uint32_t skinJoint = order[joint];
+		uint64_t node = joints[skinJoint].GetUint(UINT64_MAX);
+
+		// up to the nearest joint, nodes on the way only add their static transform
+		glm::mat4 offset(1.0f);
+		int32_t parent = -1;
+		for (uint64_t ancestor = parents[node]; ancestor != UINT64_MAX; ancestor = parents[ancestor])
+		{
+			if (nodeJoints[ancestor] != UINT32_MAX)
+			{
+				parent = static_cast<int32_t>(jointRemap[nodeJoints[ancestor]]);
+				break;
+			}
+			offset = GetLocalTransform(nodes[ancestor]) * offset;
+		}
+
+		skeleton.parents[joint] = parent;
+		skeleton.parentOffsets[joint] = offset;
+		skeleton.restPose[joint] = GetLocalPose(nodes[node]);
+
+		// column major like glm, missing matrices are identity
+		skeleton.inverseBindMatrices[joint] = glm::mat4(1.0f);
+		if (inverseBindMatrices.data != nullptr)
+		{
+			float values[16];
+			inverseBindMatrices.ReadFloats(skinJoint, values, 16);
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+					skeleton.inverseBindMatrices[joint][column][row] = values[column * 4 + row];
+			}
+		}
+	}
+
+	for (uint32_t& joint : nodeJoints)
+	{
+		if (joint != UINT32_MAX)
+			joint = jointRemap[joint];
+	}
+}
+
+void Resource::GlbImporter::ImportSkinVertices(const Engine::JsonValue& primitive, const std::vector<uint32_t>& jointRemap, std::vector<SkinVertex>& skinVertices)
+{
+	const Engine::JsonValue& attributes = primitive["attributes"];
+	if (!attributes.Has("POSITION") || !attributes.Has("JOINTS_0") || !attributes.Has("WEIGHTS_0"))
+		throw std::runtime_error("GLB skinned primitive without positions, joints or weights!!!");
+
+	Accessor position = GetAccessor(attributes["POSITION"], "POSITION");
+	Accessor joints = GetAccessor(attributes["JOINTS_0"], "JOINTS_0");
+	Accessor weights = GetAccessor(attributes["WEIGHTS_0"], "WEIGHTS_0");
+	if (position.componentType != COMPONENT_FLOAT || position.componentCount != 3 || position.count == 0 || position.count >= UINT32_MAX)
+		throw std::runtime_error("GLB skinned positions have to be float3!!!");
+	if (joints.count != position.count || joints.componentCount != 4 || joints.bNormalized
+		|| (joints.componentType != COMPONENT_UNSIGNED_BYTE && joints.componentType != COMPONENT_UNSIGNED_SHORT)
+		|| weights.count != position.count || weights.componentCount != 4)
+		throw std::runtime_error("GLB skin attributes do not match its positions!!!");
+
+	skinVertices.resize(static_cast<size_t>(position.count));
+	for (uint64_t vertex = 0; vertex < position.count; vertex++)
+	{
+		float values[3], joint[4], weight[4];
+		position.ReadFloats(vertex, values, 3);
+		joints.ReadFloats(vertex, joint, 4);
+		weights.ReadFloats(vertex, weight, 4);
+
+		// influences on joints the skin does not have are dropped, the rest is renormalized
+		for (uint32_t influence = 0; influence < 4; influence++)
+		{
+			if (static_cast<uint32_t>(joint[influence]) >= jointRemap.size())
+			{
+				joint[influence] = 0.0f;
+				weight[influence] = 0.0f;
+			}
+		}
+		float sum = weight[0] + weight[1] + weight[2] + weight[3];
+
+		SkinVertex& skinVertex = skinVertices[static_cast<size_t>(vertex)];
+		memcpy(skinVertex.position, values, sizeof(skinVertex.position));
+		skinVertex.joints = 0;
+		for (uint32_t influence = 0; influence < 4; influence++)
+		{
+			skinVertex.joints |= jointRemap[static_cast<uint32_t>(joint[influence])] << (influence * 8);
+			// unweighted vertices follow their first joint
+			skinVertex.weights[influence] = sum > 0.0f ? weight[influence] / sum : (influence == 0 ? 1.0f : 0.0f);
+		}
+	}
+}
+
+void Resource::GlbImporter::ImportAnimations(const std::vector<uint32_t>& nodeJoints, std::vector<AnimationClip>& clips)
+{
+	const Engine::JsonValue& animations = _document["animations"];
+	for (size_t animation = 0; animation < animations.GetSize(); animation++)
+	{
+		const Engine::JsonValue& samplers = animations[animation]["samplers"];
+		const Engine::JsonValue& channels = animations[animation]["channels"];
+
+		AnimationClip clip;
+		clip.name = animations[animation]["name"].GetString();
+		for (size_t channel = 0; channel < channels.GetSize(); channel++)
+		{
+			// channels of nodes outside the skin and morph target weights do not move the skeleton
+			const Engine::JsonValue& target = channels[channel]["target"];
+			uint64_t node = target["node"].GetUint(UINT64_MAX);
+			if (node >= nodeJoints.size() || nodeJoints[node] == UINT32_MAX)
+				continue;
+
+			AnimationChannel imported;
+			imported.joint = nodeJoints[node];
+			const std::string& path = target["path"].GetString();
+			if (path == "translation")
+				imported.path = AnimationPath::Translation;
+			else if (path == "rotation")
+				imported.path = AnimationPath::Rotation;
+			else if (path == "scale")
+				imported.path = AnimationPath::Scale;
+			else
+				continue;
+			uint32_t valueCount = imported.path == AnimationPath::Rotation ? 4 : 3;
+
+			const Engine::JsonValue& sampler = samplers[channels[channel]["sampler"].GetUint(UINT64_MAX)];
+			if (!sampler.IsObject())
+				throw std::runtime_error("GLB animation channel refers to a missing sampler!!!");
+
+			// cubic spline keys are stored as in tangent, value, out tangent, only the value is kept
+			const std::string& interpolation = sampler["interpolation"].GetString();
+			bool bCubicSpline = interpolation == "CUBICSPLINE";
+			imported.interpolation = interpolation == "STEP" ? AnimationInterpolation::Step : AnimationInterpolation::Linear;
+			uint64_t valuesPerKey = bCubicSpline ? 3 : 1;
+
+			Accessor input = GetAccessor(sampler["input"], "animation input");
+			Accessor output = GetAccessor(sampler["output"], "animation output");
+			if (input.componentType != COMPONENT_FLOAT || input.componentCount != 1 || input.count == 0
+				|| output.componentCount != valueCount || output.count != input.count * valuesPerKey)
+				throw std::runtime_error("GLB animation sampler does not match its channel!!!");
+
+			imported.times.resize(static_cast<size_t>(input.count));
+			imported.values.resize(static_cast<size_t>(input.count));
+			for (uint64_t key = 0; key < input.count; key++)
+			{
+				input.ReadFloats(key, &imported.times[static_cast<size_t>(key)], 1);
+				if (key > 0 && imported.times[static_cast<size_t>(key)] < imported.times[static_cast<size_t>(key - 1)])
+					throw std::runtime_error("GLB animation keys are not sorted by time!!!");
+
+				float value[4];
+				output.ReadFloats(key * valuesPerKey + (bCubicSpline ? 1 : 0), value, 4);
+				imported.values[static_cast<size_t>(key)] = glm::vec4(value[0], value[1], value[2], value[3]);
+			}
+
+			clip.duration = std::max(clip.duration, imported.times.back());
+			clip.channels.push_back(std::move(imported));
+		}
+
+		if (!clip.channels.empty())
+			clips.push_back(std::move(clip));
+	}
+}
+
+glm::mat4 Resource::GlbImporter::GetLocalTransform(const Engine::JsonValue& node)
+{
+	// column major, the same order glm stores its matrices in
+	const Engine::JsonValue& matrix = node["matrix"];
+	if (matrix.GetSize() == 16)
+	{
+		glm::mat4 transform;
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+				transform[column][row] = matrix[static_cast<size_t>(column * 4 + row)].GetFloat();
+		}
+		return transform;
+	}
+
+	// T * R * S, the rotation is a unit quaternion stored as x, y, z, w
+	const Engine::JsonValue& translation = node["translation"];
+	const Engine::JsonValue& rotation = node["rotation"];
+	const Engine::JsonValue& scale = node["scale"];
+
+	glm::mat4 transform(1.0f);
+	if (translation.GetSize() == 3)
+		transform = glm::translate(transform, glm::vec3(translation[size_t(0)].GetFloat(), translation[1].GetFloat(), translation[2].GetFloat()));
+	if (rotation.GetSize() == 4)
+		transform *= glm::mat4_cast(glm::quat(rotation[3].GetFloat(1.0f), rotation[size_t(0)].GetFloat(), rotation[1].GetFloat(), rotation[2].GetFloat()));
+	if (scale.GetSize() == 3)
+		transform = glm::scale(transform, glm::vec3(scale[size_t(0)].GetFloat(1.0f), scale[1].GetFloat(1.0f), scale[2].GetFloat(1.0f)));
+	return transform;
+}
+
+Resource::JointPose Resource::GlbImporter::GetLocalPose(const Engine::JsonValue& node)
+{
+	JointPose pose;
+	if (node["matrix"].GetSize() == 16)
+	{
+		// animated joints are expected to use TRS, a matrix is only split up for the rest pose
+		glm::vec3 skew;
+		glm::vec4 perspective;
+		glm::decompose(GetLocalTransform(node), pose.scale, pose.rotation, pose.translation, skew, perspective);
+		return pose;
+	}
+
+	const Engine::JsonValue& translation = node["translation"];
+	const Engine::JsonValue& rotation = node["rotation"];
+	const Engine::JsonValue& scale = node["scale"];
+	if (translation.GetSize() == 3)
+		pose.translation = glm::vec3(translation[size_t(0)].GetFloat(), translation[1].GetFloat(), translation[2].GetFloat());
+	if (rotation.GetSize() == 4)
+		pose.rotation = glm::quat(rotation[3].GetFloat(1.0f), rotation[size_t(0)].GetFloat(), rotation[1].GetFloat(), rotation[2].GetFloat());
+	if (scale.GetSize() == 3)
+		pose.scale = glm::vec3(scale[size_t(0)].GetFloat(1.0f), scale[1].GetFloat(1.0f), scale[2].GetFloat(1.0f));
+	return pose;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Model.h"
+#include "SkinnedMesh.h"
+#include "Json.h"
+#include "MappedFile.h"
+
+namespace Resource
+{
+	class Mesh;
+
+	// Binary glTF 2.0 (.glb) importer.
+	// The file is mapped and only the JSON chunk is parsed, the vertex and index arrays of the binary chunk are copied
+	// from the mapping straight into the staging ring. Arrays already in the GPU layout (tightly packed float positions
+	// and uvs, 16 or 32 bit indices) are a plain memcpy per chunk, everything else is converted on the way into the ring,
+	// so no copy of the geometry is ever made on the CPU.
+	// Supports triangle primitives with POSITION, TEXCOORD_0, COLOR_0 and indices, several meshes
+	// and the node hierarchy with matrix or TRS transforms. ImportSkin additionally reads one skin with JOINTS_0 and WEIGHTS_0
+	// and the translation, rotation and scale animations of its joints. Materials, morph targets, sparse accessors
+	// and external buffers are not supported.
+	class GlbImporter
+	{
+	public:
+		GlbImporter();
+		~GlbImporter();
+
+		// Appends one mesh per triangle primitive and one instance per node and primitive.
+		// Throws when the file is not a valid GLB or uses an unsupported feature.
+		// The copies are only recorded, the caller flushes Application::s_stagingRing before the meshes are drawn.
+		void Import(const char* file, std::vector<Mesh*>& meshes, std::vector<ModelInstance>& instances);
+		// Imports the first triangle primitive of the first node with a skin, its skeleton and every animation moving the joints.
+		// Vertex colors are dropped so positions stay alone in stream 0. Cubic spline keys are played back linearly.
+		// The copies are only recorded, the caller flushes Application::s_stagingRing before the mesh is drawn.
+		void ImportSkin(const char* file, Mesh*& mesh, std::vector<SkinVertex>& skinVertices, Skeleton& skeleton, std::vector<AnimationClip>& clips);
+
+	private:
+		// Typed view of an accessor inside the binary chunk
+		struct Accessor
+		{
+			// nullptr for accessors without buffer view, their elements are all zero
+			const uint8_t* data = nullptr;
+			uint64_t count = 0;
+			uint32_t stride = 0;
+			uint32_t componentType = 0;
+			uint32_t componentCount = 0;
+			bool bNormalized = false;
+
+			uint32_t GetElementSize() const;
+			// Components converted to float, normalized integers mapped to [0, 1] or [-1, 1]
+			void ReadFloats(uint64_t element, float* values, uint32_t valueCount) const;
+			uint32_t ReadIndex(uint64_t element) const;
+		};
+
+		void ReadChunks(const char* file);
+		Accessor GetAccessor(const Engine::JsonValue& index, const char* name) const;
+		// nullptr for primitives that are not triangle lists
+		Mesh* ImportPrimitive(const Engine::JsonValue& primitive, bool bColors = true);
+		void ImportNode(uint64_t node, const glm::mat4& parentTransform, uint32_t depth, std::vector<ModelInstance>& instances);
+		// Orders the joints parents first. jointRemap maps skin joints to skeleton joints, nodeJoints nodes to skeleton joints
+		// (UINT32_MAX for nodes that are no joint).
+		void ImportSkeleton(const Engine::JsonValue& skin, Skeleton& skeleton, std::vector<uint32_t>& jointRemap, std::vector<uint32_t>& nodeJoints);
+		void ImportSkinVertices(const Engine::JsonValue& primitive, const std::vector<uint32_t>& jointRemap, std::vector<SkinVertex>& skinVertices);
+		void ImportAnimations(const std::vector<uint32_t>& nodeJoints, std::vector<AnimationClip>& clips);
+		static glm::mat4 GetLocalTransform(const Engine::JsonValue& node);
+		static JointPose GetLocalPose(const Engine::JsonValue& node);
+
+	private:
+		Engine::MappedFile _file;
+		Engine::JsonValue _document;
+		const uint8_t* _binary = nullptr;
+		uint64_t _binarySize = 0;
+
+		// indices into the output meshes of the primitives of every glTF mesh
+		std::vector<std::vector<uint32_t>> _meshPrimitives;
+		std::vector<bool> _visitedNodes;
+	};
+}
@@ -2,7 +2,9 @@
 #include "GraphicsPipeline.h"
 
 #include "Application.h"
-#include "Vertex.h"
+
+// Vertex format keys use the low 24 bits only
+static const uint32_t POSITION_ONLY_INPUT_KEY = 1u << 31;
 
 Engine::GraphicsPipeline::GraphicsPipeline()
 {
@@ -10,32 +12,135 @@ Engine::GraphicsPipeline::GraphicsPipeline()
 
 Engine::GraphicsPipeline::~GraphicsPipeline()
 {
-	vkDestroyPipeline(Application::s_logicalDevice, _graphicsPipeline, nullptr);
+	// background links still reference the libraries
+	for (PendingLink& link : _pendingLinks)
+	{
+		VkPipeline optimized = link.optimizedPipeline.get();
+		vkDestroyPipeline(Application::s_logicalDevice, optimized, nullptr);
+	}
+	for (RetiredPipeline& retired : _retiredPipelines)
+		vkDestroyPipeline(Application::s_logicalDevice, retired.pipeline, nullptr);
+
+	for (auto& variant : _variants)
+		vkDestroyPipeline(Application::s_logicalDevice, variant.second, nullptr);
+
+	for (auto& library : _vertexInputLibraries)
+		vkDestroyPipeline(Application::s_logicalDevice, library.second, nullptr);
+	vkDestroyPipeline(Application::s_logicalDevice, _fragmentOutputLibrary, nullptr);
+	for (auto& library : _preRasterizationLibraries)
+		vkDestroyPipeline(Application::s_logicalDevice, library.second, nullptr);
+	for (auto& library : _fragmentShaderLibraries)
+		vkDestroyPipeline(Application::s_logicalDevice, library.second, nullptr);
+
 	vkDestroyPipelineLayout(Application::s_logicalDevice, _pipelineLayout, nullptr);
 }
 
-void Engine::GraphicsPipeline::CreateGraphicsPipeline(VkPipelineShaderStageCreateInfo* shaderStages, VkDescriptorSetLayout descriptorSetLayout, VkRenderPass renderPass)
+void Engine::GraphicsPipeline::CreateGraphicsPipeline(ShaderProgram* shaderProgram, const std::vector<VkDescriptorSetLayout>& setLayouts,
+	const std::vector<VkPushConstantRange>& pushConstantRanges, VkRenderPass renderPass,
+	VkPipelineCache pipelineCache, ShaderFeatureFlags defaultFeatures, const VertexFormat& defaultVertexFormat)
 {
+	_shaderProgram = shaderProgram;
+	_renderPass = renderPass;
+	_pipelineCache = pipelineCache;
+	_defaultFeatures = defaultFeatures;
+	_defaultVertexFormat = defaultVertexFormat;
+	_bUseLibraries = Application::s_optionalFeatures.graphicsPipelineLibrary;
+
+#pragma region PIPELINE LAYOUT
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+	pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges.data();
+	if (vkCreatePipelineLayout(Application::s_logicalDevice, &pipelineLayoutCreateInfo, nullptr, &_pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create pipeline layout object!!!");
+#pragma endregion
 
-#pragma region VERTEX INPUT
-	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
+	BuildFixedFunctionState();
 
-	auto bindingDescription = Vertex::GetBindingDescription();
-	auto attributeDescription = Vertex::GetAttributeDescriptions();
+	if (_bUseLibraries)
+	{
+		// The shader independent output part is shared by every variant, vertex input libraries by every variant of a vertex format
+		_fragmentOutputLibrary = CreateFragmentOutputLibrary();
+	}
 
-	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	// Since we are hardcoding vertex inputs in the shader itself, we do not need to bind vertex input data. This structure will be used when creating VERTEX BUFFERS
-	vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputStateCreateInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
-	vertexInputStateCreateInfo.pVertexAttributeDescriptions = attributeDescription.data();
-#pragma endregion
+	// The default variant is created up front, everything else on first use
+	GetGraphicsPipeline(defaultFeatures, defaultVertexFormat);
+}
+
+VkPipeline Engine::GraphicsPipeline::GetGraphicsPipeline(ShaderFeatureFlags features, const VertexFormat& vertexFormat)
+{
+	// Only the vertex shader runs and it only reads positions, no other bit changes the pipeline
+	if (features & SHADER_FEATURE_DEPTH_ONLY)
+	{
+		uint64_t key = (static_cast<uint64_t>(vertexFormat.GetKey()) << 32) | SHADER_FEATURE_DEPTH_ONLY;
+		auto it = _variants.find(key);
+		if (it != _variants.end())
+			return it->second;
+
+		VkPipeline pipeline = CreateDepthOnlyVariant(vertexFormat);
+		_variants[key] = pipeline;
+		return pipeline;
+	}
+
+	// A layout without colors only aliases the color input, the vertex color path must stay off
+	if (!vertexFormat.HasColor())
+		features &= ~SHADER_FEATURE_VERTEX_COLOR;
+
+	// Masks that only differ in bits the shaders do not declare resolve to the same pipeline
+	features = _shaderProgram->PruneFeatures(features);
+
+	uint64_t key = (static_cast<uint64_t>(vertexFormat.GetKey()) << 32) | features;
+	auto it = _variants.find(key);
+	if (it != _variants.end())
+		return it->second;
+
+	VkPipeline pipeline = _bUseLibraries ? LinkVariant(key, features, vertexFormat) : CreateVariant(features, vertexFormat);
+	_variants[key] = pipeline;
+	return pipeline;
+}
+
+void Engine::GraphicsPipeline::Update()
+{
+	// Swap in optimized pipelines whose background link has finished
+	for (auto it = _pendingLinks.begin(); it != _pendingLinks.end();)
+	{
+		if (it->optimizedPipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			++it;
+			continue;
+		}
+
+		VkPipeline optimized = it->optimizedPipeline.get();
+		if (optimized != VK_NULL_HANDLE)
+		{
+			VkPipeline& current = _variants[it->key];
+			// command buffers still in flight may reference the fast linked pipeline
+			_retiredPipelines.push_back({ current, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) });
+			current = optimized;
+		}
+		it = _pendingLinks.erase(it);
+	}
 
+	for (auto it = _retiredPipelines.begin(); it != _retiredPipelines.end();)
+	{
+		if (it->framesLeft-- == 0)
+		{
+			vkDestroyPipeline(Application::s_logicalDevice, it->pipeline, nullptr);
+			it = _retiredPipelines.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+void Engine::GraphicsPipeline::BuildFixedFunctionState()
+{
 #pragma region INPUT ASSEMBLY
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
-	inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; // OR use VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
-	inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
+	_state.inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	_state.inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; // OR use VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
+	_state.inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
 #pragma endregion
 
 #pragma region VIEWPORT AND SCISSORS (WILL BE SETUP LATER) | UPDATE: SETUP IN RecordCommandBuffer FUNCTION
@@ -56,124 +161,314 @@ void Engine::GraphicsPipeline::CreateGraphicsPipeline(VkPipelineShaderStageCreat
 
 #pragma region DYNAMIC STATE
 	// Set viewport and scissor as dynamic state in the graphics pipeline
-	std::vector<VkDynamicState> dynamicStates = {
+	_state.dynamicStates = {
 		VK_DYNAMIC_STATE_VIEWPORT,
 		VK_DYNAMIC_STATE_SCISSOR
 	};
-	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+	_state.dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	_state.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(_state.dynamicStates.size());
+	_state.dynamicStateCreateInfo.pDynamicStates = _state.dynamicStates.data();
 #pragma endregion
 
 #pragma region VIEWPORT STATE (WITH DYNAMC STATE - FOR VIEWPORT AND SCISSORS)
 	// Without Dynamic State, you must setup viewport and scissor like this
 	//
-	VkPipelineViewportStateCreateInfo viewportStateCreateInfo{};
-	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.scissorCount = 1;
+	_state.viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	_state.viewportStateCreateInfo.viewportCount = 1;
+	_state.viewportStateCreateInfo.scissorCount = 1;
 #pragma endregion
 
 #pragma region RASTERIZATION STATE
-	VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
-	rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
-	rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-	rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizationStateCreateInfo.lineWidth = 1.0f;
-	rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;
+	_state.rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	_state.rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
+	_state.rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+	_state.rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	_state.rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+	_state.rasterizationStateCreateInfo.lineWidth = 1.0f;
+	_state.rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	_state.rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;
 	// Optional values
-	rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
-	rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
-	rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
+	_state.rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
+	_state.rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
+	_state.rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
 #pragma endregion
 
 #pragma region MULTISAMPLING STATE
-	VkPipelineMultisampleStateCreateInfo multisamplingStateCreateInfo{};
-	multisamplingStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisamplingStateCreateInfo.sampleShadingEnable = VK_FALSE;
-	multisamplingStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisamplingStateCreateInfo.minSampleShading = 1.0f;
-	multisamplingStateCreateInfo.pSampleMask = nullptr;
-	multisamplingStateCreateInfo.alphaToCoverageEnable = VK_FALSE;
-	multisamplingStateCreateInfo.alphaToOneEnable = VK_FALSE;
+	_state.multisamplingStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	_state.multisamplingStateCreateInfo.sampleShadingEnable = VK_FALSE;
+	_state.multisamplingStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	_state.multisamplingStateCreateInfo.minSampleShading = 1.0f;
+	_state.multisamplingStateCreateInfo.pSampleMask = nullptr;
+	_state.multisamplingStateCreateInfo.alphaToCoverageEnable = VK_FALSE;
+	_state.multisamplingStateCreateInfo.alphaToOneEnable = VK_FALSE;
 #pragma endregion
 
 #pragma region COLOR BLEND STATE
-	VkPipelineColorBlendAttachmentState colorBlendAttachmentState{};
 	// enable RGBA color mask
-	colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_A_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_R_BIT;
+	_state.colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_A_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_R_BIT;
 	// not color blending for this project
-	colorBlendAttachmentState.blendEnable = VK_FALSE;
-	colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-	colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-
-	VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
-	colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
-	colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-	colorBlendStateCreateInfo.attachmentCount = 1;
-	colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
-	colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
-	colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
-	colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
-	colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
-#pragma endregion
+	_state.colorBlendAttachmentState.blendEnable = VK_FALSE;
+	_state.colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	_state.colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_state.colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+	_state.colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	_state.colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_state.colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
 
-#pragma region PIPELINE LAYOUT
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
-	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.setLayoutCount = 1;
-	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-	if (vkCreatePipelineLayout(Application::s_logicalDevice, &pipelineLayoutCreateInfo, nullptr, &_pipelineLayout) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create pipeline layout object!!!");
+	_state.colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	_state.colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
+	_state.colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY;
+	_state.colorBlendStateCreateInfo.attachmentCount = 1;
+	_state.colorBlendStateCreateInfo.pAttachments = &_state.colorBlendAttachmentState;
+	_state.colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
+	_state.colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
+	_state.colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
+	_state.colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
+
+	_state.depthOnlyColorBlendAttachmentState = _state.colorBlendAttachmentState;
+	_state.depthOnlyColorBlendAttachmentState.colorWriteMask = 0;
+	_state.depthOnlyColorBlendStateCreateInfo = _state.colorBlendStateCreateInfo;
+	_state.depthOnlyColorBlendStateCreateInfo.pAttachments = &_state.depthOnlyColorBlendAttachmentState;
 #pragma endregion
 
 #pragma region DEPTH STENCIL STATE
 
-	VkPipelineDepthStencilStateCreateInfo depthStencilState{};
-	depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencilState.depthTestEnable = VK_TRUE;
-	depthStencilState.depthWriteEnable = VK_TRUE;
-	depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencilState.depthBoundsTestEnable = VK_FALSE;
-	depthStencilState.minDepthBounds = 0.0f;
-	depthStencilState.maxDepthBounds = 1.0f;
+	_state.depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	_state.depthStencilState.depthTestEnable = VK_TRUE;
+	_state.depthStencilState.depthWriteEnable = VK_TRUE;
+	// equal passes so the shading pass can run on top of the depth prepass
+	_state.depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	_state.depthStencilState.depthBoundsTestEnable = VK_FALSE;
+	_state.depthStencilState.minDepthBounds = 0.0f;
+	_state.depthStencilState.maxDepthBounds = 1.0f;
 	// disable stencil for now
-	depthStencilState.stencilTestEnable = VK_FALSE;
-	depthStencilState.front = {};
-	depthStencilState.back = {};
+	_state.depthStencilState.stencilTestEnable = VK_FALSE;
+	_state.depthStencilState.front = {};
+	_state.depthStencilState.back = {};
 
 #pragma endregion
+}
+
+const VkPipelineVertexInputStateCreateInfo* Engine::GraphicsPipeline::GetVertexInputState(const VertexFormat& vertexFormat, bool bPositionOnly)
+{
+	uint32_t key = vertexFormat.GetKey() | (bPositionOnly ? POSITION_ONLY_INPUT_KEY : 0);
+	auto it = _vertexInputStates.find(key);
+	if (it != _vertexInputStates.end())
+		return &it->second->createInfo;
+
+	std::unique_ptr<VertexInputState> state = std::make_unique<VertexInputState>();
+	state->bindingDescriptions = vertexFormat.GetBindingDescriptions(bPositionOnly);
+	state->attributeDescriptions = vertexFormat.GetAttributeDescriptions(bPositionOnly);
+
+	state->createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	state->createInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(state->bindingDescriptions.size());
+	state->createInfo.pVertexBindingDescriptions = state->bindingDescriptions.data();
+	state->createInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(state->attributeDescriptions.size());
+	state->createInfo.pVertexAttributeDescriptions = state->attributeDescriptions.data();
+
+	const VkPipelineVertexInputStateCreateInfo* createInfo = &state->createInfo;
+	_vertexInputStates[key] = std::move(state);
+	return createInfo;
+}
+
+VkPipeline Engine::GraphicsPipeline::CreateVariant(ShaderFeatureFlags features, const VertexFormat& vertexFormat)
+{
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = _shaderProgram->GetStages(features);
 
 	VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
 	graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	graphicsPipelineCreateInfo.stageCount = 2;
-	graphicsPipelineCreateInfo.pStages = shaderStages;
-	graphicsPipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-	graphicsPipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-	graphicsPipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	graphicsPipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-	graphicsPipelineCreateInfo.pMultisampleState = &multisamplingStateCreateInfo;
-	graphicsPipelineCreateInfo.pDepthStencilState = &depthStencilState;
-	graphicsPipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-	graphicsPipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+	graphicsPipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	graphicsPipelineCreateInfo.pStages = shaderStages.data();
+	graphicsPipelineCreateInfo.pVertexInputState = GetVertexInputState(vertexFormat);
+	graphicsPipelineCreateInfo.pInputAssemblyState = &_state.inputAssemblyStateCreateInfo;
+	graphicsPipelineCreateInfo.pViewportState = &_state.viewportStateCreateInfo;
+	graphicsPipelineCreateInfo.pRasterizationState = &_state.rasterizationStateCreateInfo;
+	graphicsPipelineCreateInfo.pMultisampleState = &_state.multisamplingStateCreateInfo;
+	graphicsPipelineCreateInfo.pDepthStencilState = &_state.depthStencilState;
+	graphicsPipelineCreateInfo.pColorBlendState = &_state.colorBlendStateCreateInfo;
+	graphicsPipelineCreateInfo.pDynamicState = &_state.dynamicStateCreateInfo;
 	graphicsPipelineCreateInfo.layout = _pipelineLayout;
-	graphicsPipelineCreateInfo.renderPass = renderPass;
+	graphicsPipelineCreateInfo.renderPass = _renderPass;
 	graphicsPipelineCreateInfo.subpass = 0;
 	// NOT deriving from any pre existing pipeline
 	graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	graphicsPipelineCreateInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(Application::s_logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &_graphicsPipeline) != VK_SUCCESS)
+	// The pipeline cache lets identical variants (and variants from previous runs) skip the backend compile
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(Application::s_logicalDevice, _pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create the Graphics Pipeline!!!");
+
+	return pipeline;
+}
+
+VkPipeline Engine::GraphicsPipeline::CreateDepthOnlyVariant(const VertexFormat& vertexFormat)
+{
+	// One per vertex format and the stage set differs from every other variant,
+	// so it is always created as a whole instead of being linked from libraries
+	const VkPipelineShaderStageCreateInfo& vertexStage = _shaderProgram->GetVertexShader()->GetVariant(SHADER_FEATURE_DEPTH_ONLY)->stageCreateInfo;
+
+	VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+	graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphicsPipelineCreateInfo.stageCount = 1;
+	graphicsPipelineCreateInfo.pStages = &vertexStage;
+	graphicsPipelineCreateInfo.pVertexInputState = GetVertexInputState(vertexFormat, true);
+	graphicsPipelineCreateInfo.pInputAssemblyState = &_state.inputAssemblyStateCreateInfo;
+	graphicsPipelineCreateInfo.pViewportState = &_state.viewportStateCreateInfo;
+	graphicsPipelineCreateInfo.pRasterizationState = &_state.rasterizationStateCreateInfo;
+	graphicsPipelineCreateInfo.pMultisampleState = &_state.multisamplingStateCreateInfo;
+	graphicsPipelineCreateInfo.pDepthStencilState = &_state.depthStencilState;
+	graphicsPipelineCreateInfo.pColorBlendState = &_state.depthOnlyColorBlendStateCreateInfo;
+	graphicsPipelineCreateInfo.pDynamicState = &_state.dynamicStateCreateInfo;
+	graphicsPipelineCreateInfo.layout = _pipelineLayout;
+	graphicsPipelineCreateInfo.renderPass = _renderPass;
+	graphicsPipelineCreateInfo.subpass = 0;
+	graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	graphicsPipelineCreateInfo.basePipelineIndex = -1;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(Application::s_logicalDevice, _pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create the depth only Graphics Pipeline!!!");
+
+	return pipeline;
+}
+
+#pragma region GRAPHICS PIPELINE LIBRARY
+
+VkPipeline Engine::GraphicsPipeline::CreateLibrary(VkGraphicsPipelineCreateInfo& createInfo, VkGraphicsPipelineLibraryFlagsEXT libraryFlags)
+{
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo{};
+	libraryCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+	libraryCreateInfo.flags = libraryFlags;
+
+	createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	createInfo.pNext = &libraryCreateInfo;
+	// keep the link time optimization info around so the background link can produce a fully optimized pipeline
+	createInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+	createInfo.basePipelineHandle = VK_NULL_HANDLE;
+	createInfo.basePipelineIndex = -1;
+
+	VkPipeline library;
+	if (vkCreateGraphicsPipelines(Application::s_logicalDevice, _pipelineCache, 1, &createInfo, nullptr, &library) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create a Graphics Pipeline Library!!!");
+
+	return library;
+}
+
+VkPipeline Engine::GraphicsPipeline::CreateVertexInputLibrary(const VertexFormat& vertexFormat)
+{
+	auto it = _vertexInputLibraries.find(vertexFormat.GetKey());
+	if (it != _vertexInputLibraries.end())
+		return it->second;
+
+	VkGraphicsPipelineCreateInfo createInfo{};
+	createInfo.pVertexInputState = GetVertexInputState(vertexFormat);
+	createInfo.pInputAssemblyState = &_state.inputAssemblyStateCreateInfo;
+
+	VkPipeline library = CreateLibrary(createInfo, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT);
+	_vertexInputLibraries[vertexFormat.GetKey()] = library;
+	return library;
+}
+
+VkPipeline Engine::GraphicsPipeline::CreatePreRasterizationLibrary(ShaderFeatureFlags vertexFeatures)
+{
+	auto it = _preRasterizationLibraries.find(vertexFeatures);
+	if (it != _preRasterizationLibraries.end())
+		return it->second;
+
+	VkGraphicsPipelineCreateInfo createInfo{};
+	createInfo.stageCount = 1;
+	createInfo.pStages = &_shaderProgram->GetVertexShader()->GetVariant(vertexFeatures)->stageCreateInfo;
+	createInfo.pViewportState = &_state.viewportStateCreateInfo;
+	createInfo.pRasterizationState = &_state.rasterizationStateCreateInfo;
+	// viewport and scissor are pre rasterization state
+	createInfo.pDynamicState = &_state.dynamicStateCreateInfo;
+	createInfo.layout = _pipelineLayout;
+	createInfo.renderPass = _renderPass;
+	createInfo.subpass = 0;
+
+	VkPipeline library = CreateLibrary(createInfo, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+	_preRasterizationLibraries[vertexFeatures] = library;
+	return library;
+}
+
+VkPipeline Engine::GraphicsPipeline::CreateFragmentShaderLibrary(ShaderFeatureFlags fragmentFeatures)
+{
+	auto it = _fragmentShaderLibraries.find(fragmentFeatures);
+	if (it != _fragmentShaderLibraries.end())
+		return it->second;
+
+	VkGraphicsPipelineCreateInfo createInfo{};
+	createInfo.stageCount = 1;
+	createInfo.pStages = &_shaderProgram->GetFragmentShader()->GetVariant(fragmentFeatures)->stageCreateInfo;
+	createInfo.pMultisampleState = &_state.multisamplingStateCreateInfo;
+	createInfo.pDepthStencilState = &_state.depthStencilState;
+	createInfo.layout = _pipelineLayout;
+	createInfo.renderPass = _renderPass;
+	createInfo.subpass = 0;
+
+	VkPipeline library = CreateLibrary(createInfo, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+	_fragmentShaderLibraries[fragmentFeatures] = library;
+	return library;
+}
+
+VkPipeline Engine::GraphicsPipeline::CreateFragmentOutputLibrary()
+{
+	VkGraphicsPipelineCreateInfo createInfo{};
+	createInfo.pMultisampleState = &_state.multisamplingStateCreateInfo;
+	createInfo.pColorBlendState = &_state.colorBlendStateCreateInfo;
+	createInfo.renderPass = _renderPass;
+	createInfo.subpass = 0;
+	return CreateLibrary(createInfo, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+}
+
+VkPipeline Engine::GraphicsPipeline::LinkLibraries(const std::array<VkPipeline, 4>& libraries, VkPipelineCreateFlags flags)
+{
+	VkPipelineLibraryCreateInfoKHR libraryInfo{};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+	libraryInfo.pLibraries = libraries.data();
+
+	VkGraphicsPipelineCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	createInfo.pNext = &libraryInfo;
+	createInfo.flags = flags;
+	createInfo.layout = _pipelineLayout;
+	createInfo.basePipelineHandle = VK_NULL_HANDLE;
+	createInfo.basePipelineIndex = -1;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateGraphicsPipelines(Application::s_logicalDevice, _pipelineCache, 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	return pipeline;
+}
+
+VkPipeline Engine::GraphicsPipeline::LinkVariant(uint64_t key, ShaderFeatureFlags features, const VertexFormat& vertexFormat)
+{
+	// Each stage library only depends on the bits its own shader declares, so libraries are shared across variants
+	std::array<VkPipeline, 4> libraries = {
+		CreateVertexInputLibrary(vertexFormat),
+		CreatePreRasterizationLibrary(_shaderProgram->GetVertexShader()->PruneFeatures(features)),
+		CreateFragmentShaderLibrary(_shaderProgram->GetFragmentShader()->PruneFeatures(features)),
+		_fragmentOutputLibrary,
+	};
+
+	// Fast link: no flags, the driver only stitches the precompiled parts together
+	VkPipeline pipeline = LinkLibraries(libraries, 0);
+	if (pipeline == VK_NULL_HANDLE)
+		throw std::runtime_error("Failed to link the Graphics Pipeline Libraries!!!");
+
+	// The optimized link runs in the background and replaces the fast linked pipeline in Update()
+	PendingLink link;
+	link.key = key;
+	link.optimizedPipeline = std::async(std::launch::async, [this, libraries]()
+	{
+		return LinkLibraries(libraries, VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT);
+	});
+	_pendingLinks.push_back(std::move(link));
+
+	return pipeline;
 }
+
+#pragma endregion
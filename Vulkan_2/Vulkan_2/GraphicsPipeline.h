@@ -1,4 +1,10 @@
 #pragma once
+#include <unordered_map>
+#include <future>
+#include <list>
+
+#include "ShaderPermutation.h"
+#include "Vertex.h"
 
 namespace Engine
 {
@@ -13,17 +19,107 @@ namespace Engine
 	public:
 		GraphicsPipeline();
 		~GraphicsPipeline();
-		void CreateGraphicsPipeline(VkPipelineShaderStageCreateInfo* shaderStages, VkDescriptorSetLayout descriptorSetLayout, VkRenderPass renderPass);
+		void CreateGraphicsPipeline(ShaderProgram* shaderProgram, const std::vector<VkDescriptorSetLayout>& setLayouts,
+			const std::vector<VkPushConstantRange>& pushConstantRanges, VkRenderPass renderPass,
+			VkPipelineCache pipelineCache, ShaderFeatureFlags defaultFeatures, const VertexFormat& defaultVertexFormat);
+
+		// Returns the pipeline permutation for the given shader features and vertex layout, creating it on first use.
+		// With VK_EXT_graphics_pipeline_library the variant is fast linked from precompiled parts.
+		// SHADER_FEATURE_DEPTH_ONLY selects the depth only pipeline of the layout, it only reads vertex stream 0.
+		VkPipeline GetGraphicsPipeline(ShaderFeatureFlags features, const VertexFormat& vertexFormat);
+
+		// Call once per frame after the frame's fence has been waited on.
+		// Swaps in finished background links and destroys pipelines no frame in flight can reference anymore.
+		void Update();
+
+	private:
+		void BuildFixedFunctionState();
+		const VkPipelineVertexInputStateCreateInfo* GetVertexInputState(const VertexFormat& vertexFormat, bool bPositionOnly = false);
+		VkPipeline CreateVariant(ShaderFeatureFlags features, const VertexFormat& vertexFormat);
+		VkPipeline CreateDepthOnlyVariant(const VertexFormat& vertexFormat);
+
+#pragma region GRAPHICS PIPELINE LIBRARY
+
+		VkPipeline CreateLibrary(VkGraphicsPipelineCreateInfo& createInfo, VkGraphicsPipelineLibraryFlagsEXT libraryFlags);
+		VkPipeline CreateVertexInputLibrary(const VertexFormat& vertexFormat);
+		VkPipeline CreatePreRasterizationLibrary(ShaderFeatureFlags vertexFeatures);
+		VkPipeline CreateFragmentShaderLibrary(ShaderFeatureFlags fragmentFeatures);
+		VkPipeline CreateFragmentOutputLibrary();
+		VkPipeline LinkLibraries(const std::array<VkPipeline, 4>& libraries, VkPipelineCreateFlags flags);
+		VkPipeline LinkVariant(uint64_t key, ShaderFeatureFlags features, const VertexFormat& vertexFormat);
+
+#pragma endregion
 
+	public:
 #pragma region Getters
 
 		VkPipelineLayout& GetPipelineLayout() { return _pipelineLayout; }
-		VkPipeline& GetGraphicsPipeline() { return _graphicsPipeline; }
+		VkPipeline GetGraphicsPipeline() { return GetGraphicsPipeline(_defaultFeatures, _defaultVertexFormat); }
+		size_t GetVariantCount() const { return _variants.size(); }
+		bool IsUsingPipelineLibraries() const { return _bUseLibraries; }
 
 #pragma endregion
 
 	private:
+		// Fixed function state shared by monolithic pipelines and library parts.
+		// Create infos point into this struct, so it lives as long as the pipeline object.
+		struct FixedFunctionState
+		{
+			std::vector<VkDynamicState> dynamicStates;
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
+			VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
+			VkPipelineViewportStateCreateInfo viewportStateCreateInfo{};
+			VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
+			VkPipelineMultisampleStateCreateInfo multisamplingStateCreateInfo{};
+			VkPipelineColorBlendAttachmentState colorBlendAttachmentState{};
+			VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
+			VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+			// depth only pipelines have no fragment shader, color writes are masked off
+			VkPipelineColorBlendAttachmentState depthOnlyColorBlendAttachmentState{};
+			VkPipelineColorBlendStateCreateInfo depthOnlyColorBlendStateCreateInfo{};
+		};
+
+		// Vertex input of one vertex format, the create info points into the descriptions
+		struct VertexInputState
+		{
+			std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+			VkPipelineVertexInputStateCreateInfo createInfo{};
+		};
+
+		struct PendingLink
+		{
+			uint64_t key;
+			std::future<VkPipeline> optimizedPipeline;
+		};
+
+		struct RetiredPipeline
+		{
+			VkPipeline pipeline;
+			uint32_t framesLeft;
+		};
+
 		VkPipelineLayout _pipelineLayout;
-		VkPipeline _graphicsPipeline;
+
+		ShaderProgram* _shaderProgram = nullptr;
+		VkRenderPass _renderPass = VK_NULL_HANDLE;
+		VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+		ShaderFeatureFlags _defaultFeatures = SHADER_FEATURE_NONE;
+		VertexFormat _defaultVertexFormat;
+		FixedFunctionState _state;
+		// keyed by VertexFormat::GetKey, with POSITION_ONLY_INPUT_KEY for the position only states
+		std::unordered_map<uint32_t, std::unique_ptr<VertexInputState>> _vertexInputStates;
+		// keyed by the vertex format key in the high and the pruned feature mask in the low 32 bits
+		std::unordered_map<uint64_t, VkPipeline> _variants;
+
+		bool _bUseLibraries = false;
+		// keyed by VertexFormat::GetKey
+		std::unordered_map<uint32_t, VkPipeline> _vertexInputLibraries;
+		VkPipeline _fragmentOutputLibrary = VK_NULL_HANDLE;
+		// keyed by the feature mask pruned to the vertex / fragment shader
+		std::unordered_map<ShaderFeatureFlags, VkPipeline> _preRasterizationLibraries;
+		std::unordered_map<ShaderFeatureFlags, VkPipeline> _fragmentShaderLibraries;
+		std::list<PendingLink> _pendingLinks;
+		std::list<RetiredPipeline> _retiredPipelines;
 	};
-}
\ No newline at end of file
+}
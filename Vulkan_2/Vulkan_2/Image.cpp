@@ -21,14 +21,16 @@ void Engine::Image::CreateImage(const EngineImageCreateInfo* createInfo)
 	_height = createInfo->height;
 	_imageSize = createInfo->size;
 	_imageFormat = createInfo->imageFormat;
+	_mipLevels = createInfo->mipLevels;
+	_arrayLayers = createInfo->arrayLayers;
 	VkImageCreateInfo imageCreateInfo{};
 	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageCreateInfo.extent.width = createInfo->width;
 	imageCreateInfo.extent.height = createInfo->height;
 	imageCreateInfo.extent.depth = 1;
-	imageCreateInfo.mipLevels = 1;
-	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.mipLevels = createInfo->mipLevels;
+	imageCreateInfo.arrayLayers = createInfo->arrayLayers;
 	imageCreateInfo.format = createInfo->imageFormat;
 	imageCreateInfo.tiling = createInfo->imageTiling;
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -37,7 +39,7 @@ void Engine::Image::CreateImage(const EngineImageCreateInfo* createInfo)
 	imageCreateInfo.queueFamilyIndexCount = createInfo->queueFamilyIndexCount;
 	imageCreateInfo.pQueueFamilyIndices = createInfo->queueFamilyIndices;
 	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageCreateInfo.flags = 0;
+	imageCreateInfo.flags = createInfo->flags;
 
 	if (vkCreateImage(Application::s_logicalDevice, &imageCreateInfo, nullptr, &_image) != VK_SUCCESS)
 	{
@@ -57,6 +59,7 @@ void Engine::Image::CreateImage(const EngineImageCreateInfo* createInfo)
 		throw std::runtime_error("Failed to allocate image memory!!!");
 	}
 
+	_memorySize = memoryRequirements.size;
 	vkBindImageMemory(Application::s_logicalDevice, _image, _imageMemory, 0);
 }
 
@@ -84,9 +87,9 @@ void Engine::Image::TransitionImageLayout(VkCommandBuffer commandBuffer, VkForma
 	}
 
 	memoryBarrier.subresourceRange.baseArrayLayer = 0;
-	memoryBarrier.subresourceRange.layerCount = 1;
+	memoryBarrier.subresourceRange.layerCount = _arrayLayers;
 	memoryBarrier.subresourceRange.baseMipLevel = 0;
-	memoryBarrier.subresourceRange.levelCount = 1;
+	memoryBarrier.subresourceRange.levelCount = _mipLevels;
 
 	VkPipelineStageFlags srcStage = 0;
 	VkPipelineStageFlags dstStage = 0;
@@ -107,6 +110,14 @@ void Engine::Image::TransitionImageLayout(VkCommandBuffer commandBuffer, VkForma
 		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	else if(oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+	{
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
 	else if(oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
 	{
 		memoryBarrier.srcAccessMask = 0;
@@ -126,18 +137,18 @@ void Engine::Image::TransitionImageLayout(VkCommandBuffer commandBuffer, VkForma
 		1, &memoryBarrier);
 }
 
-void Engine::Image::CreateImageView(VkImageAspectFlags aspecFlags)
+void Engine::Image::CreateImageView(VkImageAspectFlags aspecFlags, VkImageViewType viewType)
 {
 	VkImageViewCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	createInfo.image = _image;
-	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.viewType = viewType;
 	createInfo.format = _imageFormat;
 	createInfo.subresourceRange.aspectMask = aspecFlags;
 	createInfo.subresourceRange.baseArrayLayer = 0;
-	createInfo.subresourceRange.layerCount = 1;
+	createInfo.subresourceRange.layerCount = viewType == VK_IMAGE_VIEW_TYPE_2D_ARRAY ? _arrayLayers : 1;
 	createInfo.subresourceRange.baseMipLevel = 0;
-	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.levelCount = _mipLevels;
 
 	if(vkCreateImageView(Application::s_logicalDevice, &createInfo, nullptr, &_imageView) != VK_SUCCESS)
 	{
@@ -145,6 +156,14 @@ void Engine::Image::CreateImageView(VkImageAspectFlags aspecFlags)
 	}
 }
 
+uint32_t Engine::Image::GetMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		levels++;
+	return levels;
+}
+
 uint32_t Engine::Image::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
 	VkPhysicalDeviceMemoryProperties memoryProperties;
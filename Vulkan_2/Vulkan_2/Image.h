@@ -15,6 +15,11 @@ namespace Engine
 		VkSharingMode sharingMode;
 		uint32_t queueFamilyIndexCount = 0;
 		uint32_t* queueFamilyIndices = nullptr;
+		// the view and every layout transition cover all levels
+		uint32_t mipLevels = 1;
+		// layout transitions cover all layers, a 2D view only the first one
+		uint32_t arrayLayers = 1;
+		VkImageCreateFlags flags = 0;
 	};
 
 	class Image
@@ -27,7 +32,11 @@ namespace Engine
 
 		void TransitionImageLayout(VkCommandBuffer commandBuffer, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 
-		void CreateImageView(VkImageAspectFlags aspecFlags);
+		// A 2D array view covers every layer, textures are sampled through one so packed and standalone ones share a shader
+		void CreateImageView(VkImageAspectFlags aspecFlags, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D);
+
+		// Levels of a full mip chain down to 1x1
+		static uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
 
 	private:
 		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -43,6 +52,10 @@ namespace Engine
 		uint32_t GetHeight() { return _height; }
 		VkDeviceSize GetImageSize() { return _imageSize; }
 		VkFormat GetImageFormat() { return _imageFormat; }
+		uint32_t GetMipLevels() { return _mipLevels; }
+		uint32_t GetArrayLayers() { return _arrayLayers; }
+		// bytes of the device memory allocation, padding and all levels included
+		VkDeviceSize GetMemorySize() const { return _memorySize; }
 
 #pragma endregion
 
@@ -55,11 +68,14 @@ namespace Engine
 	private:
 		VkImage _image;
 		VkDeviceMemory _imageMemory;
-		VkImageView _imageView;
+		VkImageView _imageView = VK_NULL_HANDLE;
 
 		uint32_t _width;
 		uint32_t _height;
 		VkDeviceSize _imageSize;
 		VkFormat _imageFormat;
+		uint32_t _mipLevels = 1;
+		uint32_t _arrayLayers = 1;
+		VkDeviceSize _memorySize = 0;
 	};
 }
\ No newline at end of file
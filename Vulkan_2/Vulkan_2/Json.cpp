@@ -0,0 +1,346 @@
+#include "pch.h"
+#include "Json.h"
+
+#include <cstdlib>
+#include <cmath>
+
+namespace Engine
+{
+	// Recursive descent over RFC 8259 JSON. Nesting is limited so a hostile file cannot exhaust the stack.
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* text, size_t length) : _current(text), _end(text + length) {}
+
+		bool ParseDocument(JsonValue& value)
+		{
+			if (!ParseValue(value, 0))
+				return false;
+			SkipWhitespace();
+			return _current == _end;
+		}
+
+	private:
+		static const int MAX_DEPTH = 128;
+
+		void SkipWhitespace()
+		{
+			while (_current < _end && (*_current == ' ' || *_current == '\t' || *_current == '\n' || *_current == '\r'))
+				_current++;
+		}
+
+		bool Consume(const char* literal)
+		{
+			const char* cursor = _current;
+			for (; *literal != '\0'; literal++, cursor++)
+			{
+				if (cursor >= _end || *cursor != *literal)
+					return false;
+			}
+			_current = cursor;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& value, int depth)
+		{
+			if (depth > MAX_DEPTH)
+				return false;
+
+			SkipWhitespace();
+			if (_current >= _end)
+				return false;
+
+			switch (*_current)
+			{
+			case '{':
+				return ParseObject(value, depth);
+			case '[':
+				return ParseArray(value, depth);
+			case '"':
+				value._type = JsonType::String;
+				return ParseString(value._string);
+			case 't':
+				value._type = JsonType::Bool;
+				value._bool = true;
+				return Consume("true");
+			case 'f':
+				value._type = JsonType::Bool;
+				value._bool = false;
+				return Consume("false");
+			case 'n':
+				value._type = JsonType::Null;
+				return Consume("null");
+			default:
+				return ParseNumber(value);
+			}
+		}
+
+		bool ParseObject(JsonValue& value, int depth)
+		{
+			value._type = JsonType::Object;
+			_current++;
+			SkipWhitespace();
+			if (_current < _end && *_current == '}')
+			{
+				_current++;
+				return true;
+			}
+
+			for (;;)
+			{
+				SkipWhitespace();
+				if (_current >= _end || *_current != '"')
+					return false;
+				value._keys.emplace_back();
+				if (!ParseString(value._keys.back()))
+					return false;
+
+				SkipWhitespace();
+				if (_current >= _end || *_current != ':')
+					return false;
+				_current++;
+
+				value._elements.emplace_back();
+				if (!ParseValue(value._elements.back(), depth + 1))
+					return false;
+
+				SkipWhitespace();
+				if (_current >= _end)
+					return false;
+				if (*_current == '}')
+				{
+					_current++;
+					return true;
+				}
+				if (*_current != ',')
+					return false;
+				_current++;
+			}
+		}
+
+		bool ParseArray(JsonValue& value, int depth)
+		{
+			value._type = JsonType::Array;
+			_current++;
+			SkipWhitespace();
+			if (_current < _end && *_current == ']')
+			{
+				_current++;
+				return true;
+			}
+
+			for (;;)
+			{
+				value._elements.emplace_back();
+				if (!ParseValue(value._elements.back(), depth + 1))
+					return false;
+
+				SkipWhitespace();
+				if (_current >= _end)
+					return false;
+				if (*_current == ']')
+				{
+					_current++;
+					return true;
+				}
+				if (*_current != ',')
+					return false;
+				_current++;
+			}
+		}
+
+		bool ParseHex4(uint32_t& codePoint)
+		{
+			if (_end - _current < 4)
+				return false;
+			codePoint = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				char c = *_current++;
+				codePoint <<= 4;
+				if (c >= '0' && c <= '9')
+					codePoint |= c - '0';
+				else if (c >= 'a' && c <= 'f')
+					codePoint |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F')
+					codePoint |= c - 'A' + 10;
+				else
+					return false;
+			}
+			return true;
+		}
+
+		static void AppendUtf8(std::string& out, uint32_t codePoint)
+		{
+			if (codePoint < 0x80)
+				out += static_cast<char>(codePoint);
+			else if (codePoint < 0x800)
+			{
+				out += static_cast<char>(0xC0 | (codePoint >> 6));
+				out += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else if (codePoint < 0x10000)
+			{
+				out += static_cast<char>(0xE0 | (codePoint >> 12));
+				out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else
+			{
+				out += static_cast<char>(0xF0 | (codePoint >> 18));
+				out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+				out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+		}
+
+		bool ParseString(std::string& out)
+		{
+			// opening quote
+			_current++;
+			while (_current < _end)
+			{
+				char c = *_current++;
+				if (c == '"')
+					return true;
+				if (static_cast<unsigned char>(c) < 0x20)
+					return false;
+				if (c != '\\')
+				{
+					out += c;
+					continue;
+				}
+
+				if (_current >= _end)
+					return false;
+				switch (*_current++)
+				{
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u':
+				{
+					uint32_t codePoint;
+					if (!ParseHex4(codePoint))
+						return false;
+					// characters outside the BMP come as a surrogate pair
+					if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+					{
+						uint32_t low;
+						if (!Consume("\\u") || !ParseHex4(low) || low < 0xDC00 || low > 0xDFFF)
+							return false;
+						codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUtf8(out, codePoint);
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return false;
+		}
+
+		bool ParseNumber(JsonValue& value)
+		{
+			// strtod needs a terminated string and accepts more than JSON does, so the token is checked and copied first
+			const char* start = _current;
+			if (_current < _end && *_current == '-')
+				_current++;
+			const char* digits = _current;
+			while (_current < _end && *_current >= '0' && *_current <= '9')
+				_current++;
+			if (_current == digits || (*digits == '0' && _current - digits > 1))
+				return false;
+			if (_current < _end && *_current == '.')
+			{
+				_current++;
+				const char* fraction = _current;
+				while (_current < _end && *_current >= '0' && *_current <= '9')
+					_current++;
+				if (_current == fraction)
+					return false;
+			}
+			if (_current < _end && (*_current == 'e' || *_current == 'E'))
+			{
+				_current++;
+				if (_current < _end && (*_current == '+' || *_current == '-'))
+					_current++;
+				const char* exponent = _current;
+				while (_current < _end && *_current >= '0' && *_current <= '9')
+					_current++;
+				if (_current == exponent)
+					return false;
+			}
+
+			char buffer[64];
+			size_t length = static_cast<size_t>(_current - start);
+			if (length >= sizeof(buffer))
+				return false;
+			memcpy(buffer, start, length);
+			buffer[length] = '\0';
+
+			value._type = JsonType::Number;
+			value._number = strtod(buffer, nullptr);
+			return true;
+		}
+
+	private:
+		const char* _current;
+		const char* _end;
+	};
+}
+
+namespace
+{
+	const Engine::JsonValue s_nullValue;
+}
+
+Engine::JsonValue::JsonValue()
+{
+}
+
+Engine::JsonValue::~JsonValue()
+{
+}
+
+bool Engine::JsonValue::Parse(const char* text, size_t length, JsonValue& value)
+{
+	value = JsonValue();
+	JsonParser parser(text, length);
+	return parser.ParseDocument(value);
+}
+
+const Engine::JsonValue& Engine::JsonValue::operator[](const char* key) const
+{
+	for (size_t i = 0; i < _keys.size(); i++)
+	{
+		if (_keys[i] == key)
+			return _elements[i];
+	}
+	return s_nullValue;
+}
+
+const Engine::JsonValue& Engine::JsonValue::operator[](size_t index) const
+{
+	if (_type != JsonType::Array || index >= _elements.size())
+		return s_nullValue;
+	return _elements[index];
+}
+
+bool Engine::JsonValue::Has(const char* key) const
+{
+	return !(*this)[key].IsNull();
+}
+
+uint64_t Engine::JsonValue::GetUint(uint64_t fallback) const
+{
+	if (_type != JsonType::Number || _number < 0.0 || _number > 9007199254740992.0 || std::floor(_number) != _number)
+		return fallback;
+	return static_cast<uint64_t>(_number);
+}
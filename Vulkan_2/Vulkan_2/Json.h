@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+
+namespace Engine
+{
+	enum class JsonType : uint8_t
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	// Parsed JSON document, just enough for asset descriptions such as the glTF scene graph.
+	// Lookups of missing members or elements return a null value, so they can be chained and checked once.
+	class JsonValue
+	{
+	public:
+		JsonValue();
+		~JsonValue();
+
+		// Returns false on a syntax error, text does not have to be null terminated
+		static bool Parse(const char* text, size_t length, JsonValue& value);
+
+		const JsonValue& operator[](const char* key) const;
+		const JsonValue& operator[](size_t index) const;
+		bool Has(const char* key) const;
+
+#pragma region Getters
+
+		JsonType GetType() const { return _type; }
+		bool IsNull() const { return _type == JsonType::Null; }
+		bool IsNumber() const { return _type == JsonType::Number; }
+		bool IsArray() const { return _type == JsonType::Array; }
+		bool IsObject() const { return _type == JsonType::Object; }
+
+		// elements of an array or members of an object
+		size_t GetSize() const { return _elements.size(); }
+		// key of the member at index, objects only
+		const std::string& GetKey(size_t index) const { return _keys[index]; }
+
+		bool GetBool(bool fallback = false) const { return _type == JsonType::Bool ? _bool : fallback; }
+		double GetNumber(double fallback = 0.0) const { return _type == JsonType::Number ? _number : fallback; }
+		float GetFloat(float fallback = 0.0f) const { return static_cast<float>(GetNumber(fallback)); }
+		// fallback as well for negative, fractional or too large numbers
+		uint64_t GetUint(uint64_t fallback = 0) const;
+		const std::string& GetString() const { return _string; }
+
+#pragma endregion
+
+	private:
+		friend class JsonParser;
+
+		JsonType _type = JsonType::Null;
+		bool _bool = false;
+		double _number = 0.0;
+		std::string _string;
+		// array elements or object member values, _keys holds the member names of objects
+		std::vector<JsonValue> _elements;
+		std::vector<std::string> _keys;
+	};
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+
+namespace Engine
+{
+	// Read only memory mapping of a whole file.
+	// The data stays valid until the file is closed, pages are loaded by the OS on first access.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		// Returns false when the file does not exist or cannot be mapped
+		bool Open(const std::string& file);
+		void Close();
+
+#pragma region Getters
+
+		bool IsOpen() const { return _data != nullptr; }
+		const uint8_t* GetData() const { return _data; }
+		size_t GetSize() const { return _size; }
+
+#pragma endregion
+
+	private:
+		const uint8_t* _data = nullptr;
+		size_t _size = 0;
+
+#ifdef _WIN32
+		void* _fileHandle = nullptr;
+		void* _mappingHandle = nullptr;
+#else
+		int _fileDescriptor = -1;
+#endif
+	};
+}
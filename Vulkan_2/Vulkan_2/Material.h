@@ -1,10 +1,7 @@
 #pragma once
-
-namespace Engine
-{
-	class Buffer;
-	class Image;
-}
+#include "ShaderPermutation.h"
+#include "AssetManager.h"
+#include "Texture.h"
 
 namespace Resource
 {
@@ -14,15 +11,30 @@ namespace Resource
 		Material(const char* file);
 		~Material();
 
+		// Streaming demand of a draw covering about pixels pixels on screen
+		void RequestTextureScreenSize(float pixels) { _texture->RequestScreenSize(pixels); }
+		// Keeps the textures resident for a draw this frame, see AssetHandle::MarkUsed
+		void MarkTexturesUsed() { _texture.MarkUsed(); }
+
 #pragma region Getters
 
-		VkDescriptorSet& GetDescriptorSet() { return _descriptorSet; }
-		Engine::Image* GetTextureImage() { return _textureImage; }
+		VkImageView GetTextureImageView() { return _texture->GetImageView(); }
+		Engine::ShaderFeatureFlags GetShaderFeatures() const { return _shaderFeatures; }
+		// slot in the bindless texture table, only valid when bindless textures are enabled
+		uint32_t GetTextureIndex() const { return _texture->GetTextureIndex(); }
+		// layer of the bound array view the texture sits in
+		uint32_t GetTextureLayer() const { return _texture->GetTextureLayer(); }
+
+#pragma endregion
+
+#pragma region Setters
+
+		void SetShaderFeatures(Engine::ShaderFeatureFlags features) { _shaderFeatures = features; }
 
 #pragma endregion
 
 	private:
-		VkDescriptorSet _descriptorSet;
-		Engine::Image* _textureImage;
+		Engine::AssetHandle<Texture> _texture;
+		Engine::ShaderFeatureFlags _shaderFeatures = Engine::SHADER_FEATURE_TEXTURE;
 	};
 }
\ No newline at end of file
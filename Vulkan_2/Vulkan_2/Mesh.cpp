@@ -1,98 +1,460 @@
 #include "pch.h"
 #include "Mesh.h"
 #include "Buffer.h"
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#include <unordered_map>
+#include "StagingRing.h"
 
 #include "Application.h"
+#include "MeshCache.h"
+#include "ObjImporter.h"
+#include "MeshStreamer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Reads one byte of every page so the OS loads the mapped range on the calling thread
+	void TouchPages(const void* data, uint64_t size)
+	{
+		const volatile uint8_t* bytes = static_cast<const volatile uint8_t*>(data);
+		uint8_t sum = 0;
+		for (uint64_t offset = 0; offset < size; offset += 4096)
+			sum += bytes[offset];
+		if (size > 0)
+			sum += bytes[size - 1];
+		(void)sum;
+	}
+}
+
+uint64_t Resource::MeshImportSettings::GetKey() const
+{
+	// FNV-1a over every field, a new field has to be added here as well
+	uint64_t key = 0xcbf29ce484222325ull;
+	auto add = [&key](const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			key ^= bytes[i];
+			key *= 0x100000001b3ull;
+		}
+	};
+
+	add(&weld.positionEpsilon, sizeof(weld.positionEpsilon));
+	uint8_t optimize = bOptimize ? 1 : 0;
+	add(&optimize, sizeof(optimize));
+	add(&overdrawThreshold, sizeof(overdrawThreshold));
+	uint32_t vertexFormatKey = vertexFormat.GetKey();
+	add(&vertexFormatKey, sizeof(vertexFormatKey));
+	add(&lod.maxLodCount, sizeof(lod.maxLodCount));
+	add(&lod.reduction, sizeof(lod.reduction));
+	add(&lod.maxError, sizeof(lod.maxError));
+	add(&lod.texCoordWeight, sizeof(lod.texCoordWeight));
+	add(&lod.colorWeight, sizeof(lod.colorWeight));
+	uint8_t buildMeshlets = bBuildMeshlets ? 1 : 0;
+	add(&buildMeshlets, sizeof(buildMeshlets));
+	return key;
+}
 
 Resource::Mesh::Mesh()
 {
 }
 
-Resource::Mesh::Mesh(const char* file)
+Resource::Mesh::Mesh(const char* file, const MeshImportSettings& settings)
+	: _file(file)
+	, _settings(settings)
+{
+	_bResident = false;
+	Reload();
+}
+
+Resource::DecodedMesh Resource::Mesh::Decode(const std::string& file, const MeshImportSettings& settings, Engine::ThreadPool* threadPool, bool bCpuCopy)
 {
-	// Read OBJ file
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warning, error;
+	// Everything that changes the imported arrays has to be part of the cache key
+	uint64_t settingsKey = settings.GetKey();
+	DecodedMesh decoded;
 
-	if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, file))
+	// Fast path: the cache holds the final arrays, the mapping stays open until they are uploaded
+	std::shared_ptr<MeshCache> cache = std::make_shared<MeshCache>();
+	if (cache->Open(file.c_str(), settingsKey))
 	{
-		throw std::runtime_error("Failed to load obj!!!   " + warning + error);
+		MeshDataView data = cache->GetDataView();
+		decoded.cache = cache;
+		decoded.format = cache->GetVertexFormat();
+		decoded.vertexCount = data.vertexCount;
+		decoded.indexCount = data.indexCount;
+		decoded.indexSize = data.indexSize;
+		for (uint32_t stream = 0; stream < decoded.format.GetStreamCount(); stream++)
+			TouchPages(data.streams[stream], data.GetStreamSize(stream));
+		TouchPages(data.indices, data.GetIndexDataSize());
+		// the mesh keeps these, they are small next to the streams
+		decoded.lods.assign(data.lods, data.lods + data.lodCount);
+		decoded.meshlets.assign(data.meshlets, data.meshlets + data.meshletCount);
+		decoded.meshletBounds.Build(decoded.meshlets);
+
+		decoded.boundsMin = cache->GetBoundsMin();
+		decoded.boundsMax = cache->GetBoundsMax();
+		decoded.cacheStatsBefore = cache->GetHeader().cacheStatsBefore;
+		decoded.cacheStatsAfter = cache->GetHeader().cacheStatsAfter;
+
+		// the cache only holds the GPU layout, the copy is unpacked from it
+		if (bCpuCopy)
+		{
+			decoded.format.Decode(data.streams, data.vertexCount, decoded.boundsMin, decoded.boundsMax, decoded.cpuVertices);
+			decoded.cpuIndices.resize(static_cast<size_t>(data.indexCount));
+			for (size_t i = 0; i < decoded.cpuIndices.size(); i++)
+			{
+				decoded.cpuIndices[i] = data.indexSize == sizeof(uint16_t) ? static_cast<const uint16_t*>(data.indices)[i] : static_cast<const uint32_t*>(data.indices)[i];
+			}
+		}
+		return decoded;
+	}
+
+	std::vector<Vertex>& vertices = decoded.cpuVertices;
+	std::vector<uint32_t>& indices = decoded.cpuIndices;
+	ImportObj(file, settings.weld, threadPool, decoded);
+	ComputeBounds(vertices, decoded.boundsMin, decoded.boundsMax);
+
+	decoded.cacheStatsBefore = MeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+	if (settings.bOptimize)
+	{
+		MeshOptimizer::Optimize(vertices, indices, settings.overdrawThreshold);
 	}
+	decoded.cacheStatsAfter = MeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	// The LOD levels are appended behind the base level and share its vertices
+	decoded.lods = MeshSimplifier::GenerateLods(vertices, indices, decoded.boundsMin, decoded.boundsMax, settings.lod);
 
-	for (tinyobj::shape_t& shape : shapes)
+	// Bounds come from the unquantized positions, the quantization error (1/65535 of the extent) is far below what culling could notice
+	if (settings.bBuildMeshlets)
 	{
-		for (auto index : shape.mesh.indices)
+		for (MeshLod& lod : decoded.lods)
 		{
-			Vertex vertex{};
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2],
-			};
+			lod.firstMeshlet = static_cast<uint32_t>(decoded.meshlets.size());
+			MeshletBuilder::Build(vertices, indices, lod.firstIndex, lod.indexCount, decoded.meshlets);
+			lod.meshletCount = static_cast<uint32_t>(decoded.meshlets.size()) - lod.firstMeshlet;
+		}
+		decoded.meshletBounds.Build(decoded.meshlets);
+	}
 
-			vertex.texCoord = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-			};
+	decoded.format = settings.vertexFormat.Resolve(vertices);
+	decoded.format.Encode(vertices, decoded.boundsMin, decoded.boundsMax, decoded.streams);
+	decoded.vertexCount = vertices.size();
+	decoded.indexCount = indices.size();
 
-			vertex.color = {1.0f, 1.0f, 1.0f};
+	// 0xFFFF stays unused so the index buffer also works with primitive restart
+	if (vertices.size() < 0xFFFF)
+	{
+		std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+		decoded.indexSize = sizeof(uint16_t);
+		decoded.indices.resize(shortIndices.size() * sizeof(uint16_t));
+		memcpy(decoded.indices.data(), shortIndices.data(), decoded.indices.size());
+	}
+	else
+	{
+		decoded.indexSize = sizeof(uint32_t);
+		decoded.indices.resize(indices.size() * sizeof(uint32_t));
+		memcpy(decoded.indices.data(), indices.data(), decoded.indices.size());
+	}
 
-			if(uniqueVertices.count(vertex) == 0)
-			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-				_vertices.push_back(vertex);
-			}
-			_indices.push_back(uniqueVertices[vertex]);
-		}
+	MeshDataView data = decoded.GetDataView();
+	MeshCache::Write(file.c_str(), settingsKey, data, decoded.boundsMin, decoded.boundsMax, decoded.cacheStatsBefore, decoded.cacheStatsAfter);
+	return decoded;
+}
+
+Resource::MeshDataView Resource::DecodedMesh::GetDataView() const
+{
+	if (cache != nullptr)
+		return cache->GetDataView();
+
+	MeshDataView data;
+	data.format = format;
+	data.vertexCount = vertexCount;
+	data.indexCount = indexCount;
+	data.indexSize = indexSize;
+	for (uint32_t stream = 0; stream < MAX_VERTEX_STREAMS; stream++)
+		data.streams[stream] = streams[stream].data();
+	data.indices = indices.data();
+	data.lods = lods.data();
+	data.lodCount = static_cast<uint32_t>(lods.size());
+	data.meshlets = meshlets.data();
+	data.meshletCount = meshlets.size();
+	return data;
+}
+
+void Resource::Mesh::StartLoading()
+{
+	// the worker gets its own copies, the mesh may be destroyed while the import runs
+	std::string file = _file;
+	MeshImportSettings settings = _settings;
+	bool bCpuCopy = _bCpuCopyPinned;
+	Engine::ThreadPool* threadPool = Application::s_threadPool;
+	_load = threadPool->Submit([file, settings, threadPool, bCpuCopy]() { return Decode(file, settings, threadPool, bCpuCopy); });
+}
+
+bool Resource::Mesh::Unload()
+{
+	if (!_bResident || _file.empty())
+		return false;
+
+	delete _dataBuffer;
+	_dataBuffer = nullptr;
+	_lods.clear();
+	_meshlets.clear();
+	_meshletBounds = MeshletBounds();
+	_bResident = false;
+	return true;
+}
+
+void Resource::Mesh::Reload()
+{
+	if (_bResident || IsLoadPending())
+		return;
+
+	if (MESH_STREAMING && Application::s_meshStreamer != nullptr && Application::s_threadPool != nullptr)
+	{
+		Application::s_meshStreamer->Enqueue(this);
+		return;
 	}
 
-	InitializeBuffer();
+	DecodedMesh decoded = Decode(_file, _settings, Application::s_threadPool, _bCpuCopyPinned);
+	CompleteLoading(decoded);
+}
+
+void Resource::Mesh::SetCpuCopyPinned(bool bPinned)
+{
+	_bCpuCopyPinned = bPinned;
+	if (_bCpuCopyPinned && _bResident)
+		ReadCpuCopy();
+}
+
+void Resource::Mesh::DropCpuCopy()
+{
+	if (_bCpuCopyPinned)
+		return;
+
+	// swapped with empty vectors, clear keeps the capacity
+	std::vector<Vertex>().swap(_vertices);
+	std::vector<uint32_t>().swap(_indices);
+}
+
+uint64_t Resource::Mesh::GetCpuMemorySize() const
+{
+	return _vertices.capacity() * sizeof(Vertex) + _indices.capacity() * sizeof(uint32_t);
+}
+
+uint64_t Resource::Mesh::GetMemorySize() const
+{
+	return _dataBuffer != nullptr ? _dataBuffer->GetMemorySize() : 0;
+}
+
+void Resource::Mesh::ReadCpuCopy()
+{
+	if (!_vertices.empty() || _file.empty())
+		return;
+
+	// blocks on the cache read, pinning before the mesh finished loading avoids it
+	DecodedMesh decoded = Decode(_file, _settings, Application::s_threadPool, true);
+	_vertices = std::move(decoded.cpuVertices);
+	_indices = std::move(decoded.cpuIndices);
+}
+
+bool Resource::Mesh::FinishLoading(bool bWait)
+{
+	if (_bResident)
+		return true;
+
+	if (!IsLoadPending())
+	{
+		if (!bWait)
+			return false;
+		// skips the queue
+		if (Application::s_meshStreamer != nullptr)
+			Application::s_meshStreamer->Remove(this);
+		StartLoading();
+	}
+
+	if (!bWait && _load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	DecodedMesh decoded = _load.get();
+	CompleteLoading(decoded);
+	return true;
+}
+
+void Resource::Mesh::RequestDistance(float distance)
+{
+	_requestedDistance = std::min(_requestedDistance, distance);
+}
+
+float Resource::Mesh::ConsumeRequestedDistance()
+{
+	float distance = _requestedDistance;
+	_requestedDistance = std::numeric_limits<float>::max();
+	return distance;
+}
+
+void Resource::Mesh::CompleteLoading(DecodedMesh& decoded)
+{
+	_vertices = std::move(decoded.cpuVertices);
+	_indices = std::move(decoded.cpuIndices);
+	_vertexCount = static_cast<size_t>(decoded.vertexCount);
+	_indexCount = static_cast<size_t>(decoded.indexCount);
+	_lods = std::move(decoded.lods);
+	_meshlets = std::move(decoded.meshlets);
+	_meshletBounds = std::move(decoded.meshletBounds);
+	_boundsMin = decoded.boundsMin;
+	_boundsMax = decoded.boundsMax;
+	_cacheStatsBefore = decoded.cacheStatsBefore;
+	_cacheStatsAfter = decoded.cacheStatsAfter;
+	_vertexFormat = decoded.format;
+	ComputeDequantizationMatrix();
+
+	// the arrays of the import or the cache mapping stay alive until the ring is flushed
+	InitializeBuffer(decoded.GetDataView());
+	Application::s_stagingRing->Flush();
+
+	_bResident = true;
+
+	// pinned after the import had started
+	if (_bCpuCopyPinned)
+		ReadCpuCopy();
+}
+
+void Resource::Mesh::ImportObj(const std::string& file, const WeldSettings& weldSettings, Engine::ThreadPool* threadPool, DecodedMesh& decoded)
+{
+	ObjImporter importer(threadPool);
+	importer.Import(file.c_str(), weldSettings, decoded.cpuVertices, decoded.cpuIndices);
+}
+
+void Resource::Mesh::ComputeBounds(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	if (vertices.empty())
+		return;
+
+	boundsMin = vertices[0].pos;
+	boundsMax = vertices[0].pos;
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+}
+
+void Resource::Mesh::ComputeBounds()
+{
+	ComputeBounds(_vertices, _boundsMin, _boundsMax);
+}
+
+void Resource::Mesh::ComputeDequantizationMatrix()
+{
+	_dequantizationMatrix = glm::mat4(1.0f);
+	if (_vertexFormat.position != PositionFormat::Unorm16)
+		return;
+
+	// stored = (pos - min) / extent, so pos = min + stored * extent
+	glm::vec3 extent = _boundsMax - _boundsMin;
+	_dequantizationMatrix[0][0] = extent.x;
+	_dequantizationMatrix[1][1] = extent.y;
+	_dequantizationMatrix[2][2] = extent.z;
+	_dequantizationMatrix[3] = glm::vec4(_boundsMin, 1.0f);
 }
 
 Resource::Mesh::Mesh(std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices)
 	: _vertices(std::move(vertices))
 	, _indices(std::move(indices))
 {
+	_vertexCount = _vertices.size();
+	_indexCount = _indices.size();
+	_lods.push_back({ 0, static_cast<uint32_t>(_indexCount), 0.0f });
+	ComputeBounds();
+}
+
+Resource::Mesh::Mesh(const MeshStreamSource& source)
+{
+	_vertexCount = static_cast<size_t>(source.vertexCount);
+	_indexCount = static_cast<size_t>(source.indexCount);
+	_lods.push_back({ 0, static_cast<uint32_t>(_indexCount), 0.0f });
+	_boundsMin = source.boundsMin;
+	_boundsMax = source.boundsMax;
+	_vertexFormat = source.format;
+	ComputeDequantizationMatrix();
+
+	InitializeBuffer(source);
 }
 
 Resource::Mesh::~Mesh()
 {
+	// an import still running only owns its result, dropping the future lets the worker finish and free it
+	if (!_bResident && Application::s_meshStreamer != nullptr)
+		Application::s_meshStreamer->Remove(this);
 	delete _dataBuffer;
 }
 
-void Resource::Mesh::InitializeBuffer()
+uint32_t Resource::Mesh::SelectLod(float errorScale, uint32_t currentLod) const
 {
-	VkDeviceSize verticesSize = sizeof(_vertices.at(0)) * _vertices.size();
-	VkDeviceSize indicesSize = sizeof(_indices.at(0)) * _indices.size();
-	VkDeviceSize bufferSize = indicesSize + verticesSize;
+	uint32_t lodCount = static_cast<uint32_t>(_lods.size());
+	if (lodCount == 0)
+		return 0;
+	uint32_t lod = std::min(currentLod, lodCount - 1);
 
-	_dataBuffer = new Engine::Buffer();
+	// finer as long as the current level is visibly off
+	while (lod > 0 && _lods[lod].error * errorScale > LOD_ERROR_THRESHOLD)
+		lod--;
 
-	_dataBuffer->SetVertexOffset(0);
-	_dataBuffer->SetIndexOffset(sizeof(_vertices.at(0)) * _vertices.size());
+	// coarser only once the next level is clearly below the threshold
+	while (lod + 1 < lodCount && _lods[lod + 1].error * errorScale < LOD_ERROR_THRESHOLD * (1.0f - LOD_HYSTERESIS))
+		lod++;
 
-	Engine::Buffer* stagingBuffer = new Engine::Buffer();
-	std::vector<uint32_t> transferOpsQueueFamilyIndices = Application::GetTransferOpsQueueIndices();
-	stagingBuffer->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_SHARING_MODE_CONCURRENT, 2, transferOpsQueueFamilyIndices.data());
-	void* data;
-	vkMapMemory(Application::s_logicalDevice, stagingBuffer->GetBufferMemory(), 0, bufferSize, 0, &data);
-	// copy vertices
-	memcpy(static_cast<char*>(data) + _dataBuffer->GetVertexOffset(), _vertices.data(), verticesSize);
-	// copy indices
-	memcpy(static_cast<char*>(data) + _dataBuffer->GetIndexOffset(), _indices.data(), indicesSize);
-	vkUnmapMemory(Application::s_logicalDevice, stagingBuffer->GetBufferMemory());
+	return lod;
+}
 
-	_dataBuffer->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE);
+void Resource::Mesh::InitializeBuffer(const MeshDataView& data)
+{
+	MeshStreamSource source;
+	source.format = data.format;
+	source.vertexCount = data.vertexCount;
+	source.indexCount = data.indexCount;
+	source.indexSize = data.indexSize;
+	source.writeVertices = [&data](uint32_t stream, uint8_t* dst, uint64_t first, uint64_t count)
+	{
+		uint32_t stride = data.format.GetStride(stream);
+		memcpy(dst, static_cast<const uint8_t*>(data.streams[stream]) + first * stride, static_cast<size_t>(count * stride));
+	};
+	source.writeIndices = [&data](uint8_t* dst, uint64_t first, uint64_t count)
+	{
+		memcpy(dst, static_cast<const uint8_t*>(data.indices) + first * data.indexSize, static_cast<size_t>(count * data.indexSize));
+	};
+	InitializeBuffer(source);
+}
 
-	Application::CopyBuffer(stagingBuffer->GetBuffer(), _dataBuffer->GetBuffer(), bufferSize);
+void Resource::Mesh::InitializeBuffer(const MeshStreamSource& source)
+{
+	// streams first, then the indices, every array aligned for the widest element it can hold
+	VkDeviceSize bufferSize = 0;
+	for (uint32_t stream = 0; stream < source.format.GetStreamCount(); stream++)
+	{
+		_streamOffsets[stream] = bufferSize;
+		bufferSize = (bufferSize + source.vertexCount * source.format.GetStride(stream) + 15) & ~VkDeviceSize(15);
+	}
+	VkDeviceSize indexOffset = bufferSize;
+	bufferSize += source.indexCount * source.indexSize;
 
-	delete stagingBuffer;
-}
+	_indexType = source.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	_dataBuffer = new Engine::Buffer();
+
+	_dataBuffer->SetVertexOffset(_streamOffsets[0]);
+	_dataBuffer->SetIndexOffset(indexOffset);
+
+	_dataBuffer->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE);
+
+	// The source writes each chunk straight into the mapped ring, there is no staging copy of the whole mesh
+	Engine::StagingRing* ring = Application::s_stagingRing;
+	for (uint32_t stream = 0; stream < source.format.GetStreamCount(); stream++)
+	{
+		ring->Upload(_dataBuffer->GetBuffer(), _streamOffsets[stream], source.vertexCount, source.format.GetStride(stream),
+			[&source, stream](uint8_t* dst, VkDeviceSize first, VkDeviceSize count) { source.writeVertices(stream, dst, first, count); });
+	}
+	ring->Upload(_dataBuffer->GetBuffer(), indexOffset, source.indexCount, source.indexSize, source.writeIndices);
+}
\ No newline at end of file
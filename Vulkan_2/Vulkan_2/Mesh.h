@@ -1,40 +1,224 @@
 #pragma once
+#include <functional>
+#include <memory>
+#include <future>
+#include <string>
+#include <limits>
 
 #include "Vertex.h"
+#include "VertexWelder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
 
 namespace Engine
 {
 	class Buffer;
+	class ThreadPool;
 }
 
 namespace Resource
 {
+	// Everything that changes the arrays an import produces
+	struct MeshImportSettings
+	{
+		WeldSettings weld;
+		// Reorder triangles and vertices for the post transform cache, overdraw and vertex fetch
+		bool bOptimize = true;
+		// ACMR increase accepted for finer overdraw clusters, 0 skips the overdraw pass
+		float overdrawThreshold = 1.05f;
+		// GPU layout of the vertex data, resolved per mesh (see VertexFormat::Resolve)
+		VertexFormat vertexFormat = VertexFormat::Compact();
+		LodSettings lod;
+		// Split every LOD level into meshlets so the renderer can cull clusters instead of whole meshes
+		bool bBuildMeshlets = true;
+
+		// Identifies the settings in the mesh cache
+		uint64_t GetKey() const;
+	};
+
+	struct MeshDataView;
+	class MeshCache;
+
+	// Mesh arrays an importer writes straight into staging memory, for sources already laid out close to the GPU format.
+	// The writers are called per chunk with the first element and the element count of the chunk.
+	struct MeshStreamSource
+	{
+		VertexFormat format;
+		uint64_t vertexCount = 0;
+		uint64_t indexCount = 0;
+		// 2 or 4 bytes
+		uint32_t indexSize = sizeof(uint32_t);
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+
+		// (stream, dst, firstVertex, vertexCount)
+		std::function<void(uint32_t, uint8_t*, uint64_t, uint64_t)> writeVertices;
+		// (dst, firstIndex, indexCount)
+		std::function<void(uint8_t*, uint64_t, uint64_t)> writeIndices;
+	};
+
+	// A mesh imported on a worker thread into GPU ready arrays, uploaded on the main thread.
+	// Arrays read from the mesh cache stay in the mapping, the worker only faults its pages in so the upload does not wait for the file.
+	struct DecodedMesh
+	{
+		VertexFormat format;
+		uint64_t vertexCount = 0;
+		uint64_t indexCount = 0;
+		// 2 or 4 bytes
+		uint32_t indexSize = sizeof(uint32_t);
+		// set when the arrays come from the mesh cache, the upload reads the streams and indices straight from the mapping
+		std::shared_ptr<MeshCache> cache;
+		// imported from source, empty when the cache is set
+		std::array<std::vector<uint8_t>, MAX_VERTEX_STREAMS> streams;
+		std::vector<uint8_t> indices;
+		std::vector<MeshLod> lods;
+		std::vector<Meshlet> meshlets;
+		MeshletBounds meshletBounds;
+
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		VertexCacheStats cacheStatsBefore;
+		VertexCacheStats cacheStatsAfter;
+
+		// CPU copies, only filled when the mesh was imported from source
+		std::vector<Vertex> cpuVertices;
+		std::vector<uint32_t> cpuIndices;
+
+		MeshDataView GetDataView() const;
+	};
+
+	// Meshes loaded from a file are streamed when MESH_STREAMING is on: the constructor only queues the mesh with the
+	// Application::s_meshStreamer, which imports it on the thread pool, and the mesh is uploaded once the import is done.
+	// Until then it is not resident and has neither LODs nor a buffer, the renderer skips it.
+	// The AssetManager may unload the buffer of a mesh nobody drew recently and reload it from the mesh cache on the next use,
+	// and drops the CPU copies of the vertices and indices unless they are pinned.
 	class Mesh
 	{
 	public:
 		Mesh();
-		Mesh(const char* file);
+		// Queues the mesh for streaming, or imports and uploads it right away without a streamer
+		Mesh(const char* file, const MeshImportSettings& settings = MeshImportSettings());
 		Mesh(std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices);
+		// GPU only mesh with a single LOD and no meshlets. The copies are only recorded,
+		// the caller flushes Application::s_stagingRing before the mesh is drawn.
+		Mesh(const MeshStreamSource& source);
 		~Mesh();
 
+		// Coarsest level whose error stays below LOD_ERROR_THRESHOLD pixels. errorScale converts object space units
+		// into pixels at the object's distance. Switching to a coarser level needs a margin (LOD_HYSTERESIS)
+		// so objects resting near a switch distance do not flip between two levels every frame.
+		uint32_t SelectLod(float errorScale, uint32_t currentLod) const;
+
+		// Runs on a worker thread, or on the main thread for meshes loaded right away. threadPool parallelizes the obj parsing,
+		// ParallelFor is safe on a worker.
+		// bCpuCopy also unpacks the CPU copies when the arrays come from the mesh cache.
+		static DecodedMesh Decode(const std::string& file, const MeshImportSettings& settings, Engine::ThreadPool* threadPool, bool bCpuCopy);
+
+		// Called by the MeshStreamer: starts the import on Application::s_threadPool
+		void StartLoading();
+		// Main thread: uploads the mesh once the import finished, bWait starts and blocks on it if needed.
+		// Returns true when the mesh is resident. Import errors are rethrown here.
+		bool FinishLoading(bool bWait = false);
+
+		// Records the distance of an object waiting for the mesh, the streamer loads the nearest meshes first
+		void RequestDistance(float distance);
+		// Smallest distance requested since the last call, the largest float when there was no request
+		float ConsumeRequestedDistance();
+
+		// Main thread: frees the buffer of a mesh loaded from a file, no frame in flight may use it anymore.
+		// Returns false for meshes that cannot load again.
+		bool Unload();
+		// Loads an unloaded mesh again, queued for streaming like a new one
+		void Reload();
+
+		// Keeps the CPU copies of the vertices and indices, for physics or picking. A resident mesh without them
+		// reads them back from the mesh cache right away.
+		void SetCpuCopyPinned(bool bPinned);
+		// Frees the CPU copies unless they are pinned
+		void DropCpuCopy();
+
 #pragma region Getters
 
+		// CPU copies, empty unless the mesh was imported from source or they are pinned. Quantized formats come back from
+		// the mesh cache with the precision of the format.
 		const std::vector<Vertex>& GetVertices() const { return _vertices; }
-		const size_t& GetVerticesSize() const { return _vertices.size(); }
+		size_t GetVerticesSize() const { return _vertexCount; }
 		const std::vector<uint32_t>& GetIndices() const { return _indices; }
-		const size_t& GetIndicesSize() const { return _indices.size(); }
+		// every LOD level included
+		size_t GetIndicesSize() const { return _indexCount; }
+		const std::vector<MeshLod>& GetLods() const { return _lods; }
+		const MeshLod& GetLod(uint32_t lod) const { return _lods[lod]; }
+		// every LOD level included, MeshLod::firstMeshlet selects the ones of a level
+		const std::vector<Meshlet>& GetMeshlets() const { return _meshlets; }
+		const MeshletBounds& GetMeshletBounds() const { return _meshletBounds; }
+
+		const glm::vec3& GetBoundsMin() const { return _boundsMin; }
+		const glm::vec3& GetBoundsMax() const { return _boundsMax; }
+		// vertex cache efficiency of the index buffer as imported and after the optimization pass
+		const VertexCacheStats& GetCacheStatsBefore() const { return _cacheStatsBefore; }
+		const VertexCacheStats& GetCacheStatsAfter() const { return _cacheStatsAfter; }
+
+		const VertexFormat& GetVertexFormat() const { return _vertexFormat; }
+		// Maps the stored positions back into object space, identity unless positions are quantized
+		const glm::mat4& GetDequantizationMatrix() const { return _dequantizationMatrix; }
+		// 16 bit whenever every vertex is addressable with it
+		VkIndexType GetIndexType() const { return _indexType; }
+		VkDeviceSize GetStreamOffset(uint32_t stream) const { return _streamOffsets[stream]; }
 
 		Engine::Buffer* GetDataBuffer() { return _dataBuffer; }
 
+		// false while the mesh is queued, importing or unloaded
+		bool IsResident() const { return _bResident; }
+		bool IsLoadPending() const { return _load.valid(); }
+		bool IsCpuCopyPinned() const { return _bCpuCopyPinned; }
+		// bytes of the CPU copies
+		uint64_t GetCpuMemorySize() const;
+		// bytes of device memory behind the buffer, 0 while not resident
+		uint64_t GetMemorySize() const;
+
 #pragma endregion
 
 	private:
-		void InitializeBuffer();
+		static void ImportObj(const std::string& file, const WeldSettings& weldSettings, Engine::ThreadPool* threadPool, DecodedMesh& decoded);
+		static void ComputeBounds(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsMax);
+		void ComputeBounds();
+		void ComputeDequantizationMatrix();
+		void InitializeBuffer(const MeshDataView& data);
+		void InitializeBuffer(const MeshStreamSource& source);
+		// Takes over the arrays of the import and uploads them
+		void CompleteLoading(DecodedMesh& decoded);
+		// Main thread: the CPU copies of a resident mesh, unpacked from the mesh cache when they were dropped
+		void ReadCpuCopy();
 
 	private:
 		std::vector<Vertex> _vertices;
 		std::vector<uint32_t> _indices;
+		size_t _vertexCount = 0;
+		size_t _indexCount = 0;
+		std::vector<MeshLod> _lods;
+		std::vector<Meshlet> _meshlets;
+		MeshletBounds _meshletBounds;
+
+		glm::vec3 _boundsMin = glm::vec3(0.0f);
+		glm::vec3 _boundsMax = glm::vec3(0.0f);
+		VertexCacheStats _cacheStatsBefore;
+		VertexCacheStats _cacheStatsAfter;
+
+		VertexFormat _vertexFormat;
+		glm::mat4 _dequantizationMatrix = glm::mat4(1.0f);
+		VkIndexType _indexType = VK_INDEX_TYPE_UINT32;
+		std::array<VkDeviceSize, MAX_VERTEX_STREAMS> _streamOffsets{};
+
+		Engine::Buffer* _dataBuffer = nullptr;
 
-		Engine::Buffer* _dataBuffer;
+		bool _bResident = true;
+		bool _bCpuCopyPinned = false;
+		// what the import needs, kept to load the mesh again after it was unloaded. Empty for meshes not loaded from a file.
+		std::string _file;
+		MeshImportSettings _settings;
+		// valid from StartLoading until the import has been uploaded
+		std::future<DecodedMesh> _load;
+		float _requestedDistance = std::numeric_limits<float>::max();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "pch.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uint64_t HashFnv1a(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+Resource::MeshCache::MeshCache()
+{
+	_file = new Engine::MappedFile();
+}
+
+Resource::MeshCache::~MeshCache()
+{
+	delete _file;
+}
+
+bool Resource::MeshCache::Open(const char* sourceFile, uint64_t settingsKey)
+{
+	if (!_file->Open(GetCachePath(sourceFile, settingsKey)))
+		return false;
+
+	_header = reinterpret_cast<const MeshCacheHeader*>(_file->GetData());
+	if (!IsValid() || _header->settingsKey != settingsKey)
+	{
+		_file->Close();
+		_header = nullptr;
+		return false;
+	}
+
+	if (IsSourceCurrent(sourceFile, _header->source))
+		return true;
+
+	_file->Close();
+	_header = nullptr;
+	return false;
+}
+
+void Resource::MeshCache::Write(const char* sourceFile, uint64_t settingsKey, const MeshDataView& data, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const VertexCacheStats& cacheStatsBefore, const VertexCacheStats& cacheStatsAfter)
+{
+	MeshCacheHeader header{};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.settingsKey = settingsKey;
+	if (!GetSourceStamp(sourceFile, header.source, true))
+		return;
+
+	header.vertexFormat = data.format.GetKey();
+	header.indexSize = data.indexSize;
+	header.vertexCount = data.vertexCount;
+	header.indexCount = data.indexCount;
+	uint64_t offset = AlignUp(sizeof(MeshCacheHeader), MESH_CACHE_ALIGNMENT);
+	for (uint32_t stream = 0; stream < data.format.GetStreamCount(); stream++)
+	{
+		header.streamOffsets[stream] = offset;
+		offset = AlignUp(offset + data.GetStreamSize(stream), MESH_CACHE_ALIGNMENT);
+	}
+	header.indexOffset = offset;
+	header.meshletCount = data.meshletCount;
+	header.meshletOffset = AlignUp(offset + data.GetIndexDataSize(), MESH_CACHE_ALIGNMENT);
+	header.lodCount = data.lodCount;
+	for (uint32_t lod = 0; lod < data.lodCount; lod++)
+		header.lods[lod] = data.lods[lod];
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = boundsMin[i];
+		header.boundsMax[i] = boundsMax[i];
+	}
+	header.cacheStatsBefore = cacheStatsBefore;
+	header.cacheStatsAfter = cacheStatsAfter;
+
+	uint64_t fileSize = header.meshletOffset + data.meshletCount * sizeof(Meshlet);
+	std::vector<char> fileData(static_cast<size_t>(fileSize), 0);
+	memcpy(fileData.data(), &header, sizeof(header));
+	for (uint32_t stream = 0; stream < data.format.GetStreamCount(); stream++)
+		memcpy(fileData.data() + header.streamOffsets[stream], data.streams[stream], data.GetStreamSize(stream));
+	memcpy(fileData.data() + header.indexOffset, data.indices, data.GetIndexDataSize());
+	if (data.meshletCount > 0)
+		memcpy(fileData.data() + header.meshletOffset, data.meshlets, data.meshletCount * sizeof(Meshlet));
+
+	// Write to a temporary file first so a crash never leaves a truncated cache behind. Workers importing the same
+	// mesh may write its cache at the same time, each one gets a temporary file of its own and the last rename wins.
+	static std::atomic<uint32_t> s_writeCount{ 0 };
+	std::string cachePath = GetCachePath(sourceFile, settingsKey);
+	std::ostringstream tempName;
+	tempName << cachePath << "." << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id()) << "-" << s_writeCount++ << ".tmp";
+	std::string tempPath = tempName.str();
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return;
+		file.write(fileData.data(), fileData.size());
+		if (!file.good())
+			return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+		std::filesystem::remove(tempPath, error);
+}
+
+std::string Resource::MeshCache::GetCachePath(const char* sourceFile, uint64_t settingsKey)
+{
+	std::ostringstream path;
+	path << sourceFile << "." << std::hex << settingsKey << ".vmesh";
+	return path.str();
+}
+
+bool Resource::MeshCache::IsValid()
+{
+	if (_file->GetSize() < sizeof(MeshCacheHeader))
+		return false;
+
+	if (_header->magic != MESH_CACHE_MAGIC || _header->version != MESH_CACHE_VERSION)
+		return false;
+
+	if (!VertexFormat::FromKey(_header->vertexFormat, _vertexFormat))
+		return false;
+
+	if (_header->indexSize != sizeof(uint16_t) && _header->indexSize != sizeof(uint32_t))
+		return false;
+
+	// the arrays must be aligned and lie completely inside the file
+	uint64_t fileSize = _file->GetSize();
+	auto isInside = [fileSize](uint64_t offset, uint64_t size)
+	{
+		return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+	};
+
+	// every element is at least a byte, this also keeps the size computations from overflowing
+	if (_header->vertexCount > fileSize || _header->indexCount > fileSize || _header->meshletCount > fileSize)
+		return false;
+
+	MeshDataView data = GetDataView();
+	for (uint32_t stream = 0; stream < _vertexFormat.GetStreamCount(); stream++)
+	{
+		if (!isInside(_header->streamOffsets[stream], data.GetStreamSize(stream)))
+			return false;
+	}
+	if (!isInside(_header->indexOffset, data.GetIndexDataSize()))
+		return false;
+	if (!isInside(_header->meshletOffset, _header->meshletCount * sizeof(Meshlet)))
+		return false;
+	for (uint64_t i = 0; i < _header->meshletCount; i++)
+	{
+		const Meshlet& meshlet = data.meshlets[i];
+		if (meshlet.firstIndex > _header->indexCount || meshlet.indexCount > _header->indexCount - meshlet.firstIndex)
+			return false;
+	}
+
+	if (_header->lodCount == 0 || _header->lodCount > MAX_MESH_LODS)
+		return false;
+	for (uint32_t lod = 0; lod < _header->lodCount; lod++)
+	{
+		const MeshLod& range = _header->lods[lod];
+		if (range.indexCount == 0 || range.firstIndex > _header->indexCount || range.indexCount > _header->indexCount - range.firstIndex)
+			return false;
+		if (range.firstMeshlet > _header->meshletCount || range.meshletCount > _header->meshletCount - range.firstMeshlet)
+			return false;
+	}
+
+	return _header->vertexCount > 0 && _header->indexCount > 0;
+}
+
+bool Resource::MeshCache::IsSourceCurrent(const char* sourceFile, const MeshSourceStamp& cachedStamp)
+{
+	// A shipped cache without its source is used as is
+	MeshSourceStamp stamp;
+	if (!GetSourceStamp(sourceFile, stamp, false))
+		return true;
+
+	if (stamp.timestamp == cachedStamp.timestamp && stamp.size == cachedStamp.size)
+		return true;
+
+	// The timestamp changed (copy, checkout, touch), only the contents decide
+	return stamp.size == cachedStamp.size && GetSourceStamp(sourceFile, stamp, true) && stamp.hash == cachedStamp.hash;
+}
+
+bool Resource::MeshCache::GetSourceStamp(const char* sourceFile, MeshSourceStamp& stamp, bool bHash)
+{
+	std::error_code error;
+	std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(sourceFile, error);
+	if (error)
+		return false;
+
+	stamp.timestamp = static_cast<uint64_t>(writeTime.time_since_epoch().count());
+	stamp.size = static_cast<uint64_t>(std::filesystem::file_size(sourceFile, error));
+	if (error)
+		return false;
+
+	if (bHash)
+	{
+		Engine::MappedFile source;
+		if (!source.Open(sourceFile))
+			return false;
+		stamp.hash = HashFnv1a(source.GetData(), source.GetSize());
+	}
+
+	return true;
+}
+
+Resource::MeshDataView Resource::MeshCache::GetDataView() const
+{
+	MeshDataView data;
+	data.format = _vertexFormat;
+	data.vertexCount = _header->vertexCount;
+	data.indexCount = _header->indexCount;
+	data.indexSize = _header->indexSize;
+	for (uint32_t stream = 0; stream < _vertexFormat.GetStreamCount(); stream++)
+		data.streams[stream] = _file->GetData() + _header->streamOffsets[stream];
+	data.indices = _file->GetData() + _header->indexOffset;
+	data.lods = _header->lods;
+	data.lodCount = _header->lodCount;
+	data.meshlets = reinterpret_cast<const Meshlet*>(_file->GetData() + _header->meshletOffset);
+	data.meshletCount = _header->meshletCount;
+	return data;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <string>
+
+#include "Vertex.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+
+namespace Engine
+{
+	class MappedFile;
+}
+
+namespace Resource
+{
+	// Binary mesh cache (.vmesh) written next to the source model, one per set of import settings.
+	// Layout: header | vertex stream arrays | index array | meshlet array, every array starts on MESH_CACHE_ALIGNMENT
+	// and is stored in its GPU format so it can be copied into a staging buffer as is.
+	const uint32_t MESH_CACHE_MAGIC = 0x48534D56; // "VMSH"
+	// bump whenever the layout of the header, Vertex or the arrays changes
+	const uint32_t MESH_CACHE_VERSION = 8;
+	const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+	// Identifies the source the cache was built from
+	struct MeshSourceStamp
+	{
+		uint64_t timestamp = 0;
+		uint64_t size = 0;
+		// FNV-1a over the file contents, only computed when the timestamp does not match
+		uint64_t hash = 0;
+	};
+
+	struct MeshCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		MeshSourceStamp source;
+		// import settings the arrays were built with
+		uint64_t settingsKey;
+
+		// VertexFormat::GetKey of the stored vertex streams
+		uint32_t vertexFormat;
+		// 2 or 4 bytes
+		uint32_t indexSize;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		// byte offsets from the start of the file, streams the format does not use are 0
+		uint64_t streamOffsets[MAX_VERTEX_STREAMS];
+		uint64_t indexOffset;
+		uint64_t meshletCount;
+		uint64_t meshletOffset;
+
+		// index ranges of the LOD chain, lods[0] is the base mesh
+		uint32_t lodCount;
+		MeshLod lods[MAX_MESH_LODS];
+
+		// plain floats so the header layout does not depend on glm alignment settings
+		float boundsMin[3];
+		float boundsMax[3];
+
+		// vertex cache efficiency before and after the import optimization, for reporting only
+		VertexCacheStats cacheStatsBefore;
+		VertexCacheStats cacheStatsAfter;
+	};
+
+	// GPU ready arrays of a mesh, pointing either into a cache mapping or into freshly packed arrays
+	struct MeshDataView
+	{
+		VertexFormat format;
+		uint64_t vertexCount = 0;
+		uint64_t indexCount = 0;
+		uint32_t indexSize = sizeof(uint32_t);
+		std::array<const void*, MAX_VERTEX_STREAMS> streams{};
+		const void* indices = nullptr;
+		const MeshLod* lods = nullptr;
+		uint32_t lodCount = 0;
+		const Meshlet* meshlets = nullptr;
+		uint64_t meshletCount = 0;
+
+		uint64_t GetStreamSize(uint32_t stream) const { return vertexCount * format.GetStride(stream); }
+		uint64_t GetIndexDataSize() const { return indexCount * indexSize; }
+	};
+
+	// Read only view of a mapped .vmesh file, the arrays point into the mapping
+	class MeshCache
+	{
+	public:
+		MeshCache();
+		~MeshCache();
+
+		// Maps the cache of the source file. Returns false when the cache is missing, corrupt,
+		// from another format version or built from a different source or with different import settings.
+		bool Open(const char* sourceFile, uint64_t settingsKey);
+
+		// Writes the cache of the source file, failures are ignored since the cache is only an optimization
+		static void Write(const char* sourceFile, uint64_t settingsKey, const MeshDataView& data, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const VertexCacheStats& cacheStatsBefore, const VertexCacheStats& cacheStatsAfter);
+
+		// <source>.<settings key>.vmesh, so loads of one file with different settings keep a cache each
+		static std::string GetCachePath(const char* sourceFile, uint64_t settingsKey);
+
+		// Shared with the texture cache, which stamps its files the same way
+		static bool GetSourceStamp(const char* sourceFile, MeshSourceStamp& stamp, bool bHash);
+		// True when the source still matches the stamp or is missing
+		static bool IsSourceCurrent(const char* sourceFile, const MeshSourceStamp& cachedStamp);
+
+	private:
+		// also decodes the vertex format of the header
+		bool IsValid();
+
+	public:
+#pragma region Getters
+
+		const MeshCacheHeader& GetHeader() const { return *_header; }
+		glm::vec3 GetBoundsMin() const { return glm::vec3(_header->boundsMin[0], _header->boundsMin[1], _header->boundsMin[2]); }
+		glm::vec3 GetBoundsMax() const { return glm::vec3(_header->boundsMax[0], _header->boundsMax[1], _header->boundsMax[2]); }
+		const VertexFormat& GetVertexFormat() const { return _vertexFormat; }
+		MeshDataView GetDataView() const;
+
+#pragma endregion
+
+	private:
+		Engine::MappedFile* _file;
+		const MeshCacheHeader* _header = nullptr;
+		VertexFormat _vertexFormat;
+	};
+}
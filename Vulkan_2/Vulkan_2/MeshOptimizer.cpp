@@ -0,0 +1,326 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+	// FIFO cache model: a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since it was loaded
+	class VertexCacheSimulator
+	{
+	public:
+		VertexCacheSimulator(size_t vertexCount)
+			: _timestamps(vertexCount, 0)
+			, _time(Resource::VERTEX_CACHE_SIZE + 1)
+		{
+		}
+
+		// returns true on a cache miss
+		bool Access(uint32_t vertex)
+		{
+			if (_time - _timestamps[vertex] > Resource::VERTEX_CACHE_SIZE)
+			{
+				_timestamps[vertex] = _time++;
+				return true;
+			}
+			return false;
+		}
+
+		void Reset()
+		{
+			// everything loaded so far falls out of the window
+			_time += Resource::VERTEX_CACHE_SIZE + 1;
+		}
+
+	private:
+		std::vector<uint32_t> _timestamps;
+		uint32_t _time;
+	};
+
+	struct Adjacency
+	{
+		// triangles using vertex v: triangles[offsets[v] .. offsets[v] + counts[v])
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	Adjacency BuildAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		Adjacency adjacency;
+		adjacency.counts.assign(vertexCount, 0);
+		adjacency.offsets.assign(vertexCount, 0);
+		adjacency.triangles.resize(indices.size());
+
+		for (uint32_t index : indices)
+			adjacency.counts[index]++;
+
+		uint32_t offset = 0;
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			adjacency.offsets[v] = offset;
+			offset += adjacency.counts[v];
+		}
+
+		std::vector<uint32_t> fill = adjacency.offsets;
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		return adjacency;
+	}
+
+	// Next fanning vertex: the candidate that stays in the cache the longest after emitting its remaining triangles
+	int64_t GetNextVertex(const std::vector<uint32_t>& candidates, const std::vector<uint32_t>& cacheTimes, uint32_t time,
+		const std::vector<uint32_t>& liveTriangles, std::vector<uint32_t>& deadEnds, size_t& cursor)
+	{
+		int64_t best = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (time - cacheTimes[vertex] + 2 * liveTriangles[vertex] <= Resource::VERTEX_CACHE_SIZE)
+				priority = time - cacheTimes[vertex];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				best = vertex;
+			}
+		}
+
+		if (best != -1)
+			return best;
+
+		// Dead end: most recently used vertex that still has triangles, then the input order
+		while (!deadEnds.empty())
+		{
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0)
+				return vertex;
+		}
+
+		while (cursor < liveTriangles.size())
+		{
+			if (liveTriangles[cursor] > 0)
+				return static_cast<int64_t>(cursor);
+			cursor++;
+		}
+
+		return -1;
+	}
+
+	struct Cluster
+	{
+		size_t firstIndex;
+		size_t indexCount;
+		float sortKey;
+	};
+
+	// Starts of the runs the cache optimizer emitted: a triangle missing all three vertices begins a new patch
+	std::vector<size_t> FindHardBoundaries(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		std::vector<size_t> boundaries;
+		VertexCacheSimulator cache(vertexCount);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			int misses = cache.Access(indices[i + 0]) + cache.Access(indices[i + 1]) + cache.Access(indices[i + 2]);
+			if (i == 0 || misses == 3)
+				boundaries.push_back(i);
+		}
+		return boundaries;
+	}
+
+	// Splits hard clusters further wherever the ACMR of the piece so far stays within threshold of the whole cluster
+	std::vector<size_t> FindSoftBoundaries(const std::vector<uint32_t>& indices, size_t vertexCount,
+		const std::vector<size_t>& hardBoundaries, float threshold)
+	{
+		std::vector<size_t> boundaries;
+		VertexCacheSimulator cache(vertexCount);
+
+		for (size_t c = 0; c < hardBoundaries.size(); c++)
+		{
+			size_t start = hardBoundaries[c];
+			size_t end = c + 1 < hardBoundaries.size() ? hardBoundaries[c + 1] : indices.size();
+
+			cache.Reset();
+			size_t clusterMisses = 0;
+			for (size_t i = start; i < end; i++)
+				clusterMisses += cache.Access(indices[i]);
+			float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>((end - start) / 3);
+
+			boundaries.push_back(start);
+
+			cache.Reset();
+			size_t misses = 0;
+			size_t triangles = 0;
+			for (size_t i = start; i < end; i += 3)
+			{
+				misses += cache.Access(indices[i + 0]) + cache.Access(indices[i + 1]) + cache.Access(indices[i + 2]);
+				triangles++;
+
+				if (i + 3 < end && static_cast<float>(misses) / triangles <= clusterThreshold)
+				{
+					boundaries.push_back(i + 3);
+					cache.Reset();
+					misses = 0;
+					triangles = 0;
+				}
+			}
+		}
+
+		return boundaries;
+	}
+}
+
+void Resource::MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float overdrawThreshold)
+{
+	OptimizeVertexCache(indices, vertices.size());
+	if (overdrawThreshold > 0.0f)
+		OptimizeOverdraw(indices, vertices, overdrawThreshold);
+	OptimizeVertexFetch(vertices, indices);
+}
+
+void Resource::MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	Adjacency adjacency = BuildAdjacency(indices, vertexCount);
+
+	std::vector<uint32_t> liveTriangles = adjacency.counts;
+	std::vector<uint32_t> cacheTimes(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+	size_t cursor = 0;
+	int64_t fanningVertex = GetNextVertex(candidates, cacheTimes, time, liveTriangles, deadEnds, cursor);
+
+	while (fanningVertex >= 0)
+	{
+		candidates.clear();
+
+		uint32_t first = adjacency.offsets[fanningVertex];
+		uint32_t last = first + adjacency.counts[fanningVertex];
+		for (uint32_t t = first; t < last; t++)
+		{
+			uint32_t triangle = adjacency.triangles[t];
+			if (emitted[triangle])
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+
+				if (time - cacheTimes[vertex] > VERTEX_CACHE_SIZE)
+					cacheTimes[vertex] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		fanningVertex = GetNextVertex(candidates, cacheTimes, time, liveTriangles, deadEnds, cursor);
+	}
+
+	indices = std::move(result);
+}
+
+void Resource::MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	std::vector<size_t> hardBoundaries = FindHardBoundaries(indices, vertices.size());
+	std::vector<size_t> boundaries = FindSoftBoundaries(indices, vertices.size(), hardBoundaries, threshold);
+
+	glm::vec3 meshCentroid(0.0f);
+	for (uint32_t index : indices)
+		meshCentroid += vertices[index].pos;
+	meshCentroid = meshCentroid / static_cast<float>(indices.size());
+
+	std::vector<Cluster> clusters(boundaries.size());
+	for (size_t c = 0; c < boundaries.size(); c++)
+	{
+		Cluster& cluster = clusters[c];
+		cluster.firstIndex = boundaries[c];
+		cluster.indexCount = (c + 1 < boundaries.size() ? boundaries[c + 1] : indices.size()) - cluster.firstIndex;
+
+		// area weighted normal and centroid
+		glm::vec3 normal(0.0f);
+		glm::vec3 centroid(0.0f);
+		float area = 0.0f;
+		for (size_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i += 3)
+		{
+			const glm::vec3& p0 = vertices[indices[i + 0]].pos;
+			const glm::vec3& p1 = vertices[indices[i + 1]].pos;
+			const glm::vec3& p2 = vertices[indices[i + 2]].pos;
+
+			glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(triangleNormal);
+
+			normal += triangleNormal;
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			area += triangleArea;
+		}
+
+		float normalLength = glm::length(normal);
+		normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f);
+		centroid = area > 0.0f ? centroid / area : meshCentroid;
+
+		// clusters on the outside facing away from the center occlude the rest, draw them first
+		cluster.sortKey = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (const Cluster& cluster : clusters)
+		result.insert(result.end(), indices.begin() + cluster.firstIndex, indices.begin() + cluster.firstIndex + cluster.indexCount);
+
+	indices = std::move(result);
+}
+
+void Resource::MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const uint32_t UNUSED = UINT32_MAX;
+	std::vector<uint32_t> remap(vertices.size(), UNUSED);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UNUSED)
+		{
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	// vertices no triangle references are dropped
+	vertices = std::move(result);
+}
+
+Resource::VertexCacheStats Resource::MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || vertexCount == 0)
+		return stats;
+
+	VertexCacheSimulator cache(vertexCount);
+	size_t misses = 0;
+	for (uint32_t index : indices)
+		misses += cache.Access(index);
+
+	stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+	stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+	return stats;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Vertex.h"
+
+namespace Resource
+{
+	// FIFO post-transform cache size the statistics and the optimization assume
+	const uint32_t VERTEX_CACHE_SIZE = 16;
+
+	struct VertexCacheStats
+	{
+		// average cache miss ratio: transformed vertices per triangle, 0.5 is the ideal for large grids, 3 the worst
+		float acmr = 0.0f;
+		// average transform to vertex ratio: transformed vertices per vertex, 1 is ideal
+		float atvr = 0.0f;
+	};
+
+	// Offline index and vertex reordering, run once at import
+	class MeshOptimizer
+	{
+	public:
+		// Tipsify triangle order, then overdraw cluster sorting and a vertex fetch remap.
+		// overdrawThreshold is the ACMR increase allowed for finer overdraw clusters (1.05 = 5%), 1 keeps the Tipsify order.
+		static void Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float overdrawThreshold);
+
+		// Reorders triangles for the post transform cache [Sander et al. 2007, Fast Triangle Reordering]
+		static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+		// Sorts the clusters of a cache optimized index buffer so triangles facing outwards are drawn first
+		static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold);
+		// Renumbers vertices in order of first use and reorders the vertex array to match
+		static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount);
+	};
+}
@@ -0,0 +1,604 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+namespace
+{
+	// position, uv and color, the attributes scaled by their weights
+	const int QUADRIC_SIZE = 8;
+	const int QUADRIC_MATRIX_SIZE = QUADRIC_SIZE * (QUADRIC_SIZE + 1) / 2;
+	// weight of the planes that hold open borders and seams in place, relative to the surface
+	const float BORDER_WEIGHT = 2.0f;
+
+	// open edge slots: no open edge, or more than one in the same direction
+	const uint32_t NO_EDGE = ~0u;
+	const uint32_t MULTIPLE_EDGES = ~0u - 1;
+
+	const float INVALID_COST = std::numeric_limits<float>::max();
+
+	typedef std::array<float, QUADRIC_SIZE> QuadricPoint;
+
+	// Generalized quadric, the symmetric matrix is stored as its upper triangle, row by row.
+	// Sums of area weighted squared distances, Evaluate divides by the weight so errors stay comparable
+	struct Quadric
+	{
+		float a[QUADRIC_MATRIX_SIZE] = {};
+		float b[QUADRIC_SIZE] = {};
+		float c = 0.0f;
+		float weight = 0.0f;
+
+		void Add(const Quadric& other)
+		{
+			for (int i = 0; i < QUADRIC_MATRIX_SIZE; i++)
+				a[i] += other.a[i];
+			for (int i = 0; i < QUADRIC_SIZE; i++)
+				b[i] += other.b[i];
+			c += other.c;
+			weight += other.weight;
+		}
+
+		float Evaluate(const QuadricPoint& v) const
+		{
+			if (weight <= 0.0f)
+				return 0.0f;
+
+			float result = c;
+			int k = 0;
+			for (int i = 0; i < QUADRIC_SIZE; i++)
+			{
+				result += 2.0f * b[i] * v[i];
+				// the diagonal once, everything above it twice
+				result += a[k++] * v[i] * v[i];
+				for (int j = i + 1; j < QUADRIC_SIZE; j++)
+					result += 2.0f * a[k++] * v[i] * v[j];
+			}
+			return std::abs(result) / weight;
+		}
+	};
+
+	float Dot(const QuadricPoint& a, const QuadricPoint& b)
+	{
+		float result = 0.0f;
+		for (int i = 0; i < QUADRIC_SIZE; i++)
+			result += a[i] * b[i];
+		return result;
+	}
+
+	// Squared distance to the plane of the triangle in position + attribute space
+	void AddTriangleQuadric(Quadric& quadric, const QuadricPoint& p0, const QuadricPoint& p1, const QuadricPoint& p2, float weight)
+	{
+		QuadricPoint e1, e2;
+		for (int i = 0; i < QUADRIC_SIZE; i++)
+		{
+			e1[i] = p1[i] - p0[i];
+			e2[i] = p2[i] - p0[i];
+		}
+
+		float length1 = std::sqrt(Dot(e1, e1));
+		if (length1 <= 1e-12f)
+			return;
+		for (float& value : e1)
+			value /= length1;
+
+		// Gram-Schmidt, e1 and e2 span the triangle
+		float projection = Dot(e2, e1);
+		for (int i = 0; i < QUADRIC_SIZE; i++)
+			e2[i] -= projection * e1[i];
+		float length2 = std::sqrt(Dot(e2, e2));
+		if (length2 <= 1e-12f)
+			return;
+		for (float& value : e2)
+			value /= length2;
+
+		float p0e1 = Dot(p0, e1);
+		float p0e2 = Dot(p0, e2);
+
+		int k = 0;
+		for (int i = 0; i < QUADRIC_SIZE; i++)
+		{
+			for (int j = i; j < QUADRIC_SIZE; j++)
+				quadric.a[k++] += weight * ((i == j ? 1.0f : 0.0f) - e1[i] * e1[j] - e2[i] * e2[j]);
+			quadric.b[i] += weight * (p0e1 * e1[i] + p0e2 * e2[i] - p0[i]);
+		}
+		quadric.c += weight * (Dot(p0, p0) - p0e1 * p0e1 - p0e2 * p0e2);
+		quadric.weight += weight;
+	}
+
+	// Squared distance to a plane, positions only
+	void AddPlaneQuadric(Quadric& quadric, const glm::vec3& normal, const glm::vec3& point, float weight)
+	{
+		float distance = glm::dot(normal, point);
+
+		int k = 0;
+		for (int i = 0; i < QUADRIC_SIZE; i++)
+		{
+			for (int j = i; j < QUADRIC_SIZE; j++)
+			{
+				if (j < 3)
+					quadric.a[k] += weight * normal[i] * normal[j];
+				k++;
+			}
+			if (i < 3)
+				quadric.b[i] -= weight * distance * normal[i];
+		}
+		quadric.c += weight * distance * distance;
+		quadric.weight += weight;
+	}
+
+	enum class VertexKind : uint8_t
+	{
+		// interior vertex, may collapse onto any neighbor
+		Manifold,
+		// on an open border, may only collapse along it
+		Border,
+		// one of the two vertices of a uv / color seam, collapses along the seam together with its twin
+		Seam,
+		// corners, non manifold geometry and unused vertices
+		Locked,
+	};
+
+	struct Corner
+	{
+		uint32_t next;
+		uint32_t prev;
+	};
+
+	struct EdgeAdjacency
+	{
+		// corners of vertex v: corners[offsets[v] .. offsets[v + 1])
+		std::vector<uint32_t> offsets;
+		// the other two vertices of every triangle the vertex is part of, in winding order
+		std::vector<Corner> corners;
+	};
+
+	void BuildEdgeAdjacency(EdgeAdjacency& adjacency, const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		adjacency.corners.resize(indices.size());
+
+		for (uint32_t index : indices)
+			adjacency.offsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t a = indices[i + 0], b = indices[i + 1], c = indices[i + 2];
+			adjacency.corners[fill[a]++] = { b, c };
+			adjacency.corners[fill[b]++] = { c, a };
+			adjacency.corners[fill[c]++] = { a, b };
+		}
+	}
+
+	// Whether the directed edge a -> b belongs to some triangle
+	bool HasEdge(const EdgeAdjacency& adjacency, uint32_t a, uint32_t b)
+	{
+		for (uint32_t i = adjacency.offsets[a]; i < adjacency.offsets[a + 1]; i++)
+		{
+			if (adjacency.corners[i].next == b)
+				return true;
+		}
+		return false;
+	}
+
+	// Links vertices sharing a position into rings: wedges[v] is the next vertex with the same position,
+	// positionIds[v] the lowest index among them
+	void BuildWedges(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& wedges, std::vector<uint32_t>& positionIds)
+	{
+		std::vector<uint32_t> order(positions.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&positions](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& pa = positions[a];
+			const glm::vec3& pb = positions[b];
+			if (pa.x != pb.x)
+				return pa.x < pb.x;
+			if (pa.y != pb.y)
+				return pa.y < pb.y;
+			if (pa.z != pb.z)
+				return pa.z < pb.z;
+			return a < b;
+		});
+
+		wedges.resize(positions.size());
+		positionIds.resize(positions.size());
+		for (size_t start = 0; start < order.size();)
+		{
+			size_t end = start + 1;
+			while (end < order.size() && positions[order[end]] == positions[order[start]])
+				end++;
+
+			for (size_t i = start; i < end; i++)
+			{
+				wedges[order[i]] = order[i + 1 < end ? i + 1 : start];
+				positionIds[order[i]] = order[start];
+			}
+			start = end;
+		}
+	}
+
+	bool IsSingleEdge(uint32_t edge)
+	{
+		return edge != NO_EDGE && edge != MULTIPLE_EDGES;
+	}
+
+	void ClassifyVertices(std::vector<VertexKind>& kinds, std::vector<uint32_t>& openOut, std::vector<uint32_t>& openIn,
+		const EdgeAdjacency& adjacency, const std::vector<uint32_t>& wedges, const std::vector<uint32_t>& positionIds)
+	{
+		size_t vertexCount = wedges.size();
+		openOut.assign(vertexCount, NO_EDGE);
+		openIn.assign(vertexCount, NO_EDGE);
+
+		// an edge is open when no triangle uses it in the opposite direction
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			for (uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; i++)
+			{
+				uint32_t target = adjacency.corners[i].next;
+				if (HasEdge(adjacency, target, v))
+					continue;
+
+				openOut[v] = openOut[v] == NO_EDGE ? target : MULTIPLE_EDGES;
+				openIn[target] = openIn[target] == NO_EDGE ? v : MULTIPLE_EDGES;
+			}
+		}
+
+		kinds.assign(vertexCount, VertexKind::Locked);
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			if (adjacency.offsets[v] == adjacency.offsets[v + 1])
+				continue;
+
+			if (wedges[v] == v)
+			{
+				if (openOut[v] == NO_EDGE && openIn[v] == NO_EDGE)
+					kinds[v] = VertexKind::Manifold;
+				else if (IsSingleEdge(openOut[v]) && IsSingleEdge(openIn[v]))
+					kinds[v] = VertexKind::Border;
+			}
+			else if (wedges[wedges[v]] == v)
+			{
+				// the two sides of the seam have to run along the same positions in opposite directions
+				uint32_t w = wedges[v];
+				if (IsSingleEdge(openOut[v]) && IsSingleEdge(openIn[v]) && IsSingleEdge(openOut[w]) && IsSingleEdge(openIn[w]) &&
+					positionIds[openOut[v]] == positionIds[openIn[w]] && positionIds[openIn[v]] == positionIds[openOut[w]])
+					kinds[v] = VertexKind::Seam;
+			}
+		}
+	}
+
+	// Open edges of collapse targets continue to where the collapsed vertex pointed
+	void RemapOpenEdges(std::vector<uint32_t>& openEdges, const std::vector<uint32_t>& remap)
+	{
+		for (uint32_t v = 0; v < openEdges.size(); v++)
+		{
+			if (!IsSingleEdge(openEdges[v]))
+				continue;
+
+			uint32_t target = openEdges[v];
+			uint32_t remapped = remap[target];
+			if (remapped == v)
+				openEdges[v] = IsSingleEdge(openEdges[target]) ? remap[openEdges[target]] : NO_EDGE;
+			else
+				openEdges[v] = remapped;
+		}
+	}
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float cost;
+	};
+
+	struct SimplifyState
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<QuadricPoint> points;
+		std::vector<Quadric> quadrics;
+		std::vector<uint32_t> wedges;
+		std::vector<uint32_t> positionIds;
+		std::vector<VertexKind> kinds;
+		std::vector<uint32_t> openOut;
+		std::vector<uint32_t> openIn;
+		EdgeAdjacency adjacency;
+	};
+
+	// The twin collapse of a seam collapse, NO_EDGE if there is none
+	uint32_t GetSeamTwinTarget(const SimplifyState& state, uint32_t from, uint32_t to)
+	{
+		uint32_t twin = state.wedges[from];
+		uint32_t twinTarget = state.openOut[from] == to ? state.openIn[twin] : state.openOut[twin];
+		if (!IsSingleEdge(twinTarget) || state.wedges[to] != twinTarget)
+			return NO_EDGE;
+		return twinTarget;
+	}
+
+	float GetCollapseCost(const SimplifyState& state, uint32_t from, uint32_t to)
+	{
+		VertexKind kind = state.kinds[from];
+		if (kind == VertexKind::Locked)
+			return INVALID_COST;
+
+		float cost = state.quadrics[from].Evaluate(state.points[to]);
+		if (kind == VertexKind::Manifold)
+			return cost;
+
+		// borders and seams only move along themselves
+		if (state.kinds[to] != kind || (state.openOut[from] != to && state.openIn[from] != to))
+			return INVALID_COST;
+
+		if (kind == VertexKind::Seam)
+		{
+			uint32_t twinTarget = GetSeamTwinTarget(state, from, to);
+			if (twinTarget == NO_EDGE)
+				return INVALID_COST;
+			cost += state.quadrics[state.wedges[from]].Evaluate(state.points[twinTarget]);
+		}
+		return cost;
+	}
+
+	// Whether moving from onto to turns any remaining triangle around
+	bool HasTriangleFlips(const SimplifyState& state, const std::vector<uint32_t>& remap, uint32_t from, uint32_t to)
+	{
+		const glm::vec3& p0 = state.positions[from];
+		const glm::vec3& p1 = state.positions[to];
+
+		for (uint32_t i = state.adjacency.offsets[from]; i < state.adjacency.offsets[from + 1]; i++)
+		{
+			uint32_t a = remap[state.adjacency.corners[i].next];
+			uint32_t b = remap[state.adjacency.corners[i].prev];
+
+			// triangles on the collapsed edge disappear
+			if (state.positionIds[a] == state.positionIds[to] || state.positionIds[b] == state.positionIds[to] || a == b)
+				continue;
+
+			glm::vec3 before = glm::cross(state.positions[a] - p0, state.positions[b] - p0);
+			glm::vec3 after = glm::cross(state.positions[a] - p1, state.positions[b] - p1);
+			if (glm::dot(before, after) <= 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	void FillQuadrics(SimplifyState& state, const std::vector<uint32_t>& indices)
+	{
+		state.quadrics.assign(state.positions.size(), Quadric());
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t triangle[3] = { indices[i + 0], indices[i + 1], indices[i + 2] };
+			const glm::vec3& p0 = state.positions[triangle[0]];
+			const glm::vec3& p1 = state.positions[triangle[1]];
+			const glm::vec3& p2 = state.positions[triangle[2]];
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float doubleArea = glm::length(normal);
+			if (doubleArea <= 0.0f)
+				continue;
+			normal /= doubleArea;
+
+			Quadric quadric;
+			AddTriangleQuadric(quadric, state.points[triangle[0]], state.points[triangle[1]], state.points[triangle[2]], 0.5f * doubleArea);
+			for (uint32_t v : triangle)
+				state.quadrics[v].Add(quadric);
+
+			// Open edges get a plane perpendicular to the triangle, otherwise borders could slide inwards for free
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t a = triangle[e];
+				uint32_t b = triangle[(e + 1) % 3];
+				if (HasEdge(state.adjacency, b, a))
+					continue;
+
+				glm::vec3 edge = state.positions[b] - state.positions[a];
+				glm::vec3 edgeNormal = glm::cross(edge, normal);
+				float length = glm::length(edgeNormal);
+				if (length <= 0.0f)
+					continue;
+
+				Quadric borderQuadric;
+				AddPlaneQuadric(borderQuadric, edgeNormal / length, state.positions[a], BORDER_WEIGHT * glm::dot(edge, edge));
+				state.quadrics[a].Add(borderQuadric);
+				state.quadrics[b].Add(borderQuadric);
+			}
+		}
+	}
+}
+
+std::vector<uint32_t> Resource::MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float targetError, const LodSettings& settings, float& error)
+{
+	error = 0.0f;
+	std::vector<uint32_t> result = indices;
+	size_t vertexCount = vertices.size();
+	if (result.size() <= targetIndexCount || vertexCount == 0)
+		return result;
+
+	// Positions are normalized to the unit cube so attribute weights and errors do not depend on the mesh scale
+	glm::vec3 boundsMin = vertices[0].pos;
+	glm::vec3 boundsMax = vertices[0].pos;
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+	glm::vec3 extent = boundsMax - boundsMin;
+	float scale = std::max(std::max(extent.x, extent.y), extent.z);
+	if (scale <= 0.0f)
+		return result;
+
+	SimplifyState state;
+	state.positions.resize(vertexCount);
+	state.points.resize(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const Vertex& vertex = vertices[v];
+		glm::vec3 position = (vertex.pos - boundsMin) / scale;
+		state.positions[v] = position;
+		state.points[v] = {
+			position.x, position.y, position.z,
+			vertex.texCoord.x * settings.texCoordWeight, vertex.texCoord.y * settings.texCoordWeight,
+			vertex.color.x * settings.colorWeight, vertex.color.y * settings.colorWeight, vertex.color.z * settings.colorWeight,
+		};
+	}
+
+	BuildWedges(state.positions, state.wedges, state.positionIds);
+	BuildEdgeAdjacency(state.adjacency, result, vertexCount);
+	ClassifyVertices(state.kinds, state.openOut, state.openIn, state.adjacency, state.wedges, state.positionIds);
+	FillQuadrics(state, result);
+
+	float errorLimit = (targetError / scale) * (targetError / scale);
+	float maxCost = 0.0f;
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> collapseLocked(vertexCount);
+	std::vector<Collapse> candidates;
+
+	while (result.size() > targetIndexCount)
+	{
+		// One candidate per edge, in the cheaper of the two directions
+		candidates.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t a = result[i + e];
+				uint32_t b = result[i + (e + 1) % 3];
+				// interior edges are seen from both triangles, only take them once
+				if (a > b && HasEdge(state.adjacency, b, a))
+					continue;
+
+				float costAB = GetCollapseCost(state, a, b);
+				float costBA = GetCollapseCost(state, b, a);
+				if (costAB == INVALID_COST && costBA == INVALID_COST)
+					continue;
+
+				if (costAB <= costBA)
+					candidates.push_back({ a, b, costAB });
+				else
+					candidates.push_back({ b, a, costBA });
+			}
+		}
+
+		if (candidates.empty())
+			break;
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b)
+		{
+			return a.cost < b.cost || (a.cost == b.cost && a.from < b.from);
+		});
+
+		// Most collapses remove two triangles. The pass stops a little past the candidates it should need,
+		// the rest is cheaper to judge after the costs were updated
+		size_t triangleGoal = (result.size() - targetIndexCount) / 3;
+		size_t edgeGoal = triangleGoal / 2 + 1;
+		float passLimit = std::min(errorLimit, candidates[std::min(candidates.size() - 1, edgeGoal + edgeGoal / 2)].cost);
+
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(collapseLocked.begin(), collapseLocked.end(), 0);
+
+		size_t collapsedTriangles = 0;
+		size_t collapseCount = 0;
+		for (const Collapse& collapse : candidates)
+		{
+			if (collapse.cost > passLimit || collapsedTriangles >= triangleGoal)
+				break;
+
+			uint32_t from = collapse.from;
+			uint32_t to = collapse.to;
+			if (collapseLocked[from] || collapseLocked[to])
+				continue;
+			if (HasTriangleFlips(state, remap, from, to))
+				continue;
+
+			bool bSeam = state.kinds[from] == VertexKind::Seam;
+			uint32_t twin = state.wedges[from];
+			uint32_t twinTarget = bSeam ? GetSeamTwinTarget(state, from, to) : NO_EDGE;
+			if (bSeam && (collapseLocked[twin] || collapseLocked[twinTarget] || HasTriangleFlips(state, remap, twin, twinTarget)))
+				continue;
+
+			remap[from] = to;
+			state.quadrics[to].Add(state.quadrics[from]);
+			collapseLocked[from] = collapseLocked[to] = 1;
+
+			if (bSeam)
+			{
+				remap[twin] = twinTarget;
+				state.quadrics[twinTarget].Add(state.quadrics[twin]);
+				collapseLocked[twin] = collapseLocked[twinTarget] = 1;
+			}
+
+			collapsedTriangles += state.kinds[from] == VertexKind::Border ? 1 : 2;
+			collapseCount++;
+			maxCost = std::max(maxCost, collapse.cost);
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Drop the triangles that collapsed, in index or in position space
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i + 0]];
+			uint32_t b = remap[result[i + 1]];
+			uint32_t c = remap[result[i + 2]];
+			if (state.positionIds[a] == state.positionIds[b] || state.positionIds[b] == state.positionIds[c] || state.positionIds[a] == state.positionIds[c])
+				continue;
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+
+		RemapOpenEdges(state.openOut, remap);
+		RemapOpenEdges(state.openIn, remap);
+		BuildEdgeAdjacency(state.adjacency, result, vertexCount);
+	}
+
+	error = std::sqrt(maxCost) * scale;
+	return result;
+}
+
+std::vector<Resource::MeshLod> Resource::MeshSimplifier::GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+	const glm::vec3& boundsMin, const glm::vec3& boundsMax, const LodSettings& settings)
+{
+	std::vector<MeshLod> lods;
+	lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+	glm::vec3 extent = boundsMax - boundsMin;
+	float maxError = settings.maxError * std::max(std::max(extent.x, extent.y), extent.z);
+	uint32_t levelCount = std::min(settings.maxLodCount, MAX_MESH_LODS - 1);
+
+	// Each level is simplified from the one above it, the errors add up
+	std::vector<uint32_t> previous(indices);
+	for (uint32_t level = 1; level <= levelCount; level++)
+	{
+		size_t targetIndexCount = static_cast<size_t>(previous.size() / 3 * settings.reduction) * 3;
+		float errorBudget = maxError - lods.back().error;
+		if (targetIndexCount < 3 || errorBudget <= 0.0f)
+			break;
+
+		float error;
+		std::vector<uint32_t> simplified = Simplify(vertices, previous, targetIndexCount, errorBudget, settings, error);
+
+		// a level that barely shrinks costs memory and buys nothing
+		if (simplified.empty() || simplified.size() * 10 > previous.size() * 9)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(simplified, vertices.size());
+
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), lods.back().error + error });
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		previous = std::move(simplified);
+	}
+
+	return lods;
+}
\ No newline at end of file
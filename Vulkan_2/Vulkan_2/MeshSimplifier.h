@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Vertex.h"
+
+namespace Resource
+{
+	// Base mesh included
+	const uint32_t MAX_MESH_LODS = 8;
+
+	struct LodSettings
+	{
+		// levels generated below the base mesh, 0 disables LOD generation
+		uint32_t maxLodCount = 4;
+		// triangle count of a level relative to the level above it
+		float reduction = 0.5f;
+		// simplification error the coarsest level may reach, relative to the largest bounds extent
+		float maxError = 0.05f;
+		// uv and color distortion relative to moving the surface: a weight of 1 makes a uv change of 1
+		// cost as much as moving a vertex by the whole mesh extent
+		float texCoordWeight = 0.5f;
+		float colorWeight = 0.1f;
+	};
+
+	// Index range of one level inside the mesh index buffer, every level uses the shared vertex array
+	struct MeshLod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		// largest deviation from the base surface, in object space units
+		float error;
+		// meshlets covering the range, 0 when the mesh has none and the level is drawn whole
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
+	};
+
+	// Quadric error edge collapse simplification [Garland and Heckbert 1998, Simplifying Surfaces with Color and Texture
+	// using Quadric Error Metrics]. Vertices are only ever collapsed onto other vertices, so simplified index buffers
+	// keep referencing the original vertex array. Open borders and uv seams only collapse along themselves, seams on both
+	// sides at once, so neither opens cracks.
+	class MeshSimplifier
+	{
+	public:
+		// Collapses edges until the index count reaches targetIndexCount or the next collapse would exceed targetError
+		// (object space units). error receives the error of the result.
+		static std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+			size_t targetIndexCount, float targetError, const LodSettings& settings, float& error);
+
+		// Simplifies the base level in the index buffer into a chain of levels appended behind it, cache optimized.
+		// Stops early once a level would no longer remove a meaningful share of the triangles.
+		static std::vector<MeshLod> GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+			const glm::vec3& boundsMin, const glm::vec3& boundsMax, const LodSettings& settings);
+	};
+}
\ No newline at end of file
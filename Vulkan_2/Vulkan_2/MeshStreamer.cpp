@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "MeshStreamer.h"
+#include "Mesh.h"
+
+#include "Application.h"
+
+#include <algorithm>
+
+Engine::MeshStreamer::MeshStreamer()
+{
+}
+
+Engine::MeshStreamer::~MeshStreamer()
+{
+}
+
+void Engine::MeshStreamer::Enqueue(Resource::Mesh* mesh)
+{
+	_queued.push_back({ mesh, std::numeric_limits<float>::max() });
+}
+
+void Engine::MeshStreamer::Remove(Resource::Mesh* mesh)
+{
+	_queued.erase(std::remove_if(_queued.begin(), _queued.end(), [mesh](const QueuedMesh& queued) { return queued.mesh == mesh; }), _queued.end());
+	_loading.erase(std::remove(_loading.begin(), _loading.end(), mesh), _loading.end());
+}
+
+void Engine::MeshStreamer::Update()
+{
+	// uploaded imports free their slot
+	_loading.erase(std::remove_if(_loading.begin(), _loading.end(), [](Resource::Mesh* mesh) { return !mesh->IsLoadPending(); }), _loading.end());
+
+	for (QueuedMesh& queued : _queued)
+		queued.distance = queued.mesh->ConsumeRequestedDistance();
+
+	if (_queued.empty() || _loading.size() >= MESH_STREAMING_MAX_LOADS)
+		return;
+
+	// nearest first, stable so meshes without a request keep their creation order
+	std::stable_sort(_queued.begin(), _queued.end(), [](const QueuedMesh& a, const QueuedMesh& b) { return a.distance < b.distance; });
+
+	size_t started = std::min(_queued.size(), static_cast<size_t>(MESH_STREAMING_MAX_LOADS) - _loading.size());
+	for (size_t i = 0; i < started; i++)
+	{
+		_queued[i].mesh->StartLoading();
+		_loading.push_back(_queued[i].mesh);
+	}
+	_queued.erase(_queued.begin(), _queued.begin() + started);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+namespace Resource
+{
+	class Mesh;
+}
+
+namespace Engine
+{
+	// Decides which meshes import on the thread pool next. Meshes loaded from a file queue up in their constructor,
+	// objects waiting for one record their distance to the camera (Mesh::RequestDistance), and once per frame Update starts
+	// the nearest queued meshes while fewer than MESH_STREAMING_MAX_LOADS imports are running. Meshes nobody asked for
+	// load last, in the order they were created. The AssetManager uploads every mesh whose import finished.
+	// Main thread only.
+	class MeshStreamer
+	{
+	public:
+		MeshStreamer();
+		~MeshStreamer();
+
+		// Called by meshes that are not resident yet
+		void Enqueue(Resource::Mesh* mesh);
+		// Called by meshes when they are destroyed or have to load right away
+		void Remove(Resource::Mesh* mesh);
+
+		// Call once per frame after the frame's objects recorded their distances
+		void Update();
+
+#pragma region Getters
+
+		size_t GetQueuedCount() const { return _queued.size(); }
+		size_t GetLoadingCount() const { return _loading.size(); }
+
+#pragma endregion
+
+	private:
+		struct QueuedMesh
+		{
+			Resource::Mesh* mesh;
+			// nearest object waiting for the mesh in the last frame
+			float distance;
+		};
+
+		std::vector<QueuedMesh> _queued;
+		// imports running on the thread pool. A mesh destroyed while importing frees its slot right away,
+		// its worker may keep running until the import is done.
+		std::vector<Resource::Mesh*> _loading;
+	};
+}
@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "Meshlet.h"
+
+#include <algorithm>
+
+// Cones wider than this (cosine of the half angle) are never back facing as a whole, skip the test for them
+static const float MIN_CONE_DOT = 0.1f;
+
+void Resource::MeshletBounds::Build(const std::vector<Meshlet>& meshlets)
+{
+	size_t paddedCount = (meshlets.size() + 3) & ~size_t(3);
+	for (std::vector<float>* values : { &centerX, &centerY, &centerZ, &radius, &coneAxisX, &coneAxisY, &coneAxisZ, &coneCutoff })
+		values->assign(paddedCount, 0.0f);
+
+	for (size_t i = 0; i < meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		centerX[i] = meshlet.center[0];
+		centerY[i] = meshlet.center[1];
+		centerZ[i] = meshlet.center[2];
+		radius[i] = meshlet.radius;
+		coneAxisX[i] = meshlet.coneAxis[0];
+		coneAxisY[i] = meshlet.coneAxis[1];
+		coneAxisZ[i] = meshlet.coneAxis[2];
+		coneCutoff[i] = meshlet.coneCutoff;
+	}
+}
+
+void Resource::MeshletBuilder::Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount,
+	std::vector<Meshlet>& meshlets)
+{
+	// last meshlet each vertex was counted for
+	std::vector<uint32_t> vertexMeshlet(vertices.size(), ~0u);
+	uint32_t meshletId = static_cast<uint32_t>(meshlets.size());
+
+	uint32_t meshletStart = firstIndex;
+	uint32_t meshletVertices = 0;
+	uint32_t end = firstIndex + indexCount;
+	for (uint32_t i = firstIndex; i < end; i += 3)
+	{
+		uint32_t newVertices = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			// corners repeating within the triangle only count once
+			uint32_t v = indices[i + corner];
+			bool bRepeated = (corner > 0 && indices[i] == v) || (corner > 1 && indices[i + 1] == v);
+			if (vertexMeshlet[v] != meshletId && !bRepeated)
+				newVertices++;
+		}
+
+		uint32_t triangleCount = (i - meshletStart) / 3;
+		if (triangleCount > 0 && (meshletVertices + newVertices > MESHLET_MAX_VERTICES || triangleCount == MESHLET_MAX_TRIANGLES))
+		{
+			meshlets.push_back(ComputeBounds(vertices, indices, meshletStart, i - meshletStart, meshletVertices));
+			meshletId++;
+			meshletStart = i;
+			meshletVertices = 0;
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = indices[i + corner];
+			if (vertexMeshlet[v] != meshletId)
+			{
+				vertexMeshlet[v] = meshletId;
+				meshletVertices++;
+			}
+		}
+	}
+
+	if (end > meshletStart)
+		meshlets.push_back(ComputeBounds(vertices, indices, meshletStart, end - meshletStart, meshletVertices));
+}
+
+Resource::Meshlet Resource::MeshletBuilder::ComputeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex,
+	uint32_t indexCount, uint32_t vertexCount)
+{
+	Meshlet meshlet{};
+	meshlet.firstIndex = firstIndex;
+	meshlet.indexCount = indexCount;
+	meshlet.vertexCount = vertexCount;
+
+	// Sphere around the box center, a little looser than the minimal one but cheap and stable
+	glm::vec3 boundsMin = vertices[indices[firstIndex]].pos;
+	glm::vec3 boundsMax = boundsMin;
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+	{
+		boundsMin = glm::min(boundsMin, vertices[indices[i]].pos);
+		boundsMax = glm::max(boundsMax, vertices[indices[i]].pos);
+	}
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+		radius = std::max(radius, glm::length(vertices[indices[i]].pos - center));
+
+	// Cone axis: average of the unit triangle normals, the widest normal decides the angle
+	std::vector<glm::vec3> normals;
+	normals.reserve(indexCount / 3);
+	glm::vec3 axis(0.0f);
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[i + 0]].pos;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+		float length = glm::length(normal);
+		if (length <= 0.0f)
+			continue;
+		normals.push_back(normal / length);
+		axis += normals.back();
+	}
+
+	float coneCutoff = 1.0f;
+	float axisLength = glm::length(axis);
+	if (axisLength > 0.0f)
+	{
+		axis /= axisLength;
+		float minDot = 1.0f;
+		for (const glm::vec3& normal : normals)
+			minDot = std::min(minDot, glm::dot(normal, axis));
+		if (minDot >= MIN_CONE_DOT)
+			coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		meshlet.center[i] = center[i];
+		meshlet.coneAxis[i] = axis[i];
+	}
+	meshlet.radius = radius;
+	meshlet.coneCutoff = coneCutoff;
+	return meshlet;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Vertex.h"
+
+namespace Resource
+{
+	// Limits of a single meshlet, sized so a meshlet also fits mesh shader workgroups
+	const uint32_t MESHLET_MAX_VERTICES = 64;
+	const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+	// A run of triangles in the index buffer with the bounds needed to cull it as a whole
+	struct Meshlet
+	{
+		// triangles: indices[firstIndex .. firstIndex + indexCount)
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t vertexCount;
+
+		// bounding sphere in object space
+		float center[3];
+		float radius;
+
+		// normal cone: every triangle normal lies within the cone around the axis.
+		// coneCutoff is the sine of the half angle, 1 for cones too wide to ever be back facing
+		float coneAxis[3];
+		float coneCutoff;
+	};
+
+	// The meshlet bounds as structure of arrays, padded to a multiple of 4 for the SIMD culling
+	struct MeshletBounds
+	{
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radius;
+		std::vector<float> coneAxisX;
+		std::vector<float> coneAxisY;
+		std::vector<float> coneAxisZ;
+		std::vector<float> coneCutoff;
+
+		void Build(const std::vector<Meshlet>& meshlets);
+	};
+
+	class MeshletBuilder
+	{
+	public:
+		// Splits indices[firstIndex .. firstIndex + indexCount) into meshlets and appends them.
+		// Meshlets are consecutive runs of the index buffer, so the cache and overdraw optimized order is kept
+		// and the index buffer itself does not change.
+		static void Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount,
+			std::vector<Meshlet>& meshlets);
+
+	private:
+		static Meshlet ComputeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex,
+			uint32_t indexCount, uint32_t vertexCount);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "MeshletCuller.h"
+
+// SSE2 is part of every x64 target, 32 bit and other targets take the scalar path
+#if defined(_M_X64) || defined(__SSE2__)
+#define MESHLET_CULLING_SSE 1
+#include <emmintrin.h>
+#else
+#define MESHLET_CULLING_SSE 0
+#endif
+
+Engine::CullView Engine::CullView::Create(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition)
+{
+	// Planes of the clip volume taken from the rows of the object to clip matrix [Gribb and Hartmann 2001],
+	// with the 0..1 depth range of Vulkan for the near plane
+	glm::mat4 m = viewProjection * model;
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+		rows[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+
+	CullView view;
+	view.planes[0] = rows[3] + rows[0];
+	view.planes[1] = rows[3] - rows[0];
+	view.planes[2] = rows[3] + rows[1];
+	view.planes[3] = rows[3] - rows[1];
+	view.planes[4] = rows[2];
+	view.planes[5] = rows[3] - rows[2];
+	for (glm::vec4& plane : view.planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	view.cameraPosition = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+	return view;
+}
+
+uint32_t Engine::MeshletCuller::Cull(const std::vector<Resource::Meshlet>& meshlets, const Resource::MeshletBounds& bounds, uint32_t firstMeshlet,
+	uint32_t meshletCount, const CullView& view, std::vector<DrawRange>& ranges)
+{
+	uint32_t visibleCount = 0;
+	uint32_t end = firstMeshlet + meshletCount;
+
+#if MESHLET_CULLING_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int plane = 0; plane < 6; plane++)
+	{
+		planeX[plane] = _mm_set1_ps(view.planes[plane].x);
+		planeY[plane] = _mm_set1_ps(view.planes[plane].y);
+		planeZ[plane] = _mm_set1_ps(view.planes[plane].z);
+		planeW[plane] = _mm_set1_ps(view.planes[plane].w);
+	}
+	__m128 cameraX = _mm_set1_ps(view.cameraPosition.x);
+	__m128 cameraY = _mm_set1_ps(view.cameraPosition.y);
+	__m128 cameraZ = _mm_set1_ps(view.cameraPosition.z);
+
+	// The bounds are padded to a multiple of 4, so a group starting on a multiple of 4 never reads past them
+	for (uint32_t group = firstMeshlet & ~3u; group < end; group += 4)
+	{
+		__m128 centerX = _mm_loadu_ps(bounds.centerX.data() + group);
+		__m128 centerY = _mm_loadu_ps(bounds.centerY.data() + group);
+		__m128 centerZ = _mm_loadu_ps(bounds.centerZ.data() + group);
+		__m128 radius = _mm_loadu_ps(bounds.radius.data() + group);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+		// frustum: the sphere must not lie completely behind any plane
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int plane = 0; plane < 6; plane++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[plane], centerX), _mm_mul_ps(planeY[plane], centerY)),
+				_mm_add_ps(_mm_mul_ps(planeZ[plane], centerZ), planeW[plane]));
+			visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, negativeRadius));
+		}
+
+		// normal cone: back facing when dot(center - camera, axis) >= cutoff * |center - camera| + radius
+		__m128 toCenterX = _mm_sub_ps(centerX, cameraX);
+		__m128 toCenterY = _mm_sub_ps(centerY, cameraY);
+		__m128 toCenterZ = _mm_sub_ps(centerZ, cameraZ);
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, toCenterX), _mm_mul_ps(toCenterY, toCenterY)),
+			_mm_mul_ps(toCenterZ, toCenterZ)));
+		__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, _mm_loadu_ps(bounds.coneAxisX.data() + group)),
+			_mm_mul_ps(toCenterY, _mm_loadu_ps(bounds.coneAxisY.data() + group))),
+			_mm_mul_ps(toCenterZ, _mm_loadu_ps(bounds.coneAxisZ.data() + group)));
+		__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(bounds.coneCutoff.data() + group), distance), radius);
+		visible = _mm_and_ps(visible, _mm_cmplt_ps(along, limit));
+
+		int mask = _mm_movemask_ps(visible);
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			uint32_t meshlet = group + lane;
+			if (meshlet < firstMeshlet || meshlet >= end || (mask & (1 << lane)) == 0)
+				continue;
+			AddRange(meshlets[meshlet], ranges);
+			visibleCount++;
+		}
+	}
+#else
+	for (uint32_t meshlet = firstMeshlet; meshlet < end; meshlet++)
+	{
+		if (!IsVisible(bounds, meshlet, view))
+			continue;
+		AddRange(meshlets[meshlet], ranges);
+		visibleCount++;
+	}
+#endif
+
+	return visibleCount;
+}
+
+bool Engine::MeshletCuller::IsVisible(const Resource::MeshletBounds& bounds, uint32_t meshlet, const CullView& view)
+{
+	glm::vec3 center(bounds.centerX[meshlet], bounds.centerY[meshlet], bounds.centerZ[meshlet]);
+	float radius = bounds.radius[meshlet];
+
+	for (const glm::vec4& plane : view.planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius)
+			return false;
+	}
+
+	glm::vec3 toCenter = center - view.cameraPosition;
+	glm::vec3 axis(bounds.coneAxisX[meshlet], bounds.coneAxisY[meshlet], bounds.coneAxisZ[meshlet]);
+	return glm::dot(toCenter, axis) < bounds.coneCutoff[meshlet] * glm::length(toCenter) + radius;
+}
+
+void Engine::MeshletCuller::AddRange(const Resource::Meshlet& meshlet, std::vector<DrawRange>& ranges)
+{
+	// meshlets are consecutive in the index buffer, so runs of visible meshlets become a single draw
+	if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexCount == meshlet.firstIndex)
+		ranges.back().indexCount += meshlet.indexCount;
+	else
+		ranges.push_back({ meshlet.firstIndex, meshlet.indexCount });
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Meshlet.h"
+
+namespace Engine
+{
+	// Index range to draw, neighbouring visible meshlets are merged into one range
+	struct DrawRange
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// View frustum and camera moved into the object space of the mesh, so meshlet bounds are tested untransformed
+	struct CullView
+	{
+		// inside: dot(plane.xyz, p) + plane.w >= 0, normalized
+		std::array<glm::vec4, 6> planes;
+		glm::vec3 cameraPosition;
+
+		static CullView Create(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+	};
+
+	// CPU cluster culling ahead of draw submission: drops meshlets outside the frustum and meshlets whose
+	// normal cone faces away from the camera, 4 meshlets at a time
+	class MeshletCuller
+	{
+	public:
+		// Tests meshlets [firstMeshlet, firstMeshlet + meshletCount) and appends the index ranges of the visible ones.
+		// Returns the number of visible meshlets.
+		static uint32_t Cull(const std::vector<Resource::Meshlet>& meshlets, const Resource::MeshletBounds& bounds, uint32_t firstMeshlet,
+			uint32_t meshletCount, const CullView& view, std::vector<DrawRange>& ranges);
+
+	private:
+		static bool IsVisible(const Resource::MeshletBounds& bounds, uint32_t meshlet, const CullView& view);
+		static void AddRange(const Resource::Meshlet& meshlet, std::vector<DrawRange>& ranges);
+	};
+}
\ No newline at end of file
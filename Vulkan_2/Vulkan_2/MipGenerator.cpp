@@ -0,0 +1,284 @@
+#include "pch.h"
+#include "MipGenerator.h"
+
+#include "Application.h"
+#include "Image.h"
+#include "Descriptors.h"
+#include "ShaderPermutation.h"
+
+namespace
+{
+	// Matches the push constant block of downsample.comp
+	struct DownsamplePushConstants
+	{
+		int32_t dstWidth;
+		int32_t dstHeight;
+		uint32_t bSrgb;
+	};
+
+	const uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+
+	VkImageMemoryBarrier GetLevelBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = baseLevel;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		return barrier;
+	}
+
+	uint32_t GetLevelSize(uint32_t size, uint32_t level)
+	{
+		return std::max(size >> level, 1u);
+	}
+}
+
+Engine::MipGenerator::MipGenerator()
+{
+}
+
+Engine::MipGenerator::~MipGenerator()
+{
+	delete _descriptorAllocator;
+	vkDestroyPipeline(Application::s_logicalDevice, _pipeline, nullptr);
+	vkDestroyPipelineLayout(Application::s_logicalDevice, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(Application::s_logicalDevice, _setLayout, nullptr);
+	delete _shader;
+}
+
+VkImageUsageFlags Engine::MipGenerator::GetRequiredUsage(VkFormat format)
+{
+	return SupportsBlit(format) ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : VK_IMAGE_USAGE_STORAGE_BIT;
+}
+
+VkImageCreateFlags Engine::MipGenerator::GetRequiredFlags(VkFormat format)
+{
+	// sRGB formats cannot be storage images, the compute path writes through a UNORM view instead
+	if (SupportsBlit(format) || format == VK_FORMAT_R8G8B8A8_UNORM)
+		return 0;
+	return VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+}
+
+void Engine::MipGenerator::Generate(Image* image)
+{
+	if (image->GetMipLevels() == 1)
+	{
+		VkCommandBuffer commandBuffer = Application::BeginSingleTimeCommands();
+		image->TransitionImageLayout(commandBuffer, image->GetImageFormat(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		Application::EndSingleTimeCommands(commandBuffer);
+		return;
+	}
+
+	if (SupportsBlit(image->GetImageFormat()))
+	{
+		VkCommandBuffer commandBuffer = Application::BeginSingleTimeCommands();
+		RecordBlits(commandBuffer, image);
+		Application::EndSingleTimeCommands(commandBuffer);
+		return;
+	}
+
+	if (image->GetImageFormat() != VK_FORMAT_R8G8B8A8_UNORM && image->GetImageFormat() != VK_FORMAT_R8G8B8A8_SRGB)
+	{
+		throw std::runtime_error("Texture format supports neither linear blits nor compute mip generation!!!");
+	}
+
+	if (_pipeline == VK_NULL_HANDLE)
+	{
+		CreateComputePipeline();
+	}
+
+	std::vector<VkImageView> levelViews(image->GetMipLevels(), VK_NULL_HANDLE);
+	for (uint32_t level = 0; level < image->GetMipLevels(); level++)
+	{
+		VkImageViewCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image = image->GetImage();
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		createInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		createInfo.subresourceRange.baseMipLevel = level;
+		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.baseArrayLayer = 0;
+		createInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(Application::s_logicalDevice, &createInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+		{
+			for (VkImageView view : levelViews)
+				vkDestroyImageView(Application::s_logicalDevice, view, nullptr);
+			throw std::runtime_error("Failed to create mip level view!!!");
+		}
+	}
+
+	VkCommandBuffer commandBuffer = Application::BeginSingleTimeCommands();
+	RecordDispatches(commandBuffer, image, levelViews);
+	Application::EndSingleTimeCommands(commandBuffer);
+
+	for (VkImageView view : levelViews)
+		vkDestroyImageView(Application::s_logicalDevice, view, nullptr);
+	_descriptorAllocator->ResetPools();
+}
+
+bool Engine::MipGenerator::SupportsBlit(VkFormat format)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(Application::s_physicalDevice, format, &properties);
+
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+void Engine::MipGenerator::RecordBlits(VkCommandBuffer commandBuffer, Image* image)
+{
+	for (uint32_t level = 1; level < image->GetMipLevels(); level++)
+	{
+		// the previous level was just written, by the upload or by the last blit
+		VkImageMemoryBarrier barrier = GetLevelBarrier(image->GetImage(), level - 1, 1,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		VkImageBlit blit{};
+		blit.srcOffsets[1] = { static_cast<int32_t>(GetLevelSize(image->GetWidth(), level - 1)), static_cast<int32_t>(GetLevelSize(image->GetHeight(), level - 1)), 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstOffsets[1] = { static_cast<int32_t>(GetLevelSize(image->GetWidth(), level)), static_cast<int32_t>(GetLevelSize(image->GetHeight(), level)), 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(commandBuffer,
+			image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		barrier = GetLevelBarrier(image->GetImage(), level - 1, 1,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+	}
+
+	// the last level is never a blit source
+	VkImageMemoryBarrier barrier = GetLevelBarrier(image->GetImage(), image->GetMipLevels() - 1, 1,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+}
+
+void Engine::MipGenerator::RecordDispatches(VkCommandBuffer commandBuffer, Image* image, const std::vector<VkImageView>& levelViews)
+{
+	VkImageMemoryBarrier barrier = GetLevelBarrier(image->GetImage(), 0, image->GetMipLevels(),
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+
+	DownsamplePushConstants pushConstants{};
+	pushConstants.bSrgb = image->GetImageFormat() == VK_FORMAT_R8G8B8A8_SRGB ? 1 : 0;
+	for (uint32_t level = 1; level < image->GetMipLevels(); level++)
+	{
+		VkDescriptorSet descriptorSet = DescriptorSetBuilder(_setLayout)
+			.BindImage(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelViews[level - 1], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL)
+			.BindImage(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelViews[level], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL)
+			.Build(_descriptorAllocator);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+		pushConstants.dstWidth = static_cast<int32_t>(GetLevelSize(image->GetWidth(), level));
+		pushConstants.dstHeight = static_cast<int32_t>(GetLevelSize(image->GetHeight(), level));
+		vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+		uint32_t groupsX = (pushConstants.dstWidth + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE;
+		uint32_t groupsY = (pushConstants.dstHeight + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE;
+		vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+		// the level is the source of the next dispatch
+		barrier = GetLevelBarrier(image->GetImage(), level, 1,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+	}
+
+	barrier = GetLevelBarrier(image->GetImage(), 0, image->GetMipLevels(),
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+}
+
+void Engine::MipGenerator::CreateComputePipeline()
+{
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(Application::s_logicalDevice, &layoutCreateInfo, nullptr, &_setLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create mip generation descriptor set layout!!!");
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DownsamplePushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &_setLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(Application::s_logicalDevice, &pipelineLayoutCreateInfo, nullptr, &_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create mip generation pipeline layout!!!");
+	}
+
+	_shader = new Shader("downsample", VK_SHADER_STAGE_COMPUTE_BIT, {});
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = _shader->GetVariant(SHADER_FEATURE_NONE)->stageCreateInfo;
+	pipelineCreateInfo.layout = _pipelineLayout;
+
+	if (vkCreateComputePipelines(Application::s_logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &_pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create mip generation pipeline!!!");
+	}
+
+	_descriptorAllocator = new DescriptorAllocator();
+	_descriptorAllocator->CreateDescriptorAllocator(16, { { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2.0f } });
+}
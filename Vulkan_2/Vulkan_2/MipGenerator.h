@@ -0,0 +1,42 @@
+#pragma once
+
+namespace Engine
+{
+	class Image;
+	class Shader;
+	class DescriptorAllocator;
+
+	// Fills the mip chain of a texture from its first level on the GPU.
+	// Formats with linear filtered blit support are downsampled with a chain of vkCmdBlitImage, any other RGBA8 format
+	// falls back to a compute shader that averages 2x2 texels per level through UNORM storage views of the image.
+	// sRGB textures are averaged in linear space on the compute path, blits already filter them that way.
+	class MipGenerator
+	{
+	public:
+		MipGenerator();
+		~MipGenerator();
+
+		// Usage and create flags a texture of the format needs on top of its own so its mips can be generated
+		static VkImageUsageFlags GetRequiredUsage(VkFormat format);
+		static VkImageCreateFlags GetRequiredFlags(VkFormat format);
+
+		// Expects every level in TRANSFER_DST_OPTIMAL with level 0 written, leaves every level in SHADER_READ_ONLY_OPTIMAL.
+		// Records and waits for its own graphics queue submission.
+		void Generate(Image* image);
+
+	private:
+		static bool SupportsBlit(VkFormat format);
+		void RecordBlits(VkCommandBuffer commandBuffer, Image* image);
+		void RecordDispatches(VkCommandBuffer commandBuffer, Image* image, const std::vector<VkImageView>& levelViews);
+		// created on first use, most devices never take the compute path
+		void CreateComputePipeline();
+
+	private:
+		Shader* _shader = nullptr;
+		VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+		VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline _pipeline = VK_NULL_HANDLE;
+		// one set per generated level, reset after every image
+		DescriptorAllocator* _descriptorAllocator = nullptr;
+	};
+}
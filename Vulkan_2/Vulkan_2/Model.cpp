@@ -0,0 +1,33 @@
+#include "pch.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "GlbImporter.h"
+#include "StagingRing.h"
+
+#include "Application.h"
+
+Resource::Model::Model(const char* file)
+{
+	try
+	{
+		GlbImporter importer;
+		importer.Import(file, _meshes, _instances);
+	}
+	catch (...)
+	{
+		// the meshes created so far may still have copies into their buffers recorded
+		Application::s_stagingRing->Flush();
+		for (Mesh* mesh : _meshes)
+			delete mesh;
+		throw;
+	}
+
+	// one wait for the whole file, the copies of every primitive overlap with the reads of the next ones
+	Application::s_stagingRing->Flush();
+}
+
+Resource::Model::~Model()
+{
+	for (Mesh* mesh : _meshes)
+		delete mesh;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+namespace Resource
+{
+	class Mesh;
+
+	// One placement of a mesh of a model
+	struct ModelInstance
+	{
+		uint32_t mesh;
+		// object space of the model, the node hierarchy already applied
+		glm::mat4 transform;
+	};
+
+	// Meshes placed by a node hierarchy, imported from a binary glTF file (see GlbImporter).
+	// The hierarchy is flattened at import, so a mesh used by several nodes is stored once and instanced.
+	class Model
+	{
+	public:
+		Model(const char* file);
+		~Model();
+
+#pragma region Getters
+
+		// one mesh per glTF primitive
+		const std::vector<Mesh*>& GetMeshes() const { return _meshes; }
+		const std::vector<ModelInstance>& GetInstances() const { return _instances; }
+
+#pragma endregion
+
+	private:
+		std::vector<Mesh*> _meshes;
+		std::vector<ModelInstance> _instances;
+	};
+}
@@ -0,0 +1,408 @@
+#include "pch.h"
+#include "ObjImporter.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <charconv>
+
+namespace
+{
+	// Work split constants, changing them does not change the output for exact welding
+	const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+	const size_t CORNERS_PER_BLOCK = 3 * 65536;
+
+	const uint32_t NO_TEXCOORD = UINT32_MAX;
+
+	// Negative OBJ indices count back from the last element defined before the face
+	const uint8_t RELATIVE_POSITION = 1 << 0;
+	const uint8_t RELATIVE_TEXCOORD = 1 << 1;
+
+	struct ParsedCorner
+	{
+		// 0 based, relative ones are local to the chunk until resolved
+		int64_t position;
+		int64_t texCoord;
+		uint8_t relativeFlags;
+	};
+
+	struct ResolvedCorner
+	{
+		uint32_t position;
+		uint32_t texCoord;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<float> positions;
+		std::vector<float> texCoords;
+		std::vector<ParsedCorner> corners;
+		// corner offsets where an o or g statement started a new shape
+		std::vector<size_t> shapeStarts;
+
+		size_t positionBase = 0;
+		size_t texCoordBase = 0;
+		size_t cornerBase = 0;
+	};
+
+	// [firstCorner, lastCorner) welded by one task
+	struct WeldBlock
+	{
+		size_t firstCorner;
+		size_t lastCorner;
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> localIndices;
+		size_t vertexBase = 0;
+	};
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpaces(const char* cursor, const char* end)
+	{
+		while (cursor < end && IsSpace(*cursor))
+			cursor++;
+		return cursor;
+	}
+
+	const char* SkipLine(const char* cursor, const char* end)
+	{
+		while (cursor < end && *cursor != '\n')
+			cursor++;
+		return cursor < end ? cursor + 1 : end;
+	}
+
+	bool ParseFloat(const char*& cursor, const char* lineEnd, float& value)
+	{
+		cursor = SkipSpaces(cursor, lineEnd);
+		// from_chars does not accept a leading plus
+		if (cursor < lineEnd && *cursor == '+')
+			cursor++;
+		std::from_chars_result result = std::from_chars(cursor, lineEnd, value);
+		if (result.ec != std::errc())
+			return false;
+		cursor = result.ptr;
+		return true;
+	}
+
+	bool ParseInt(const char*& cursor, const char* lineEnd, int64_t& value)
+	{
+		std::from_chars_result result = std::from_chars(cursor, lineEnd, value);
+		if (result.ec != std::errc())
+			return false;
+		cursor = result.ptr;
+		return true;
+	}
+
+	// OBJ index to 0 based, negative ones become chunk local and get flagged
+	bool ToZeroBased(int64_t index, size_t localCount, int64_t& zeroBased, bool& bRelative)
+	{
+		if (index > 0)
+		{
+			zeroBased = index - 1;
+			bRelative = false;
+			return true;
+		}
+		if (index < 0)
+		{
+			zeroBased = static_cast<int64_t>(localCount) + index;
+			bRelative = true;
+			return true;
+		}
+		return false;
+	}
+
+	// v, v/vt, v//vn or v/vt/vn
+	bool ParseFaceCorner(const char*& cursor, const char* lineEnd, ObjChunk& chunk, ParsedCorner& corner)
+	{
+		int64_t index;
+		bool bRelative;
+		if (!ParseInt(cursor, lineEnd, index) || !ToZeroBased(index, chunk.positions.size() / 3, corner.position, bRelative))
+			return false;
+		corner.relativeFlags = bRelative ? RELATIVE_POSITION : 0;
+		corner.texCoord = -1;
+
+		if (cursor < lineEnd && *cursor == '/')
+		{
+			cursor++;
+			if (cursor < lineEnd && *cursor != '/')
+			{
+				if (!ParseInt(cursor, lineEnd, index) || !ToZeroBased(index, chunk.texCoords.size() / 2, corner.texCoord, bRelative))
+					return false;
+				corner.relativeFlags |= bRelative ? RELATIVE_TEXCOORD : 0;
+			}
+			// normals are not imported
+			if (cursor < lineEnd && *cursor == '/')
+			{
+				cursor++;
+				if (!ParseInt(cursor, lineEnd, index))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void ParseChunk(ObjChunk& chunk, const char* file)
+	{
+		std::vector<ParsedCorner> polygon;
+
+		const char* cursor = chunk.begin;
+		while (cursor < chunk.end)
+		{
+			const char* lineStart = SkipSpaces(cursor, chunk.end);
+			const char* nextLine = SkipLine(lineStart, chunk.end);
+			const char* lineEnd = nextLine;
+			while (lineEnd > lineStart && (lineEnd[-1] == '\n' || IsSpace(lineEnd[-1])))
+				lineEnd--;
+			cursor = nextLine;
+
+			// every statement we care about is a one or two letter keyword
+			if (lineEnd - lineStart < 2 || (!IsSpace(lineStart[1]) && lineStart[1] != 't'))
+				continue;
+
+			const char* token = lineStart;
+			bool bOk = true;
+			if (token[0] == 'v' && IsSpace(token[1]))
+			{
+				const char* values = token + 2;
+				float x, y, z;
+				bOk = ParseFloat(values, lineEnd, x) && ParseFloat(values, lineEnd, y) && ParseFloat(values, lineEnd, z);
+				chunk.positions.push_back(x);
+				chunk.positions.push_back(y);
+				chunk.positions.push_back(z);
+			}
+			else if (token[0] == 'v' && token[1] == 't' && lineEnd - token > 2 && IsSpace(token[2]))
+			{
+				const char* values = token + 3;
+				float u, v = 0.0f;
+				bOk = ParseFloat(values, lineEnd, u);
+				// v is optional
+				ParseFloat(values, lineEnd, v);
+				chunk.texCoords.push_back(u);
+				chunk.texCoords.push_back(v);
+			}
+			else if (token[0] == 'f' && IsSpace(token[1]))
+			{
+				polygon.clear();
+				const char* values = SkipSpaces(token + 2, lineEnd);
+				while (bOk && values < lineEnd)
+				{
+					ParsedCorner corner;
+					bOk = ParseFaceCorner(values, lineEnd, chunk, corner);
+					polygon.push_back(corner);
+					values = SkipSpaces(values, lineEnd);
+				}
+				bOk = bOk && polygon.size() >= 3;
+
+				// fan triangulation
+				for (size_t i = 1; bOk && i + 1 < polygon.size(); i++)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i]);
+					chunk.corners.push_back(polygon[i + 1]);
+				}
+			}
+			else if ((token[0] == 'o' || token[0] == 'g') && IsSpace(token[1]))
+			{
+				chunk.shapeStarts.push_back(chunk.corners.size());
+			}
+
+			if (!bOk)
+			{
+				throw std::runtime_error("Failed to parse obj!!!   " + std::string(file) + ": " + std::string(lineStart, lineEnd));
+			}
+		}
+	}
+}
+
+Resource::ObjImporter::ObjImporter(Engine::ThreadPool* threadPool)
+	: _threadPool(threadPool)
+{
+}
+
+void Resource::ObjImporter::Import(const char* file, const WeldSettings& weldSettings, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	Engine::MappedFile mappedFile;
+	if (!mappedFile.Open(file))
+	{
+		throw std::runtime_error("Failed to load obj!!!   " + std::string(file));
+	}
+
+#pragma region Parse
+
+	// Cut at the first line break after every CHUNK_SIZE bytes
+	const char* data = reinterpret_cast<const char*>(mappedFile.GetData());
+	const char* dataEnd = data + mappedFile.GetSize();
+	std::vector<ObjChunk> chunks;
+	for (const char* chunkBegin = data; chunkBegin < dataEnd;)
+	{
+		const char* chunkEnd = chunkBegin + std::min(CHUNK_SIZE, static_cast<size_t>(dataEnd - chunkBegin));
+		chunkEnd = chunkEnd < dataEnd ? SkipLine(chunkEnd, dataEnd) : dataEnd;
+
+		ObjChunk chunk;
+		chunk.begin = chunkBegin;
+		chunk.end = chunkEnd;
+		chunks.push_back(std::move(chunk));
+		chunkBegin = chunkEnd;
+	}
+
+	ParallelFor(chunks.size(), [&chunks, file](size_t i) { ParseChunk(chunks[i], file); });
+
+#pragma endregion
+
+#pragma region Resolve indices
+
+	size_t positionCount = 0, texCoordCount = 0, cornerCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.positionBase = positionCount;
+		chunk.texCoordBase = texCoordCount;
+		chunk.cornerBase = cornerCount;
+		positionCount += chunk.positions.size() / 3;
+		texCoordCount += chunk.texCoords.size() / 2;
+		cornerCount += chunk.corners.size();
+	}
+
+	if (cornerCount == 0)
+	{
+		throw std::runtime_error("Obj has no faces!!!   " + std::string(file));
+	}
+
+	std::vector<float> positions(positionCount * 3);
+	std::vector<float> texCoords(texCoordCount * 2);
+	std::vector<ResolvedCorner> corners(cornerCount);
+
+	ParallelFor(chunks.size(), [&](size_t i)
+	{
+		const ObjChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase * 3);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.texCoordBase * 2);
+
+		for (size_t c = 0; c < chunk.corners.size(); c++)
+		{
+			const ParsedCorner& parsed = chunk.corners[c];
+			int64_t position = parsed.position + ((parsed.relativeFlags & RELATIVE_POSITION) ? static_cast<int64_t>(chunk.positionBase) : 0);
+			int64_t texCoord = parsed.texCoord + ((parsed.relativeFlags & RELATIVE_TEXCOORD) ? static_cast<int64_t>(chunk.texCoordBase) : 0);
+
+			bool bHasTexCoord = parsed.texCoord != -1 || (parsed.relativeFlags & RELATIVE_TEXCOORD);
+			if (position < 0 || position >= static_cast<int64_t>(positionCount) ||
+				(bHasTexCoord && (texCoord < 0 || texCoord >= static_cast<int64_t>(texCoordCount))))
+			{
+				throw std::runtime_error("Obj index out of range!!!   " + std::string(file));
+			}
+
+			ResolvedCorner& resolved = corners[chunk.cornerBase + c];
+			resolved.position = static_cast<uint32_t>(position);
+			resolved.texCoord = bHasTexCoord ? static_cast<uint32_t>(texCoord) : NO_TEXCOORD;
+		}
+	});
+
+#pragma endregion
+
+#pragma region Weld
+
+	// Shape boundaries in global corner offsets, blocks never cross them
+	std::vector<size_t> shapeStarts = { 0 };
+	for (const ObjChunk& chunk : chunks)
+	{
+		for (size_t start : chunk.shapeStarts)
+			shapeStarts.push_back(chunk.cornerBase + start);
+	}
+	shapeStarts.push_back(cornerCount);
+	chunks.clear();
+
+	std::vector<WeldBlock> blocks;
+	for (size_t s = 0; s + 1 < shapeStarts.size(); s++)
+	{
+		for (size_t first = shapeStarts[s]; first < shapeStarts[s + 1]; first += CORNERS_PER_BLOCK)
+		{
+			WeldBlock block;
+			block.firstCorner = first;
+			block.lastCorner = std::min(first + CORNERS_PER_BLOCK, shapeStarts[s + 1]);
+			blocks.push_back(std::move(block));
+		}
+	}
+
+	ParallelFor(blocks.size(), [&](size_t i)
+	{
+		WeldBlock& block = blocks[i];
+		size_t blockCornerCount = block.lastCorner - block.firstCorner;
+		VertexWelder welder(blockCornerCount / 4 + 1, weldSettings);
+
+		block.localIndices.resize(blockCornerCount);
+		for (size_t c = 0; c < blockCornerCount; c++)
+		{
+			const ResolvedCorner& corner = corners[block.firstCorner + c];
+
+			Vertex vertex{};
+			vertex.pos = {
+				positions[3 * corner.position + 0],
+				positions[3 * corner.position + 1],
+				positions[3 * corner.position + 2],
+			};
+			if (corner.texCoord != NO_TEXCOORD)
+			{
+				vertex.texCoord = {
+					texCoords[2 * corner.texCoord + 0],
+					1.0f - texCoords[2 * corner.texCoord + 1],
+				};
+			}
+			vertex.color = { 1.0f, 1.0f, 1.0f };
+
+			block.localIndices[c] = welder.Insert(vertex);
+		}
+		block.vertices = std::move(welder.GetVertices());
+	});
+
+	if (blocks.size() == 1)
+	{
+		vertices = std::move(blocks[0].vertices);
+		indices = std::move(blocks[0].localIndices);
+		return;
+	}
+
+	// Merge: welding the block vertices in block order assigns every vertex the index of its first
+	// occurrence across all corners, the same result a single welder over every corner gives
+	size_t blockVertexCount = 0;
+	for (WeldBlock& block : blocks)
+	{
+		block.vertexBase = blockVertexCount;
+		blockVertexCount += block.vertices.size();
+	}
+
+	VertexWelder mergeWelder(blockVertexCount, weldSettings);
+	std::vector<uint32_t> remap(blockVertexCount);
+	for (const WeldBlock& block : blocks)
+	{
+		for (size_t v = 0; v < block.vertices.size(); v++)
+			remap[block.vertexBase + v] = mergeWelder.Insert(block.vertices[v]);
+	}
+
+	indices.resize(cornerCount);
+	ParallelFor(blocks.size(), [&](size_t i)
+	{
+		const WeldBlock& block = blocks[i];
+		for (size_t c = 0; c < block.localIndices.size(); c++)
+			indices[block.firstCorner + c] = remap[block.vertexBase + block.localIndices[c]];
+	});
+
+	vertices = std::move(mergeWelder.GetVertices());
+
+#pragma endregion
+}
+
+void Resource::ObjImporter::ParallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+	if (_threadPool != nullptr)
+	{
+		_threadPool->ParallelFor(count, task);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		task(i);
+}
@@ -2,7 +2,13 @@
 #include "Object.h"
 #include "Transform.h"
 #include "Mesh.h"
+#include "SkinnedMesh.h"
+#include "SkinningPass.h"
 #include "Material.h"
+#include "Application.h"
+
+#include <algorithm>
+#include <limits>
 
 Object::Object()
 {
@@ -11,17 +17,88 @@ Object::Object()
 
 Object::~Object()
 {
+	if (_skin != nullptr)
+		Application::s_skinningPass->DestroyInstance(_skin);
 	delete _transform;
-	delete _mesh;
-	delete _material;
 }
 
 void Object::AddMesh(const char* file)
 {
-	_mesh = new Resource::Mesh(file);
+	_mesh = Application::s_assetManager->LoadMesh(file);
 }
 
 void Object::AddMaterial(const char* file)
 {
-	_material = new Resource::Material(file);
+	_material = Application::s_assetManager->LoadMaterial(file);
+}
+
+void Object::AddSkinnedMesh(const char* file)
+{
+	Engine::AssetHandle<Resource::SkinnedMesh> skinnedMesh = Application::s_assetManager->LoadSkinnedMesh(file);
+	// frames in flight may still draw the previous skin, the pass releases it once they are done
+	if (_skin != nullptr)
+		Application::s_skinningPass->DestroyInstance(_skin);
+
+	_skinnedMesh = std::move(skinnedMesh);
+	_skin = Application::s_skinningPass->CreateInstance(_skinnedMesh.Get());
+}
+
+void Object::SetMeshPinned(bool bPinned)
+{
+	_mesh.SetPinned(bPinned);
+}
+
+void Object::UpdateAnimation(float time)
+{
+	if (_skin != nullptr)
+		_skin->sampler.Sample(time);
+}
+
+Resource::Mesh* Object::GetMesh()
+{
+	return _skinnedMesh.IsValid() ? _skinnedMesh->GetMesh() : _mesh.Get();
+}
+
+void Object::UpdateLod(const glm::vec3& cameraPosition, float projectionScale)
+{
+	// The asset manager unloads what no draw used recently
+	_mesh.MarkUsed();
+	_skinnedMesh.MarkUsed();
+	_material.MarkUsed();
+	if (_material.IsValid())
+		_material->MarkTexturesUsed();
+
+	Resource::Mesh* mesh = GetMesh();
+
+	// Until the mesh streamed in its bounds are unknown, the object's position orders the imports
+	if (!mesh->IsResident())
+	{
+		mesh->RequestDistance(glm::length(_transform->GetPosition() - cameraPosition));
+		return;
+	}
+
+	// Bounding sphere of the mesh in world space
+	glm::vec3 scale = glm::abs(_transform->GetScale());
+	float maxScale = std::max(std::max(scale.x, scale.y), scale.z);
+	glm::vec3 localCenter = (mesh->GetBoundsMin() + mesh->GetBoundsMax()) * 0.5f;
+	glm::vec3 center = glm::vec3(_transform->GetModelMatrix() * glm::vec4(localCenter, 1.0f));
+	float radius = glm::length(mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f * maxScale;
+
+	// The closest point of the sphere decides, inside it the full mesh is used
+	float distance = glm::length(center - cameraPosition) - radius;
+
+	// Texture streaming wants the texels the draw covers, the sphere's diameter on screen
+	if (_material.IsValid())
+	{
+		float pixels = distance > 0.0f ? 2.0f * radius * projectionScale / distance : std::numeric_limits<float>::max();
+		_material->RequestTextureScreenSize(pixels);
+	}
+
+	if (distance <= 0.0f)
+	{
+		_lod = 0;
+		return;
+	}
+
+	_lod = mesh->SelectLod(maxScale * projectionScale / distance, _lod);
 }
@@ -1,16 +1,18 @@
 #pragma once
-
-namespace Engine
-{
-
-}
+#include "AssetManager.h"
 
 namespace Resource
 {
 	class Mesh;
+	class SkinnedMesh;
 	class Material;
 }
 
+namespace Engine
+{
+	struct SkinInstance;
+}
+
 namespace Component
 {
 	class Transform;
@@ -22,19 +24,43 @@ public:
 	Object();
 	~Object();
 
+	// Objects using the same file share one loaded copy through the asset manager.
+	// Meshes stream in the background, the object is not drawn until its mesh is resident.
 	void AddMesh(const char* file);
 	void AddMaterial(const char* file);
+	// Draws the first skinned mesh of a binary glTF file instead of the static mesh, posed by its first animation
+	void AddSkinnedMesh(const char* file);
+
+	// Keeps the CPU copies of the mesh vertices and indices, for physics or picking (see Mesh::GetVertices)
+	void SetMeshPinned(bool bPinned);
+
+	// Poses the skin at the time in seconds, the SkinningPass writes the positions when the frame is recorded
+	void UpdateAnimation(float time);
+
+	// Picks the mesh LOD for the camera and records the texture detail the draw needs for streaming,
+	// or the distance the mesh streamer orders imports by while the mesh is loading.
+	// Marks everything the draw uses as used, which brings back resources the asset manager unloaded.
+	// projectionScale is the size of one world unit at distance 1 in pixels
+	void UpdateLod(const glm::vec3& cameraPosition, float projectionScale);
 
 #pragma region Getters
 
-	Resource::Mesh* GetMesh() { return _mesh; }
-	Resource::Material* GetMaterial() { return _material; }
+	// the index buffer and uvs of the skinned mesh when there is one, stream 0 then comes from the skin
+	Resource::Mesh* GetMesh();
+	// nullptr for static meshes
+	Engine::SkinInstance* GetSkin() { return _skin; }
+	Resource::Material* GetMaterial() { return _material.Get(); }
 	Component::Transform* GetTransform() { return _transform; }
+	uint32_t GetLod() const { return _lod; }
 
 #pragma endregion
 
 private:
-	Resource::Mesh* _mesh;
-	Resource::Material* _material;
+	Engine::AssetHandle<Resource::Mesh> _mesh;
+	Engine::AssetHandle<Resource::SkinnedMesh> _skinnedMesh;
+	Engine::SkinInstance* _skin = nullptr;
+	Engine::AssetHandle<Resource::Material> _material;
 	Component::Transform* _transform;
+	// kept between frames for the LOD hysteresis
+	uint32_t _lod = 0;
 };
\ No newline at end of file
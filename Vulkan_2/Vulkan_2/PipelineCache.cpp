@@ -0,0 +1,76 @@
+#include "pch.h"
+#include "PipelineCache.h"
+
+#include "Application.h"
+
+Engine::PipelineCache::PipelineCache()
+{
+}
+
+Engine::PipelineCache::~PipelineCache()
+{
+	vkDestroyPipelineCache(Application::s_logicalDevice, _pipelineCache, nullptr);
+}
+
+void Engine::PipelineCache::CreatePipelineCache(const char* file)
+{
+	_file = file;
+
+	std::vector<char> data;
+	try
+	{
+		data = ReadFile(_file);
+	}
+	catch (const std::exception&)
+	{
+		// no cache yet, it will be written on shutdown
+	}
+
+	if (!data.empty() && !IsCompatible(data))
+		data.clear();
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(Application::s_logicalDevice, &createInfo, nullptr, &_pipelineCache) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create pipeline cache!!!");
+}
+
+void Engine::PipelineCache::SavePipelineCache()
+{
+	size_t size = 0;
+	if (vkGetPipelineCacheData(Application::s_logicalDevice, _pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+		return;
+
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(Application::s_logicalDevice, _pipelineCache, &size, data.data()) != VK_SUCCESS)
+		return;
+
+	std::ofstream file(_file, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return;
+	file.write(data.data(), size);
+}
+
+bool Engine::PipelineCache::IsCompatible(const std::vector<char>& data)
+{
+	// VkPipelineCacheHeaderVersionOne
+	const size_t headerSize = 16 + VK_UUID_SIZE;
+	if (data.size() < headerSize)
+		return false;
+
+	uint32_t headerLength, headerVersion, vendorID, deviceID;
+	memcpy(&headerLength, data.data() + 0, sizeof(uint32_t));
+	memcpy(&headerVersion, data.data() + 4, sizeof(uint32_t));
+	memcpy(&vendorID, data.data() + 8, sizeof(uint32_t));
+	memcpy(&deviceID, data.data() + 12, sizeof(uint32_t));
+
+	const VkPhysicalDeviceProperties& properties = Application::s_physicalDeviceProperties;
+	return headerLength >= headerSize
+		&& headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& vendorID == properties.vendorID
+		&& deviceID == properties.deviceID
+		&& memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
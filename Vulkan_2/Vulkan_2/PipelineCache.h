@@ -0,0 +1,30 @@
+#pragma once
+
+namespace Engine
+{
+	// VkPipelineCache persisted to disk, shared by every pipeline (and every pipeline variant)
+	class PipelineCache
+	{
+	public:
+		PipelineCache();
+		~PipelineCache();
+
+		// Loads the cache blob from the file if it was written by the same device and driver
+		void CreatePipelineCache(const char* file);
+		void SavePipelineCache();
+
+	private:
+		bool IsCompatible(const std::vector<char>& data);
+
+	public:
+#pragma region Getters
+
+		VkPipelineCache& Get() { return _pipelineCache; }
+
+#pragma endregion
+
+	private:
+		VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+		std::string _file;
+	};
+}
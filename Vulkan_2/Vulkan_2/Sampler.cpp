@@ -30,7 +30,8 @@ void Engine::Sampler::CreateSampler()
 	createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	createInfo.mipLodBias = 0.0f;
 	createInfo.minLod = 0.0f;
-	createInfo.maxLod = 0.0f;
+	// the view of every texture covers its mip chain, so the view alone bounds the sampled levels
+	createInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	if (vkCreateSampler(Application::s_logicalDevice, &createInfo, nullptr, &_sampler) != VK_SUCCESS)
 	{
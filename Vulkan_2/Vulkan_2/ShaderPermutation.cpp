@@ -0,0 +1,122 @@
+#include "pch.h"
+#include "ShaderPermutation.h"
+
+#include "Application.h"
+
+Engine::Shader::Shader(const char* name, VkShaderStageFlagBits stage, std::vector<ShaderFeature> features)
+	: _name(name)
+	, _stage(stage)
+	, _features(std::move(features))
+{
+	for (const ShaderFeature& feature : _features)
+	{
+		_declaredFeatures |= feature.bit;
+		if (feature.kind == ShaderFeatureKind::Define)
+			_defineFeatures |= feature.bit;
+	}
+}
+
+Engine::Shader::~Shader()
+{
+	for (auto& module : _modules)
+		vkDestroyShaderModule(Application::s_logicalDevice, module.second, nullptr);
+}
+
+const Engine::ShaderVariant* Engine::Shader::GetVariant(ShaderFeatureFlags features)
+{
+	features = PruneFeatures(features);
+
+	auto it = _variants.find(features);
+	if (it != _variants.end())
+		return it->second.get();
+
+	std::unique_ptr<ShaderVariant> variant = std::make_unique<ShaderVariant>();
+
+	// every declared specialization constant is always provided, so the shader defaults are never used
+	for (const ShaderFeature& feature : _features)
+	{
+		if (feature.kind != ShaderFeatureKind::SpecializationConstant)
+			continue;
+
+		VkSpecializationMapEntry mapEntry{};
+		mapEntry.constantID = feature.constantId;
+		mapEntry.offset = static_cast<uint32_t>(variant->constants.size() * sizeof(VkBool32));
+		mapEntry.size = sizeof(VkBool32);
+		variant->mapEntries.push_back(mapEntry);
+		variant->constants.push_back((features & feature.bit) ? VK_TRUE : VK_FALSE);
+	}
+
+	variant->specializationInfo.mapEntryCount = static_cast<uint32_t>(variant->mapEntries.size());
+	variant->specializationInfo.pMapEntries = variant->mapEntries.data();
+	variant->specializationInfo.dataSize = variant->constants.size() * sizeof(VkBool32);
+	variant->specializationInfo.pData = variant->constants.data();
+
+	variant->stageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	variant->stageCreateInfo.stage = _stage;
+	variant->stageCreateInfo.module = GetModule(features & _defineFeatures);
+	variant->stageCreateInfo.pName = "main";
+	variant->stageCreateInfo.pSpecializationInfo = variant->mapEntries.empty() ? nullptr : &variant->specializationInfo;
+
+	const ShaderVariant* result = variant.get();
+	_variants[features] = std::move(variant);
+	return result;
+}
+
+VkShaderModule Engine::Shader::GetModule(ShaderFeatureFlags defineFeatures)
+{
+	auto it = _modules.find(defineFeatures);
+	if (it != _modules.end())
+		return it->second;
+
+	std::vector<char> shaderCode = ReadFile(GetSpirvPath(defineFeatures));
+	VkShaderModule module = CreateShaderModule(shaderCode);
+	_modules[defineFeatures] = module;
+	return module;
+}
+
+std::string Engine::Shader::GetSpirvPath(ShaderFeatureFlags defineFeatures) const
+{
+	// The define suffixes follow the declaration order, compile.bat has to emit the same names
+	std::string path = "shaders/" + _name;
+	for (const ShaderFeature& feature : _features)
+	{
+		if (feature.kind == ShaderFeatureKind::Define && (defineFeatures & feature.bit))
+		{
+			path += "_";
+			path += feature.name;
+		}
+	}
+	path += ".spv";
+	return path;
+}
+
+VkShaderModule Engine::Shader::CreateShaderModule(const std::vector<char>& shaderCode)
+{
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = shaderCode.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(Application::s_logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create Shader Module!!!");
+
+	return shaderModule;
+}
+
+Engine::ShaderProgram::ShaderProgram(Shader* vertexShader, Shader* fragmentShader)
+	: _vertexShader(vertexShader)
+	, _fragmentShader(fragmentShader)
+{
+}
+
+Engine::ShaderProgram::~ShaderProgram()
+{
+	delete _vertexShader;
+	delete _fragmentShader;
+}
+
+std::array<VkPipelineShaderStageCreateInfo, 2> Engine::ShaderProgram::GetStages(ShaderFeatureFlags features)
+{
+	return { _vertexShader->GetVariant(features)->stageCreateInfo, _fragmentShader->GetVariant(features)->stageCreateInfo };
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <unordered_map>
+#include <memory>
+#include <string>
+
+namespace Engine
+{
+	// Feature toggles a shader can be permuted on.
+	// Every bit is realized either through a specialization constant or through a compile time define.
+	enum ShaderFeatureBits : uint32_t
+	{
+		SHADER_FEATURE_NONE = 0,
+		// Sample the material texture (specialization constant)
+		SHADER_FEATURE_TEXTURE = 1 << 0,
+		// Modulate by the per vertex color (specialization constant)
+		SHADER_FEATURE_VERTEX_COLOR = 1 << 1,
+		// Discard fragments below the alpha cutoff (define, adds a discard to the shader)
+		SHADER_FEATURE_ALPHA_TEST = 1 << 2,
+		// Sample from the global bindless texture array instead of a per material set (define, changes the descriptor interface)
+		SHADER_FEATURE_BINDLESS = 1 << 3,
+		// Position only vertex shader without a fragment stage, for passes that only write depth (define)
+		SHADER_FEATURE_DEPTH_ONLY = 1 << 4,
+	};
+	typedef uint32_t ShaderFeatureFlags;
+
+	enum class ShaderFeatureKind
+	{
+		SpecializationConstant,
+		Define,
+	};
+
+	struct ShaderFeature
+	{
+		ShaderFeatureBits bit;
+		ShaderFeatureKind kind;
+		// define name for compile time features, debug name for specialization constants
+		const char* name;
+		// layout(constant_id = X) in the shader, only used by specialization constants
+		uint32_t constantId = 0;
+	};
+
+	// Specialized shader stage. Owns the specialization data pointed to by the stage create info,
+	// so it must not move once created.
+	struct ShaderVariant
+	{
+		VkPipelineShaderStageCreateInfo stageCreateInfo{};
+		VkSpecializationInfo specializationInfo{};
+		std::vector<VkSpecializationMapEntry> mapEntries;
+		std::vector<VkBool32> constants;
+	};
+
+	// A single shader source together with the features it declares.
+	// Define based features select a precompiled SPIR-V file: shaders/<name>[_<DEFINE>...].spv
+	// Specialization constant features are baked when the pipeline is created.
+	class Shader
+	{
+	public:
+		Shader(const char* name, VkShaderStageFlagBits stage, std::vector<ShaderFeature> features);
+		~Shader();
+
+		// Strip the bits this shader does not declare, so variants that only differ in unused bits are shared
+		ShaderFeatureFlags PruneFeatures(ShaderFeatureFlags features) const { return features & _declaredFeatures; }
+
+		const ShaderVariant* GetVariant(ShaderFeatureFlags features);
+
+	private:
+		VkShaderModule GetModule(ShaderFeatureFlags defineFeatures);
+		std::string GetSpirvPath(ShaderFeatureFlags defineFeatures) const;
+		VkShaderModule CreateShaderModule(const std::vector<char>& shaderCode);
+
+	public:
+#pragma region Getters
+
+		const std::string& GetName() const { return _name; }
+		VkShaderStageFlagBits GetStage() const { return _stage; }
+		ShaderFeatureFlags GetDeclaredFeatures() const { return _declaredFeatures; }
+
+#pragma endregion
+
+	private:
+		std::string _name;
+		VkShaderStageFlagBits _stage;
+		std::vector<ShaderFeature> _features;
+		ShaderFeatureFlags _declaredFeatures = SHADER_FEATURE_NONE;
+		ShaderFeatureFlags _defineFeatures = SHADER_FEATURE_NONE;
+
+		// keyed by the define bits only, specialization constants share the module
+		std::unordered_map<ShaderFeatureFlags, VkShaderModule> _modules;
+		// keyed by the pruned feature mask
+		std::unordered_map<ShaderFeatureFlags, std::unique_ptr<ShaderVariant>> _variants;
+	};
+
+	// Vertex + fragment shader pair used by a graphics pipeline
+	class ShaderProgram
+	{
+	public:
+		ShaderProgram(Shader* vertexShader, Shader* fragmentShader);
+		~ShaderProgram();
+
+		ShaderFeatureFlags PruneFeatures(ShaderFeatureFlags features) const
+		{
+			return _vertexShader->PruneFeatures(features) | _fragmentShader->PruneFeatures(features);
+		}
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> GetStages(ShaderFeatureFlags features);
+
+#pragma region Getters
+
+		Shader* GetVertexShader() { return _vertexShader; }
+		Shader* GetFragmentShader() { return _fragmentShader; }
+
+#pragma endregion
+
+	private:
+		Shader* _vertexShader;
+		Shader* _fragmentShader;
+	};
+}
@@ -0,0 +1,37 @@
+#include "pch.h"
+#include "SkinnedMesh.h"
+#include "Mesh.h"
+#include "Buffer.h"
+#include "GlbImporter.h"
+#include "StagingRing.h"
+
+#include "Application.h"
+
+Resource::SkinnedMesh::SkinnedMesh(const char* file)
+{
+	try
+	{
+		GlbImporter importer;
+		importer.ImportSkin(file, _mesh, _skinVertices, _skeleton, _clips);
+	}
+	catch (...)
+	{
+		// the mesh may still have copies into its buffer recorded
+		Application::s_stagingRing->Flush();
+		delete _mesh;
+		throw;
+	}
+
+	VkDeviceSize size = _skinVertices.size() * sizeof(SkinVertex);
+	_skinBuffer = new Engine::Buffer();
+	_skinBuffer->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE);
+	Application::s_stagingRing->Upload(_skinBuffer->GetBuffer(), 0, _skinVertices.data(), size);
+
+	Application::s_stagingRing->Flush();
+}
+
+Resource::SkinnedMesh::~SkinnedMesh()
+{
+	delete _skinBuffer;
+	delete _mesh;
+}
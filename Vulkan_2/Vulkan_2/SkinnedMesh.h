@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Animation.h"
+
+namespace Engine
+{
+	class Buffer;
+}
+
+namespace Resource
+{
+	class Mesh;
+
+	// Bind pose position and the joints that move a vertex, in the std430 layout skinning.comp reads
+	struct SkinVertex
+	{
+		float position[3];
+		// four 8 bit joint indices, the first influence in the lowest byte
+		uint32_t joints;
+		// sum up to 1
+		float weights[4];
+	};
+
+	// Mesh deformed by a skeleton, imported from a binary glTF file (see GlbImporter::ImportSkin).
+	// Indices and uvs live in a regular Mesh with positions alone in stream 0. The SkinningPass writes the posed positions
+	// into a buffer per instance and frame that replaces stream 0 in every pass, so the skin is evaluated once per frame.
+	class SkinnedMesh
+	{
+	public:
+		SkinnedMesh(const char* file);
+		~SkinnedMesh();
+
+#pragma region Getters
+
+		// single LOD without meshlets, the bounds are the ones of the bind pose
+		Mesh* GetMesh() { return _mesh; }
+		// kept for the CPU skinning path
+		const std::vector<SkinVertex>& GetSkinVertices() const { return _skinVertices; }
+		uint32_t GetVertexCount() const { return static_cast<uint32_t>(_skinVertices.size()); }
+		const Skeleton& GetSkeleton() const { return _skeleton; }
+		const std::vector<AnimationClip>& GetClips() const { return _clips; }
+		// the skin vertices as a storage buffer for the compute path
+		Engine::Buffer* GetSkinBuffer() { return _skinBuffer; }
+
+#pragma endregion
+
+	private:
+		Mesh* _mesh = nullptr;
+		std::vector<SkinVertex> _skinVertices;
+		Skeleton _skeleton;
+		std::vector<AnimationClip> _clips;
+		Engine::Buffer* _skinBuffer = nullptr;
+	};
+}
@@ -0,0 +1,374 @@
+#include "pch.h"
+#include "SkinningPass.h"
+
+#include "Application.h"
+#include "Buffer.h"
+#include "Queue.h"
+#include "Descriptors.h"
+#include "ShaderPermutation.h"
+#include "SkinnedMesh.h"
+
+#include <algorithm>
+
+// SSE2 is part of every x64 target, 32 bit and other targets take the reference path
+#if defined(_M_X64) || defined(__SSE2__)
+#define SKINNING_SSE 1
+#include <emmintrin.h>
+#else
+#define SKINNING_SSE 0
+#endif
+
+namespace
+{
+	// Matches the push constant block of skinning.comp
+	struct SkinningPushConstants
+	{
+		uint32_t vertexCount;
+	};
+
+	const uint32_t SKINNING_GROUP_SIZE = 64;
+}
+
+Engine::SkinningPass::SkinningPass()
+{
+	_bGpuSkinning = GPU_SKINNING && SupportsComputeSkinning();
+}
+
+Engine::SkinningPass::~SkinningPass()
+{
+	// the device is idle, nothing waits for the frames anymore
+	for (SkinInstance* instance : _instances)
+		ReleaseInstance(instance);
+	for (RetiredInstance& retired : _retiredInstances)
+		ReleaseInstance(retired.instance);
+
+	delete _descriptorAllocator;
+	vkDestroyPipeline(Application::s_logicalDevice, _pipeline, nullptr);
+	vkDestroyPipelineLayout(Application::s_logicalDevice, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(Application::s_logicalDevice, _setLayout, nullptr);
+	delete _shader;
+}
+
+Engine::SkinInstance* Engine::SkinningPass::CreateInstance(Resource::SkinnedMesh* mesh)
+{
+	if (_bGpuSkinning && _pipeline == VK_NULL_HANDLE)
+	{
+		CreateComputePipeline();
+	}
+
+	SkinInstance* instance = new SkinInstance();
+	instance->mesh = mesh;
+	instance->sampler = Resource::AnimationSampler(&mesh->GetSkeleton(), mesh->GetClips().empty() ? nullptr : &mesh->GetClips()[0]);
+
+	VkDeviceSize outputSize = static_cast<VkDeviceSize>(mesh->GetVertexCount()) * 3 * sizeof(float);
+	VkDeviceSize jointSize = static_cast<VkDeviceSize>(mesh->GetSkeleton().GetJointCount()) * sizeof(glm::mat4);
+	for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+	{
+		Buffer* output = new Buffer();
+		instance->outputs.push_back(output);
+		void* mapped = nullptr;
+
+		if (_bGpuSkinning)
+		{
+			output->CreateBuffer(outputSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE);
+
+			Buffer* joints = new Buffer();
+			instance->jointBuffers.push_back(joints);
+			joints->CreateBuffer(jointSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_SHARING_MODE_EXCLUSIVE);
+			vkMapMemory(Application::s_logicalDevice, joints->GetBufferMemory(), 0, jointSize, 0, &mapped);
+
+			VkDescriptorSet descriptorSet = DescriptorSetBuilder(_setLayout)
+				.BindBuffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh->GetSkinBuffer()->GetBuffer(), 0, VK_WHOLE_SIZE)
+				.BindBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, joints->GetBuffer(), 0, VK_WHOLE_SIZE)
+				.BindBuffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, output->GetBuffer(), 0, VK_WHOLE_SIZE)
+				.Build(_descriptorAllocator);
+			instance->descriptorSets.push_back(descriptorSet);
+		}
+		else
+		{
+			output->CreateBuffer(outputSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_SHARING_MODE_EXCLUSIVE);
+			vkMapMemory(Application::s_logicalDevice, output->GetBufferMemory(), 0, outputSize, 0, &mapped);
+		}
+
+		instance->mapped.push_back(mapped);
+	}
+
+	_instances.push_back(instance);
+	return instance;
+}
+
+void Engine::SkinningPass::DestroyInstance(SkinInstance* instance)
+{
+	_instances.erase(std::remove(_instances.begin(), _instances.end(), instance), _instances.end());
+
+	// command buffers still in flight may read the outputs or run the dispatch
+	_retiredInstances.push_back({ instance, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) });
+}
+
+void Engine::SkinningPass::Record(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+	for (auto it = _retiredInstances.begin(); it != _retiredInstances.end();)
+	{
+		if (it->framesLeft-- == 0)
+		{
+			ReleaseInstance(it->instance);
+			it = _retiredInstances.erase(it);
+		}
+		else
+			++it;
+	}
+
+	if (_instances.empty())
+		return;
+
+	if (!_bGpuSkinning)
+	{
+		for (SkinInstance* instance : _instances)
+			SkinOnCpu(instance, frame);
+		return;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	for (SkinInstance* instance : _instances)
+	{
+		// the frame's fence was waited on, nothing reads this frame's joint buffer anymore
+		const std::vector<glm::mat4>& matrices = instance->sampler.GetSkinningMatrices();
+		memcpy(instance->mapped[frame], matrices.data(), matrices.size() * sizeof(glm::mat4));
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &instance->descriptorSets[frame], 0, nullptr);
+
+		SkinningPushConstants pushConstants{};
+		pushConstants.vertexCount = instance->mesh->GetVertexCount();
+		vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+		vkCmdDispatch(commandBuffer, (pushConstants.vertexCount + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, 1, 1);
+	}
+
+	// every pass of the frame reads the positions as vertex attributes
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+void Engine::SkinningPass::SkinPositions(const Resource::SkinVertex* vertices, size_t count, const glm::mat4* joints, float* positions)
+{
+#if SKINNING_SSE
+	for (size_t vertex = 0; vertex < count; vertex++)
+	{
+		const Resource::SkinVertex& source = vertices[vertex];
+		__m128 x = _mm_set1_ps(source.position[0]);
+		__m128 y = _mm_set1_ps(source.position[1]);
+		__m128 z = _mm_set1_ps(source.position[2]);
+
+		__m128 result = _mm_setzero_ps();
+		for (uint32_t influence = 0; influence < 4; influence++)
+		{
+			// most vertices follow one or two joints
+			float weight = source.weights[influence];
+			if (weight == 0.0f)
+				continue;
+
+			// column major, one column per register
+			const float* joint = &joints[(source.joints >> (influence * 8)) & 0xFF][0][0];
+			__m128 moved = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(joint), x), _mm_mul_ps(_mm_loadu_ps(joint + 4), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(joint + 8), z), _mm_loadu_ps(joint + 12)));
+			result = _mm_add_ps(result, _mm_mul_ps(moved, _mm_set1_ps(weight)));
+		}
+
+		// the fourth lane lands on the x of the next vertex, which is written right after. The last vertex has no next one.
+		if (vertex + 1 < count)
+		{
+			_mm_storeu_ps(positions + vertex * 3, result);
+		}
+		else
+		{
+			float last[4];
+			_mm_storeu_ps(last, result);
+			memcpy(positions + vertex * 3, last, 3 * sizeof(float));
+		}
+	}
+#else
+	SkinPositionsReference(vertices, count, joints, positions);
+#endif
+}
+
+void Engine::SkinningPass::SkinPositionsReference(const Resource::SkinVertex* vertices, size_t count, const glm::mat4* joints, float* positions)
+{
+	for (size_t vertex = 0; vertex < count; vertex++)
+	{
+		const Resource::SkinVertex& source = vertices[vertex];
+		glm::vec4 position(source.position[0], source.position[1], source.position[2], 1.0f);
+
+		glm::vec4 result(0.0f);
+		for (uint32_t influence = 0; influence < 4; influence++)
+		{
+			if (source.weights[influence] == 0.0f)
+				continue;
+			result += source.weights[influence] * (joints[(source.joints >> (influence * 8)) & 0xFF] * position);
+		}
+
+		positions[vertex * 3 + 0] = result.x;
+		positions[vertex * 3 + 1] = result.y;
+		positions[vertex * 3 + 2] = result.z;
+	}
+}
+
+void Engine::SkinningPass::SkinPositionsGpu(const Resource::SkinVertex* vertices, size_t count, const glm::mat4* joints, size_t jointCount, float* positions)
+{
+	if (!_bGpuSkinning)
+	{
+		throw std::runtime_error("GPU skinning is not supported on this device!!!");
+	}
+	if (_pipeline == VK_NULL_HANDLE)
+	{
+		CreateComputePipeline();
+	}
+
+	// host visible on both ends, the copies through mapped memory are what the check pays for instead of staging
+	VkDeviceSize vertexSize = count * sizeof(Resource::SkinVertex);
+	VkDeviceSize jointSize = jointCount * sizeof(glm::mat4);
+	VkDeviceSize outputSize = count * 3 * sizeof(float);
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	Buffer* vertexBuffer = new Buffer();
+	vertexBuffer->CreateBuffer(vertexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, VK_SHARING_MODE_EXCLUSIVE);
+	Buffer* jointBuffer = new Buffer();
+	jointBuffer->CreateBuffer(jointSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, VK_SHARING_MODE_EXCLUSIVE);
+	Buffer* outputBuffer = new Buffer();
+	outputBuffer->CreateBuffer(outputSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, VK_SHARING_MODE_EXCLUSIVE);
+
+	void* mapped;
+	vkMapMemory(Application::s_logicalDevice, vertexBuffer->GetBufferMemory(), 0, vertexSize, 0, &mapped);
+	memcpy(mapped, vertices, static_cast<size_t>(vertexSize));
+	vkUnmapMemory(Application::s_logicalDevice, vertexBuffer->GetBufferMemory());
+	vkMapMemory(Application::s_logicalDevice, jointBuffer->GetBufferMemory(), 0, jointSize, 0, &mapped);
+	memcpy(mapped, joints, static_cast<size_t>(jointSize));
+	vkUnmapMemory(Application::s_logicalDevice, jointBuffer->GetBufferMemory());
+
+	VkDescriptorSet descriptorSet = DescriptorSetBuilder(_setLayout)
+		.BindBuffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vertexBuffer->GetBuffer(), 0, VK_WHOLE_SIZE)
+		.BindBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, jointBuffer->GetBuffer(), 0, VK_WHOLE_SIZE)
+		.BindBuffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, outputBuffer->GetBuffer(), 0, VK_WHOLE_SIZE)
+		.Build(_descriptorAllocator);
+
+	SkinningPushConstants pushConstants{};
+	pushConstants.vertexCount = static_cast<uint32_t>(count);
+
+	VkCommandBuffer commandBuffer = Application::BeginSingleTimeCommands();
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, (pushConstants.vertexCount + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+	Application::EndSingleTimeCommands(commandBuffer);
+
+	vkMapMemory(Application::s_logicalDevice, outputBuffer->GetBufferMemory(), 0, outputSize, 0, &mapped);
+	memcpy(positions, mapped, static_cast<size_t>(outputSize));
+	vkUnmapMemory(Application::s_logicalDevice, outputBuffer->GetBufferMemory());
+
+	_descriptorAllocator->Free(descriptorSet);
+	delete vertexBuffer;
+	delete jointBuffer;
+	delete outputBuffer;
+}
+
+bool Engine::SkinningPass::SupportsComputeSkinning()
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(Application::s_physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(Application::s_physicalDevice, &familyCount, families.data());
+
+	uint32_t family = Application::s_graphicsQueue->GetQueueFamilyIndex();
+	return family < familyCount && (families[family].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+}
+
+void Engine::SkinningPass::CreateComputePipeline()
+{
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(Application::s_logicalDevice, &layoutCreateInfo, nullptr, &_setLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create skinning descriptor set layout!!!");
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(SkinningPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &_setLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(Application::s_logicalDevice, &pipelineLayoutCreateInfo, nullptr, &_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create skinning pipeline layout!!!");
+	}
+
+	_shader = new Shader("skinning", VK_SHADER_STAGE_COMPUTE_BIT, {});
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = _shader->GetVariant(SHADER_FEATURE_NONE)->stageCreateInfo;
+	pipelineCreateInfo.layout = _pipelineLayout;
+
+	if (vkCreateComputePipelines(Application::s_logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &_pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create skinning pipeline!!!");
+	}
+
+	_descriptorAllocator = new DescriptorAllocator();
+	_descriptorAllocator->CreateDescriptorAllocator(16, { { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.0f } }, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+}
+
+void Engine::SkinningPass::SkinOnCpu(SkinInstance* instance, uint32_t frame)
+{
+	const std::vector<Resource::SkinVertex>& vertices = instance->mesh->GetSkinVertices();
+	_positions.resize(vertices.size() * 3);
+	SkinPositions(vertices.data(), vertices.size(), instance->sampler.GetSkinningMatrices().data(), _positions.data());
+
+	// the frame's fence was waited on, its output is free to overwrite
+	memcpy(instance->mapped[frame], _positions.data(), _positions.size() * sizeof(float));
+}
+
+void Engine::SkinningPass::ReleaseInstance(SkinInstance* instance)
+{
+	for (VkDescriptorSet descriptorSet : instance->descriptorSets)
+		_descriptorAllocator->Free(descriptorSet);
+
+	// freeing the memory unmaps it
+	for (Buffer* output : instance->outputs)
+		delete output;
+	for (Buffer* joints : instance->jointBuffers)
+		delete joints;
+	delete instance;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <list>
+
+#include "Animation.h"
+
+namespace Resource
+{
+	class SkinnedMesh;
+	struct SkinVertex;
+}
+
+namespace Engine
+{
+	class Buffer;
+	class Shader;
+	class DescriptorAllocator;
+
+	// One placement of a skinned mesh: its animation and the buffers its posed positions are written to.
+	// Owned by the SkinningPass.
+	struct SkinInstance
+	{
+		Resource::SkinnedMesh* mesh = nullptr;
+		// sampled by the owner of the instance before the pass records the frame
+		Resource::AnimationSampler sampler;
+		// tightly packed float3 in the layout of stream 0 of the mesh, one buffer per frame in flight
+		std::vector<Buffer*> outputs;
+		// compute path: the skinning matrices of every frame, persistently mapped
+		std::vector<Buffer*> jointBuffers;
+		// the joint buffers on the compute path, the outputs on the CPU path
+		std::vector<void*> mapped;
+		std::vector<VkDescriptorSet> descriptorSets;
+	};
+
+	// Poses every skinned mesh instance once per frame, before any pass draws it. The depth prepass and the shading pass
+	// then bind the posed positions like a static position stream, so the skin is not evaluated again per pass.
+	// Skinning runs in a compute shader (skinning.comp) on the graphics queue. Devices whose graphics queue has no compute
+	// support, or GPU_SKINNING turned off, skin on the CPU with SSE into host visible buffers instead.
+	// Main thread only.
+	class SkinningPass
+	{
+	public:
+		SkinningPass();
+		~SkinningPass();
+
+		// The instance starts out in the rest pose, animated by its first clip if the mesh has any
+		SkinInstance* CreateInstance(Resource::SkinnedMesh* mesh);
+		// The instance is no longer skinned from the next Record on. Frames in flight may still draw its outputs,
+		// its buffers and descriptor sets are released MAX_FRAMES_IN_FLIGHT frames later.
+		void DestroyInstance(SkinInstance* instance);
+
+		// Once per frame after the frame's fence. Skins every instance with the matrices its sampler holds and releases
+		// the destroyed instances no frame can draw anymore. The compute path records the dispatches and a barrier
+		// in front of the vertex input of the draws, call it outside a render pass. The CPU path writes the frame's outputs right away.
+		void Record(VkCommandBuffer commandBuffer, uint32_t frame);
+
+		// CPU skinning into tightly packed float3 positions. Every joint moves the bind pose position and the results are
+		// blended, the same order of operations as skinning.comp. 4 wide SSE on x64, the reference otherwise.
+		static void SkinPositions(const Resource::SkinVertex* vertices, size_t count, const glm::mat4* joints, float* positions);
+		// Plain glm version, the oracle the SSE path and the compute shader are checked against (see Benchmarks)
+		static void SkinPositionsReference(const Resource::SkinVertex* vertices, size_t count, const glm::mat4* joints, float* positions);
+		// One dispatch of skinning.comp on the arrays, read back into positions. Waits for the graphics queue,
+		// for checking the shader against the reference only. Requires IsGpuSkinning.
+		void SkinPositionsGpu(const Resource::SkinVertex* vertices, size_t count, const glm::mat4* joints, size_t jointCount, float* positions);
+
+	private:
+		static bool SupportsComputeSkinning();
+		// created on first use, most scenes have no skinned meshes
+		void CreateComputePipeline();
+		void SkinOnCpu(SkinInstance* instance, uint32_t frame);
+		// Frees the buffers and descriptor sets of the instance
+		void ReleaseInstance(SkinInstance* instance);
+
+	public:
+#pragma region Getters
+
+		bool IsGpuSkinning() const { return _bGpuSkinning; }
+		size_t GetInstanceCount() const { return _instances.size(); }
+
+#pragma endregion
+
+	private:
+		struct RetiredInstance
+		{
+			SkinInstance* instance;
+			uint32_t framesLeft;
+		};
+
+		bool _bGpuSkinning = false;
+		std::vector<SkinInstance*> _instances;
+		// destroyed instances frames in flight may still draw
+		std::list<RetiredInstance> _retiredInstances;
+		// the CPU path skins into cached memory and copies the result into the write combined output in one go
+		std::vector<float> _positions;
+
+		Shader* _shader = nullptr;
+		VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+		VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline _pipeline = VK_NULL_HANDLE;
+		// one set per instance and frame, freed with the instance
+		DescriptorAllocator* _descriptorAllocator = nullptr;
+	};
+}
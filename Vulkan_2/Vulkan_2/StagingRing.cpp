@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "StagingRing.h"
+#include "Buffer.h"
+#include "Queue.h"
+
+#include "Application.h"
+
+#include <algorithm>
+
+namespace
+{
+	// keeps every chunk aligned for wide memcpy and for buffer to image copies of any texel size
+	const VkDeviceSize STAGING_ALIGNMENT = 16;
+}
+
+Engine::StagingRing::StagingRing()
+{
+}
+
+Engine::StagingRing::~StagingRing()
+{
+	Flush();
+
+	for (VkFence fence : _freeFences)
+		vkDestroyFence(Application::s_logicalDevice, fence, nullptr);
+
+	if (_buffer != nullptr)
+	{
+		vkUnmapMemory(Application::s_logicalDevice, _buffer->GetBufferMemory());
+		delete _buffer;
+	}
+}
+
+void Engine::StagingRing::CreateStagingRing(VkDeviceSize capacity)
+{
+	_capacity = capacity;
+
+	_buffer = new Buffer();
+	std::vector<uint32_t> transferOpsQueueFamilyIndices = Application::GetTransferOpsQueueIndices();
+	_buffer->CreateBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_SHARING_MODE_CONCURRENT, 2, transferOpsQueueFamilyIndices.data());
+
+	// persistent mapping, unmapped when the ring is destroyed
+	void* mapped;
+	if (vkMapMemory(Application::s_logicalDevice, _buffer->GetBufferMemory(), 0, capacity, 0, &mapped) != VK_SUCCESS)
+		throw std::runtime_error("Failed to map the staging ring!!!");
+	_mapped = static_cast<uint8_t*>(mapped);
+}
+
+void Engine::StagingRing::Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	Upload(dstBuffer, dstOffset, size, 1, [bytes](uint8_t* dst, VkDeviceSize first, VkDeviceSize count)
+	{
+		memcpy(dst, bytes + first, static_cast<size_t>(count));
+	});
+}
+
+void Engine::StagingRing::Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize elementCount, VkDeviceSize elementSize, const FillFunction& fill)
+{
+	// a quarter of the ring per chunk keeps up to three chunks in flight while the next one is filled
+	VkDeviceSize chunkElements = std::max<VkDeviceSize>(1, (_capacity / 4) / elementSize);
+	if (chunkElements * elementSize > _capacity - STAGING_ALIGNMENT)
+		throw std::runtime_error("Staging ring is smaller than one element!!!");
+
+	for (VkDeviceSize first = 0; first < elementCount; first += chunkElements)
+	{
+		VkDeviceSize count = std::min(chunkElements, elementCount - first);
+		VkDeviceSize size = count * elementSize;
+		VkDeviceSize offset = Allocate(size);
+
+		fill(_mapped + offset, first, count);
+		RecordCopy(dstBuffer, dstOffset + first * elementSize, offset, size);
+
+		if (_recordedSize >= _capacity / 4)
+			Submit();
+	}
+}
+
+void Engine::StagingRing::Flush()
+{
+	if (_commandBuffer != VK_NULL_HANDLE)
+		Submit();
+	while (!_submissions.empty())
+		WaitOldest();
+}
+
+VkDeviceSize Engine::StagingRing::Allocate(VkDeviceSize size)
+{
+	for (;;)
+	{
+		// nothing recorded or in flight, start over at the beginning
+		if (_commandBuffer == VK_NULL_HANDLE && _submissions.empty())
+		{
+			_head = 0;
+			_tail = 0;
+		}
+
+		// head == tail only when the ring is empty, allocations never fill the last byte before the tail
+		VkDeviceSize offset = (_head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		if (_head >= _tail)
+		{
+			// free space is [head, capacity) and [0, tail)
+			if (offset + size <= _capacity)
+			{
+				_head = offset + size;
+				return offset;
+			}
+			if (size < _tail)
+			{
+				_head = size;
+				return 0;
+			}
+		}
+		else if (offset + size < _tail)
+		{
+			_head = offset + size;
+			return offset;
+		}
+
+		// full: hand over what is recorded and wait for the oldest batch to free its bytes
+		if (_commandBuffer != VK_NULL_HANDLE)
+			Submit();
+		WaitOldest();
+	}
+}
+
+void Engine::StagingRing::RecordCopy(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize srcOffset, VkDeviceSize size)
+{
+	if (_commandBuffer == VK_NULL_HANDLE)
+		_commandBuffer = Application::BeginSingleTimeTransferCommands();
+
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(_commandBuffer, _buffer->GetBuffer(), dstBuffer, 1, &copyRegion);
+
+	_recordedSize += size;
+}
+
+void Engine::StagingRing::Submit()
+{
+	vkEndCommandBuffer(_commandBuffer);
+
+	VkFence fence;
+	if (!_freeFences.empty())
+	{
+		fence = _freeFences.back();
+		_freeFences.pop_back();
+	}
+	else
+	{
+		VkFenceCreateInfo fenceCreateInfo{};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(Application::s_logicalDevice, &fenceCreateInfo, nullptr, &fence) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a staging ring fence!!!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &_commandBuffer;
+
+	if (vkQueueSubmit(Application::s_transferQueue->GetQueue(), 1, &submitInfo, fence) != VK_SUCCESS)
+		throw std::runtime_error("Failed to submit staging ring copies!!!");
+
+	_submissions.push_back({ _commandBuffer, fence, _head });
+	_commandBuffer = VK_NULL_HANDLE;
+	_recordedSize = 0;
+}
+
+void Engine::StagingRing::WaitOldest()
+{
+	Submission& submission = _submissions.front();
+	vkWaitForFences(Application::s_logicalDevice, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+	vkResetFences(Application::s_logicalDevice, 1, &submission.fence);
+	_freeFences.push_back(submission.fence);
+
+	vkFreeCommandBuffers(Application::s_logicalDevice, Application::GetTransferCommandPool(), 1, &submission.commandBuffer);
+
+	_tail = submission.end;
+	_submissions.pop_front();
+}
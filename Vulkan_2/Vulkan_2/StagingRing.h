@@ -0,0 +1,70 @@
+#pragma once
+#include <deque>
+#include <functional>
+
+namespace Engine
+{
+	class Buffer;
+
+	// Persistently mapped upload buffer shared by every asset upload.
+	// Data is written into the ring in chunks and copied into its destination on the transfer queue. A batch is submitted
+	// once a quarter of the ring is recorded, so the CPU fills the next chunks while the GPU copies the previous ones,
+	// and the CPU only waits when it laps copies that are still running.
+	// Main thread only.
+	class StagingRing
+	{
+	public:
+		// fill(dst, firstElement, elementCount) writes the elements into staging memory
+		using FillFunction = std::function<void(uint8_t*, VkDeviceSize, VkDeviceSize)>;
+
+		StagingRing();
+		~StagingRing();
+
+		void CreateStagingRing(VkDeviceSize capacity);
+
+		// Copies the bytes into the destination buffer
+		void Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		// Lets the caller produce the data directly in staging memory, a chunk never splits an element
+		void Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize elementCount, VkDeviceSize elementSize, const FillFunction& fill);
+
+		// Submits what is recorded and waits until every copy is done, call before the destinations are used
+		void Flush();
+
+	private:
+		// Start of size free bytes, waits for submitted copies when the ring is full
+		VkDeviceSize Allocate(VkDeviceSize size);
+		void RecordCopy(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize srcOffset, VkDeviceSize size);
+		void Submit();
+		void WaitOldest();
+
+	public:
+#pragma region Getters
+
+		VkDeviceSize GetCapacity() const { return _capacity; }
+
+#pragma endregion
+
+	private:
+		struct Submission
+		{
+			VkCommandBuffer commandBuffer;
+			VkFence fence;
+			// ring offset after the last byte of the batch, the ring is free up to here once the fence signals
+			VkDeviceSize end;
+		};
+
+		Buffer* _buffer = nullptr;
+		uint8_t* _mapped = nullptr;
+		VkDeviceSize _capacity = 0;
+
+		// bytes in use run from _tail to _head, wrapping around the end of the ring
+		VkDeviceSize _head = 0;
+		VkDeviceSize _tail = 0;
+
+		// batch being recorded, VK_NULL_HANDLE when there is none
+		VkCommandBuffer _commandBuffer = VK_NULL_HANDLE;
+		VkDeviceSize _recordedSize = 0;
+		std::deque<Submission> _submissions;
+		std::vector<VkFence> _freeFences;
+	};
+}
@@ -0,0 +1,593 @@
+#include "pch.h"
+#include "Texture.h"
+#include "Buffer.h"
+#include <stb_image.h>
+#include "Queue.h"
+
+#include "Application.h"
+#include "Image.h"
+#include "BindlessTextureTable.h"
+#include "MipGenerator.h"
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "TextureArrayPool.h"
+#include "TextureCooker.h"
+#include "Descriptors.h"
+#include "Constants.h"
+
+#include <cmath>
+
+namespace
+{
+	// Block compressed formats also need the device feature. Only queries the physical device, so workers may call it
+	bool IsSampleable(VkFormat format)
+	{
+		if (Resource::BlockCompression::IsBlockCompressed(format) && !Application::s_optionalFeatures.textureCompressionBC)
+			return false;
+
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(Application::s_physicalDevice, format, &properties);
+		return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	// First level small enough for the mip tail, 0 when the chain is not worth streaming.
+	// The finer levels are read on the thread pool, so there is no streaming without one.
+	uint32_t GetStreamingTailMip(const Resource::TextureDataView& chain)
+	{
+		if (!TEXTURE_STREAMING || Application::s_threadPool == nullptr)
+			return 0;
+
+		for (uint32_t level = 0; level < chain.levelCount; level++)
+		{
+			if (std::max(chain.levels[level].width, chain.levels[level].height) <= TEXTURE_STREAMING_TAIL_SIZE)
+				return level;
+		}
+		return chain.levelCount - 1;
+	}
+}
+
+Resource::Texture::Texture(const char* file, TextureColorSpace colorSpace)
+	: _file(file)
+	, _colorSpace(colorSpace)
+{
+	if (Application::s_threadPool != nullptr)
+	{
+		StartDecode();
+		return;
+	}
+
+	DecodedTexture decoded = Decode(_file, colorSpace);
+	CompleteLoading(decoded);
+}
+
+Resource::Texture::Texture(const uint8_t rgba[4])
+	: _colorSpace(TextureColorSpace::Linear)
+{
+	DecodedTexture decoded;
+	decoded.data.format = VK_FORMAT_R8G8B8A8_UNORM;
+	decoded.data.width = 1;
+	decoded.data.height = 1;
+	decoded.data.levelCount = 1;
+	decoded.data.levels[0] = { nullptr, 4, 1, 1 };
+
+	memcpy(CreateStagingBuffer(decoded), rgba, 4);
+	UnmapStagingBuffer(decoded);
+
+	CreateImage(decoded);
+	RegisterTexture();
+}
+
+Resource::Texture::~Texture()
+{
+	// a decode still running only owns its result, dropping the future lets the worker finish and free it
+	if (!IsResident())
+		return;
+
+	ReleaseImage();
+}
+
+bool Resource::Texture::Unload()
+{
+	// the levels of a pending read would land in an image that is gone
+	if (!IsResident() || IsStreamInPending() || _file.empty() || Application::s_threadPool == nullptr)
+		return false;
+
+	ReleaseImage();
+	_streamSource.reset();
+	return true;
+}
+
+void Resource::Texture::Reload()
+{
+	if (IsResident() || _decode.valid())
+		return;
+
+	StartDecode();
+}
+
+void Resource::Texture::StartDecode()
+{
+	std::string path = _file;
+	TextureColorSpace colorSpace = _colorSpace;
+	_decode = Application::s_threadPool->Submit([path, colorSpace]() { return Decode(path, colorSpace); });
+}
+
+void Resource::Texture::ReleaseImage()
+{
+	if (IsStreamed())
+	{
+		Application::s_textureStreamer->Unregister(this);
+	}
+
+	// the array keeps its view, slot and material sets until its last layer is freed
+	if (IsPacked())
+	{
+		Application::s_textureArrays->Free(_arraySlot);
+		_arraySlot = Engine::TextureArraySlot();
+		return;
+	}
+
+	// cached material sets bind the view, they go before it
+	if (Application::s_descriptorSetCache != nullptr)
+	{
+		Application::s_descriptorSetCache->InvalidateImageView(_image->GetImageView());
+	}
+
+	// a swap recorded in a frame still in flight may be copying into the image
+	if (IsStreamed())
+	{
+		Application::s_textureStreamer->Retire(_image, _textureIndex, nullptr);
+		_image = nullptr;
+		return;
+	}
+
+	if (Application::s_bindlessTextures != nullptr)
+	{
+		Application::s_bindlessTextures->UnregisterTexture(_textureIndex);
+	}
+
+	delete _image;
+	_image = nullptr;
+}
+
+bool Resource::Texture::FinishLoading(bool bWait)
+{
+	if (IsResident())
+		return true;
+
+	if (!bWait && _decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	// rethrows what the decode threw
+	DecodedTexture decoded = _decode.get();
+	CompleteLoading(decoded);
+	return true;
+}
+
+void Resource::Texture::CompleteLoading(DecodedTexture& decoded)
+{
+	// small textures with their whole chain become a layer of a shared array
+	const TextureDataView& data = decoded.data;
+	if (decoded.streamSource == nullptr && !decoded.bGenerateMips && Engine::TextureArrayPool::CanPack(data.width, data.height, data.levelCount))
+	{
+		_arraySlot = Application::s_textureArrays->Allocate(data.format, data.width, data.height, data.levelCount, decoded.stagingBuffer.get(), decoded.levelOffsets.data());
+		decoded.stagingBuffer.reset();
+		return;
+	}
+
+	CreateImage(decoded);
+	RegisterTexture();
+
+	if (decoded.streamSource != nullptr)
+	{
+		_streamSource = std::move(decoded.streamSource);
+		_residentMip = decoded.firstMip;
+		_tailMip = decoded.firstMip;
+		Application::s_textureStreamer->Register(this);
+	}
+}
+
+Resource::DecodedTexture Resource::Texture::Decode(const std::string& file, TextureColorSpace colorSpace)
+{
+	bool bSrgb = colorSpace == TextureColorSpace::Srgb;
+	DecodedTexture decoded;
+
+	// a cooked texture comes with its whole mip chain, it is only used when it was cooked for the same color space
+	std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>();
+	if (cache->Open(file.c_str()) && BlockCompression::IsSrgb(cache->GetDataView().format) == bSrgb)
+	{
+		const TextureDataView& source = cache->GetDataView();
+		if (IsSampleable(source.format))
+		{
+			// a large chain starts with its mip tail, the cache stays mapped for the finer levels
+			uint32_t tailMip = GetStreamingTailMip(source);
+			decoded = ReadLevels(*cache, tailMip, source.levelCount);
+			if (tailMip > 0)
+				decoded.streamSource = cache;
+			return decoded;
+		}
+
+		// decode the blocks on the CPU, the texture keeps its precomputed mips but takes the uncompressed size
+		if (BlockCompression::IsBlockCompressed(source.format))
+		{
+			decoded.data = source;
+			decoded.data.format = bSrgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+			for (uint32_t level = 0; level < source.levelCount; level++)
+				decoded.data.levels[level].size = static_cast<uint64_t>(source.levels[level].width) * source.levels[level].height * 4;
+
+			uint8_t* staging = CreateStagingBuffer(decoded);
+			bool bDecoded = true;
+			for (uint32_t level = 0; level < source.levelCount && bDecoded; level++)
+			{
+				const TextureLevel& blocks = source.levels[level];
+				bDecoded = BlockCompression::DecompressLevel(source.format, blocks.data, blocks.width, blocks.height, staging + decoded.levelOffsets[level]);
+			}
+			UnmapStagingBuffer(decoded);
+
+			if (bDecoded)
+				return decoded;
+			decoded = DecodedTexture();
+		}
+	}
+
+	// load the image
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixelData = stbi_load(file.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+	if (!pixelData)
+	{
+		throw std::runtime_error("Failed to load texture image " + file + "!!!");
+	}
+
+	decoded.data.format = bSrgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	decoded.data.width = texWidth;
+	decoded.data.height = texHeight;
+	decoded.data.levelCount = 1;
+	decoded.data.levels[0].size = static_cast<uint64_t>(texWidth) * texHeight * STBI_rgb_alpha;
+	decoded.data.levels[0].width = texWidth;
+	decoded.data.levels[0].height = texHeight;
+
+	// the chain of a texture small enough for an array is built here, a layer cannot get its mips generated on its own
+	if (Engine::TextureArrayPool::CanPack(texWidth, texHeight, Engine::Image::GetMipLevelCount(texWidth, texHeight)))
+	{
+		std::vector<std::vector<uint8_t>> levels;
+		TextureCooker::BuildMipChain(pixelData, texWidth, texHeight, bSrgb, levels);
+		stbi_image_free(pixelData);
+
+		decoded.data.levelCount = static_cast<uint32_t>(levels.size());
+		for (uint32_t level = 0; level < decoded.data.levelCount; level++)
+		{
+			decoded.data.levels[level].size = levels[level].size();
+			decoded.data.levels[level].width = std::max(decoded.data.width >> level, 1u);
+			decoded.data.levels[level].height = std::max(decoded.data.height >> level, 1u);
+		}
+
+		uint8_t* staging = CreateStagingBuffer(decoded);
+		for (uint32_t level = 0; level < decoded.data.levelCount; level++)
+			memcpy(staging + decoded.levelOffsets[level], levels[level].data(), levels[level].size());
+		UnmapStagingBuffer(decoded);
+		return decoded;
+	}
+	decoded.bGenerateMips = true;
+
+	// stb_image only decodes into memory it allocates itself
+	try
+	{
+		memcpy(CreateStagingBuffer(decoded), pixelData, static_cast<size_t>(decoded.data.levels[0].size));
+	}
+	catch (...)
+	{
+		stbi_image_free(pixelData);
+		throw;
+	}
+	UnmapStagingBuffer(decoded);
+
+	// free pixel Data
+	stbi_image_free(pixelData);
+	return decoded;
+}
+
+Engine::Image* Resource::Texture::GetImage()
+{
+	if (IsPacked())
+		return _arraySlot.image;
+	return _image != nullptr ? _image : Application::s_placeholderTexture->GetImage();
+}
+
+VkImageView Resource::Texture::GetImageView()
+{
+	if (IsPacked())
+		return _arraySlot.view;
+	return _image != nullptr ? _image->GetImageView() : Application::s_placeholderTexture->GetImageView();
+}
+
+uint32_t Resource::Texture::GetTextureIndex() const
+{
+	if (IsPacked())
+		return _arraySlot.textureIndex;
+	return IsResident() ? _textureIndex : Application::s_placeholderTexture->GetTextureIndex();
+}
+
+uint64_t Resource::Texture::GetMemorySize() const
+{
+	if (IsPacked())
+		return Engine::TextureArrayPool::GetLayerMemorySize(_arraySlot);
+	return _image != nullptr ? _image->GetMemorySize() : 0;
+}
+
+uint32_t Resource::Texture::GetMipCount() const
+{
+	if (IsStreamed())
+		return _streamSource->GetDataView().levelCount;
+	if (IsPacked())
+		return _arraySlot.image->GetMipLevels();
+	return _image != nullptr ? _image->GetMipLevels() : 1;
+}
+
+void Resource::Texture::RequestScreenSize(float pixels)
+{
+	if (!IsStreamed())
+		return;
+
+	// one texel per pixel: every halving of the coverage drops one level
+	const TextureDataView& chain = _streamSource->GetDataView();
+	float texels = static_cast<float>(std::max(chain.width, chain.height));
+	uint32_t mip = 0;
+	if (pixels < texels)
+		mip = pixels > 0.0f ? static_cast<uint32_t>(std::floor(std::log2(texels / pixels))) : chain.levelCount - 1;
+	_requestedMip = std::min(_requestedMip, std::min(mip, chain.levelCount - 1));
+}
+
+uint32_t Resource::Texture::ConsumeRequestedMip()
+{
+	uint32_t mip = std::min(_requestedMip, GetMipCount());
+	_requestedMip = MAX_TEXTURE_MIPS;
+	return mip;
+}
+
+bool Resource::Texture::StreamIn(uint32_t mip)
+{
+	if (!IsStreamed() || IsStreamInPending() || mip >= _residentMip)
+		return false;
+
+	// the worker keeps the mapping alive, the texture may go away before the read is done
+	std::shared_ptr<TextureCache> source = _streamSource;
+	uint32_t residentMip = _residentMip;
+	_streamInMip = mip;
+	_streamIn = Application::s_threadPool->Submit([source, mip, residentMip]() { return ReadLevels(*source, mip, residentMip); });
+	return true;
+}
+
+bool Resource::Texture::FinishStreamIn(VkCommandBuffer commandBuffer)
+{
+	if (!IsStreamInPending() || _streamIn.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	DecodedTexture levels = _streamIn.get();
+	ReplaceImage(commandBuffer, _streamInMip, &levels);
+	return true;
+}
+
+void Resource::Texture::Evict(VkCommandBuffer commandBuffer, uint32_t mip)
+{
+	// the pending read ends at the current resident level, it has to land first
+	if (!IsStreamed() || IsStreamInPending() || mip <= _residentMip || mip > _tailMip)
+		return;
+
+	ReplaceImage(commandBuffer, mip, nullptr);
+}
+
+uint64_t Resource::Texture::GetLevelRangeSize(uint32_t mip) const
+{
+	const TextureDataView& chain = _streamSource->GetDataView();
+	uint64_t size = 0;
+	for (uint32_t level = mip; level < chain.levelCount; level++)
+		size += chain.levels[level].size;
+	return size;
+}
+
+Resource::TextureDataView Resource::Texture::GetLevelRange(const TextureDataView& chain, uint32_t firstMip, uint32_t endMip)
+{
+	TextureDataView range;
+	range.format = chain.format;
+	range.width = chain.levels[firstMip].width;
+	range.height = chain.levels[firstMip].height;
+	range.levelCount = endMip - firstMip;
+	for (uint32_t level = firstMip; level < endMip; level++)
+		range.levels[level - firstMip] = chain.levels[level];
+	return range;
+}
+
+Resource::DecodedTexture Resource::Texture::ReadLevels(const TextureCache& source, uint32_t firstMip, uint32_t endMip)
+{
+	const TextureDataView& chain = source.GetDataView();
+	DecodedTexture decoded;
+	decoded.data = GetLevelRange(chain, firstMip, endMip);
+	decoded.firstMip = firstMip;
+
+	// straight from the mapping into staging memory, the only copy the levels take on the CPU
+	uint8_t* staging = CreateStagingBuffer(decoded);
+	for (uint32_t level = firstMip; level < endMip; level++)
+		memcpy(staging + decoded.levelOffsets[level - firstMip], chain.levels[level].data, static_cast<size_t>(chain.levels[level].size));
+	UnmapStagingBuffer(decoded);
+	return decoded;
+}
+
+void Resource::Texture::ReplaceImage(VkCommandBuffer commandBuffer, uint32_t mip, DecodedTexture* levels)
+{
+	const TextureDataView& chain = _streamSource->GetDataView();
+	uint32_t indices[] = { Application::s_transferQueue->GetQueueFamilyIndex(), Application::s_graphicsQueue->GetQueueFamilyIndex() };
+
+	Engine::Image* image = new Engine::Image();
+	Engine::EngineImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.size = chain.levels[mip].size;
+	imageCreateInfo.width = chain.levels[mip].width;
+	imageCreateInfo.height = chain.levels[mip].height;
+	imageCreateInfo.imageFormat = chain.format;
+	imageCreateInfo.imageTiling = VK_IMAGE_TILING_OPTIMAL;
+	// the next swap copies out of it
+	imageCreateInfo.usageFlags = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	imageCreateInfo.queueFamilyIndexCount = 2;
+	imageCreateInfo.queueFamilyIndices = indices;
+	imageCreateInfo.mipLevels = chain.levelCount - mip;
+	image->CreateImage(&imageCreateInfo);
+
+	// levels both images hold
+	uint32_t keptMip = std::max(mip, _residentMip);
+	std::array<VkImageCopy, MAX_TEXTURE_MIPS> imageRegions{};
+	uint32_t imageRegionCount = 0;
+	for (uint32_t level = keptMip; level < chain.levelCount; level++)
+	{
+		VkImageCopy& region = imageRegions[imageRegionCount++];
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - _residentMip, 0, 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - mip, 0, 1 };
+		region.extent = { chain.levels[level].width, chain.levels[level].height, 1 };
+	}
+
+	// levels read by StreamIn
+	std::array<VkBufferImageCopy, MAX_TEXTURE_MIPS> bufferRegions{};
+	uint32_t bufferRegionCount = 0;
+	if (levels != nullptr)
+	{
+		for (uint32_t level = mip; level < _residentMip; level++)
+		{
+			VkBufferImageCopy& region = bufferRegions[bufferRegionCount++];
+			region.bufferOffset = levels->levelOffsets[level - mip];
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - mip, 0, 1 };
+			region.imageExtent = { chain.levels[level].width, chain.levels[level].height, 1 };
+		}
+	}
+
+	// Recorded ahead of the frame's draws on the graphics queue: the barrier out of SHADER_READ_ONLY also waits for
+	// the frame still in flight sampling the old image, and the draws after it only bind the new one
+	image->TransitionImageLayout(commandBuffer, chain.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	_image->TransitionImageLayout(commandBuffer, chain.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	vkCmdCopyImage(commandBuffer, _image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageRegionCount, imageRegions.data());
+	if (bufferRegionCount > 0)
+	{
+		vkCmdCopyBufferToImage(commandBuffer, levels->stagingBuffer->GetBuffer(), image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferRegionCount, bufferRegions.data());
+	}
+	image->TransitionImageLayout(commandBuffer, chain.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	image->CreateImageView(VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+
+	// The frame in flight may still sample the old image through its cached sets and bindless slot, so the new image
+	// gets a slot of its own and the old one is kept with the staging buffer until no frame can use them
+	if (Application::s_descriptorSetCache != nullptr)
+	{
+		Application::s_descriptorSetCache->InvalidateImageView(_image->GetImageView());
+	}
+	Application::s_textureStreamer->Retire(_image, _textureIndex, levels != nullptr ? std::move(levels->stagingBuffer) : nullptr);
+	_image = image;
+	_residentMip = mip;
+	RegisterTexture();
+}
+
+void Resource::Texture::RegisterTexture()
+{
+	if (Application::s_bindlessTextures != nullptr)
+	{
+		_textureIndex = Application::s_bindlessTextures->RegisterTexture(GetImageView());
+	}
+}
+
+uint8_t* Resource::Texture::CreateStagingBuffer(DecodedTexture& decoded)
+{
+	VkDeviceSize stagingSize = 0;
+	for (uint32_t level = 0; level < decoded.data.levelCount; level++)
+	{
+		decoded.levelOffsets[level] = stagingSize;
+		stagingSize = (stagingSize + decoded.data.levels[level].size + 15) & ~VkDeviceSize(15);
+	}
+
+	// buffer creation and mapping only need the device, workers may create their own staging buffers
+	Engine::Buffer* stagingBuffer = new Engine::Buffer();
+	uint32_t indices[] = { Application::s_transferQueue->GetQueueFamilyIndex(), Application::s_graphicsQueue->GetQueueFamilyIndex() };
+	stagingBuffer->CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_SHARING_MODE_CONCURRENT, 2, indices);
+	decoded.stagingBuffer.reset(stagingBuffer);
+
+	void* mapped;
+	if (vkMapMemory(Application::s_logicalDevice, decoded.stagingBuffer->GetBufferMemory(), 0, stagingSize, 0, &mapped) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to map texture staging buffer!!!");
+	}
+
+	for (uint32_t level = 0; level < decoded.data.levelCount; level++)
+		decoded.data.levels[level].data = static_cast<uint8_t*>(mapped) + decoded.levelOffsets[level];
+	return static_cast<uint8_t*>(mapped);
+}
+
+void Resource::Texture::UnmapStagingBuffer(DecodedTexture& decoded)
+{
+	vkUnmapMemory(Application::s_logicalDevice, decoded.stagingBuffer->GetBufferMemory());
+	for (uint32_t level = 0; level < decoded.data.levelCount; level++)
+		decoded.data.levels[level].data = nullptr;
+}
+
+void Resource::Texture::CreateImage(DecodedTexture& decoded)
+{
+	const TextureDataView& data = decoded.data;
+	bool bGenerateMips = decoded.bGenerateMips;
+	uint32_t indices[] = { Application::s_transferQueue->GetQueueFamilyIndex(), Application::s_graphicsQueue->GetQueueFamilyIndex() };
+
+	_image = new Engine::Image();
+	Engine::EngineImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.size = data.levels[0].size;
+	imageCreateInfo.width = data.width;
+	imageCreateInfo.height = data.height;
+	imageCreateInfo.imageFormat = data.format;
+	imageCreateInfo.imageTiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usageFlags = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	imageCreateInfo.queueFamilyIndexCount = 2;
+	imageCreateInfo.queueFamilyIndices = indices;
+	imageCreateInfo.mipLevels = data.levelCount;
+	// the streamer copies the levels out when it swaps the image
+	if (decoded.streamSource != nullptr)
+	{
+		imageCreateInfo.usageFlags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	if (bGenerateMips)
+	{
+		imageCreateInfo.mipLevels = Engine::Image::GetMipLevelCount(data.width, data.height);
+		imageCreateInfo.usageFlags |= Engine::MipGenerator::GetRequiredUsage(data.format);
+		imageCreateInfo.flags = Engine::MipGenerator::GetRequiredFlags(data.format);
+	}
+	_image->CreateImage(&imageCreateInfo);
+
+	std::array<VkBufferImageCopy, MAX_TEXTURE_MIPS> regions{};
+	for (uint32_t level = 0; level < data.levelCount; level++)
+	{
+		regions[level].bufferOffset = decoded.levelOffsets[level];
+		regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[level].imageSubresource.mipLevel = level;
+		regions[level].imageSubresource.baseArrayLayer = 0;
+		regions[level].imageSubresource.layerCount = 1;
+		regions[level].imageExtent = { data.levels[level].width, data.levels[level].height, 1 };
+	}
+
+	// one submission for the transitions and the copies of every level
+	VkCommandBuffer commandBuffer = Application::BeginSingleTimeCommands();
+	_image->TransitionImageLayout(commandBuffer, data.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	vkCmdCopyBufferToImage(commandBuffer, decoded.stagingBuffer->GetBuffer(), _image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, data.levelCount, regions.data());
+	if (!bGenerateMips)
+	{
+		_image->TransitionImageLayout(commandBuffer, data.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+	Application::EndSingleTimeCommands(commandBuffer);
+
+	decoded.stagingBuffer.reset();
+
+	// leaves every level ready to sample
+	if (bGenerateMips)
+	{
+		Application::s_mipGenerator->Generate(_image);
+	}
+
+	// sampled like the shared arrays of packed textures, as layer 0
+	_image->CreateImageView(VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+}
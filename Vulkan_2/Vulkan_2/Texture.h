@@ -0,0 +1,160 @@
+#pragma once
+#include <future>
+#include <memory>
+
+#include "TextureCache.h"
+#include "TextureArrayPool.h"
+
+namespace Engine
+{
+	class Image;
+	class Buffer;
+}
+
+namespace Resource
+{
+	// How the texels of a file are interpreted, part of the texture key since the same file
+	// can be color data in one material and plain data in another
+	enum class TextureColorSpace
+	{
+		// color data, sampled through an sRGB format and filtered in linear space
+		Srgb,
+		// normals, masks and other non color data
+		Linear,
+	};
+
+	// A texture decoded on a worker thread straight into a mapped staging buffer, ready to be copied into the image.
+	// The data view describes the levels, its data pointers are only valid on the worker while the buffer is mapped.
+	struct DecodedTexture
+	{
+		TextureDataView data;
+		// only levels[0] was decoded, the rest of the chain is generated on the GPU
+		bool bGenerateMips = false;
+
+		std::unique_ptr<Engine::Buffer> stagingBuffer;
+		// every level starts on an offset that suits any texel or block size
+		std::array<VkDeviceSize, MAX_TEXTURE_MIPS> levelOffsets{};
+
+		// level of the full chain data.levels[0] is, above 0 when only the mip tail of a streamed texture was read
+		uint32_t firstMip = 0;
+		// cooked chain the finer levels stream from, shared with the reads in flight
+		std::shared_ptr<TextureCache> streamSource;
+	};
+
+	// Device image of one texture file with its whole mip chain, shared by every material using the file.
+	// Loaded through AssetManager::LoadTexture: the file is decoded on the thread pool (the cooked texture cache when it is current,
+	// otherwise the source image with the mips generated on the GPU) and uploaded on the main thread once the decode is done.
+	// Until then the texture reports the placeholder image, so it can be bound right away.
+	// Cooked textures larger than the mip tail are streamed: only the tail is loaded up front and the TextureStreamer
+	// swaps in images holding finer levels as draws ask for them. The image only ever holds uploaded levels.
+	// Textures up to TEXTURE_ARRAY_MAX_SIZE are packed as a layer of a shared array image instead (see TextureArrayPool).
+	// The AssetManager may unload the image of a texture nobody drew recently, it is decoded again on the next use.
+	class Texture
+	{
+	public:
+		// Starts decoding the file on Application::s_threadPool, or decodes and uploads right away without a pool
+		Texture(const char* file, TextureColorSpace colorSpace);
+		// Single texel texture uploaded right away, used as the placeholder of textures still loading
+		Texture(const uint8_t rgba[4]);
+		~Texture();
+
+		// Main thread: uploads the image once the decode finished, bWait blocks until it has.
+		// Returns true when the texture is resident. Decode errors are rethrown here.
+		bool FinishLoading(bool bWait = false);
+
+		// Main thread: frees the image of a texture loaded from a file, no frame in flight may use it anymore.
+		// Returns false for textures that cannot load again. Draws see the placeholder until Reload finished.
+		bool Unload();
+		// Starts decoding the file of an unloaded texture again, FinishLoading completes it
+		void Reload();
+
+		// Runs on a worker thread: the cooked levels are read, and block compressed ones the device cannot sample decoded,
+		// directly into the staging buffer. Source images go through the buffer stb_image allocates.
+		static DecodedTexture Decode(const std::string& file, TextureColorSpace colorSpace);
+
+		// Records the demand of a draw covering about pixels pixels, the texture is assumed to span it once.
+		// Only streamed textures keep track.
+		void RequestScreenSize(float pixels);
+		// Finest level requested since the last call, GetMipCount() when there was no request
+		uint32_t ConsumeRequestedMip();
+		// Starts reading the levels [mip, resident mip) on the thread pool. Returns false while another read is pending.
+		bool StreamIn(uint32_t mip);
+		// Main thread: swaps in an image with the levels read by StreamIn once they are ready, the copies are recorded
+		// into commandBuffer. Returns true when it did.
+		bool FinishStreamIn(VkCommandBuffer commandBuffer);
+		// Main thread: swaps in an image without the levels finer than mip, the copies are recorded into commandBuffer
+		void Evict(VkCommandBuffer commandBuffer, uint32_t mip);
+		// Device bytes of the levels [mip, mip count), estimated from the level sizes
+		uint64_t GetLevelRangeSize(uint32_t mip) const;
+
+	private:
+		// Views the levels [firstMip, endMip) of a chain as a chain of its own
+		static TextureDataView GetLevelRange(const TextureDataView& chain, uint32_t firstMip, uint32_t endMip);
+		// Worker side of StreamIn
+		static DecodedTexture ReadLevels(const TextureCache& source, uint32_t firstMip, uint32_t endMip);
+		// Replaces the image by one holding the levels [mip, mip count). Levels both images hold are copied on the GPU,
+		// finer ones come from the staging buffer of levels. The copies are recorded into commandBuffer ahead of the draws
+		// sampling the new image, the old image and slot go to the streamer until no frame in flight uses them.
+		void ReplaceImage(VkCommandBuffer commandBuffer, uint32_t mip, DecodedTexture* levels);
+		// Creates the staging buffer for the levels described by decoded.data, mapped and pointed to by the levels
+		static uint8_t* CreateStagingBuffer(DecodedTexture& decoded);
+		static void UnmapStagingBuffer(DecodedTexture& decoded);
+		// Copies every staged level into a new image, and fills the rest of the chain on the GPU when bGenerateMips is set
+		void CreateImage(DecodedTexture& decoded);
+		void RegisterTexture();
+		// Submits the decode of the file to Application::s_threadPool
+		void StartDecode();
+		// Frees the image or the array layer and every registration of it
+		void ReleaseImage();
+		// Uploads the decode, registers the image and hands streamed textures to the streamer
+		void CompleteLoading(DecodedTexture& decoded);
+
+	public:
+#pragma region Getters
+
+		// the placeholder image while the texture is loading, the shared array image of a packed texture
+		Engine::Image* GetImage();
+		// what materials bind, a 2D array view, shared by every layer of the array for packed textures
+		VkImageView GetImageView();
+		TextureColorSpace GetColorSpace() const { return _colorSpace; }
+		bool IsResident() const { return _image != nullptr || IsPacked(); }
+		bool IsPacked() const { return _arraySlot.image != nullptr; }
+		// slot in the bindless texture table, only valid when bindless textures are enabled. Packed textures share the slot of their array.
+		uint32_t GetTextureIndex() const;
+		// layer of the view the shader samples, 0 unless packed
+		uint32_t GetTextureLayer() const { return _arraySlot.layer; }
+		// bytes of device memory behind the image, 0 while loading, the layer's share of the array when packed
+		uint64_t GetMemorySize() const;
+
+		bool IsStreamed() const { return _streamSource != nullptr; }
+		bool IsStreamInPending() const { return _streamIn.valid(); }
+		// levels of the full chain, resident or not
+		uint32_t GetMipCount() const;
+		// finest level the image holds
+		uint32_t GetResidentMip() const { return _residentMip; }
+		// finest level of the mip tail, streamed textures never evict further
+		uint32_t GetTailMip() const { return _tailMip; }
+
+#pragma endregion
+
+	private:
+		// empty for the placeholder
+		std::string _file;
+		Engine::Image* _image = nullptr;
+		// used instead of _image when the texture is packed
+		Engine::TextureArraySlot _arraySlot;
+		TextureColorSpace _colorSpace;
+		uint32_t _textureIndex = 0;
+		// valid until the decode has been uploaded
+		std::future<DecodedTexture> _decode;
+
+		// nullptr when the whole chain is resident
+		std::shared_ptr<TextureCache> _streamSource;
+		uint32_t _residentMip = 0;
+		uint32_t _tailMip = 0;
+		uint32_t _requestedMip = MAX_TEXTURE_MIPS;
+		// levels [_streamInMip, _residentMip) being read, valid while a read is pending
+		std::future<DecodedTexture> _streamIn;
+		uint32_t _streamInMip = 0;
+	};
+}
@@ -0,0 +1,181 @@
+#include "pch.h"
+#include "TextureArrayPool.h"
+#include "Image.h"
+#include "Buffer.h"
+#include "Queue.h"
+#include "BindlessTextureTable.h"
+#include "Descriptors.h"
+
+#include "Application.h"
+#include "Constants.h"
+
+#include <algorithm>
+
+namespace
+{
+	VkImageMemoryBarrier GetLayerBarrier(VkImage image, uint32_t layer, uint32_t layerCount, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = layer;
+		barrier.subresourceRange.layerCount = layerCount;
+		return barrier;
+	}
+
+	uint32_t GetLevelSize(uint32_t size, uint32_t level)
+	{
+		return std::max(size >> level, 1u);
+	}
+}
+
+Engine::TextureArrayPool::TextureArrayPool()
+{
+}
+
+Engine::TextureArrayPool::~TextureArrayPool()
+{
+	for (TextureArray* array : _arrays)
+		DestroyArray(array);
+}
+
+bool Engine::TextureArrayPool::CanPack(uint32_t width, uint32_t height, uint32_t levelCount)
+{
+	return std::max(width, height) <= TEXTURE_ARRAY_MAX_SIZE && levelCount == Image::GetMipLevelCount(width, height);
+}
+
+Engine::TextureArraySlot Engine::TextureArrayPool::Allocate(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, Buffer* stagingBuffer, const VkDeviceSize* levelOffsets)
+{
+	auto it = std::find_if(_arrays.begin(), _arrays.end(), [format, width, height, levelCount](const TextureArray* array)
+	{
+		return !array->freeLayers.empty() && array->image->GetImageFormat() == format && array->image->GetWidth() == width
+			&& array->image->GetHeight() == height && array->image->GetMipLevels() == levelCount;
+	});
+	TextureArray* array = it != _arrays.end() ? *it : CreateArray(format, width, height, levelCount);
+
+	TextureArraySlot slot;
+	slot.image = array->image;
+	slot.layer = array->freeLayers.back();
+	slot.view = array->image->GetImageView();
+	slot.textureIndex = array->textureIndex;
+	UploadLayer(slot.image, slot.layer, stagingBuffer, levelOffsets);
+
+	array->freeLayers.pop_back();
+	_layerCount++;
+	return slot;
+}
+
+void Engine::TextureArrayPool::Free(const TextureArraySlot& slot)
+{
+	auto it = std::find_if(_arrays.begin(), _arrays.end(), [&slot](const TextureArray* array) { return array->image == slot.image; });
+	if (it == _arrays.end())
+		return;
+
+	TextureArray* array = *it;
+	array->freeLayers.push_back(slot.layer);
+	_layerCount--;
+
+	if (array->freeLayers.size() == TEXTURE_ARRAY_LAYERS)
+	{
+		_arrays.erase(it);
+		DestroyArray(array);
+	}
+}
+
+uint64_t Engine::TextureArrayPool::GetLayerMemorySize(const TextureArraySlot& slot)
+{
+	return slot.image->GetMemorySize() / slot.image->GetArrayLayers();
+}
+
+Engine::TextureArrayPool::TextureArray* Engine::TextureArrayPool::CreateArray(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+	uint32_t indices[] = { Application::s_transferQueue->GetQueueFamilyIndex(), Application::s_graphicsQueue->GetQueueFamilyIndex() };
+
+	Image* image = new Image();
+	EngineImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.width = width;
+	imageCreateInfo.height = height;
+	imageCreateInfo.imageFormat = format;
+	imageCreateInfo.imageTiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usageFlags = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	imageCreateInfo.queueFamilyIndexCount = 2;
+	imageCreateInfo.queueFamilyIndices = indices;
+	imageCreateInfo.mipLevels = levelCount;
+	imageCreateInfo.arrayLayers = TEXTURE_ARRAY_LAYERS;
+	image->CreateImage(&imageCreateInfo);
+	image->CreateImageView(VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+
+	// Materials bind the view of every layer, so the layers nothing was copied into yet have to be in the sampled layout
+	// as well. Their contents are undefined, no draw selects them.
+	VkCommandBuffer commandBuffer = Application::BeginSingleTimeCommands();
+	VkImageMemoryBarrier barrier = GetLayerBarrier(image->GetImage(), 0, TEXTURE_ARRAY_LAYERS, levelCount,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	Application::EndSingleTimeCommands(commandBuffer);
+
+	TextureArray* array = new TextureArray();
+	array->image = image;
+	// one slot for every layer, the draws pick theirs by layer index
+	if (Application::s_bindlessTextures != nullptr)
+	{
+		array->textureIndex = Application::s_bindlessTextures->RegisterTexture(image->GetImageView());
+	}
+	// handed out from the back, lowest layer first
+	for (uint32_t layer = TEXTURE_ARRAY_LAYERS; layer > 0; layer--)
+		array->freeLayers.push_back(layer - 1);
+
+	_arrays.push_back(array);
+	return array;
+}
+
+void Engine::TextureArrayPool::DestroyArray(TextureArray* array)
+{
+	if (Application::s_bindlessTextures != nullptr)
+	{
+		Application::s_bindlessTextures->UnregisterTexture(array->textureIndex);
+	}
+	// cached material sets bind the view, they go before it
+	if (Application::s_descriptorSetCache != nullptr)
+	{
+		Application::s_descriptorSetCache->InvalidateImageView(array->image->GetImageView());
+	}
+
+	delete array->image;
+	delete array;
+}
+
+void Engine::TextureArrayPool::UploadLayer(Image* image, uint32_t layer, Buffer* stagingBuffer, const VkDeviceSize* levelOffsets)
+{
+	uint32_t levelCount = image->GetMipLevels();
+	std::vector<VkBufferImageCopy> regions(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		regions[level].bufferOffset = levelOffsets[level];
+		regions[level].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, layer, 1 };
+		regions[level].imageExtent = { GetLevelSize(image->GetWidth(), level), GetLevelSize(image->GetHeight(), level), 1 };
+	}
+
+	// only the written layer leaves the sampled layout, the other layers keep being sampled
+	VkCommandBuffer commandBuffer = Application::BeginSingleTimeCommands();
+	VkImageMemoryBarrier barrier = GetLayerBarrier(image->GetImage(), layer, 1, levelCount,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer->GetBuffer(), image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+
+	barrier = GetLayerBarrier(image->GetImage(), layer, 1, levelCount,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	Application::EndSingleTimeCommands(commandBuffer);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+namespace Engine
+{
+	class Image;
+	class Buffer;
+
+	// Layer of a shared array image handed to one small texture
+	struct TextureArraySlot
+	{
+		Image* image = nullptr;
+		uint32_t layer = 0;
+		// the array view every layer shares, owned by the image
+		VkImageView view = VK_NULL_HANDLE;
+		// slot of the array view in the bindless texture table, only valid when bindless textures are enabled
+		uint32_t textureIndex = 0;
+	};
+
+	// Packs small textures of the same format, size and level count as layers of shared 2D array images,
+	// so up to TEXTURE_ARRAY_LAYERS textures take one image, one allocation and one bindless slot or material set.
+	// Draws bind the array view and select their layer with DrawPushConstants::textureLayer, meshes need no
+	// UV remapping, and since every layer has its own mip chain there is no bleeding between neighbours to pad against.
+	// Main thread only.
+	class TextureArrayPool
+	{
+	public:
+		TextureArrayPool();
+		~TextureArrayPool();
+
+		// Small enough for an array and with its whole mip chain
+		static bool CanPack(uint32_t width, uint32_t height, uint32_t levelCount);
+
+		// Copies the staged levels into a free layer of an array of the same kind, creating the array when all are taken.
+		// levelOffsets holds the staging offset of every level. Waits for the graphics queue.
+		TextureArraySlot Allocate(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, Buffer* stagingBuffer, const VkDeviceSize* levelOffsets);
+		// Hands the layer back, no frame in flight may sample it anymore.
+		// Arrays without layers in use are destroyed along with their bindless slot and cached material sets.
+		void Free(const TextureArraySlot& slot);
+
+		// Share of the array memory one layer accounts for
+		static uint64_t GetLayerMemorySize(const TextureArraySlot& slot);
+
+	private:
+		struct TextureArray
+		{
+			Image* image;
+			uint32_t textureIndex = 0;
+			std::vector<uint32_t> freeLayers;
+		};
+
+		TextureArray* CreateArray(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount);
+		void DestroyArray(TextureArray* array);
+		void UploadLayer(Image* image, uint32_t layer, Buffer* stagingBuffer, const VkDeviceSize* levelOffsets);
+
+	public:
+#pragma region Getters
+
+		size_t GetArrayCount() const { return _arrays.size(); }
+		// layers handed out over every array
+		uint32_t GetLayerCount() const { return _layerCount; }
+
+#pragma endregion
+
+	private:
+		std::vector<TextureArray*> _arrays;
+		uint32_t _layerCount = 0;
+	};
+}
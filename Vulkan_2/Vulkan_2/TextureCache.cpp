@@ -0,0 +1,304 @@
+#include "pch.h"
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include "Image.h"
+#include "BlockCompression.h"
+
+#include <filesystem>
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	// File header and index of the KTX 2.0 specification
+	struct Ktx2Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must match the file layout");
+
+	struct Ktx2LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	// Value of the TEXTURE_CACHE_STAMP_KEY entry
+	struct TextureCacheStamp
+	{
+		uint32_t version;
+		uint32_t reserved;
+		Resource::MeshSourceStamp source;
+	};
+
+	// Values of the Khronos Data Format specification used by the basic descriptor block
+	const uint32_t KHR_DF_MODEL_RGBSDA = 1;
+	const uint32_t KHR_DF_MODEL_BC1A = 128;
+	const uint32_t KHR_DF_MODEL_BC3 = 130;
+	const uint32_t KHR_DF_MODEL_BC5 = 132;
+	const uint32_t KHR_DF_MODEL_BC7 = 134;
+	const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+	const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+	const uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+	struct DataFormatSample
+	{
+		uint32_t channel;
+		uint32_t bitOffset;
+		uint32_t bitLength;
+		uint32_t upper;
+	};
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Basic data format descriptor of the format, prefixed with the total size as stored in the file
+	std::vector<uint32_t> GetDataFormatDescriptor(VkFormat format)
+	{
+		uint32_t model = KHR_DF_MODEL_RGBSDA;
+		uint32_t blockDimensions = 0;
+		uint32_t bytesPerBlock = 4;
+		std::vector<DataFormatSample> samples;
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			model = KHR_DF_MODEL_BC1A;
+			samples = { { 0, 0, 64, UINT32_MAX } };
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			model = KHR_DF_MODEL_BC3;
+			samples = { { KHR_DF_CHANNEL_ALPHA, 0, 64, UINT32_MAX }, { 0, 64, 64, UINT32_MAX } };
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			model = KHR_DF_MODEL_BC5;
+			samples = { { 0, 0, 64, UINT32_MAX }, { 1, 64, 64, UINT32_MAX } };
+			break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			model = KHR_DF_MODEL_BC7;
+			samples = { { 0, 0, 128, UINT32_MAX } };
+			break;
+		default:
+			samples = { { 0, 0, 8, 255 }, { 1, 8, 8, 255 }, { 2, 16, 8, 255 }, { KHR_DF_CHANNEL_ALPHA, 24, 8, 255 } };
+			break;
+		}
+		if (Resource::BlockCompression::IsBlockCompressed(format))
+		{
+			// 4x4 texel blocks, stored as size - 1
+			blockDimensions = 3 | (3 << 8);
+			bytesPerBlock = static_cast<uint32_t>(Resource::BlockCompression::GetLevelSize(format, 4, 4));
+		}
+		bool bSrgb = Resource::BlockCompression::IsSrgb(format);
+
+		std::vector<uint32_t> words;
+		words.push_back(0);
+		// vendor and descriptor type 0 is the Khronos basic block, version 2, 24 bytes plus 16 per sample
+		words.push_back(0);
+		words.push_back(2 | (static_cast<uint32_t>(24 + 16 * samples.size()) << 16));
+		words.push_back(model | (KHR_DF_PRIMARIES_BT709 << 8) | ((bSrgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+		words.push_back(blockDimensions);
+		words.push_back(bytesPerBlock);
+		words.push_back(0);
+		for (const DataFormatSample& sample : samples)
+		{
+			// alpha is never sRGB encoded
+			uint32_t channelType = sample.channel | (bSrgb && sample.channel == KHR_DF_CHANNEL_ALPHA ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0);
+			words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (channelType << 24));
+			words.push_back(0);
+			words.push_back(0);
+			words.push_back(sample.upper);
+		}
+		words[0] = static_cast<uint32_t>(words.size() * sizeof(uint32_t));
+		return words;
+	}
+}
+
+Resource::TextureCache::TextureCache()
+{
+	_file = new Engine::MappedFile();
+}
+
+Resource::TextureCache::~TextureCache()
+{
+	delete _file;
+}
+
+bool Resource::TextureCache::Open(const char* sourceFile)
+{
+	if (!_file->Open(GetCachePath(sourceFile)))
+		return false;
+
+	if (!IsValid() || !MeshCache::IsSourceCurrent(sourceFile, _source))
+	{
+		_file->Close();
+		_data = TextureDataView();
+		return false;
+	}
+	return true;
+}
+
+void Resource::TextureCache::Write(const char* sourceFile, const TextureDataView& data)
+{
+	TextureCacheStamp stamp{};
+	stamp.version = TEXTURE_CACHE_VERSION;
+	if (!MeshCache::GetSourceStamp(sourceFile, stamp.source, true))
+		return;
+
+	std::vector<uint32_t> descriptor = GetDataFormatDescriptor(data.format);
+
+	// one key/value entry: length, key with its terminator, value, padding to 4 bytes
+	uint32_t keySize = static_cast<uint32_t>(strlen(TEXTURE_CACHE_STAMP_KEY) + 1);
+	uint32_t entrySize = keySize + sizeof(TextureCacheStamp);
+
+	Ktx2Header header{};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = data.format;
+	header.typeSize = 1;
+	header.pixelWidth = data.width;
+	header.pixelHeight = data.height;
+	header.faceCount = 1;
+	header.levelCount = data.levelCount;
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + data.levelCount * sizeof(Ktx2LevelIndex));
+	header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = static_cast<uint32_t>(AlignUp(sizeof(uint32_t) + entrySize, 4));
+
+	// the smallest level comes first in the file
+	std::vector<Ktx2LevelIndex> levelIndex(data.levelCount);
+	uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+	for (uint32_t level = data.levelCount; level-- > 0;)
+	{
+		offset = AlignUp(offset, TEXTURE_CACHE_ALIGNMENT);
+		levelIndex[level].byteOffset = offset;
+		levelIndex[level].byteLength = data.levels[level].size;
+		levelIndex[level].uncompressedByteLength = data.levels[level].size;
+		offset += data.levels[level].size;
+	}
+
+	std::vector<char> fileData(static_cast<size_t>(offset), 0);
+	memcpy(fileData.data(), &header, sizeof(header));
+	memcpy(fileData.data() + sizeof(header), levelIndex.data(), levelIndex.size() * sizeof(Ktx2LevelIndex));
+	memcpy(fileData.data() + header.dfdByteOffset, descriptor.data(), header.dfdByteLength);
+	char* entry = fileData.data() + header.kvdByteOffset;
+	memcpy(entry, &entrySize, sizeof(entrySize));
+	memcpy(entry + sizeof(entrySize), TEXTURE_CACHE_STAMP_KEY, keySize);
+	memcpy(entry + sizeof(entrySize) + keySize, &stamp, sizeof(stamp));
+	for (uint32_t level = 0; level < data.levelCount; level++)
+		memcpy(fileData.data() + levelIndex[level].byteOffset, data.levels[level].data, data.levels[level].size);
+
+	// Write to a temporary file first so a crash never leaves a truncated cache behind
+	std::string cachePath = GetCachePath(sourceFile);
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return;
+		file.write(fileData.data(), fileData.size());
+		if (!file.good())
+			return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+		std::filesystem::remove(tempPath, error);
+}
+
+std::string Resource::TextureCache::GetCachePath(const char* sourceFile)
+{
+	return std::string(sourceFile) + ".ktx2";
+}
+
+bool Resource::TextureCache::IsValid()
+{
+	uint64_t fileSize = _file->GetSize();
+	if (fileSize < sizeof(Ktx2Header))
+		return false;
+
+	Ktx2Header header;
+	memcpy(&header, _file->GetData(), sizeof(header));
+	if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		return false;
+
+	// only plain 2D images with a mip chain are cached
+	if (header.supercompressionScheme != 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1)
+		return false;
+	if (header.pixelWidth == 0 || header.pixelHeight == 0 || BlockCompression::GetLevelSize(static_cast<VkFormat>(header.vkFormat), 1, 1) == 0)
+		return false;
+	if (header.levelCount == 0 || header.levelCount > MAX_TEXTURE_MIPS || header.levelCount > Engine::Image::GetMipLevelCount(header.pixelWidth, header.pixelHeight))
+		return false;
+
+	auto isInside = [fileSize](uint64_t offset, uint64_t size)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	};
+
+	if (!isInside(sizeof(Ktx2Header), header.levelCount * sizeof(Ktx2LevelIndex)))
+		return false;
+
+	_data = TextureDataView();
+	_data.format = static_cast<VkFormat>(header.vkFormat);
+	_data.width = header.pixelWidth;
+	_data.height = header.pixelHeight;
+	_data.levelCount = header.levelCount;
+	for (uint32_t level = 0; level < header.levelCount; level++)
+	{
+		Ktx2LevelIndex index;
+		memcpy(&index, _file->GetData() + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+
+		TextureLevel& data = _data.levels[level];
+		data.width = std::max(header.pixelWidth >> level, 1u);
+		data.height = std::max(header.pixelHeight >> level, 1u);
+		data.size = BlockCompression::GetLevelSize(_data.format, data.width, data.height);
+		if (index.byteLength != data.size || !isInside(index.byteOffset, index.byteLength))
+			return false;
+		data.data = _file->GetData() + index.byteOffset;
+	}
+
+	// look for the stamp among the key/value entries
+	if (!isInside(header.kvdByteOffset, header.kvdByteLength))
+		return false;
+	const uint8_t* entry = _file->GetData() + header.kvdByteOffset;
+	const uint8_t* end = entry + header.kvdByteLength;
+	uint32_t keySize = static_cast<uint32_t>(strlen(TEXTURE_CACHE_STAMP_KEY) + 1);
+	while (end - entry >= static_cast<ptrdiff_t>(sizeof(uint32_t)))
+	{
+		uint32_t entrySize;
+		memcpy(&entrySize, entry, sizeof(entrySize));
+		entry += sizeof(entrySize);
+		if (entrySize > static_cast<uint64_t>(end - entry))
+			return false;
+
+		if (entrySize == keySize + sizeof(TextureCacheStamp) && memcmp(entry, TEXTURE_CACHE_STAMP_KEY, keySize) == 0)
+		{
+			TextureCacheStamp stamp;
+			memcpy(&stamp, entry + keySize, sizeof(stamp));
+			_source = stamp.source;
+			return stamp.version == TEXTURE_CACHE_VERSION;
+		}
+		entry += std::min<uint64_t>(AlignUp(entrySize, 4), end - entry);
+	}
+	return false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+
+#include "MeshCache.h"
+
+namespace Engine
+{
+	class MappedFile;
+}
+
+namespace Resource
+{
+	// Texture cache (.ktx2) written next to the source image.
+	// A plain KTX 2.0 container without supercompression: one 2D image with its mip chain, levels stored smallest first
+	// as the format requires and every level already in its GPU layout (RGBA8 or BCn blocks, see BlockCompression.h).
+	// The source stamp is kept in a key/value entry, so the files stay readable by the standard KTX tools.
+	const char* const TEXTURE_CACHE_STAMP_KEY = "VulkanEngine.source";
+	// bump whenever the meaning of the cached data changes
+	const uint32_t TEXTURE_CACHE_VERSION = 1;
+	const uint64_t TEXTURE_CACHE_ALIGNMENT = 16;
+	const uint32_t MAX_TEXTURE_MIPS = 16;
+
+	struct TextureLevel
+	{
+		const uint8_t* data = nullptr;
+		uint64_t size = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	// GPU ready levels of a texture, pointing either into a cache mapping or into freshly decoded pixels
+	struct TextureDataView
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// levels[0] is the full resolution image
+		uint32_t levelCount = 0;
+		std::array<TextureLevel, MAX_TEXTURE_MIPS> levels{};
+	};
+
+	// Read only view of a mapped .ktx2 file, the levels point into the mapping
+	class TextureCache
+	{
+	public:
+		TextureCache();
+		~TextureCache();
+
+		// Maps the cache of the source image. Returns false when the cache is missing, corrupt,
+		// uses a format the engine cannot upload or was built from a different source.
+		bool Open(const char* sourceFile);
+
+		// Writes the cache of the source image, failures are ignored since the cache is only an optimization
+		static void Write(const char* sourceFile, const TextureDataView& data);
+
+		static std::string GetCachePath(const char* sourceFile);
+
+	private:
+		// also fills the data view and the source stamp
+		bool IsValid();
+
+	public:
+#pragma region Getters
+
+		const TextureDataView& GetDataView() const { return _data; }
+
+#pragma endregion
+
+	private:
+		Engine::MappedFile* _file;
+		TextureDataView _data;
+		MeshSourceStamp _source;
+	};
+}
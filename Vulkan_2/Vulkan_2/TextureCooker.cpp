@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "TextureCooker.h"
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <iostream>
+#include <stb_image.h>
+
+namespace
+{
+	float SrgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LinearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+}
+
+void Resource::TextureCooker::BuildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, bool bSrgb, std::vector<std::vector<uint8_t>>& levels)
+{
+	uint32_t levelCount = std::min(Engine::Image::GetMipLevelCount(width, height), MAX_TEXTURE_MIPS);
+	levels.assign(levelCount, std::vector<uint8_t>());
+	levels[0].assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+	// byte to linear value of every channel, alpha is never sRGB encoded
+	std::array<float, 256> decodeColor;
+	std::array<float, 256> decodeAlpha;
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		decodeAlpha[i] = i / 255.0f;
+		decodeColor[i] = bSrgb ? SrgbToLinear(decodeAlpha[i]) : decodeAlpha[i];
+	}
+
+	for (uint32_t level = 1; level < levelCount; level++)
+	{
+		uint32_t srcWidth = std::max(width >> (level - 1), 1u);
+		uint32_t srcHeight = std::max(height >> (level - 1), 1u);
+		uint32_t dstWidth = std::max(width >> level, 1u);
+		uint32_t dstHeight = std::max(height >> level, 1u);
+		const std::vector<uint8_t>& src = levels[level - 1];
+		std::vector<uint8_t>& dst = levels[level];
+		dst.resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				// 2x2 box, clamped for levels that only shrink along one axis
+				uint32_t x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+				uint32_t y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+				const uint8_t* texels[4] = {
+					&src[(static_cast<size_t>(y0) * srcWidth + x0) * 4],
+					&src[(static_cast<size_t>(y0) * srcWidth + x1) * 4],
+					&src[(static_cast<size_t>(y1) * srcWidth + x0) * 4],
+					&src[(static_cast<size_t>(y1) * srcWidth + x1) * 4],
+				};
+
+				uint8_t* out = &dst[(static_cast<size_t>(y) * dstWidth + x) * 4];
+				for (uint32_t channel = 0; channel < 4; channel++)
+				{
+					const std::array<float, 256>& decode = channel == 3 ? decodeAlpha : decodeColor;
+					float value = (decode[texels[0][channel]] + decode[texels[1][channel]] + decode[texels[2][channel]] + decode[texels[3][channel]]) * 0.25f;
+					if (bSrgb && channel != 3)
+						value = LinearToSrgb(value);
+					out[channel] = static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+				}
+			}
+		}
+	}
+}
+
+bool Resource::TextureCooker::Cook(const char* file, TextureEncoding encoding, bool bSrgb, Engine::ThreadPool* threadPool)
+{
+	VkFormat format = BlockCompression::GetFormat(encoding, bSrgb);
+	if (format == VK_FORMAT_UNDEFINED)
+		return false;
+
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(file, &width, &height, &channels, STBI_rgb_alpha);
+	if (pixels == nullptr)
+		return false;
+
+	std::vector<std::vector<uint8_t>> levels;
+	BuildMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), bSrgb, levels);
+	stbi_image_free(pixels);
+
+	TextureDataView data;
+	data.format = format;
+	data.width = static_cast<uint32_t>(width);
+	data.height = static_cast<uint32_t>(height);
+	data.levelCount = static_cast<uint32_t>(levels.size());
+	// the blocks are encoded from the filtered RGBA8 levels, never from a coarser encoded level
+	std::vector<std::vector<uint8_t>> encodedLevels(levels.size());
+	for (uint32_t level = 0; level < data.levelCount; level++)
+	{
+		TextureLevel& levelData = data.levels[level];
+		levelData.width = std::max(data.width >> level, 1u);
+		levelData.height = std::max(data.height >> level, 1u);
+		levelData.size = BlockCompression::GetLevelSize(format, levelData.width, levelData.height);
+		if (BlockCompression::IsBlockCompressed(format))
+		{
+			encodedLevels[level].resize(static_cast<size_t>(levelData.size));
+			BlockCompression::CompressLevel(format, levels[level].data(), levelData.width, levelData.height, encodedLevels[level].data(), threadPool);
+			levelData.data = encodedLevels[level].data();
+		}
+		else
+		{
+			levelData.data = levels[level].data();
+		}
+	}
+
+	TextureCache::Write(file, data);
+	return true;
+}
+
+int Resource::TextureCooker::RunCookTextures(int argumentCount, char** arguments)
+{
+	Engine::ThreadPool threadPool;
+	TextureEncoding encoding = TextureEncoding::BC7;
+	// textures are color data unless stated otherwise, the material samples them as sRGB
+	bool bSrgb = true;
+	int failures = 0;
+	for (int i = 0; i < argumentCount; i++)
+	{
+		std::string argument = arguments[i];
+		if (argument == "--linear")
+		{
+			bSrgb = false;
+			continue;
+		}
+		if (argument == "--format" && i + 1 < argumentCount)
+		{
+			std::string name = arguments[++i];
+			if (name == "rgba8")
+				encoding = TextureEncoding::RGBA8;
+			else if (name == "bc1")
+				encoding = TextureEncoding::BC1;
+			else if (name == "bc3")
+				encoding = TextureEncoding::BC3;
+			else if (name == "bc5")
+				encoding = TextureEncoding::BC5;
+			else if (name == "bc7")
+				encoding = TextureEncoding::BC7;
+			else
+			{
+				std::cerr << "Unknown texture format " << name << std::endl;
+				return EXIT_FAILURE;
+			}
+			continue;
+		}
+
+		if (Cook(arguments[i], encoding, bSrgb, &threadPool))
+		{
+			std::cout << "Cooked " << TextureCache::GetCachePath(arguments[i]) << std::endl;
+		}
+		else
+		{
+			std::cerr << "Failed to cook " << arguments[i] << std::endl;
+			failures++;
+		}
+	}
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "TextureCache.h"
+#include "BlockCompression.h"
+
+namespace Resource
+{
+	// Offline texture processing, run instead of the renderer through Vulkan_2.exe --cook-textures (see main.cpp).
+	// Cooked textures load with their whole mip chain from the texture cache and skip the decode and the GPU mip generation.
+	namespace TextureCooker
+	{
+		// Full mip chain of an RGBA8 image with a 2x2 box filter, the same filter the compute mip generator uses.
+		// sRGB images are averaged in linear space. levels[0] is a copy of the input.
+		void BuildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, bool bSrgb, std::vector<std::vector<uint8_t>>& levels);
+
+		// Decodes the image, builds its mip chain, encodes every level and writes the texture cache next to it.
+		// Returns false when the image cannot be decoded or the encoding has no variant in the requested color space.
+		bool Cook(const char* file, TextureEncoding encoding, bool bSrgb, Engine::ThreadPool* threadPool = nullptr);
+
+		// Arguments: [--format rgba8|bc1|bc3|bc5|bc7] [--linear] files..., the options apply to the files after them.
+		// Defaults to BC7 in sRGB.
+		int RunCookTextures(int argumentCount, char** arguments);
+	}
+}
@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+#include "Texture.h"
+#include "Image.h"
+#include "Buffer.h"
+#include "BindlessTextureTable.h"
+#include "Application.h"
+#include "Constants.h"
+
+#include <algorithm>
+
+Engine::TextureStreamer::TextureStreamer()
+{
+}
+
+Engine::TextureStreamer::~TextureStreamer()
+{
+	// the device is idle by now
+	ReleaseRetired(true);
+}
+
+void Engine::TextureStreamer::Register(Resource::Texture* texture)
+{
+	_textures.push_back({ texture, texture->GetTailMip(), _frame });
+}
+
+void Engine::TextureStreamer::Unregister(Resource::Texture* texture)
+{
+	auto it = std::find_if(_textures.begin(), _textures.end(), [texture](const StreamedTexture& streamed) { return streamed.texture == texture; });
+	if (it != _textures.end())
+	{
+		*it = _textures.back();
+		_textures.pop_back();
+	}
+}
+
+void Engine::TextureStreamer::Retire(Image* image, uint32_t textureIndex, std::unique_ptr<Buffer> stagingBuffer)
+{
+	_retiredImages.push_back({ image, textureIndex, std::move(stagingBuffer), static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) });
+}
+
+void Engine::TextureStreamer::ReleaseRetired(bool bAll)
+{
+	for (auto it = _retiredImages.begin(); it != _retiredImages.end();)
+	{
+		if (bAll || it->framesLeft-- == 0)
+		{
+			if (Application::s_bindlessTextures != nullptr)
+			{
+				Application::s_bindlessTextures->UnregisterTexture(it->textureIndex);
+			}
+			delete it->image;
+			it = _retiredImages.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+bool Engine::TextureStreamer::Update(VkCommandBuffer commandBuffer)
+{
+	_frame++;
+	_frameUploadSize = 0;
+	bool bReplaced = false;
+
+	ReleaseRetired(false);
+
+	// levels read since the last frame, each one is a swap
+	for (StreamedTexture& streamed : _textures)
+	{
+		if (streamed.texture->FinishStreamIn(commandBuffer))
+			bReplaced = true;
+	}
+
+	// a texture no draw asked for only needs its tail, its levels stay until the memory is needed
+	_memoryUsage = 0;
+	for (StreamedTexture& streamed : _textures)
+	{
+		Resource::Texture* texture = streamed.texture;
+		uint32_t requested = texture->ConsumeRequestedMip();
+		if (requested < texture->GetMipCount())
+		{
+			streamed.wantedMip = std::min(requested, texture->GetTailMip());
+			streamed.lastRequestFrame = _frame;
+		}
+		else
+			streamed.wantedMip = texture->GetTailMip();
+
+		_memoryUsage += texture->GetMemorySize();
+	}
+
+	if (_memoryUsage > TEXTURE_STREAMING_MEMORY_BUDGET && Evict(commandBuffer, TEXTURE_STREAMING_MEMORY_BUDGET))
+		bReplaced = true;
+
+	// one level per texture and frame, the ones furthest below their demand first
+	std::vector<StreamedTexture*> candidates;
+	for (StreamedTexture& streamed : _textures)
+	{
+		if (streamed.texture->GetResidentMip() > streamed.wantedMip && !streamed.texture->IsStreamInPending())
+			candidates.push_back(&streamed);
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		return a->texture->GetResidentMip() - a->wantedMip > b->texture->GetResidentMip() - b->wantedMip;
+	});
+
+	for (StreamedTexture* streamed : candidates)
+	{
+		Resource::Texture* texture = streamed->texture;
+		uint32_t mip = texture->GetResidentMip() - 1;
+		uint64_t levelSize = texture->GetLevelRangeSize(mip) - texture->GetLevelRangeSize(mip + 1);
+
+		// the first level of a frame may exceed the budget, a level larger than it would never load otherwise
+		if (_frameUploadSize > 0 && _frameUploadSize + levelSize > TEXTURE_STREAMING_FRAME_BUDGET)
+			continue;
+		if (_memoryUsage + levelSize > TEXTURE_STREAMING_MEMORY_BUDGET)
+		{
+			if (Evict(commandBuffer, TEXTURE_STREAMING_MEMORY_BUDGET - std::min(levelSize, TEXTURE_STREAMING_MEMORY_BUDGET)))
+				bReplaced = true;
+			if (_memoryUsage + levelSize > TEXTURE_STREAMING_MEMORY_BUDGET)
+				continue;
+		}
+
+		if (texture->StreamIn(mip))
+		{
+			_frameUploadSize += levelSize;
+			_memoryUsage += levelSize;
+		}
+	}
+
+	return bReplaced;
+}
+
+bool Engine::TextureStreamer::Evict(VkCommandBuffer commandBuffer, uint64_t budget)
+{
+	std::vector<StreamedTexture*> candidates;
+	for (StreamedTexture& streamed : _textures)
+	{
+		if (streamed.texture->GetResidentMip() < streamed.wantedMip && !streamed.texture->IsStreamInPending())
+			candidates.push_back(&streamed);
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b) { return a->lastRequestFrame < b->lastRequestFrame; });
+
+	bool bEvicted = false;
+	for (StreamedTexture* streamed : candidates)
+	{
+		if (_memoryUsage <= budget)
+			break;
+
+		Resource::Texture* texture = streamed->texture;
+		uint64_t before = texture->GetMemorySize();
+		texture->Evict(commandBuffer, streamed->wantedMip);
+		_memoryUsage = _memoryUsage - before + texture->GetMemorySize();
+		bEvicted = true;
+	}
+	return bEvicted;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <list>
+#include <memory>
+
+namespace Resource
+{
+	class Texture;
+}
+
+namespace Engine
+{
+	class Image;
+	class Buffer;
+
+	// Keeps the finer mip levels of streamed textures resident where draws need them.
+	// Draws record the coverage of their textures (Texture::RequestScreenSize), once per frame Update turns that into the level
+	// each texture wants, evicts levels nobody asked for recently while over TEXTURE_STREAMING_MEMORY_BUDGET and starts reading
+	// the next finer level of the textures furthest below their demand within TEXTURE_STREAMING_FRAME_BUDGET.
+	// Every change swaps the texture image for one holding the new level range, so sampling never reaches a level
+	// that is not uploaded: the image itself is the minLod clamp. The copies are recorded ahead of the frame's draws
+	// and the old images stay alive until no frame in flight can sample them, nothing waits for the GPU.
+	// Main thread only.
+	class TextureStreamer
+	{
+	public:
+		TextureStreamer();
+		~TextureStreamer();
+
+		// Called by streamed textures once their mip tail is resident and when they are destroyed
+		void Register(Resource::Texture* texture);
+		void Unregister(Resource::Texture* texture);
+
+		// Call once per frame after the frame's fence has been waited on, with the frame's command buffer before its draws
+		// are recorded into it. Returns true when an image was replaced, descriptors written with the old views are stale then.
+		bool Update(VkCommandBuffer commandBuffer);
+
+		// Keeps a replaced image, its bindless slot and the staging buffer of its copy until no frame in flight uses them
+		void Retire(Image* image, uint32_t textureIndex, std::unique_ptr<Buffer> stagingBuffer);
+
+	private:
+		// Drops the levels finer than wanted of the least recently requested textures until the usage is down to the budget.
+		// Returns true when it evicted anything.
+		bool Evict(VkCommandBuffer commandBuffer, uint64_t budget);
+		// Frees the retired images no frame in flight can use anymore
+		void ReleaseRetired(bool bAll);
+
+	public:
+#pragma region Getters
+
+		size_t GetTextureCount() const { return _textures.size(); }
+		// device memory of the streamed textures, reads in flight included
+		uint64_t GetMemoryUsage() const { return _memoryUsage; }
+		// bytes of levels the last Update started reading
+		uint64_t GetFrameUploadSize() const { return _frameUploadSize; }
+
+#pragma endregion
+
+	private:
+		struct StreamedTexture
+		{
+			Resource::Texture* texture;
+			// finest level the draws asked for, the tail when there was no request this frame
+			uint32_t wantedMip;
+			uint64_t lastRequestFrame;
+		};
+
+		struct RetiredImage
+		{
+			Image* image;
+			uint32_t textureIndex;
+			std::unique_ptr<Buffer> stagingBuffer;
+			uint32_t framesLeft;
+		};
+
+		std::vector<StreamedTexture> _textures;
+		std::list<RetiredImage> _retiredImages;
+		uint64_t _frame = 0;
+		uint64_t _memoryUsage = 0;
+		uint64_t _frameUploadSize = 0;
+	};
+}
@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+
+Engine::ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+Engine::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_bStopping = true;
+	}
+	_condition.notify_all();
+
+	for (std::thread& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+void Engine::ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+	if (count == 0)
+		return;
+
+	std::atomic<size_t> nextIndex{ 0 };
+	auto runRange = [&nextIndex, count, &task]()
+	{
+		for (size_t i = nextIndex++; i < count; i = nextIndex++)
+		{
+			task(i);
+		}
+	};
+
+	// the calling thread takes one share, no point in waking more workers than there are items
+	size_t helperCount = std::min(static_cast<size_t>(_workers.size()), count - 1);
+	std::vector<std::future<void>> helpers;
+	helpers.reserve(helperCount);
+	for (size_t i = 0; i < helperCount; i++)
+	{
+		helpers.push_back(Submit(runRange));
+	}
+
+	std::exception_ptr exception;
+	try
+	{
+		runRange();
+	}
+	catch (...)
+	{
+		exception = std::current_exception();
+		// stop handing out items, the helpers finish the ones they already picked up
+		nextIndex = count;
+	}
+
+	// every helper has to be done before the captured references go out of scope.
+	// A helper still queued may sit behind this very worker, so queued tasks run here until it was picked up,
+	// once the queue is empty it is running somewhere and blocking on it is safe.
+	for (std::future<void>& helper : helpers)
+	{
+		while (helper.wait_for(std::chrono::seconds(0)) != std::future_status::ready && RunPendingTask())
+		{
+		}
+
+		try
+		{
+			helper.get();
+		}
+		catch (...)
+		{
+			if (!exception)
+				exception = std::current_exception();
+			nextIndex = count;
+		}
+	}
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+bool Engine::ThreadPool::RunPendingTask()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_tasks.empty())
+			return false;
+
+		task = std::move(_tasks.front());
+		_tasks.pop();
+	}
+	// packaged tasks, exceptions end up in their futures
+	task();
+	return true;
+}
+
+void Engine::ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this]() { return _bStopping || !_tasks.empty(); });
+			if (_bStopping && _tasks.empty())
+				return;
+
+			task = std::move(_tasks.front());
+			_tasks.pop();
+		}
+		task();
+	}
+}
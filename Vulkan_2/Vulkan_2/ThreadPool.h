@@ -0,0 +1,57 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <queue>
+
+namespace Engine
+{
+	// Fixed set of worker threads pulling tasks from one shared queue
+	class ThreadPool
+	{
+	public:
+		// 0 uses one thread per hardware thread minus the calling thread
+		ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		template<typename Task>
+		auto Submit(Task&& task) -> std::future<decltype(task())>
+		{
+			using Result = decltype(task());
+			auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+			std::future<Result> future = packagedTask->get_future();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_tasks.push([packagedTask]() { (*packagedTask)(); });
+			}
+			_condition.notify_one();
+			return future;
+		}
+
+		// Runs task(i) for every i in [0, count) and returns once all are done.
+		// The calling thread works on the range too, the first exception thrown by a task is rethrown here.
+		// Safe inside a pool task: while its helpers are still queued the caller runs queued tasks instead of blocking.
+		void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+	private:
+		void WorkerLoop();
+		// Runs the oldest queued task on the calling thread, false when the queue is empty
+		bool RunPendingTask();
+
+	public:
+#pragma region Getters
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(_workers.size()); }
+
+#pragma endregion
+
+	private:
+		std::vector<std::thread> _workers;
+		std::queue<std::function<void()>> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		bool _bStopping = false;
+	};
+}
@@ -1,2 +1,304 @@
 #include "pch.h"
-#include "Vertex.h"
\ No newline at end of file
+#include "Vertex.h"
+
+#include <glm/gtc/packing.hpp>
+
+static VkFormat GetPositionFormat(PositionFormat format)
+{
+	// 3 component 16 bit formats are rarely supported for vertex fetch, the fourth one is padding
+	return format == PositionFormat::Unorm16 ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+}
+
+static uint32_t GetPositionSize(PositionFormat format)
+{
+	return format == PositionFormat::Unorm16 ? 8 : 12;
+}
+
+static VkFormat GetTexCoordFormat(TexCoordFormat format)
+{
+	switch (format)
+	{
+	case TexCoordFormat::Float16: return VK_FORMAT_R16G16_SFLOAT;
+	case TexCoordFormat::Unorm16: return VK_FORMAT_R16G16_UNORM;
+	default: return VK_FORMAT_R32G32_SFLOAT;
+	}
+}
+
+static uint32_t GetTexCoordSize(TexCoordFormat format)
+{
+	return format == TexCoordFormat::Float32 ? 8 : 4;
+}
+
+static VkFormat GetColorFormat(ColorFormat format)
+{
+	return format == ColorFormat::Unorm8 ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+}
+
+static uint32_t GetColorSize(ColorFormat format)
+{
+	switch (format)
+	{
+	case ColorFormat::Float32: return 12;
+	case ColorFormat::Unorm8: return 4;
+	default: return 0;
+	}
+}
+
+uint32_t VertexFormat::GetKey() const
+{
+	return static_cast<uint32_t>(position) | (static_cast<uint32_t>(texCoord) << 8) | (static_cast<uint32_t>(color) << 16);
+}
+
+bool VertexFormat::FromKey(uint32_t key, VertexFormat& format)
+{
+	uint32_t positionValue = key & 0xFF;
+	uint32_t texCoordValue = (key >> 8) & 0xFF;
+	uint32_t colorValue = (key >> 16) & 0xFF;
+	if ((key >> 24) != 0 || positionValue > static_cast<uint32_t>(PositionFormat::Unorm16) ||
+		texCoordValue > static_cast<uint32_t>(TexCoordFormat::Unorm16) || colorValue > static_cast<uint32_t>(ColorFormat::Unorm8))
+		return false;
+
+	format.position = static_cast<PositionFormat>(positionValue);
+	format.texCoord = static_cast<TexCoordFormat>(texCoordValue);
+	format.color = static_cast<ColorFormat>(colorValue);
+	return true;
+}
+
+uint32_t VertexFormat::GetStreamCount() const
+{
+	return IsFull() ? 1 : 2;
+}
+
+uint32_t VertexFormat::GetStride(uint32_t stream) const
+{
+	if (IsFull())
+		return stream == 0 ? sizeof(Vertex) : 0;
+
+	if (stream == 0)
+		return GetPositionSize(position);
+	return stream == 1 ? GetTexCoordSize(texCoord) + GetColorSize(color) : 0;
+}
+
+std::vector<VkVertexInputBindingDescription> VertexFormat::GetBindingDescriptions(bool bPositionOnly) const
+{
+	if (IsFull())
+		return { Vertex::GetBindingDescription() };
+
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(bPositionOnly ? 1 : GetStreamCount());
+	for (uint32_t stream = 0; stream < bindingDescriptions.size(); stream++)
+	{
+		bindingDescriptions[stream].binding = stream;
+		bindingDescriptions[stream].stride = GetStride(stream);
+		bindingDescriptions[stream].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	}
+	return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexFormat::GetAttributeDescriptions(bool bPositionOnly) const
+{
+	if (IsFull())
+	{
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = Vertex::GetAttributeDescriptions();
+		// the interleaved stream still has to be bound, only the other attributes are left out
+		return std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.begin() + (bPositionOnly ? 1 : 3));
+	}
+
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(bPositionOnly ? 1 : 3);
+
+	// position
+	{
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = GetPositionFormat(position);
+		attributeDescriptions[0].offset = 0;
+	}
+
+	if (bPositionOnly)
+		return attributeDescriptions;
+
+	// color
+	{
+		if (HasColor())
+		{
+			attributeDescriptions[1].binding = 1;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = GetColorFormat(color);
+			attributeDescriptions[1].offset = GetTexCoordSize(texCoord);
+		}
+		else
+		{
+			// The vertex shader still declares the input, feed it the position. It is never read since
+			// the pipeline strips SHADER_FEATURE_VERTEX_COLOR for formats without colors
+			attributeDescriptions[1] = attributeDescriptions[0];
+			attributeDescriptions[1].location = 1;
+		}
+	}
+
+	// uv
+	{
+		attributeDescriptions[2].binding = 1;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = GetTexCoordFormat(texCoord);
+		attributeDescriptions[2].offset = 0;
+	}
+
+	return attributeDescriptions;
+}
+
+VertexFormat VertexFormat::Resolve(const std::vector<Vertex>& vertices) const
+{
+	VertexFormat resolved = *this;
+	if (texCoord == TexCoordFormat::Unorm16)
+	{
+		for (const Vertex& vertex : vertices)
+		{
+			if (vertex.texCoord.x < 0.0f || vertex.texCoord.x > 1.0f || vertex.texCoord.y < 0.0f || vertex.texCoord.y > 1.0f)
+			{
+				resolved.texCoord = TexCoordFormat::Float16;
+				break;
+			}
+		}
+	}
+	return resolved;
+}
+
+void VertexFormat::Encode(const std::vector<Vertex>& vertices, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+	std::array<std::vector<uint8_t>, MAX_VERTEX_STREAMS>& streams) const
+{
+	for (uint32_t stream = 0; stream < MAX_VERTEX_STREAMS; stream++)
+		streams[stream].assign(vertices.size() * GetStride(stream), 0);
+
+	if (IsFull())
+	{
+		memcpy(streams[0].data(), vertices.data(), streams[0].size());
+		return;
+	}
+
+	// flat axes quantize to 0, the dequantization scale for them is 0 as well
+	glm::vec3 extent = boundsMax - boundsMin;
+	glm::vec3 inverseExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+	uint32_t positionStride = GetStride(0);
+	uint32_t attributeStride = GetStride(1);
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& vertex = vertices[i];
+		uint8_t* out = streams[0].data() + i * positionStride;
+
+		if (position == PositionFormat::Unorm16)
+		{
+			glm::vec3 normalized = glm::clamp((vertex.pos - boundsMin) * inverseExtent, glm::vec3(0.0f), glm::vec3(1.0f));
+			uint16_t packed[4] = { glm::packUnorm1x16(normalized.x), glm::packUnorm1x16(normalized.y), glm::packUnorm1x16(normalized.z), 0 };
+			memcpy(out, packed, sizeof(packed));
+		}
+		else
+		{
+			float packed[3] = { vertex.pos.x, vertex.pos.y, vertex.pos.z };
+			memcpy(out, packed, sizeof(packed));
+		}
+
+		// uv first, then the color
+		out = streams[1].data() + i * attributeStride;
+
+		if (texCoord == TexCoordFormat::Float16)
+		{
+			uint16_t packed[2] = { glm::packHalf1x16(vertex.texCoord.x), glm::packHalf1x16(vertex.texCoord.y) };
+			memcpy(out, packed, sizeof(packed));
+		}
+		else if (texCoord == TexCoordFormat::Unorm16)
+		{
+			uint16_t packed[2] = { glm::packUnorm1x16(vertex.texCoord.x), glm::packUnorm1x16(vertex.texCoord.y) };
+			memcpy(out, packed, sizeof(packed));
+		}
+		else
+		{
+			float packed[2] = { vertex.texCoord.x, vertex.texCoord.y };
+			memcpy(out, packed, sizeof(packed));
+		}
+		out += GetTexCoordSize(texCoord);
+
+		if (color == ColorFormat::Unorm8)
+		{
+			uint32_t packed = glm::packUnorm4x8(glm::vec4(vertex.color, 1.0f));
+			memcpy(out, &packed, sizeof(packed));
+		}
+		else if (color == ColorFormat::Float32)
+		{
+			float packed[3] = { vertex.color.x, vertex.color.y, vertex.color.z };
+			memcpy(out, packed, sizeof(packed));
+		}
+	}
+}
+
+void VertexFormat::Decode(const std::array<const void*, MAX_VERTEX_STREAMS>& streams, uint64_t vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+	std::vector<Vertex>& vertices) const
+{
+	vertices.resize(static_cast<size_t>(vertexCount));
+
+	if (IsFull())
+	{
+		memcpy(vertices.data(), streams[0], vertices.size() * sizeof(Vertex));
+		return;
+	}
+
+	glm::vec3 extent = boundsMax - boundsMin;
+	uint32_t positionStride = GetStride(0);
+	uint32_t attributeStride = GetStride(1);
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		Vertex& vertex = vertices[i];
+		const uint8_t* in = static_cast<const uint8_t*>(streams[0]) + i * positionStride;
+
+		if (position == PositionFormat::Unorm16)
+		{
+			uint16_t packed[3];
+			memcpy(packed, in, sizeof(packed));
+			vertex.pos = boundsMin + glm::vec3(glm::unpackUnorm1x16(packed[0]), glm::unpackUnorm1x16(packed[1]), glm::unpackUnorm1x16(packed[2])) * extent;
+		}
+		else
+		{
+			float packed[3];
+			memcpy(packed, in, sizeof(packed));
+			vertex.pos = glm::vec3(packed[0], packed[1], packed[2]);
+		}
+
+		in = static_cast<const uint8_t*>(streams[1]) + i * attributeStride;
+
+		if (texCoord == TexCoordFormat::Float16)
+		{
+			uint16_t packed[2];
+			memcpy(packed, in, sizeof(packed));
+			vertex.texCoord = glm::vec2(glm::unpackHalf1x16(packed[0]), glm::unpackHalf1x16(packed[1]));
+		}
+		else if (texCoord == TexCoordFormat::Unorm16)
+		{
+			uint16_t packed[2];
+			memcpy(packed, in, sizeof(packed));
+			vertex.texCoord = glm::vec2(glm::unpackUnorm1x16(packed[0]), glm::unpackUnorm1x16(packed[1]));
+		}
+		else
+		{
+			float packed[2];
+			memcpy(packed, in, sizeof(packed));
+			vertex.texCoord = glm::vec2(packed[0], packed[1]);
+		}
+		in += GetTexCoordSize(texCoord);
+
+		if (color == ColorFormat::Unorm8)
+		{
+			uint32_t packed;
+			memcpy(&packed, in, sizeof(packed));
+			vertex.color = glm::vec3(glm::unpackUnorm4x8(packed));
+		}
+		else if (color == ColorFormat::Float32)
+		{
+			float packed[3];
+			memcpy(packed, in, sizeof(packed));
+			vertex.color = glm::vec3(packed[0], packed[1], packed[2]);
+		}
+		else
+		{
+			vertex.color = glm::vec3(1.0f);
+		}
+	}
+}
\ No newline at end of file
@@ -57,6 +57,72 @@ struct Vertex
 	}
 };
 
+// Vertex buffers are split into at most this many bindings
+const uint32_t MAX_VERTEX_STREAMS = 2;
+
+enum class PositionFormat : uint8_t
+{
+	Float32,
+	// 16 bit unorm relative to the mesh bounds, the mesh dequantization matrix maps it back into object space
+	Unorm16,
+};
+
+enum class TexCoordFormat : uint8_t
+{
+	Float32,
+	// half floats, the step near 1.0 is 1/2048 so very large textures lose sub texel precision
+	Float16,
+	// 16 bit unorm, only possible when every uv lies in [0, 1]
+	Unorm16,
+};
+
+enum class ColorFormat : uint8_t
+{
+	// no color data, the vertex color shader path can not be used with this format
+	None,
+	Float32,
+	Unorm8,
+};
+
+// GPU layout of the vertex data of a mesh.
+// The all Float32 format is the Vertex struct as is, a single interleaved stream.
+// Every other format keeps positions alone in stream 0 and packs uv and colors, if any, into stream 1,
+// so passes that only need positions (depth prepass, shadows) fetch nothing else.
+struct VertexFormat
+{
+	PositionFormat position = PositionFormat::Float32;
+	TexCoordFormat texCoord = TexCoordFormat::Float32;
+	ColorFormat color = ColorFormat::Float32;
+
+	static VertexFormat Full() { return VertexFormat(); }
+	// 12 bytes per vertex: quantized positions and unorm uvs, no colors
+	static VertexFormat Compact() { return { PositionFormat::Unorm16, TexCoordFormat::Unorm16, ColorFormat::None }; }
+
+	bool IsFull() const { return position == PositionFormat::Float32 && texCoord == TexCoordFormat::Float32 && color == ColorFormat::Float32; }
+	bool HasColor() const { return color != ColorFormat::None; }
+	bool operator==(const VertexFormat& other) const { return GetKey() == other.GetKey(); }
+
+	// Identifies the format in pipeline variants and the mesh cache
+	uint32_t GetKey() const;
+	// Returns false for keys that do not describe a format
+	static bool FromKey(uint32_t key, VertexFormat& format);
+
+	uint32_t GetStreamCount() const;
+	uint32_t GetStride(uint32_t stream) const;
+	// bPositionOnly describes just the position attribute of stream 0, for depth only pipelines
+	std::vector<VkVertexInputBindingDescription> GetBindingDescriptions(bool bPositionOnly = false) const;
+	std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(bool bPositionOnly = false) const;
+
+	// The format the vertices can actually be stored in, unorm uvs outside [0, 1] fall back to half floats
+	VertexFormat Resolve(const std::vector<Vertex>& vertices) const;
+	// Packs the vertices into one byte array per stream, quantized positions are relative to the bounds
+	void Encode(const std::vector<Vertex>& vertices, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+		std::array<std::vector<uint8_t>, MAX_VERTEX_STREAMS>& streams) const;
+	// Inverse of Encode within the precision of the format, formats without colors decode to white
+	void Decode(const std::array<const void*, MAX_VERTEX_STREAMS>& streams, uint64_t vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+		std::vector<Vertex>& vertices) const;
+};
+
 // Hash specialization
 namespace std
 {
@@ -0,0 +1,217 @@
+#include "pch.h"
+#include "VertexWelder.h"
+
+static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+#pragma region Hashing
+
+// Attribute bytes without struct padding, -0.0 is folded into 0.0 so equal floats hash the same
+struct WeldKey
+{
+	float values[8];
+};
+
+static WeldKey MakeKey(const Vertex& vertex)
+{
+	WeldKey key;
+	key.values[0] = vertex.pos.x + 0.0f;
+	key.values[1] = vertex.pos.y + 0.0f;
+	key.values[2] = vertex.pos.z + 0.0f;
+	key.values[3] = vertex.color.r + 0.0f;
+	key.values[4] = vertex.color.g + 0.0f;
+	key.values[5] = vertex.color.b + 0.0f;
+	key.values[6] = vertex.texCoord.x + 0.0f;
+	key.values[7] = vertex.texCoord.y + 0.0f;
+	return key;
+}
+
+static uint64_t Mix(uint64_t value)
+{
+	// splitmix64 finalizer
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9ull;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111ebull;
+	value ^= value >> 31;
+	return value;
+}
+
+// Multiply-mix over 64 bit words, every input bit affects every output bit
+static uint64_t HashWords(const uint64_t* words, size_t count)
+{
+	uint64_t hash = 0x9e3779b97f4a7c15ull ^ (count * 0xff51afd7ed558ccdull);
+	for (size_t i = 0; i < count; i++)
+	{
+		hash = (hash ^ Mix(words[i])) * 0x100000001b3ull;
+		hash = (hash << 27) | (hash >> 37);
+	}
+	return Mix(hash);
+}
+
+static uint64_t HashKey(const WeldKey& key)
+{
+	uint64_t words[4];
+	memcpy(words, key.values, sizeof(words));
+	return HashWords(words, 4);
+}
+
+// Position replaced by its grid cell, color and uv still exact
+static uint64_t HashCell(const glm::ivec3& cell, const WeldKey& key)
+{
+	uint64_t words[5] = {};
+	words[0] = static_cast<uint32_t>(cell.x) | (static_cast<uint64_t>(static_cast<uint32_t>(cell.y)) << 32);
+	words[1] = static_cast<uint32_t>(cell.z);
+	memcpy(&words[2], &key.values[3], sizeof(float) * 5);
+	return HashWords(words, 5);
+}
+
+#pragma endregion
+
+Resource::VertexWelder::VertexWelder(size_t expectedVertexCount, const WeldSettings& settings)
+	: _settings(settings)
+{
+	_cellSize = _settings.positionEpsilon * 2.0f;
+
+	// keep the load factor at or below 0.5
+	size_t capacity = 64;
+	while (capacity < expectedVertexCount * 2)
+		capacity <<= 1;
+
+	_slots.assign(capacity, EMPTY_SLOT);
+	_slotHashes.assign(capacity, 0);
+	_mask = capacity - 1;
+	_vertices.reserve(expectedVertexCount);
+}
+
+uint32_t Resource::VertexWelder::Insert(const Vertex& vertex)
+{
+	if (_settings.positionEpsilon > 0.0f)
+		return InsertWithEpsilon(vertex);
+	return InsertExact(vertex);
+}
+
+void Resource::VertexWelder::Weld(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+	const WeldSettings& settings)
+{
+	// most meshes share every vertex between ~6 triangles, corners / 4 avoids regrowing in the common case
+	VertexWelder welder(corners.size() / 4 + 1, settings);
+
+	indices.resize(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		indices[i] = welder.Insert(corners[i]);
+	}
+
+	vertices = std::move(welder.GetVertices());
+}
+
+uint32_t Resource::VertexWelder::InsertExact(const Vertex& vertex)
+{
+	uint64_t hash = HashKey(MakeKey(vertex));
+
+	uint32_t index = Find(hash, vertex, nullptr);
+	if (index != EMPTY_SLOT)
+		return index;
+
+	return Add(hash, vertex);
+}
+
+uint32_t Resource::VertexWelder::InsertWithEpsilon(const Vertex& vertex)
+{
+	WeldKey key = MakeKey(vertex);
+	glm::vec3 scaled = vertex.pos / _cellSize;
+	glm::ivec3 cell = GetCell(vertex.pos);
+
+	// The cell itself plus the neighbor on the nearer side along each axis
+	glm::ivec3 step;
+	for (int axis = 0; axis < 3; axis++)
+		step[axis] = (scaled[axis] - std::floor(scaled[axis])) < 0.5f ? -1 : 1;
+
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::ivec3 neighbor = cell;
+		if (corner & 1) neighbor.x += step.x;
+		if (corner & 2) neighbor.y += step.y;
+		if (corner & 4) neighbor.z += step.z;
+
+		uint32_t index = Find(HashCell(neighbor, key), vertex, &neighbor);
+		if (index != EMPTY_SLOT)
+			return index;
+	}
+
+	return Add(HashCell(cell, key), vertex);
+}
+
+uint32_t Resource::VertexWelder::Find(uint64_t hash, const Vertex& vertex, const glm::ivec3* cell) const
+{
+	for (size_t slot = hash & _mask; _slots[slot] != EMPTY_SLOT; slot = (slot + 1) & _mask)
+	{
+		if (_slotHashes[slot] != hash)
+			continue;
+
+		const Vertex& candidate = _vertices[_slots[slot]];
+		if (candidate.color != vertex.color || candidate.texCoord != vertex.texCoord)
+			continue;
+
+		if (cell == nullptr)
+		{
+			if (candidate.pos == vertex.pos)
+				return _slots[slot];
+		}
+		else if (GetCell(candidate.pos) == *cell)
+		{
+			glm::vec3 delta = candidate.pos - vertex.pos;
+			if (glm::dot(delta, delta) <= _settings.positionEpsilon * _settings.positionEpsilon)
+				return _slots[slot];
+		}
+	}
+
+	return EMPTY_SLOT;
+}
+
+uint32_t Resource::VertexWelder::Add(uint64_t hash, const Vertex& vertex)
+{
+	if ((_vertices.size() + 1) * 2 > _slots.size())
+		Grow();
+
+	uint32_t index = static_cast<uint32_t>(_vertices.size());
+	_vertices.push_back(vertex);
+
+	size_t slot = hash & _mask;
+	while (_slots[slot] != EMPTY_SLOT)
+		slot = (slot + 1) & _mask;
+
+	_slots[slot] = index;
+	_slotHashes[slot] = hash;
+	return index;
+}
+
+void Resource::VertexWelder::Grow()
+{
+	std::vector<uint32_t> oldSlots = std::move(_slots);
+	std::vector<uint64_t> oldHashes = std::move(_slotHashes);
+
+	size_t capacity = oldSlots.size() * 2;
+	_slots.assign(capacity, EMPTY_SLOT);
+	_slotHashes.assign(capacity, 0);
+	_mask = capacity - 1;
+
+	// the stored hashes are reused, vertices are never hashed twice
+	for (size_t i = 0; i < oldSlots.size(); i++)
+	{
+		if (oldSlots[i] == EMPTY_SLOT)
+			continue;
+
+		size_t slot = oldHashes[i] & _mask;
+		while (_slots[slot] != EMPTY_SLOT)
+			slot = (slot + 1) & _mask;
+
+		_slots[slot] = oldSlots[i];
+		_slotHashes[slot] = oldHashes[i];
+	}
+}
+
+glm::ivec3 Resource::VertexWelder::GetCell(const glm::vec3& position) const
+{
+	return glm::ivec3(glm::floor(position / _cellSize));
+}
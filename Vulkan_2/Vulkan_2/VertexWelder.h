@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Vertex.h"
+
+namespace Resource
+{
+	struct WeldSettings
+	{
+		// 0 welds bitwise identical vertices only. Otherwise positions closer than this are merged,
+		// color and uv still have to match exactly. The first vertex inserted keeps its position.
+		float positionEpsilon = 0.0f;
+	};
+
+	// Deduplicates vertices through a flat open addressing table (linear probing, power of two capacity).
+	// Keys are hashed over the raw attribute bytes, indices are handed out in first seen order
+	// so the output only depends on the insertion order.
+	class VertexWelder
+	{
+	public:
+		VertexWelder(size_t expectedVertexCount, const WeldSettings& settings = WeldSettings());
+
+		// Returns the index of the unique vertex matching the given one, adding it if there is none
+		uint32_t Insert(const Vertex& vertex);
+
+		// Welds a flat list of triangle corners into a vertex and index array
+		static void Weld(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+			const WeldSettings& settings = WeldSettings());
+
+	private:
+		uint32_t InsertExact(const Vertex& vertex);
+		uint32_t InsertWithEpsilon(const Vertex& vertex);
+		uint32_t Find(uint64_t hash, const Vertex& vertex, const glm::ivec3* cell) const;
+		uint32_t Add(uint64_t hash, const Vertex& vertex);
+		void Grow();
+		glm::ivec3 GetCell(const glm::vec3& position) const;
+
+	public:
+#pragma region Getters
+
+		std::vector<Vertex>& GetVertices() { return _vertices; }
+		size_t GetCapacity() const { return _slots.size(); }
+
+#pragma endregion
+
+	private:
+		WeldSettings _settings;
+		// 2 * epsilon, a vertex within epsilon of a position can then only be in that cell or its neighbor towards it
+		float _cellSize = 0.0f;
+
+		// vertex index per slot, EMPTY_SLOT when unused
+		std::vector<uint32_t> _slots;
+		// full hash per slot, compared before touching the vertex itself
+		std::vector<uint64_t> _slotHashes;
+		size_t _mask = 0;
+
+		std::vector<Vertex> _vertices;
+	};
+}
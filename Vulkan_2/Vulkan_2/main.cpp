@@ -8,9 +8,32 @@
 
 #include "Constants.h"
 #include "Application.h"
+#include "Benchmarks.h"
+#include "TextureCooker.h"
 
-int main() 
+int main(int argc, char* argv[])
 {
+    // Vulkan_2.exe --bench-weld [model.obj]
+    if (argc >= 2 && std::string(argv[1]) == "--bench-weld")
+    {
+        return Benchmarks::RunWeldBenchmark(argc >= 3 ? argv[2] : nullptr);
+    }
+    // Vulkan_2.exe --bench-import model.obj
+    if (argc >= 3 && std::string(argv[1]) == "--bench-import")
+    {
+        return Benchmarks::RunImportBenchmark(argv[2]);
+    }
+    // Vulkan_2.exe --bench-skinning
+    if (argc >= 2 && std::string(argv[1]) == "--bench-skinning")
+    {
+        return Benchmarks::RunSkinningBenchmark();
+    }
+    // Vulkan_2.exe --cook-textures [--format rgba8|bc1|bc3|bc5|bc7] [--linear] texture.png [texture.png...]
+    if (argc >= 3 && std::string(argv[1]) == "--cook-textures")
+    {
+        return Resource::TextureCooker::RunCookTextures(argc - 2, argv + 2);
+    }
+
 #pragma region Compile shaders
 
     std::filesystem::path exePath = std::filesystem::current_path();
@@ -1,5 +1,7 @@
 #pragma once
 
+// keep windows.h from defining min/max macros that break std::min/std::max
+#define NOMINMAX
 #define VK_USE_PLATFORM_WIN32_KHR
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -1,14 +1,60 @@
 @echo off
+setlocal
 
-D:\Libraries\VulkanSDK\1.3.296.0\Bin\glslc.exe shader.vert -o vert.spv
+REM glslc of the installed Vulkan SDK, or the one on the PATH when VULKAN_SDK is not set
+if defined VULKAN_SDK (
+	set GLSLC="%VULKAN_SDK%\Bin\glslc.exe"
+) else (
+	set GLSLC=glslc
+)
+
+%GLSLC% shader.vert -o vert.spv
 if %errorlevel% neq 0 (
 	echo Failed to compile shader.vert
 	exit /b 1
 	)
 
-D:\Libraries\VulkanSDK\1.3.296.0\Bin\glslc.exe shader.frag -o frag.spv
+%GLSLC% shader.frag -o frag.spv
 if %errorlevel% neq 0 (
-	echo Failed to compile shader.vert
+	echo Failed to compile shader.frag
+	exit /b 1
+	)
+
+REM Define based permutations: <stage>_<DEFINE>[_<DEFINE>...].spv in the order the features are declared
+%GLSLC% -DDEPTH_ONLY shader.vert -o vert_DEPTH_ONLY.spv
+if %errorlevel% neq 0 (
+	echo Failed to compile shader.vert with DEPTH_ONLY
+	exit /b 1
+	)
+
+%GLSLC% -DALPHA_TEST shader.frag -o frag_ALPHA_TEST.spv
+if %errorlevel% neq 0 (
+	echo Failed to compile shader.frag with ALPHA_TEST
+	exit /b 1
+	)
+
+%GLSLC% -DBINDLESS shader.frag -o frag_BINDLESS.spv
+if %errorlevel% neq 0 (
+	echo Failed to compile shader.frag with BINDLESS
+	exit /b 1
+	)
+
+%GLSLC% -DALPHA_TEST -DBINDLESS shader.frag -o frag_ALPHA_TEST_BINDLESS.spv
+if %errorlevel% neq 0 (
+	echo Failed to compile shader.frag with ALPHA_TEST BINDLESS
+	exit /b 1
+	)
+
+REM Compute shaders
+%GLSLC% downsample.comp -o downsample.spv
+if %errorlevel% neq 0 (
+	echo Failed to compile downsample.comp
+	exit /b 1
+	)
+
+%GLSLC% skinning.comp -o skinning.spv
+if %errorlevel% neq 0 (
+	echo Failed to compile skinning.comp
 	exit /b 1
 	)
 	
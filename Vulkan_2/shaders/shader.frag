@@ -1,6 +1,25 @@
 #version 450
 
-layout(binding = 1) uniform sampler2D texSampler;
+#ifdef BINDLESS
+// SHADER_FEATURE_BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 1, binding = 0) uniform sampler texSampler;
+layout(set = 1, binding = 1) uniform texture2DArray textures[];
+#else
+layout(set = 1, binding = 0) uniform sampler2DArray texSampler;
+#endif
+
+// Per draw data, matches DrawPushConstants
+layout(push_constant) uniform DrawPushConstants
+{
+    mat4 model;
+    uint textureIndex;
+    uint textureLayer;
+} draw;
+
+// SHADER_FEATURE_TEXTURE
+layout(constant_id = 0) const bool USE_TEXTURE = true;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -8,5 +27,23 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 color = vec4(fragColor, 1.0);
+    if (USE_TEXTURE)
+    {
+        // every texture is an array view, packed textures share the view of their array and pick their layer
+        vec3 texCoord = vec3(fragTexCoord, float(draw.textureLayer));
+#ifdef BINDLESS
+        color *= texture(sampler2DArray(textures[draw.textureIndex], texSampler), texCoord);
+#else
+        color *= texture(texSampler, texCoord);
+#endif
+    }
+
+#ifdef ALPHA_TEST
+    // SHADER_FEATURE_ALPHA_TEST
+    if (color.a < 0.5)
+        discard;
+#endif
+
+    outColor = color;
 }
\ No newline at end of file
@@ -1,22 +1,41 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject
+layout(set = 0, binding = 0) uniform UniformBufferObject
 {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
+// Per draw data, matches DrawPushConstants
+layout(push_constant) uniform DrawPushConstants
+{
+    mat4 model;
+    uint textureIndex;
+    uint textureLayer;
+} draw;
+
+// SHADER_FEATURE_VERTEX_COLOR
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = false;
+
+// Formats come from the VertexFormat of the mesh, quantized positions are dequantized by draw.model.
+// Layouts without colors alias inColor to the position, only read with USE_VERTEX_COLOR
 layout(location = 0) in vec3 inPosition;
+#ifndef DEPTH_ONLY
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+#endif
+
+// The shading pass tests against the depth of the DEPTH_ONLY prepass, both must produce the exact same depth
+invariant gl_Position;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * draw.model * vec4(inPosition, 1.0);
     //gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
+#ifndef DEPTH_ONLY
+    fragColor = USE_VERTEX_COLOR ? inColor : vec3(1.0);
     fragTexCoord = inTexCoord;
+#endif
 }
\ No newline at end of file